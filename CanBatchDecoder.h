@@ -0,0 +1,196 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanBatchDecoder.h
+ *
+ * Purpose:
+ *    Decodes a contiguous array of CanMsg sharing the same id into one output
+ *    array per field (struct-of-arrays), e.g. for voyage log processing.
+ *
+ * Developer Notes:
+ *    Payload words are first loaded into a small scratch buffer, then every field is
+ *    extracted by its own loop over that buffer. Those loops are plain shift/mask or
+ *    multiply/add over contiguous arrays, which the compiler vectorizes.
+ *
+ *    All messages given to a decode function MUST have the id of the message type,
+ *    ids are not checked inside the loops.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANBATCHDECODER_H
+#define SAILINGROBOT_CANBATCHDECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CanMessageSchema.h"
+#include "CanPayload.h"
+#include "Float16Compressor.h"
+
+/**
+ * Output columns for MSG_ID_MARINE_SENSOR_DATA, raw encoded values.
+ * A NULL column is skipped.
+ */
+struct MarineSensorColumns {
+    MarineSensorData::Ph::ValueType* ph;
+    MarineSensorData::Conductivity::ValueType* conductivity;
+    MarineSensorData::Temperature::ValueType* temperature;
+    MarineSensorData::Error::ValueType* error;
+};
+
+/**
+ * Output columns for MSG_ID_CURRENT_SENSOR_DATA, voltage and current are decompressed
+ * from half precision. A NULL column is skipped.
+ */
+struct CurrentSensorColumns {
+    float* voltage;
+    float* current;
+    CurrentSensorData::Error::ValueType* error;
+    CurrentSensorData::RollingNumber::ValueType* rollingNumber;
+    CurrentSensorData::SensorId::ValueType* sensorId;
+};
+
+class CanBatchDecoder {
+   public:
+#ifdef ON_ARDUINO_BOARD
+    static const size_t CHUNK_SIZE = 16;
+#else
+    static const size_t CHUNK_SIZE = 256;
+#endif
+
+    /**
+     * Loads the payload words of count messages, see CanPayload.h
+     */
+    static inline void loadPayloads(const CanMsg* messages, size_t count, uint64_t* payloads) {
+        for (size_t i = 0; i < count; i++) {
+            payloads[i] = CanPayload::load(messages[i].data);
+        }
+    }
+
+    /**
+     * Extracts the raw value of one field from count payload words
+     */
+    template <class Field>
+    static inline void extractColumn(const uint64_t* payloads, size_t count,
+                                     typename Field::ValueType* column) {
+        for (size_t i = 0; i < count; i++) {
+            column[i] = Field::get(payloads[i]);
+        }
+    }
+
+    /**
+     * Extracts one field and maps it from [0, 2^length - 1] to [minValue, maxValue],
+     * same formula as CanMessageHandler::getMappedData()
+     */
+    template <class Field>
+    static inline void extractMappedColumn(const uint64_t* payloads, size_t count, float* column,
+                                           long int minValue, long int maxValue) {
+        const float fromMax = static_cast<float>(Field::MASK);
+        const float toMin = static_cast<float>(minValue);
+        const float toRange = static_cast<float>(maxValue) - toMin;
+        for (size_t i = 0; i < count; i++) {
+            column[i] = (static_cast<float>(Field::get(payloads[i])) / fromMax) * toRange + toMin;
+        }
+    }
+
+    /**
+     * Decodes the raw value of one field of count messages
+     */
+    template <class Field>
+    static void decodeColumn(const CanMsg* messages, size_t count, typename Field::ValueType* column) {
+        uint64_t payloads[CHUNK_SIZE];
+        for (size_t done = 0; done < count; done += CHUNK_SIZE) {
+            size_t chunk = (count - done < CHUNK_SIZE) ? count - done : CHUNK_SIZE;
+            loadPayloads(messages + done, chunk, payloads);
+            extractColumn<Field>(payloads, chunk, column + done);
+        }
+    }
+
+    /**
+     * Decodes one field of count messages mapped onto [minValue, maxValue]
+     */
+    template <class Field>
+    static void decodeMappedColumn(const CanMsg* messages, size_t count, float* column,
+                                   long int minValue, long int maxValue) {
+        uint64_t payloads[CHUNK_SIZE];
+        for (size_t done = 0; done < count; done += CHUNK_SIZE) {
+            size_t chunk = (count - done < CHUNK_SIZE) ? count - done : CHUNK_SIZE;
+            loadPayloads(messages + done, chunk, payloads);
+            extractMappedColumn<Field>(payloads, chunk, column + done, minValue, maxValue);
+        }
+    }
+
+    /**
+     * Decodes a 16 bits half precision field of count messages
+     */
+    template <class Field>
+    static void decodeFloat16Column(const CanMsg* messages, size_t count, float* column) {
+        static_assert(Field::LENGTH == 16, "decodeFloat16Column: field is not 16 bits long");
+        uint64_t payloads[CHUNK_SIZE];
+        uint16_t halves[CHUNK_SIZE];
+        for (size_t done = 0; done < count; done += CHUNK_SIZE) {
+            size_t chunk = (count - done < CHUNK_SIZE) ? count - done : CHUNK_SIZE;
+            loadPayloads(messages + done, chunk, payloads);
+            extractColumn<Field>(payloads, chunk, halves);
+            Float16Compressor::decompress(halves, column + done, chunk);
+        }
+    }
+
+    /**
+     * Decodes count MSG_ID_MARINE_SENSOR_DATA messages into columns
+     * @return the number of decoded messages
+     */
+    static size_t decode(const CanMsg* messages, size_t count, const MarineSensorColumns& columns) {
+        uint64_t payloads[CHUNK_SIZE];
+        for (size_t done = 0; done < count; done += CHUNK_SIZE) {
+            size_t chunk = (count - done < CHUNK_SIZE) ? count - done : CHUNK_SIZE;
+            loadPayloads(messages + done, chunk, payloads);
+            if (columns.ph) {
+                extractColumn<MarineSensorData::Ph>(payloads, chunk, columns.ph + done);
+            }
+            if (columns.conductivity) {
+                extractColumn<MarineSensorData::Conductivity>(payloads, chunk, columns.conductivity + done);
+            }
+            if (columns.temperature) {
+                extractColumn<MarineSensorData::Temperature>(payloads, chunk, columns.temperature + done);
+            }
+            if (columns.error) {
+                extractColumn<MarineSensorData::Error>(payloads, chunk, columns.error + done);
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Decodes count MSG_ID_CURRENT_SENSOR_DATA messages into columns
+     * @return the number of decoded messages
+     */
+    static size_t decode(const CanMsg* messages, size_t count, const CurrentSensorColumns& columns) {
+        uint64_t payloads[CHUNK_SIZE];
+        uint16_t halves[CHUNK_SIZE];
+        for (size_t done = 0; done < count; done += CHUNK_SIZE) {
+            size_t chunk = (count - done < CHUNK_SIZE) ? count - done : CHUNK_SIZE;
+            loadPayloads(messages + done, chunk, payloads);
+            if (columns.voltage) {
+                extractColumn<CurrentSensorData::Voltage>(payloads, chunk, halves);
+                Float16Compressor::decompress(halves, columns.voltage + done, chunk);
+            }
+            if (columns.current) {
+                extractColumn<CurrentSensorData::Current>(payloads, chunk, halves);
+                Float16Compressor::decompress(halves, columns.current + done, chunk);
+            }
+            if (columns.error) {
+                extractColumn<CurrentSensorData::Error>(payloads, chunk, columns.error + done);
+            }
+            if (columns.rollingNumber) {
+                extractColumn<CurrentSensorData::RollingNumber>(payloads, chunk, columns.rollingNumber + done);
+            }
+            if (columns.sensorId) {
+                extractColumn<CurrentSensorData::SensorId>(payloads, chunk, columns.sensorId + done);
+            }
+        }
+        return count;
+    }
+};
+
+#endif  // SAILINGROBOT_CANBATCHDECODER_H
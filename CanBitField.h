@@ -0,0 +1,149 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanBitField.h
+ *
+ * Purpose:
+ *    Byte-wise extraction and insertion of bit fields in the 8 data bytes of a CanMsg,
+ *    for the AVR boards where shifting a 64 bits word costs a library call per shift.
+ *
+ * Developer Notes:
+ *    Bit positions are the ones of the payload word (see CanPayload.h): bit 0 is the
+ *    lowest bit of CanMsg.data[7], bit 63 the highest bit of CanMsg.data[0]. Results
+ *    are identical to the shift and mask on the payload word used on the RPI.
+ *
+ *    Only the bytes holding the field are read or written, bytesTouched() of them, and
+ *    every shift is an 8 bits shift. Nothing is allocated.
+ *
+ *    CANBUS_BYTEWISE_CODEC selects this codec in CanMessageHandler. It is on by default
+ *    on Arduino boards and can be forced on the RPI (-DCANBUS_BYTEWISE_CODEC=1) to
+ *    check that both codecs agree.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANBITFIELD_H
+#define SAILINGROBOT_CANBITFIELD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "CanPayload.h"
+#include "canbus_global_defs.h"
+
+#ifndef CANBUS_BYTEWISE_CODEC
+ #ifdef ON_ARDUINO_BOARD
+  #define CANBUS_BYTEWISE_CODEC 1
+ #else
+  #define CANBUS_BYTEWISE_CODEC 0
+ #endif
+#endif
+
+class CanBitField {
+   public:
+    /**
+     * @return the number of data bytes holding the field
+     */
+    static inline uint8_t bytesTouched(uint8_t start, uint8_t length) {
+        if (length == 0) {
+            return 0;
+        }
+        return static_cast<uint8_t>(((start + length - 1) >> 3) - (start >> 3) + 1);
+    }
+
+    /**
+     * Reads a field, start + length must not be above 64
+     *
+     * @tparam R uint32_t or uint64_t, length must fit in it
+     * @return the field value
+     */
+    template <class R>
+    static inline R get(const uint8_t* data, uint8_t start, uint8_t length) {
+        uint8_t bytes[sizeof(R)];
+        uint8_t offset = start & 7;
+        int8_t index = static_cast<int8_t>(CanPayload::PAYLOAD_SIZE_IN_BYTES - 1 - (start >> 3));
+        uint8_t fieldBytes = static_cast<uint8_t>((length + 7) >> 3);
+
+        for (uint8_t i = 0; i < sizeof(R); i++, index--) {
+            if (i >= fieldBytes) {
+                bytes[i] = 0;
+                continue;
+            }
+            uint8_t value = static_cast<uint8_t>(data[index] >> offset);
+            if (offset != 0 && index > 0) {
+                value |= static_cast<uint8_t>(data[index - 1] << (8 - offset));
+            }
+            bytes[i] = value;
+        }
+        if (length & 7) {
+            bytes[fieldBytes - 1] &= static_cast<uint8_t>(0xFF >> (8 - (length & 7)));
+        }
+        return fromLittleEndian<R>(bytes);
+    }
+
+    /**
+     * Overwrites a field, bits of value above length are dropped. start + length must
+     * not be above 64.
+     *
+     * @tparam R uint32_t or uint64_t, length must fit in it
+     */
+    template <class R>
+    static inline void set(uint8_t* data, uint8_t start, uint8_t length, R value) {
+        if (length == 0) {
+            return;
+        }
+        // Field value and mask as little-endian bytes, one spare byte for the shift
+        uint8_t bytes[sizeof(R) + 1];
+        uint8_t masks[sizeof(R) + 1];
+        toLittleEndian(value, bytes);
+        bytes[sizeof(R)] = 0;
+        uint8_t fieldBytes = static_cast<uint8_t>((length + 7) >> 3);
+        for (uint8_t i = 0; i <= sizeof(R); i++) {
+            masks[i] = (i < fieldBytes) ? 0xFF : 0;
+        }
+        if (length & 7) {
+            masks[fieldBytes - 1] = static_cast<uint8_t>(0xFF >> (8 - (length & 7)));
+        }
+
+        uint8_t offset = start & 7;
+        int8_t index = static_cast<int8_t>(CanPayload::PAYLOAD_SIZE_IN_BYTES - 1 - (start >> 3));
+        uint8_t touched = bytesTouched(start, length);
+        // index >= 0 holds with start + length <= 64, it bounds the writes for the compiler
+        for (uint8_t i = 0; i < touched && index >= 0; i++, index--) {
+            uint8_t byteValue = static_cast<uint8_t>(bytes[i] << offset);
+            uint8_t byteMask = static_cast<uint8_t>(masks[i] << offset);
+            if (offset != 0 && i > 0) {
+                byteValue |= static_cast<uint8_t>(bytes[i - 1] >> (8 - offset));
+                byteMask |= static_cast<uint8_t>(masks[i - 1] >> (8 - offset));
+            }
+            data[index] = static_cast<uint8_t>((data[index] & ~byteMask) | (byteValue & byteMask));
+        }
+    }
+
+   private:
+    template <class R>
+    static inline R fromLittleEndian(const uint8_t* bytes) {
+        R value = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        memcpy(&value, bytes, sizeof(R));
+#else
+        for (uint8_t i = sizeof(R); i > 0; i--) {
+            value = static_cast<R>((value << 8) | bytes[i - 1]);
+        }
+#endif
+        return value;
+    }
+
+    template <class R>
+    static inline void toLittleEndian(R value, uint8_t* bytes) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        memcpy(bytes, &value, sizeof(R));
+#else
+        for (uint8_t i = 0; i < sizeof(R); i++) {
+            bytes[i] = static_cast<uint8_t>(value);
+            value >>= 8;
+        }
+#endif
+    }
+};
+
+#endif  // SAILINGROBOT_CANBITFIELD_H
@@ -0,0 +1,101 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanBusLoadMonitor.cpp
+ *
+ * Purpose:
+ *    Sliding window sums of CanBusLoadMonitor
+ *
+ * Developer Notes:
+ *    Compiled out on Arduino boards, the Arduino IDE builds every source file of
+ *    the library.
+ *
+ ***************************************************************************************/
+
+#include "canbus_global_defs.h"
+
+#ifndef ON_ARDUINO_BOARD
+
+#include "CanBusLoadMonitor.h"
+
+namespace {
+
+const uint64_t NO_EPOCH = ~0ULL;
+const float NANOSECONDS_PER_SECOND = 1e9f;
+
+}  // namespace
+
+CanBusLoadMonitor::CanBusLoadMonitor(uint32_t bitrate, uint32_t windowMs)
+    : m_bitrate(bitrate),
+      m_bucketNs(static_cast<uint64_t>(windowMs > 0 ? windowMs : 1) * 1000000ULL / BUCKET_COUNT),
+      m_firstTimestampNs(NO_TIMESTAMP) {
+    if (m_bucketNs == 0) {
+        m_bucketNs = 1;
+    }
+    for (uint8_t i = 0; i < BUCKET_COUNT; i++) {
+        m_buckets[i].reset(NO_EPOCH);
+    }
+}
+
+void CanBusLoadMonitor::Bucket::reset(uint64_t newEpoch) {
+    worstCaseBits.store(0, std::memory_order_relaxed);
+    for (uint8_t i = 0; i < CanBusLoadSnapshot::ID_COUNT; i++) {
+        ids[i].frames.store(0, std::memory_order_relaxed);
+        ids[i].bytes.store(0, std::memory_order_relaxed);
+        ids[i].bits.store(0, std::memory_order_relaxed);
+    }
+    epoch.store(newEpoch, std::memory_order_release);
+}
+
+void CanBusLoadMonitor::snapshot(uint64_t nowNs, CanBusLoadSnapshot& snapshot) const {
+    uint64_t nowEpoch = nowNs / m_bucketNs;
+    uint32_t bytes[CanBusLoadSnapshot::ID_COUNT] = {};
+    uint32_t bits[CanBusLoadSnapshot::ID_COUNT] = {};
+
+    snapshot.frames = 0;
+    snapshot.bits = 0;
+    snapshot.worstCaseBits = 0;
+    for (uint8_t i = 0; i < CanBusLoadSnapshot::ID_COUNT; i++) {
+        snapshot.ids[i].messageId = (i == OTHER_IDS) ? 0 : CanMessageRegistry::descriptorAt(i).id;
+        snapshot.ids[i].frames = 0;
+    }
+
+    for (uint8_t b = 0; b < BUCKET_COUNT; b++) {
+        const Bucket& bucket = m_buckets[b];
+        uint64_t epoch = bucket.epoch.load(std::memory_order_acquire);
+        if (epoch == NO_EPOCH || epoch > nowEpoch || nowEpoch - epoch >= BUCKET_COUNT) {
+            continue;  // outside of the window
+        }
+        snapshot.worstCaseBits += bucket.worstCaseBits.load(std::memory_order_relaxed);
+        for (uint8_t i = 0; i < CanBusLoadSnapshot::ID_COUNT; i++) {
+            snapshot.ids[i].frames += bucket.ids[i].frames.load(std::memory_order_relaxed);
+            bytes[i] += bucket.ids[i].bytes.load(std::memory_order_relaxed);
+            bits[i] += bucket.ids[i].bits.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Full buckets and the elapsed part of the current one, less if the monitor started later
+    uint64_t windowNs = (BUCKET_COUNT - 1) * m_bucketNs + (nowNs - nowEpoch * m_bucketNs);
+    uint64_t firstTimestampNs = m_firstTimestampNs.load(std::memory_order_relaxed);
+    if (firstTimestampNs != NO_TIMESTAMP && nowNs > firstTimestampNs && nowNs - firstTimestampNs < windowNs) {
+        windowNs = nowNs - firstTimestampNs;
+    }
+    snapshot.windowNs = windowNs;
+    float windowSeconds = (windowNs > 0) ? static_cast<float>(windowNs) / NANOSECONDS_PER_SECOND : 1.0f;
+
+    for (uint8_t i = 0; i < CanBusLoadSnapshot::ID_COUNT; i++) {
+        CanIdLoad& load = snapshot.ids[i];
+        load.framesPerSecond = static_cast<float>(load.frames) / windowSeconds;
+        load.bytesPerSecond = static_cast<float>(bytes[i]) / windowSeconds;
+        load.bitsPerSecond = static_cast<float>(bits[i]) / windowSeconds;
+        snapshot.frames += load.frames;
+        snapshot.bits += bits[i];
+    }
+
+    float capacity = static_cast<float>(m_bitrate) * windowSeconds;
+    snapshot.utilization = (capacity > 0) ? 100.0f * static_cast<float>(snapshot.bits) / capacity : 0.0f;
+    snapshot.worstCaseUtilization =
+        (capacity > 0) ? 100.0f * static_cast<float>(snapshot.worstCaseBits) / capacity : 0.0f;
+}
+
+#endif  // ON_ARDUINO_BOARD
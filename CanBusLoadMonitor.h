@@ -0,0 +1,158 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanBusLoadMonitor.h
+ *
+ * Purpose:
+ *    Bus load instrumentation fed with every frame sent or received: exact on-wire
+ *    bits of each frame (CanUtility::exactFrameBits()), sliding window frame, byte
+ *    and bit rates per message id of CanMessageRegistry, and the bus utilization.
+ *
+ *      CanBusLoadMonitor monitor(250000);   // bus bitrate
+ *      monitor.record(message);             // bus thread, every TX and RX frame
+ *
+ *      CanBusLoadSnapshot load;
+ *      monitor.snapshot(load);              // any thread
+ *      if (load.utilization > 70.0f) { ... }
+ *
+ * Developer Notes:
+ *    RPI only, relies on std::atomic.
+ *
+ *    The window is split into BUCKET_COUNT buckets. record() is called by a single
+ *    thread: it resets a bucket when the time moves into it and adds relaxed atomic
+ *    counts. snapshot() can be called from any thread and sums the buckets of the
+ *    window, a bucket being reset at the same time may be counted partly.
+ *
+ *    Ids outside the registry, extended ids included, are counted together in the
+ *    OTHER_IDS entry.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANBUSLOADMONITOR_H
+#define SAILINGROBOT_CANBUSLOADMONITOR_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+#include "CanMessageRegistry.h"
+#include "CanUtility.h"
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "CanBusLoadMonitor.h is only available on the RPI"
+#endif
+
+struct CanIdLoad {
+    uint32_t messageId;  // 0 for OTHER_IDS
+    uint32_t frames;     // in the window
+    float framesPerSecond;
+    float bytesPerSecond;  // data bytes
+    float bitsPerSecond;   // on-wire bits
+};
+
+struct CanBusLoadSnapshot {
+    static const uint8_t ID_COUNT = CanMessageRegistry::SLOT_COUNT + 1;
+
+    uint64_t windowNs;          // time the rates are computed over
+    uint32_t frames;
+    uint32_t bits;              // on-wire bits, stuff bits included
+    uint32_t worstCaseBits;     // with the most stuff bits the frames could have needed
+    float utilization;          // percent of the bitrate
+    float worstCaseUtilization;
+    CanIdLoad ids[ID_COUNT];    // by registry slot, OTHER_IDS last
+};
+
+class CanBusLoadMonitor {
+   public:
+    static const uint8_t BUCKET_COUNT = 10;
+    static const uint8_t OTHER_IDS = CanMessageRegistry::SLOT_COUNT;
+
+    /**
+     * @param bitrate bus bitrate in bits per second
+     * @param windowMs length of the sliding window
+     */
+    explicit CanBusLoadMonitor(uint32_t bitrate, uint32_t windowMs = 1000);
+
+    CanBusLoadMonitor(const CanBusLoadMonitor&) = delete;
+    CanBusLoadMonitor& operator=(const CanBusLoadMonitor&) = delete;
+
+    /**
+     * Single thread only
+     *
+     * @param timestampNs send or receive time, any monotonic clock
+     * @return the on-wire bits of the frame
+     */
+    uint16_t record(const CanMsg& message, uint64_t timestampNs) {
+        uint8_t length = (message.header.length > 8) ? 8 : message.header.length;
+        bool extendedId = message.header.ide != 0;
+        uint16_t bits = CanUtility::exactFrameBits(message.id, extendedId, message.data, length);
+
+        uint64_t epoch = timestampNs / m_bucketNs;
+        Bucket& bucket = m_buckets[epoch % BUCKET_COUNT];
+        if (bucket.epoch.load(std::memory_order_relaxed) != epoch) {
+            bucket.reset(epoch);
+        }
+        if (m_firstTimestampNs.load(std::memory_order_relaxed) == NO_TIMESTAMP) {
+            m_firstTimestampNs.store(timestampNs, std::memory_order_relaxed);
+        }
+
+        uint8_t slot = CanMessageRegistry::slotOf(message.id);
+        Counters& counters = bucket.ids[(slot == CanMessageRegistry::NO_SLOT || extendedId) ? OTHER_IDS : slot];
+        add(counters.frames, 1);
+        add(counters.bytes, length);
+        add(counters.bits, bits);
+        add(bucket.worstCaseBits, CanUtility::worstCaseFrameBits(length, extendedId));
+        return bits;
+    }
+
+    /**
+     * Single thread only, timestamped with std::chrono::steady_clock
+     */
+    uint16_t record(const CanMsg& message) { return record(message, now()); }
+
+    /**
+     * Safe from any number of threads
+     *
+     * @param nowNs current time, same clock as record()
+     */
+    void snapshot(uint64_t nowNs, CanBusLoadSnapshot& snapshot) const;
+
+    void snapshot(CanBusLoadSnapshot& snapshot) const { this->snapshot(now(), snapshot); }
+
+    uint32_t bitrate() const { return m_bitrate; }
+
+   private:
+    static const uint64_t NO_TIMESTAMP = ~0ULL;
+
+    struct Counters {
+        std::atomic<uint32_t> frames;
+        std::atomic<uint32_t> bytes;
+        std::atomic<uint32_t> bits;
+    };
+
+    struct alignas(64) Bucket {
+        std::atomic<uint64_t> epoch;  // timestamp / bucket length of the counts
+        std::atomic<uint32_t> worstCaseBits;
+        Counters ids[CanBusLoadSnapshot::ID_COUNT];
+
+        void reset(uint64_t newEpoch);
+    };
+
+    // Single writer, no read-modify-write needed
+    static inline void add(std::atomic<uint32_t>& counter, uint32_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    static inline uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    uint32_t m_bitrate;
+    uint64_t m_bucketNs;
+    std::atomic<uint64_t> m_firstTimestampNs;
+    Bucket m_buckets[BUCKET_COUNT];
+};
+
+#endif  // SAILINGROBOT_CANBUSLOADMONITOR_H
@@ -0,0 +1,496 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanCaptureFile.cpp
+ *
+ * Purpose:
+ *    Writer and memory-mapped reader of the CanMsg capture format
+ *
+ * Developer Notes:
+ *    Compiled out on Arduino boards, the Arduino IDE builds every source file of
+ *    the library.
+ *
+ ***************************************************************************************/
+
+#include "canbus_global_defs.h"
+
+#ifndef ON_ARDUINO_BOARD
+
+#include "CanCaptureFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../../SystemServices/Logger.h"
+
+namespace {
+
+const char FILE_MAGIC[8] = {'C', 'A', 'N', 'C', 'A', 'P', '0', '1'};
+const char INDEX_MAGIC[8] = {'C', 'A', 'N', 'I', 'D', 'X', '0', '2'};
+const uint32_t FORMAT_VERSION = 2;
+const size_t WRITE_BUFFER_SIZE = 1 << 20;
+const size_t READ_BACK_RECORDS = 4096;
+const size_t LIST_BUFFER_SIZE = 512;  // record numbers buffered per id by CanCaptureWriter::close()
+
+bool writeAt(int fileDescriptor, const void* data, size_t size, uint64_t offset) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fileDescriptor, bytes, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+}  // namespace
+
+CanMsg CanCaptureRecord::toCanMsg() const {
+    CanMsg message;
+    message.id = id;
+    message.header.ide = ide;
+    message.header.length = length;
+    memcpy(message.data, data, sizeof(message.data));
+    return message;
+}
+
+void CanCaptureIndex::addRecord(std::vector<CanCaptureIndexEntry>& blocks, uint64_t recordNumber,
+                                uint64_t timestampNs) {
+    if (blocks.empty() || blocks.back().recordCount == RECORDS_PER_BLOCK) {
+        CanCaptureIndexEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.firstTimestampNs = timestampNs;
+        entry.lastTimestampNs = timestampNs;
+        entry.firstRecord = recordNumber;
+        blocks.push_back(entry);
+    }
+
+    CanCaptureIndexEntry& entry = blocks.back();
+    if (timestampNs < entry.firstTimestampNs) {
+        entry.firstTimestampNs = timestampNs;
+    }
+    if (timestampNs > entry.lastTimestampNs) {
+        entry.lastTimestampNs = timestampNs;
+    }
+    entry.recordCount++;
+}
+
+void CanCaptureIndex::layoutIds(const std::map<uint32_t, uint64_t>& recordCounts,
+                                std::vector<CanCaptureIdEntry>& ids) {
+    ids.clear();
+    uint64_t firstPosting = 0;
+    for (std::map<uint32_t, uint64_t>::const_iterator it = recordCounts.begin(); it != recordCounts.end(); ++it) {
+        CanCaptureIdEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.id = it->first;
+        entry.firstPosting = firstPosting;
+        entry.postingCount = it->second;
+        ids.push_back(entry);
+        firstPosting += it->second;
+    }
+}
+
+CanCaptureWriter::CanCaptureWriter()
+    : m_file(NULL), m_recordCount(0), m_lastTimestampNs(0), m_timeOrdered(true) {}
+
+CanCaptureWriter::~CanCaptureWriter() {
+    close();
+}
+
+bool CanCaptureWriter::open(const char* path) {
+    close();
+
+    // Read as well, close() reads the records back to write the index
+    m_file = fopen(path, "w+b");
+    if (m_file == NULL) {
+        Logger::error("CanCaptureWriter::open(): cannot create %s: %s", path, strerror(errno));
+        return false;
+    }
+    setvbuf(m_file, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+    m_recordCount = 0;
+    m_lastTimestampNs = 0;
+    m_timeOrdered = true;
+    m_blocks.clear();
+    m_idRecordCounts.clear();
+
+    CanCaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.recordSize = sizeof(CanCaptureRecord);
+    header.recordsPerBlock = CanCaptureIndex::RECORDS_PER_BLOCK;
+
+    if (fwrite(&header, sizeof(header), 1, m_file) != 1) {
+        Logger::error("CanCaptureWriter::open(): cannot write %s: %s", path, strerror(errno));
+        fclose(m_file);
+        m_file = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool CanCaptureWriter::append(const CanMsg& message, uint64_t timestampNs) {
+    if (m_file == NULL) {
+        return false;
+    }
+
+    CanCaptureRecord record;
+    record.timestampNs = timestampNs;
+    record.id = message.id;
+    record.ide = message.header.ide;
+    record.length = message.header.length;
+    record.reserved = 0;
+    memcpy(record.data, message.data, sizeof(record.data));
+
+    if (fwrite(&record, sizeof(record), 1, m_file) != 1) {
+        Logger::error("CanCaptureWriter::append(): write failed: %s", strerror(errno));
+        return false;
+    }
+
+    if (timestampNs < m_lastTimestampNs) {
+        m_timeOrdered = false;
+    }
+    m_lastTimestampNs = timestampNs;
+    CanCaptureIndex::addRecord(m_blocks, m_recordCount, timestampNs);
+    m_idRecordCounts[message.id]++;
+    m_recordCount++;
+    return true;
+}
+
+bool CanCaptureWriter::close() {
+    if (m_file == NULL) {
+        return true;
+    }
+
+    std::vector<CanCaptureIdEntry> ids;
+    CanCaptureIndex::layoutIds(m_idRecordCounts, ids);
+
+    CanCaptureTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.indexOffset = sizeof(CanCaptureFileHeader) + m_recordCount * sizeof(CanCaptureRecord);
+    trailer.recordCount = m_recordCount;
+    trailer.blockCount = static_cast<uint32_t>(m_blocks.size());
+    trailer.idCount = static_cast<uint32_t>(ids.size());
+    trailer.flags = m_timeOrdered ? CanCaptureIndex::FLAG_TIME_ORDERED : 0;
+    memcpy(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic));
+
+    uint64_t listsOffset = trailer.indexOffset + m_blocks.size() * sizeof(CanCaptureIndexEntry) +
+                           ids.size() * sizeof(CanCaptureIdEntry);
+    uint64_t trailerOffset = listsOffset + m_recordCount * sizeof(uint64_t);
+
+    bool success = fflush(m_file) == 0;
+    int fileDescriptor = fileno(m_file);
+    if (success && !m_blocks.empty()) {
+        success = writeAt(fileDescriptor, m_blocks.data(), m_blocks.size() * sizeof(CanCaptureIndexEntry),
+                          trailer.indexOffset);
+    }
+    if (success && !ids.empty()) {
+        success = writeAt(fileDescriptor, ids.data(), ids.size() * sizeof(CanCaptureIdEntry),
+                          trailer.indexOffset + m_blocks.size() * sizeof(CanCaptureIndexEntry));
+    }
+    if (success) {
+        success = writeIdLists(listsOffset, ids);
+    }
+    // Last, a file without trailer is a file without index
+    if (success) {
+        success = writeAt(fileDescriptor, &trailer, sizeof(trailer), trailerOffset);
+    }
+    if (fclose(m_file) != 0) {
+        success = false;
+    }
+    if (!success) {
+        Logger::error("CanCaptureWriter::close(): cannot write the index: %s", strerror(errno));
+    }
+
+    m_file = NULL;
+    m_blocks.clear();
+    m_idRecordCounts.clear();
+    return success;
+}
+
+bool CanCaptureWriter::writeIdLists(uint64_t listsOffset, const std::vector<CanCaptureIdEntry>& ids) {
+    struct IdList {
+        uint64_t offset;  // of the next record number to write
+        std::vector<uint64_t> buffer;
+    };
+    std::map<uint32_t, IdList> lists;
+    for (size_t i = 0; i < ids.size(); i++) {
+        lists[ids[i].id].offset = listsOffset + ids[i].firstPosting * sizeof(uint64_t);
+    }
+
+    int fileDescriptor = fileno(m_file);
+    std::vector<CanCaptureRecord> records(READ_BACK_RECORDS);
+    uint64_t recordNumber = 0;
+    while (recordNumber < m_recordCount) {
+        uint64_t remaining = m_recordCount - recordNumber;
+        size_t count = (remaining < READ_BACK_RECORDS) ? static_cast<size_t>(remaining) : READ_BACK_RECORDS;
+        size_t size = count * sizeof(CanCaptureRecord);
+        off_t offset = static_cast<off_t>(sizeof(CanCaptureFileHeader) + recordNumber * sizeof(CanCaptureRecord));
+        if (pread(fileDescriptor, records.data(), size, offset) != static_cast<ssize_t>(size)) {
+            return false;
+        }
+
+        for (size_t i = 0; i < count; i++, recordNumber++) {
+            IdList& list = lists[records[i].id];
+            list.buffer.push_back(recordNumber);
+            if (list.buffer.size() == LIST_BUFFER_SIZE) {
+                if (!writeAt(fileDescriptor, list.buffer.data(), LIST_BUFFER_SIZE * sizeof(uint64_t), list.offset)) {
+                    return false;
+                }
+                list.offset += LIST_BUFFER_SIZE * sizeof(uint64_t);
+                list.buffer.clear();
+            }
+        }
+    }
+
+    for (std::map<uint32_t, IdList>::iterator it = lists.begin(); it != lists.end(); ++it) {
+        IdList& list = it->second;
+        if (!list.buffer.empty() &&
+            !writeAt(fileDescriptor, list.buffer.data(), list.buffer.size() * sizeof(uint64_t), list.offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CanCaptureReader::CanCaptureReader()
+    : m_fileDescriptor(-1),
+      m_mapping(NULL),
+      m_mappingSize(0),
+      m_records(NULL),
+      m_recordCount(0),
+      m_blocks(NULL),
+      m_blockCount(0),
+      m_ids(NULL),
+      m_idCount(0),
+      m_postings(NULL),
+      m_storedIndex(false),
+      m_timeOrdered(false) {}
+
+CanCaptureReader::~CanCaptureReader() {
+    close();
+}
+
+bool CanCaptureReader::open(const char* path) {
+    close();
+
+    m_fileDescriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (m_fileDescriptor < 0) {
+        Logger::error("CanCaptureReader::open(): cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (fstat(m_fileDescriptor, &fileStatus) < 0 ||
+        static_cast<size_t>(fileStatus.st_size) < sizeof(CanCaptureFileHeader)) {
+        Logger::error("CanCaptureReader::open(): %s is not a capture file", path);
+        close();
+        return false;
+    }
+    m_mappingSize = static_cast<size_t>(fileStatus.st_size);
+
+    void* mapping = mmap(NULL, m_mappingSize, PROT_READ, MAP_SHARED, m_fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        Logger::error("CanCaptureReader::open(): mmap() of %s failed: %s", path, strerror(errno));
+        m_mappingSize = 0;
+        close();
+        return false;
+    }
+    m_mapping = static_cast<const uint8_t*>(mapping);
+    // Queries jump from block to block, no point in reading ahead
+    madvise(mapping, m_mappingSize, MADV_RANDOM);
+
+    const CanCaptureFileHeader* header = reinterpret_cast<const CanCaptureFileHeader*>(m_mapping);
+    if (memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header->version != FORMAT_VERSION ||
+        header->recordSize != sizeof(CanCaptureRecord)) {
+        Logger::error("CanCaptureReader::open(): %s is not a capture file of version %u", path, FORMAT_VERSION);
+        close();
+        return false;
+    }
+    m_records = reinterpret_cast<const CanCaptureRecord*>(m_mapping + sizeof(CanCaptureFileHeader));
+    uint64_t recordCount = (m_mappingSize - sizeof(CanCaptureFileHeader)) / sizeof(CanCaptureRecord);
+
+    if (m_mappingSize >= sizeof(CanCaptureFileHeader) + sizeof(CanCaptureTrailer)) {
+        // Copied out, the end of a file without index may not be aligned
+        CanCaptureTrailer trailer;
+        memcpy(&trailer, m_mapping + m_mappingSize - sizeof(CanCaptureTrailer), sizeof(trailer));
+        if (memcmp(trailer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 && trailer.recordCount <= recordCount &&
+            trailer.indexOffset == sizeof(CanCaptureFileHeader) + trailer.recordCount * sizeof(CanCaptureRecord)) {
+            // The records end where the index starts, whatever the index holds
+            recordCount = trailer.recordCount;
+            if (loadStoredIndex(trailer)) {
+                return true;
+            }
+            Logger::warning("CanCaptureReader::open(): %s has an inconsistent index, rebuilding it", path);
+        } else {
+            Logger::warning("CanCaptureReader::open(): %s has no index, rebuilding it", path);
+        }
+    } else {
+        Logger::warning("CanCaptureReader::open(): %s has no index, rebuilding it", path);
+    }
+
+    rebuildIndex(recordCount);
+    return true;
+}
+
+bool CanCaptureReader::loadStoredIndex(const CanCaptureTrailer& trailer) {
+    // Sizes checked against the file size first, the products cannot overflow then
+    uint64_t available = m_mappingSize - trailer.indexOffset - sizeof(CanCaptureTrailer);
+    if (trailer.blockCount > available / sizeof(CanCaptureIndexEntry) ||
+        trailer.idCount > available / sizeof(CanCaptureIdEntry) ||
+        trailer.recordCount > available / sizeof(uint64_t) ||
+        static_cast<uint64_t>(trailer.blockCount) * sizeof(CanCaptureIndexEntry) +
+                static_cast<uint64_t>(trailer.idCount) * sizeof(CanCaptureIdEntry) +
+                trailer.recordCount * sizeof(uint64_t) != available) {
+        return false;
+    }
+
+    const CanCaptureIndexEntry* blocks =
+        reinterpret_cast<const CanCaptureIndexEntry*>(m_mapping + trailer.indexOffset);
+    const CanCaptureIdEntry* ids = reinterpret_cast<const CanCaptureIdEntry*>(blocks + trailer.blockCount);
+    const uint64_t* postings = reinterpret_cast<const uint64_t*>(ids + trailer.idCount);
+
+    for (uint32_t i = 0; i < trailer.blockCount; i++) {
+        if (blocks[i].recordCount > CanCaptureIndex::RECORDS_PER_BLOCK || blocks[i].firstRecord > trailer.recordCount ||
+            blocks[i].recordCount > trailer.recordCount - blocks[i].firstRecord) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < trailer.idCount; i++) {
+        if ((i > 0 && ids[i].id <= ids[i - 1].id) || ids[i].firstPosting > trailer.recordCount ||
+            ids[i].postingCount > trailer.recordCount - ids[i].firstPosting) {
+            return false;
+        }
+    }
+
+    m_recordCount = trailer.recordCount;
+    m_blocks = blocks;
+    m_blockCount = trailer.blockCount;
+    m_ids = ids;
+    m_idCount = trailer.idCount;
+    m_postings = postings;
+    m_timeOrdered = (trailer.flags & CanCaptureIndex::FLAG_TIME_ORDERED) != 0;
+    m_storedIndex = true;
+    return true;
+}
+
+void CanCaptureReader::rebuildIndex(uint64_t recordCount) {
+    m_recordCount = recordCount;
+    m_timeOrdered = true;
+    madvise(const_cast<uint8_t*>(m_mapping), m_mappingSize, MADV_SEQUENTIAL);
+
+    std::map<uint32_t, uint64_t> idRecordCounts;
+    for (uint64_t i = 0; i < m_recordCount; i++) {
+        if (i > 0 && m_records[i].timestampNs < m_records[i - 1].timestampNs) {
+            m_timeOrdered = false;
+        }
+        CanCaptureIndex::addRecord(m_rebuiltBlocks, i, m_records[i].timestampNs);
+        idRecordCounts[m_records[i].id]++;
+    }
+
+    CanCaptureIndex::layoutIds(idRecordCounts, m_rebuiltIds);
+    std::map<uint32_t, uint64_t> nextPosting;
+    for (size_t i = 0; i < m_rebuiltIds.size(); i++) {
+        nextPosting[m_rebuiltIds[i].id] = m_rebuiltIds[i].firstPosting;
+    }
+    m_rebuiltPostings.resize(static_cast<size_t>(m_recordCount));
+    for (uint64_t i = 0; i < m_recordCount; i++) {
+        m_rebuiltPostings[static_cast<size_t>(nextPosting[m_records[i].id]++)] = i;
+    }
+    madvise(const_cast<uint8_t*>(m_mapping), m_mappingSize, MADV_RANDOM);
+
+    m_blocks = m_rebuiltBlocks.data();
+    m_blockCount = m_rebuiltBlocks.size();
+    m_ids = m_rebuiltIds.data();
+    m_idCount = m_rebuiltIds.size();
+    m_postings = m_rebuiltPostings.data();
+    m_storedIndex = false;
+}
+
+void CanCaptureReader::close() {
+    if (m_mapping != NULL) {
+        munmap(const_cast<uint8_t*>(m_mapping), m_mappingSize);
+    }
+    if (m_fileDescriptor >= 0) {
+        ::close(m_fileDescriptor);
+    }
+    m_fileDescriptor = -1;
+    m_mapping = NULL;
+    m_mappingSize = 0;
+    m_records = NULL;
+    m_recordCount = 0;
+    m_blocks = NULL;
+    m_blockCount = 0;
+    m_ids = NULL;
+    m_idCount = 0;
+    m_postings = NULL;
+    m_rebuiltBlocks.clear();
+    m_rebuiltIds.clear();
+    m_rebuiltPostings.clear();
+    m_storedIndex = false;
+    m_timeOrdered = false;
+}
+
+size_t CanCaptureReader::firstCandidateBlock(uint64_t fromNs) const {
+    if (!m_timeOrdered) {
+        return 0;
+    }
+    // First block ending at or after fromNs
+    size_t low = 0;
+    size_t high = m_blockCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (m_blocks[middle].lastTimestampNs < fromNs) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+uint64_t CanCaptureReader::firstCandidatePosting(const CanCaptureIdEntry& entry, uint64_t fromNs) const {
+    if (!m_timeOrdered) {
+        return 0;
+    }
+    // First record of the id at or after fromNs, invalid record numbers are skipped by forEach()
+    const uint64_t* postings = m_postings + entry.firstPosting;
+    uint64_t low = 0;
+    uint64_t high = entry.postingCount;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (postings[middle] < m_recordCount && m_records[postings[middle]].timestampNs < fromNs) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+const CanCaptureIdEntry* CanCaptureReader::findId(uint32_t messageId) const {
+    size_t low = 0;
+    size_t high = m_idCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (m_ids[middle].id < messageId) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return (low < m_idCount && m_ids[low].id == messageId) ? &m_ids[low] : NULL;
+}
+
+#endif  // ON_ARDUINO_BOARD
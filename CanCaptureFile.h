@@ -0,0 +1,269 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanCaptureFile.h
+ *
+ * Purpose:
+ *    Binary capture format for timestamped CanMsg streams, e.g. whole voyages.
+ *    CanCaptureWriter appends records sequentially, CanCaptureReader memory-maps the
+ *    file and uses a per id index so that a query on one id and a time interval only
+ *    touches the pages of the matching records.
+ *
+ * Developer Notes:
+ *    RPI only. Integers are stored in host byte order (little-endian on the RPI and x86).
+ *
+ *    File layout:
+ *      CanCaptureFileHeader
+ *      CanCaptureRecord * recordCount
+ *      CanCaptureIndexEntry * blockCount    index, written by CanCaptureWriter::close()
+ *      CanCaptureIdEntry * idCount
+ *      uint64_t * recordCount               record numbers grouped by id
+ *      CanCaptureTrailer
+ *
+ *    Every block of RECORDS_PER_BLOCK records gets an index entry with its time
+ *    interval, for queries on any id. Every id gets the sorted list of its record
+ *    numbers (8 bytes per record), a query on one id binary searches its time
+ *    interval in the list when the file is time ordered.
+ *
+ *    CanCaptureWriter only keeps a counter per id while recording, close() reads the
+ *    records back to write the lists. A file that was not closed (crash, power loss)
+ *    or whose index is not consistent has no index, the reader then rebuilds it in
+ *    memory with one scan.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANCAPTUREFILE_H
+#define SAILINGROBOT_CANCAPTUREFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "CanCaptureFile.h is only available on the RPI"
+#endif
+
+struct CanCaptureFileHeader {
+    char magic[8];  // "CANCAP01"
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t recordsPerBlock;
+    uint32_t reserved[3];
+};
+
+struct CanCaptureRecord {
+    uint64_t timestampNs;
+    uint32_t id;
+    uint8_t ide;
+    uint8_t length;
+    uint16_t reserved;
+    uint8_t data[8];
+
+    CanMsg toCanMsg() const;
+};
+
+struct CanCaptureIndexEntry {
+    uint64_t firstTimestampNs;
+    uint64_t lastTimestampNs;
+    uint64_t firstRecord;
+    uint32_t recordCount;
+    uint32_t reserved;
+};
+
+struct CanCaptureIdEntry {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t firstPosting;  // index of the first record number of the id in the lists
+    uint64_t postingCount;
+};
+
+struct CanCaptureTrailer {
+    uint64_t indexOffset;
+    uint64_t recordCount;
+    uint32_t blockCount;
+    uint32_t idCount;
+    uint32_t flags;
+    uint32_t reserved;
+    char magic[8];  // "CANIDX02"
+};
+
+static_assert(sizeof(CanCaptureFileHeader) == 32, "CanCaptureFileHeader layout changed");
+static_assert(sizeof(CanCaptureRecord) == 24, "CanCaptureRecord layout changed");
+static_assert(sizeof(CanCaptureIndexEntry) == 32, "CanCaptureIndexEntry layout changed");
+static_assert(sizeof(CanCaptureIdEntry) == 24, "CanCaptureIdEntry layout changed");
+static_assert(sizeof(CanCaptureTrailer) == 40, "CanCaptureTrailer layout changed");
+
+class CanCaptureIndex {
+   public:
+    static const uint32_t RECORDS_PER_BLOCK = 4096;
+
+    // CanCaptureTrailer.flags: timestamps never decrease, blocks can be binary searched
+    static const uint32_t FLAG_TIME_ORDERED = 1;
+
+    /**
+     * Adds a record to the last block, starting a new block when it is full
+     */
+    static void addRecord(std::vector<CanCaptureIndexEntry>& blocks, uint64_t recordNumber, uint64_t timestampNs);
+
+    /**
+     * @param recordCounts number of records of each id
+     * @param ids output, sorted by id, with the position of the list of each id
+     */
+    static void layoutIds(const std::map<uint32_t, uint64_t>& recordCounts, std::vector<CanCaptureIdEntry>& ids);
+};
+
+class CanCaptureWriter {
+   public:
+    CanCaptureWriter();
+    ~CanCaptureWriter();
+
+    CanCaptureWriter(const CanCaptureWriter&) = delete;
+    CanCaptureWriter& operator=(const CanCaptureWriter&) = delete;
+
+    /**
+     * Creates a capture file, an existing file is truncated
+     * @return false on failure, the reason is logged
+     */
+    bool open(const char* path);
+
+    /**
+     * Appends one record, buffered
+     * @return false on write error
+     */
+    bool append(const CanMsg& message, uint64_t timestampNs);
+
+    /**
+     * Writes the index and closes the file
+     * @return false on write error
+     */
+    bool close();
+
+    bool isOpen() const { return m_file != NULL; }
+
+    uint64_t recordCount() const { return m_recordCount; }
+
+   private:
+    FILE* m_file;
+    uint64_t m_recordCount;
+    uint64_t m_lastTimestampNs;
+    bool m_timeOrdered;
+    std::vector<CanCaptureIndexEntry> m_blocks;
+    std::map<uint32_t, uint64_t> m_idRecordCounts;
+
+    bool writeIdLists(uint64_t listsOffset, const std::vector<CanCaptureIdEntry>& ids);
+};
+
+class CanCaptureReader {
+   public:
+    static const uint32_t ANY_ID = 0xFFFFFFFF;
+
+    CanCaptureReader();
+    ~CanCaptureReader();
+
+    CanCaptureReader(const CanCaptureReader&) = delete;
+    CanCaptureReader& operator=(const CanCaptureReader&) = delete;
+
+    /**
+     * Memory-maps a capture file and loads its index, rebuilding it if the file was
+     * not closed properly
+     *
+     * @return false if the file cannot be read or is not a capture file
+     */
+    bool open(const char* path);
+
+    void close();
+
+    uint64_t recordCount() const { return m_recordCount; }
+
+    /**
+     * @return false if the index was rebuilt because the file had none or an
+     *         inconsistent one
+     */
+    bool hasStoredIndex() const { return m_storedIndex; }
+
+    const CanCaptureRecord& record(uint64_t recordNumber) const { return m_records[recordNumber]; }
+
+    /**
+     * Calls callback(const CanCaptureRecord&) for each record of messageId (or any id
+     * with ANY_ID) with fromNs <= timestamp <= toNs, in file order
+     *
+     * @return the number of matching records
+     */
+    template <class Callback>
+    uint64_t forEach(uint32_t messageId, uint64_t fromNs, uint64_t toNs, Callback callback) const {
+        uint64_t matches = 0;
+        if (messageId != ANY_ID) {
+            const CanCaptureIdEntry* entry = findId(messageId);
+            if (entry == NULL) {
+                return 0;
+            }
+            const uint64_t* postings = m_postings + entry->firstPosting;
+            for (uint64_t i = firstCandidatePosting(*entry, fromNs); i < entry->postingCount; i++) {
+                if (postings[i] >= m_recordCount) {
+                    continue;  // corrupted list
+                }
+                const CanCaptureRecord& record = m_records[postings[i]];
+                if (m_timeOrdered && record.timestampNs > toNs) {
+                    break;
+                }
+                if (record.id == messageId && record.timestampNs >= fromNs && record.timestampNs <= toNs) {
+                    callback(record);
+                    matches++;
+                }
+            }
+            return matches;
+        }
+
+        for (size_t block = firstCandidateBlock(fromNs); block < m_blockCount; block++) {
+            const CanCaptureIndexEntry& entry = m_blocks[block];
+            if (m_timeOrdered && entry.firstTimestampNs > toNs) {
+                break;
+            }
+            if (entry.lastTimestampNs < fromNs && m_timeOrdered) {
+                continue;
+            }
+
+            const CanCaptureRecord* records = m_records + entry.firstRecord;
+            for (uint32_t i = 0; i < entry.recordCount; i++) {
+                const CanCaptureRecord& record = records[i];
+                if (record.timestampNs >= fromNs && record.timestampNs <= toNs) {
+                    callback(record);
+                    matches++;
+                }
+            }
+        }
+        return matches;
+    }
+
+   private:
+    bool loadStoredIndex(const CanCaptureTrailer& trailer);
+    void rebuildIndex(uint64_t recordCount);
+    size_t firstCandidateBlock(uint64_t fromNs) const;
+    uint64_t firstCandidatePosting(const CanCaptureIdEntry& entry, uint64_t fromNs) const;
+    const CanCaptureIdEntry* findId(uint32_t messageId) const;
+
+    int m_fileDescriptor;
+    const uint8_t* m_mapping;
+    size_t m_mappingSize;
+
+    const CanCaptureRecord* m_records;
+    uint64_t m_recordCount;
+
+    const CanCaptureIndexEntry* m_blocks;
+    size_t m_blockCount;
+    const CanCaptureIdEntry* m_ids;
+    size_t m_idCount;
+    const uint64_t* m_postings;
+
+    std::vector<CanCaptureIndexEntry> m_rebuiltBlocks;
+    std::vector<CanCaptureIdEntry> m_rebuiltIds;
+    std::vector<uint64_t> m_rebuiltPostings;
+    bool m_storedIndex;
+    bool m_timeOrdered;
+};
+
+#endif  // SAILINGROBOT_CANCAPTUREFILE_H
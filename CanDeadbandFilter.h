@@ -0,0 +1,206 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanDeadbandFilter.h
+ *
+ * Purpose:
+ *    Transmit side change-only filter: a frame is only sent when one of its fields
+ *    moved by more than its deadband since the last frame sent with that id, or
+ *    when the heartbeat interval has elapsed.
+ *
+ *      CanDeadbandFilter<1, 3> filter;
+ *      filter.addField<CAN_FIELD(SENSOR_TEMPERATURE)>(MSG_ID_MARINE_SENSOR_DATA, 20);
+ *      filter.addField<CAN_FIELD(SENSOR_PH)>(MSG_ID_MARINE_SENSOR_DATA, 1);
+ *      if (filter.shouldSend(message, millis())) {
+ *          send(message);
+ *      }
+ *
+ * Developer Notes:
+ *    Works on Arduino and RPI. MAX_MESSAGES ids with up to MAX_FIELDS fields each are
+ *    stored inside the object, nothing is allocated.
+ *
+ *    Deadbands are in raw field units, on the unsigned field value. Bits outside the
+ *    configured fields (error codes, ids, counters) have no deadband, any change is
+ *    sent. Frames of ids not added to the filter are always sent.
+ *
+ *    The voltage and current of MSG_ID_CURRENT_SENSOR_DATA are half precision floats,
+ *    whose raw values do not move in proportion to the physical value: addField()
+ *    rejects them. Their change is still sent, as any bit outside the fields.
+ *
+ *    The reference is the last frame sent, not the last one seen, so a slow drift is
+ *    sent once it adds up to the deadband.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANDEADBANDFILTER_H
+#define SAILINGROBOT_CANDEADBANDFILTER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "CanBitField.h"
+#include "CanPayload.h"
+#include "canbus_defs.h"
+
+struct CanDeadbandField {
+    uint8_t start;      // in bits, see CanPayload.h for the bit order
+    uint8_t length;     // in bits, 1 to 32
+    uint32_t deadband;  // largest change not sent, in raw units
+};
+
+template <uint8_t MAX_MESSAGES, uint8_t MAX_FIELDS>
+class CanDeadbandFilter {
+   public:
+    static const uint32_t DEFAULT_HEARTBEAT_MS = 1000;
+
+    explicit CanDeadbandFilter(uint32_t heartbeatMs = DEFAULT_HEARTBEAT_MS)
+        : m_defaultHeartbeatMs(heartbeatMs), m_messageCount(0) {}
+
+    /**
+     * Adds a field with a deadband to a message id, the id is added on first use
+     *
+     * @param start in bits
+     * @param length in bits, 1 to 32
+     * @param deadband in raw field units
+     * @return false if the field is out of the payload, is a half precision float or
+     *         the filter is full
+     */
+    bool addField(uint32_t messageId, uint8_t start, uint8_t length, uint32_t deadband) {
+        if (length == 0 || length > 32 || start + length > 64 || isFloat16(messageId, start, length)) {
+            return false;
+        }
+        Message* message = findOrAdd(messageId);
+        if (message == NULL || message->fieldCount == MAX_FIELDS) {
+            return false;
+        }
+        CanDeadbandField& field = message->fields[message->fieldCount++];
+        field.start = start;
+        field.length = length;
+        field.deadband = deadband;
+        CanBitField::set<uint32_t>(message->fieldMask, start, length, 0xFFFFFFFFUL);
+        return true;
+    }
+
+    /**
+     * Same as above with a field of CanMessageSchema.h: addField<CAN_FIELD(SENSOR_PH)>(...)
+     */
+    template <class Field>
+    bool addField(uint32_t messageId, uint32_t deadband) {
+        static_assert(Field::LENGTH <= 32, "CanDeadbandFilter: fields are limited to 32 bits");
+        return addField(messageId, static_cast<uint8_t>(Field::START_BIT), static_cast<uint8_t>(Field::LENGTH),
+                        deadband);
+    }
+
+    /**
+     * Heartbeat of a message id, the id is added on first use
+     *
+     * @param heartbeatMs longest time without sending a frame, 0 for none
+     * @return false if the filter is full
+     */
+    bool setHeartbeat(uint32_t messageId, uint32_t heartbeatMs) {
+        Message* message = findOrAdd(messageId);
+        if (message == NULL) {
+            return false;
+        }
+        message->heartbeatMs = heartbeatMs;
+        return true;
+    }
+
+    /**
+     * Decides whether a frame is sent, and makes it the reference when it is
+     *
+     * @param nowMs current time in milliseconds, may wrap around
+     * @return true if the frame must be sent
+     */
+    bool shouldSend(const CanMsg& frame, uint32_t nowMs) {
+        Message* message = find(frame.id);
+        if (message == NULL) {
+            return true;
+        }
+        if (message->hasSent && !changed(*message, frame.data) &&
+            (message->heartbeatMs == 0 || nowMs - message->lastSentMs < message->heartbeatMs)) {
+            return false;
+        }
+        memcpy(message->lastSent, frame.data, sizeof(message->lastSent));
+        message->lastSentMs = nowMs;
+        message->hasSent = true;
+        return true;
+    }
+
+    /**
+     * The next frame of this id is sent whatever its content, e.g. after a bus error
+     */
+    void forceNext(uint32_t messageId) {
+        Message* message = find(messageId);
+        if (message != NULL) {
+            message->hasSent = false;
+        }
+    }
+
+   private:
+    struct Message {
+        uint32_t id;
+        uint32_t heartbeatMs;
+        uint32_t lastSentMs;
+        bool hasSent;
+        uint8_t fieldCount;
+        uint8_t lastSent[CanPayload::PAYLOAD_SIZE_IN_BYTES];
+        uint8_t fieldMask[CanPayload::PAYLOAD_SIZE_IN_BYTES];  // bits covered by a deadband
+        CanDeadbandField fields[MAX_FIELDS];
+    };
+
+    Message* find(uint32_t messageId) {
+        for (uint8_t i = 0; i < m_messageCount; i++) {
+            if (m_messages[i].id == messageId) {
+                return &m_messages[i];
+            }
+        }
+        return NULL;
+    }
+
+    Message* findOrAdd(uint32_t messageId) {
+        Message* message = find(messageId);
+        if (message != NULL || m_messageCount == MAX_MESSAGES) {
+            return message;
+        }
+        message = &m_messages[m_messageCount++];
+        memset(message, 0, sizeof(*message));
+        message->id = messageId;
+        message->heartbeatMs = m_defaultHeartbeatMs;
+        return message;
+    }
+
+    static bool overlaps(uint8_t start, uint8_t length, uint32_t otherStart, uint32_t otherLength) {
+        return start < otherStart + otherLength && otherStart < static_cast<uint32_t>(start + length);
+    }
+
+    static bool isFloat16(uint32_t messageId, uint8_t start, uint8_t length) {
+        return messageId == MSG_ID_CURRENT_SENSOR_DATA &&
+               (overlaps(start, length, CURRENT_SENSOR_VOLTAGE_START * 8, CURRENT_SENSOR_VOLTAGE_DATASIZE * 8) ||
+                overlaps(start, length, CURRENT_SENSOR_CURRENT_START * 8, CURRENT_SENSOR_CURRENT_DATASIZE * 8));
+    }
+
+    static bool changed(const Message& message, const uint8_t* data) {
+        for (uint8_t i = 0; i < CanPayload::PAYLOAD_SIZE_IN_BYTES; i++) {
+            if ((data[i] ^ message.lastSent[i]) & ~message.fieldMask[i]) {
+                return true;
+            }
+        }
+        for (uint8_t i = 0; i < message.fieldCount; i++) {
+            const CanDeadbandField& field = message.fields[i];
+            uint32_t value = CanBitField::get<uint32_t>(data, field.start, field.length);
+            uint32_t lastValue = CanBitField::get<uint32_t>(message.lastSent, field.start, field.length);
+            uint32_t difference = (value > lastValue) ? value - lastValue : lastValue - value;
+            if (difference > field.deadband) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t m_defaultHeartbeatMs;
+    uint8_t m_messageCount;
+    Message m_messages[MAX_MESSAGES];
+};
+
+#endif  // SAILINGROBOT_CANDEADBANDFILTER_H
@@ -0,0 +1,137 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanDiagnostics.h
+ *
+ * Purpose:
+ *    Diagnostics of the encode/decode paths, with a policy chosen at compile time so
+ *    they cost nothing when not wanted.
+ *
+ *    CANBUS_DIAGNOSTICS_OFF               the diagnostic macros compile to nothing
+ *    CANBUS_DIAGNOSTICS_COUNTERS          one counter per diagnostic code
+ *    CANBUS_DIAGNOSTICS_RATE_LIMITED_LOG  counters, and at most CANBUS_DIAGNOSTICS_LOG_RATE
+ *                                         Logger messages per second per call site
+ *
+ * Developer Notes:
+ *    Select the policy by defining CANBUS_DIAGNOSTICS before including any header of
+ *    this library (e.g. -DCANBUS_DIAGNOSTICS=CANBUS_DIAGNOSTICS_COUNTERS). The default
+ *    is RATE_LIMITED_LOG on the RPI and OFF on Arduino boards. Arduino boards have no
+ *    Logger, RATE_LIMITED_LOG behaves like COUNTERS there.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANDIAGNOSTICS_H
+#define SAILINGROBOT_CANDIAGNOSTICS_H
+
+#include <stdint.h>
+
+#include "canbus_global_defs.h"
+
+#define CANBUS_DIAGNOSTICS_OFF 0
+#define CANBUS_DIAGNOSTICS_COUNTERS 1
+#define CANBUS_DIAGNOSTICS_RATE_LIMITED_LOG 2
+
+#ifndef CANBUS_DIAGNOSTICS
+ #ifdef ON_ARDUINO_BOARD
+  #define CANBUS_DIAGNOSTICS CANBUS_DIAGNOSTICS_OFF
+ #else
+  #define CANBUS_DIAGNOSTICS CANBUS_DIAGNOSTICS_RATE_LIMITED_LOG
+ #endif
+#endif
+
+#ifndef CANBUS_DIAGNOSTICS_LOG_RATE
+ #define CANBUS_DIAGNOSTICS_LOG_RATE 1
+#endif
+
+#ifndef ON_ARDUINO_BOARD
+ #include <atomic>
+ #include <chrono>
+ #include "../../../SystemServices/Logger.h"
+#endif
+
+enum CanDiagnosticCode {
+    CAN_DIAG_READ_OUT_OF_BOUNDS,       // getData() start + length over 64 bits
+    CAN_DIAG_READ_TRUNCATED,           // getData() field longer than the data type
+    CAN_DIAG_ENCODE_OUT_OF_BOUNDS,     // encodeMessage() start + length over 64 bits
+    CAN_DIAG_EMPTY_PAYLOAD,            // canMsgToBitset() on a payload with no bit set
+    CAN_DIAG_ERROR_CODE_TOO_LARGE,     // setErrorMessage() value does not fit the error field
+    CAN_DIAG_MAPPING_LENGTH_MISMATCH,  // fixed-point mapping length differs from the field length
+    CAN_DIAG_CODE_COUNT
+};
+
+#ifndef ON_ARDUINO_BOARD
+typedef std::atomic<uint32_t> CanCounter;
+#else
+typedef uint32_t CanCounter;
+#endif
+
+class CanDiagnostics {
+   public:
+    /**
+     * @return the number of times a diagnostic code was raised, always 0 when
+     *         diagnostics are off
+     */
+    static inline uint32_t counter(CanDiagnosticCode code) {
+        return counters()[code];
+    }
+
+    static inline void resetCounters() {
+        for (int i = 0; i < CAN_DIAG_CODE_COUNT; i++) {
+            counters()[i] = 0;
+        }
+    }
+
+    static inline void count(CanDiagnosticCode code) {
+#ifndef ON_ARDUINO_BOARD
+        counters()[code].fetch_add(1, std::memory_order_relaxed);
+#else
+        counters()[code]++;
+#endif
+    }
+
+#ifndef ON_ARDUINO_BOARD
+    /**
+     * Allows CANBUS_DIAGNOSTICS_LOG_RATE calls per second. Meant to be a function
+     * local static, zero initialized, one per call site.
+     */
+    struct RateLimiter {
+        std::atomic<int64_t> windowSecond;
+        std::atomic<uint32_t> callsInWindow;
+
+        bool allow() {
+            int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                              std::chrono::steady_clock::now().time_since_epoch()).count() + 1;
+            if (windowSecond.exchange(now, std::memory_order_relaxed) != now) {
+                callsInWindow.store(0, std::memory_order_relaxed);
+            }
+            return callsInWindow.fetch_add(1, std::memory_order_relaxed) < CANBUS_DIAGNOSTICS_LOG_RATE;
+        }
+    };
+#endif
+
+   private:
+    static inline CanCounter* counters() {
+        static CanCounter diagnosticCounters[CAN_DIAG_CODE_COUNT];
+        return diagnosticCounters;
+    }
+};
+
+#if CANBUS_DIAGNOSTICS == CANBUS_DIAGNOSTICS_OFF
+ #define CAN_DIAG(LEVEL, CODE, MESSAGE) do {} while (0)
+#elif CANBUS_DIAGNOSTICS == CANBUS_DIAGNOSTICS_COUNTERS || defined(ON_ARDUINO_BOARD)
+ #define CAN_DIAG(LEVEL, CODE, MESSAGE) CanDiagnostics::count(CODE)
+#else
+ #define CAN_DIAG(LEVEL, CODE, MESSAGE)                          \
+    do {                                                         \
+        CanDiagnostics::count(CODE);                             \
+        static CanDiagnostics::RateLimiter canDiagRateLimiter;   \
+        if (canDiagRateLimiter.allow()) {                        \
+            Logger::LEVEL(MESSAGE);                              \
+        }                                                        \
+    } while (0)
+#endif
+
+#define CAN_DIAG_ERROR(CODE, MESSAGE) CAN_DIAG(error, CODE, MESSAGE)
+#define CAN_DIAG_WARNING(CODE, MESSAGE) CAN_DIAG(warning, CODE, MESSAGE)
+
+#endif  // SAILINGROBOT_CANDIAGNOSTICS_H
@@ -0,0 +1,276 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanFieldCodec.h
+ *
+ * Purpose:
+ *    The bit-indexed field functions shared by CanMessageHandler, CanMessageView and
+ *    CanMessageEncoder: getData(), encodeMessage(), the fixed-point and quantized
+ *    variants and the error message, written once for both kinds of storage.
+ *
+ *      uint64_t payload    the payload word of CanMessageHandler on the RPI
+ *      uint8_t* data       CanMsg.data, as the views and CanMessageHandler on Arduino
+ *
+ * Developer Notes:
+ *    Positions are the ones of the payload word, see CanPayload.h. On the data bytes
+ *    the fields go through CanBitField.h when CANBUS_BYTEWISE_CODEC is set, through
+ *    the payload word otherwise; the results are the same.
+ *
+ *    A zero field reads as false, as it is what overflows and wrong operations give,
+ *    while a zero can be valid data.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANFIELDCODEC_H
+#define SAILINGROBOT_CANFIELDCODEC_H
+
+#include <stdint.h>
+#include <type_traits>  // ArduinoSTL on Arduino, like CanMessageHandler.h
+
+#include "CanBitField.h"
+#include "CanDiagnostics.h"
+#include "CanMessageRegistry.h"
+#include "CanPayload.h"
+#include "canbus_defs.h"
+
+class CanFieldCodec {
+   public:
+    //-----------------------------------------------------------------------------------
+    // Raw fields, start + length must not be above 64
+    //-----------------------------------------------------------------------------------
+
+    static inline uint32_t get32(uint64_t payload, uint32_t start, uint32_t length) {
+        return static_cast<uint32_t>((payload >> start) & CanPayload::mask(length));
+    }
+
+    static inline uint64_t get64(uint64_t payload, uint32_t start, uint32_t length) {
+        return (payload >> start) & CanPayload::mask(length);
+    }
+
+    static inline void set(uint64_t& payload, uint32_t start, uint32_t length, uint64_t value) {
+        uint64_t mask = CanPayload::mask(length) << start;
+        payload = (payload & ~mask) | ((value << start) & mask);
+    }
+
+    static inline uint32_t get32(const uint8_t* data, uint32_t start, uint32_t length) {
+#if CANBUS_BYTEWISE_CODEC
+        return CanBitField::get<uint32_t>(data, static_cast<uint8_t>(start), static_cast<uint8_t>(length));
+#else
+        return get32(CanPayload::load(data), start, length);
+#endif
+    }
+
+    static inline uint64_t get64(const uint8_t* data, uint32_t start, uint32_t length) {
+#if CANBUS_BYTEWISE_CODEC
+        return CanBitField::get<uint64_t>(data, static_cast<uint8_t>(start), static_cast<uint8_t>(length));
+#else
+        return get64(CanPayload::load(data), start, length);
+#endif
+    }
+
+    static inline void set(uint8_t* data, uint32_t start, uint32_t length, uint64_t value) {
+#if CANBUS_BYTEWISE_CODEC
+        if (length <= 32) {  // no 64 bits arithmetic for the fields that fit in 32 bits
+            CanBitField::set<uint32_t>(data, static_cast<uint8_t>(start), static_cast<uint8_t>(length),
+                                       static_cast<uint32_t>(value));
+        } else {
+            CanBitField::set<uint64_t>(data, static_cast<uint8_t>(start), static_cast<uint8_t>(length), value);
+        }
+#else
+        uint64_t payload = CanPayload::load(data);
+        set(payload, start, length, value);
+        CanPayload::store(payload, data);
+#endif
+    }
+
+    //-----------------------------------------------------------------------------------
+    // Field functions, storage is a payload word or data bytes
+    //-----------------------------------------------------------------------------------
+
+    /**
+     * @param start, length in bytes if varInBytes, in bits otherwise
+     * @return false if the field is out of bounds or zero
+     */
+    template <class Storage, class T>
+    static bool getData(const Storage& storage, T* dataToSet, uint32_t start, uint32_t length, bool varInBytes) {
+        #ifndef ON_ARDUINO_BOARD
+        static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value,
+                      "getData(): use an unsigned integer type");
+        #endif
+        if (varInBytes) { length *= 8; start *= 8; }
+
+        if (start + length > 64) {
+            CAN_DIAG_ERROR(CAN_DIAG_READ_OUT_OF_BOUNDS, "In getData(): Wrong reading parameters");
+            *dataToSet = 0;
+            return false;
+        }
+        if (length > sizeof(T) * 8) {
+            CAN_DIAG_WARNING(CAN_DIAG_READ_TRUNCATED, "In getData(): data type is smaller than the field, data is truncated");
+        }
+
+#if CANBUS_BYTEWISE_CODEC
+        if (length <= 32) {
+            uint32_t data = get32(storage, start, length);
+            *dataToSet = static_cast<T>(data);
+            return data != 0;
+        }
+#endif
+        uint64_t data = get64(storage, start, length);
+        *dataToSet = static_cast<T>(data);
+        return data != 0;
+    }
+
+    /**
+     * Overwrites the field, bits of data above length are dropped. Negative values are
+     * encoded as two's complement truncated to length bits.
+     *
+     * @return false if the field is out of bounds
+     */
+    template <class Storage, class T>
+    static bool encodeMessage(Storage&& storage, T data, uint32_t start, uint32_t length, bool varInBytes) {
+        #ifndef ON_ARDUINO_BOARD
+        static_assert(std::is_integral<T>::value, "encodeMessage(): use an integer type");
+        #endif
+        if (varInBytes) { length *= 8; start *= 8; }
+
+        if (start + length > 64) {
+            CAN_DIAG_ERROR(CAN_DIAG_ENCODE_OUT_OF_BOUNDS, "In encodeMessage(): start + length > 64 ---> overflow!");
+            return false;
+        }
+        set(storage, start, length, static_cast<uint64_t>(data));
+        return true;
+    }
+
+    /**
+     * Field decoded with a fixed-point mapping, see CanFixedPointMapping.h
+     *
+     * @return false if data is not valid or the mapping and field lengths differ
+     */
+    template <class Storage, class T, class Mapping>
+    static bool getMappedData(const Storage& storage, T* dataToSet, uint32_t start, uint32_t length,
+                              bool varInBytes, const Mapping& mapping) {
+        if (varInBytes) { length *= 8; start *= 8; }
+
+        uint32_t data;
+        if (length != mapping.length()) {
+            CAN_DIAG_ERROR(CAN_DIAG_MAPPING_LENGTH_MISMATCH, "In getMappedData(): mapping and field lengths differ");
+            *dataToSet = 0;
+            return false;
+        }
+        if (!getData(storage, &data, start, length, false)) {
+            *dataToSet = 0;
+            return false;
+        }
+
+        if (std::is_floating_point<T>::value) {
+            *dataToSet = static_cast<T>(mapping.decodeFloat(data));
+        } else {
+            *dataToSet = static_cast<T>(mapping.decode(data));
+        }
+        return true;
+    }
+
+    /**
+     * Field encoded with a fixed-point mapping, rounded to the nearest step
+     *
+     * @return false if data is outside of the mapping interval or the lengths differ
+     */
+    template <class Storage, class T, class Mapping>
+    static bool encodeMappedMessage(Storage&& storage, T data, uint32_t start, uint32_t length, bool varInBytes,
+                                    const Mapping& mapping) {
+        if (data > mapping.maxValue() || data < mapping.minValue()) {
+            return false;
+        }
+        if (varInBytes) { start *= 8; length *= 8; }
+        if (length != mapping.length()) {
+            CAN_DIAG_ERROR(CAN_DIAG_MAPPING_LENGTH_MISMATCH, "In encodeMappedMessage(): mapping and field lengths differ");
+            return false;
+        }
+
+        uint32_t mappedData;
+        if (std::is_floating_point<T>::value) {
+            mappedData = mapping.encodeFloat(static_cast<float>(data));
+        } else {
+            mappedData = mapping.encode(static_cast<long>(data));
+        }
+        return encodeMessage(storage, mappedData, start, length, false);
+    }
+
+    /**
+     * Field packed with a quantizer, see CanQuantizer.h
+     *
+     * @return false if data is not valid, a raw 0 included, or the lengths differ
+     */
+    template <class Storage, class Quantizer>
+    static bool getQuantizedData(const Storage& storage, float* dataToSet, uint32_t start, uint32_t length,
+                                 bool varInBytes, const Quantizer& quantizer) {
+        if (varInBytes) { length *= 8; start *= 8; }
+
+        uint32_t data;
+        if (length != quantizer.length()) {
+            CAN_DIAG_ERROR(CAN_DIAG_MAPPING_LENGTH_MISMATCH, "In getQuantizedData(): quantizer and field lengths differ");
+            *dataToSet = 0;
+            return false;
+        }
+        if (!getData(storage, &data, start, length, false)) {
+            *dataToSet = 0;
+            return false;
+        }
+
+        *dataToSet = quantizer.dequantize(data);
+        return true;
+    }
+
+    /**
+     * Field packed with a quantizer, to its nearest value
+     *
+     * @return false if data is NaN, outside of the quantizer range or the lengths differ
+     */
+    template <class Storage, class Quantizer>
+    static bool encodeQuantized(Storage&& storage, float data, uint32_t start, uint32_t length, bool varInBytes,
+                                const Quantizer& quantizer) {
+        if (!(data <= quantizer.maxValue() && data >= quantizer.minValue())) {
+            return false;
+        }
+        if (varInBytes) { start *= 8; length *= 8; }
+        if (length != quantizer.length()) {
+            CAN_DIAG_ERROR(CAN_DIAG_MAPPING_LENGTH_MISMATCH, "In encodeQuantized(): quantizer and field lengths differ");
+            return false;
+        }
+
+        return encodeMessage(storage, quantizer.quantize(data), start, length, false);
+    }
+
+    /**
+     * Error field of the message id, see CanMessageRegistry.cpp
+     */
+    template <class Storage>
+    static uint8_t getErrorMessage(const Storage& storage, uint32_t messageId) {
+        CanMessageDescriptor descriptor = CanMessageRegistry::descriptor(messageId);
+        uint8_t errorMessage;
+        getData(storage, &errorMessage, descriptor.errorStart, descriptor.errorLength, false);
+        return errorMessage;
+    }
+
+    /**
+     * Sets the error field of the message id, to the largest code it holds if
+     * errorMessage does not fit. The first error is kept if the message says so.
+     */
+    template <class Storage>
+    static void setErrorMessage(Storage&& storage, uint32_t messageId, uint8_t errorMessage) {
+        CanMessageDescriptor descriptor = CanMessageRegistry::descriptor(messageId);
+
+        if (errorMessage > descriptor.errorMaxValue) {
+            CAN_DIAG_ERROR(CAN_DIAG_ERROR_CODE_TOO_LARGE, "In setErrorMessage(): error code value > max error value of the message. Wrong error coded.");
+            // encode the max value ('111' for the current sensor) to make sure an error is still coded
+            errorMessage = descriptor.errorMaxValue;
+        }
+
+        if (descriptor.keepFirstError && getErrorMessage(storage, messageId) != NO_ERRORS) {
+            return;
+        }
+        encodeMessage(storage, errorMessage, descriptor.errorStart, descriptor.errorLength, false);
+    }
+};
+
+#endif  // SAILINGROBOT_CANFIELDCODEC_H
@@ -0,0 +1,198 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanFilterBank.cpp
+ *
+ * Purpose:
+ *    Rule compilation and extended id matching of CanFilterBank
+ *
+ * Developer Notes:
+ *    Compiled out on Arduino boards, the Arduino IDE builds every source file of
+ *    the library.
+ *
+ ***************************************************************************************/
+
+#include "canbus_global_defs.h"
+
+#ifndef ON_ARDUINO_BOARD
+
+#include "CanFilterBank.h"
+
+#if defined(__SSE2__)
+ #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+ #define CANFILTERBANK_NEON
+#endif
+
+#include "../../../SystemServices/Logger.h"
+
+namespace {
+
+const size_t RULES_PER_COMPARE = 4;
+
+// Padding rule, no 29 bits id matches it
+const uint32_t NO_MATCH_ID = 0xFFFFFFFF;
+const uint32_t NO_MATCH_MASK = 0xFFFFFFFF;
+
+inline size_t paddedCount(size_t count) {
+    return (count + RULES_PER_COMPARE - 1) & ~(RULES_PER_COMPARE - 1);
+}
+
+}  // namespace
+
+CanFilterBank::CanFilterBank() : m_extendedRuleCount(0) {
+    for (uint32_t i = 0; i < STANDARD_ID_COUNT; i++) {
+        m_standardSubscribers[i] = 0;
+    }
+    for (size_t i = 0; i < MAX_EXTENDED_RULES; i++) {
+        m_extendedIds[i] = NO_MATCH_ID;
+        m_extendedMasks[i] = NO_MATCH_MASK;
+        m_extendedSubscribers[i] = 0;
+    }
+}
+
+bool CanFilterBank::addIdMask(uint8_t subscriber, uint32_t messageId, uint32_t idMask, bool extendedId) {
+    if (subscriber >= MAX_SUBSCRIBERS) {
+        Logger::error("CanFilterBank::addIdMask(): subscriber %u out of range", subscriber);
+        return false;
+    }
+    if (extendedId) {
+        return addExtendedRule(subscriber, messageId & MAX_EXTENDED_ID, idMask & MAX_EXTENDED_ID);
+    }
+
+    uint32_t bit = 1UL << subscriber;
+    idMask &= MAX_STANDARD_ID;
+    messageId &= idMask;
+    for (uint32_t id = 0; id < STANDARD_ID_COUNT; id++) {
+        if ((id & idMask) == messageId) {
+            m_standardSubscribers[id] |= bit;
+        }
+    }
+    return true;
+}
+
+bool CanFilterBank::addRange(uint8_t subscriber, uint32_t firstId, uint32_t lastId, bool extendedId) {
+    if (subscriber >= MAX_SUBSCRIBERS) {
+        Logger::error("CanFilterBank::addRange(): subscriber %u out of range", subscriber);
+        return false;
+    }
+    uint32_t spaceLast = extendedId ? MAX_EXTENDED_ID : MAX_STANDARD_ID;
+    if (lastId > spaceLast) {
+        lastId = spaceLast;
+    }
+    if (firstId > lastId) {
+        return false;
+    }
+
+    if (!extendedId) {
+        uint32_t bit = 1UL << subscriber;
+        for (uint32_t id = firstId; id <= lastId; id++) {
+            m_standardSubscribers[id] |= bit;
+        }
+        return true;
+    }
+
+    size_t previousCount = m_extendedRuleCount;
+    uint64_t first = firstId;
+    while (first <= lastId) {
+        // Largest aligned power of two block starting at first and ending within the range
+        uint64_t blockSize = 1;
+        while ((first & (blockSize * 2 - 1)) == 0 && first + blockSize * 2 - 1 <= lastId) {
+            blockSize *= 2;
+        }
+        if (!addExtendedRule(subscriber, static_cast<uint32_t>(first),
+                             static_cast<uint32_t>(~(blockSize - 1)) & MAX_EXTENDED_ID)) {
+            truncateExtendedRules(previousCount);  // all of the range or nothing
+            return false;
+        }
+        first += blockSize;
+    }
+    return true;
+}
+
+bool CanFilterBank::addExtendedRule(uint8_t subscriber, uint32_t messageId, uint32_t idMask) {
+    if (m_extendedRuleCount == MAX_EXTENDED_RULES) {
+        Logger::error("CanFilterBank: more than %zu extended id rules", MAX_EXTENDED_RULES);
+        return false;
+    }
+    m_extendedIds[m_extendedRuleCount] = messageId & idMask;
+    m_extendedMasks[m_extendedRuleCount] = idMask;
+    m_extendedSubscribers[m_extendedRuleCount] = 1UL << subscriber;
+    m_extendedRuleCount++;
+    return true;
+}
+
+void CanFilterBank::removeSubscriber(uint8_t subscriber) {
+    if (subscriber >= MAX_SUBSCRIBERS) {
+        return;
+    }
+    uint32_t bit = 1UL << subscriber;
+    for (uint32_t id = 0; id < STANDARD_ID_COUNT; id++) {
+        m_standardSubscribers[id] &= ~bit;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < m_extendedRuleCount; i++) {
+        if (m_extendedSubscribers[i] != bit) {
+            m_extendedIds[kept] = m_extendedIds[i];
+            m_extendedMasks[kept] = m_extendedMasks[i];
+            m_extendedSubscribers[kept] = m_extendedSubscribers[i];
+            kept++;
+        }
+    }
+    truncateExtendedRules(kept);
+}
+
+void CanFilterBank::truncateExtendedRules(size_t count) {
+    for (size_t i = count; i < m_extendedRuleCount; i++) {
+        m_extendedIds[i] = NO_MATCH_ID;
+        m_extendedMasks[i] = NO_MATCH_MASK;
+        m_extendedSubscribers[i] = 0;
+    }
+    m_extendedRuleCount = count;
+}
+
+uint32_t CanFilterBank::matchExtended(uint32_t messageId) const {
+    size_t count = paddedCount(m_extendedRuleCount);
+
+#if defined(__SSE2__)
+    __m128i id = _mm_set1_epi32(static_cast<int>(messageId));
+    __m128i subscribers = _mm_setzero_si128();
+    for (size_t i = 0; i < count; i += RULES_PER_COMPARE) {
+        __m128i masks = _mm_load_si128(reinterpret_cast<const __m128i*>(&m_extendedMasks[i]));
+        __m128i ids = _mm_load_si128(reinterpret_cast<const __m128i*>(&m_extendedIds[i]));
+        __m128i ruleSubscribers = _mm_load_si128(reinterpret_cast<const __m128i*>(&m_extendedSubscribers[i]));
+        __m128i matches = _mm_cmpeq_epi32(_mm_and_si128(id, masks), ids);
+        subscribers = _mm_or_si128(subscribers, _mm_and_si128(matches, ruleSubscribers));
+    }
+    subscribers = _mm_or_si128(subscribers, _mm_shuffle_epi32(subscribers, _MM_SHUFFLE(1, 0, 3, 2)));
+    subscribers = _mm_or_si128(subscribers, _mm_shuffle_epi32(subscribers, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(subscribers));
+#elif defined(CANFILTERBANK_NEON)
+    uint32x4_t id = vdupq_n_u32(messageId);
+    uint32x4_t subscribers = vdupq_n_u32(0);
+    for (size_t i = 0; i < count; i += RULES_PER_COMPARE) {
+        uint32x4_t matches = vceqq_u32(vandq_u32(id, vld1q_u32(&m_extendedMasks[i])), vld1q_u32(&m_extendedIds[i]));
+        subscribers = vorrq_u32(subscribers, vandq_u32(matches, vld1q_u32(&m_extendedSubscribers[i])));
+    }
+    uint32x2_t halves = vorr_u32(vget_low_u32(subscribers), vget_high_u32(subscribers));
+    return vget_lane_u32(halves, 0) | vget_lane_u32(halves, 1);
+#else
+    uint32_t subscribers = 0;
+    for (size_t i = 0; i < count; i++) {
+        if ((messageId & m_extendedMasks[i]) == m_extendedIds[i]) {
+            subscribers |= m_extendedSubscribers[i];
+        }
+    }
+    return subscribers;
+#endif
+}
+
+void CanFilterBank::match(const CanMsg* frames, size_t count, uint32_t* subscribers) const {
+    for (size_t i = 0; i < count; i++) {
+        subscribers[i] = match(frames[i]);
+    }
+}
+
+#endif  // ON_ARDUINO_BOARD
@@ -0,0 +1,110 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanFilterBank.h
+ *
+ * Purpose:
+ *    Software acceptance filters of the consumers of a bus: each subscriber (0 to 31)
+ *    adds (id, mask) and id range rules, match() returns the set of subscribers a
+ *    frame is for as a bit mask, whatever the number of subscribers.
+ *
+ *      CanFilterBank filters;
+ *      filters.addRange(ACTUATORS, MSG_ID_AU_CONTROL, MSG_ID_AU_CONTROL + 4);
+ *      filters.addRange(WINCH, MSG_ID_WINCH_CONTROL, MSG_ID_WINCH_FEEDBACK);
+ *
+ *      uint32_t subscribers[64];
+ *      filters.match(frames, count, subscribers);
+ *      if (subscribers[i] & (1UL << WINCH)) { ... }
+ *
+ * Developer Notes:
+ *    RPI only.
+ *
+ *    Rules are compiled when added: standard ids into a table of the subscriber mask
+ *    of each of the 2048 ids, a single load per frame. Extended rules are kept as
+ *    (id, mask) arrays compared to the frame id 4 at a time (SSE2 or NEON), ranges
+ *    being split into aligned power of two blocks like the SocketCAN filters.
+ *
+ *    A frame is extended if header.ide is set or its id does not fit in 11 bits.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANFILTERBANK_H
+#define SAILINGROBOT_CANFILTERBANK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "CanFilterBank.h is only available on the RPI"
+#endif
+
+class CanFilterBank {
+   public:
+    static const uint8_t MAX_SUBSCRIBERS = 32;
+    static const size_t MAX_EXTENDED_RULES = 128;
+    static const uint32_t STANDARD_ID_COUNT = 2048;
+    static const uint32_t MAX_STANDARD_ID = STANDARD_ID_COUNT - 1;
+    static const uint32_t MAX_EXTENDED_ID = 0x1FFFFFFF;
+
+    CanFilterBank();
+
+    /**
+     * Subscribes to the ids for which (id & idMask) == (messageId & idMask)
+     *
+     * @param subscriber 0 to MAX_SUBSCRIBERS - 1
+     * @param extendedId true for rules on 29 bits ids
+     * @return false if the subscriber is out of range or the extended rules are full
+     */
+    bool addIdMask(uint8_t subscriber, uint32_t messageId, uint32_t idMask, bool extendedId = false);
+
+    /**
+     * Subscribes to the ids in [firstId, lastId]
+     *
+     * @return false if the subscriber is out of range, the range is empty or the
+     *         extended rules are full
+     */
+    bool addRange(uint8_t subscriber, uint32_t firstId, uint32_t lastId, bool extendedId = false);
+
+    /**
+     * Removes all the rules of a subscriber
+     */
+    void removeSubscriber(uint8_t subscriber);
+
+    /**
+     * @return the subscribers of the frame, bit n set for subscriber n
+     */
+    uint32_t match(const CanMsg& frame) const {
+        if (frame.header.ide == 0 && frame.id <= MAX_STANDARD_ID) {
+            return m_standardSubscribers[frame.id];
+        }
+        return matchExtended(frame.id & MAX_EXTENDED_ID);
+    }
+
+    /**
+     * Matches a batch of frames in one pass
+     *
+     * @param subscribers count masks, one per frame
+     */
+    void match(const CanMsg* frames, size_t count, uint32_t* subscribers) const;
+
+    size_t extendedRuleCount() const { return m_extendedRuleCount; }
+
+   private:
+    uint32_t matchExtended(uint32_t messageId) const;
+
+    bool addExtendedRule(uint8_t subscriber, uint32_t messageId, uint32_t idMask);
+
+    void truncateExtendedRules(size_t count);
+
+    uint32_t m_standardSubscribers[STANDARD_ID_COUNT];
+
+    // Structure of arrays, padded with rules that match nothing for the 4 wide compares
+    alignas(16) uint32_t m_extendedIds[MAX_EXTENDED_RULES];
+    alignas(16) uint32_t m_extendedMasks[MAX_EXTENDED_RULES];
+    alignas(16) uint32_t m_extendedSubscribers[MAX_EXTENDED_RULES];
+    size_t m_extendedRuleCount;
+};
+
+#endif  // SAILINGROBOT_CANFILTERBANK_H
@@ -0,0 +1,351 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanFixedPointMapping.h
+ *
+ * Purpose:
+ *    Integer-only mapping between a value in [min, max] and a raw field of length
+ *    bits, [0, 2^length - 1], replacing CanUtility::mapInterval() on nodes without FPU.
+ *
+ *      raw   = round((value - min) * (2^length - 1) / (max - min))
+ *      value = min + raw * (max - min) / (2^length - 1)
+ *
+ *    CanFixedPointMapping<MIN, MAX, LENGTH> computes the scale factors at compile time,
+ *    CanFixedPointMapper computes the same factors once at construction. Both have the
+ *    same interface and give the same results on Arduino and RPI.
+ *
+ * Developer Notes:
+ *    A division by the range is replaced by a multiplication by a 32 bits factor
+ *    followed by a shift, the product is a 32 x 32 -> 64 bits multiplication.
+ *    Factors are rounded up, so the computed quotient is never below the exact one.
+ *
+ *    The quotient is exact if maxInput * divisor <= 2^shift (see roundsExactly()),
+ *    e.g. for encode() of a field of [0, 100] on 16 bits. When the factors cannot
+ *    guarantee it, e.g. SENSOR_CONDUCTIVETY ([0, 200000] on 32 bits) or encodeFixed()
+ *    of most fields, the quotient is corrected: two more 32 x 32 -> 64 bits
+ *    multiplications, then an addition and a comparison per step away from the exact
+ *    quotient.
+ *
+ *    Results, checked exhaustively for the mapped fields of canbus_datamappings_defs.h
+ *    by test/CanFixedPointMappingTest.cpp:
+ *      encode()       nearest integer to the exact value, ties up
+ *      encodeFixed()  same, of an offset with FRACTION_BITS fraction bits
+ *      encodeFloat()  the value is first quantized to 2^-FRACTION_BITS, then encodeFixed()
+ *      decode()       nearest integer, ties up
+ *      decodeFixed()  nearest multiple of 2^-FRACTION_BITS, ties up
+ *      decodeFloat()  decodeFixed() / 2^FRACTION_BITS converted to float
+ *
+ *    The only float operations are value - min and exact multiplications by powers of
+ *    two, so the float functions give the same result with the AVR soft-float library,
+ *    the RPI FPU and with or without FMA contraction.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANFIXEDPOINTMAPPING_H
+#define SAILINGROBOT_CANFIXEDPOINTMAPPING_H
+
+#include <stdint.h>
+
+class CanFixedPoint {
+   public:
+    static const uint8_t MAX_FRACTION_BITS = 16;
+
+    /**
+     * @return the number of bits needed to write value
+     */
+    static constexpr uint8_t bitWidth(uint64_t value) {
+        return (value == 0) ? 0 : static_cast<uint8_t>(1 + bitWidth(value >> 1));
+    }
+
+    static constexpr uint32_t rawMax(uint8_t length) {
+        return (length >= 32) ? 0xFFFFFFFFUL : static_cast<uint32_t>((1UL << length) - 1);
+    }
+
+    /**
+     * Largest shift keeping ceil(numerator * 2^shift / denominator) below 2^32
+     */
+    static constexpr uint8_t factorShift(uint32_t numerator, uint32_t denominator) {
+        return (30 + bitWidth(denominator) > bitWidth(numerator))
+                   ? static_cast<uint8_t>(30 + bitWidth(denominator) - bitWidth(numerator))
+                   : 0;
+    }
+
+    /**
+     * @return ceil(numerator * 2^shift / denominator)
+     */
+    static constexpr uint32_t factor(uint32_t numerator, uint32_t denominator, uint8_t shift) {
+        return static_cast<uint32_t>(((static_cast<uint64_t>(numerator) << shift) + denominator - 1) / denominator);
+    }
+
+    /**
+     * Fraction bits of the fixed-point values, as many as keep them within one step
+     * of the exact value
+     */
+    static constexpr uint8_t fractionBits(uint32_t range) {
+        return (bitWidth(range) >= 30) ? 0
+               : (30 - bitWidth(range) < MAX_FRACTION_BITS) ? static_cast<uint8_t>(30 - bitWidth(range))
+                                                             : MAX_FRACTION_BITS;
+    }
+
+    /**
+     * @return true if scale(input, factor(numerator, divisor, shift), shift) is
+     *         round(input * numerator / divisor) for any input <= maxInput, with
+     *         divisor = baseDivisor * 2^extraBits
+     */
+    static constexpr bool roundsExactly(uint32_t maxInput, uint32_t baseDivisor, uint8_t extraBits, uint8_t shift) {
+        // The factor is at most 2^-shift above the exact one, an error below
+        // 1 / divisor cannot move the rounded quotient
+        return shift >= extraBits &&
+               (shift - extraBits >= 64 ||
+                static_cast<uint64_t>(maxInput) * baseDivisor <= (1ULL << (shift - extraBits)));
+    }
+
+    /**
+     * @return round(offset * factor / 2^shift), ties up
+     */
+    static inline uint64_t scale(uint32_t offset, uint32_t factor, uint8_t shift) {
+        uint64_t product = static_cast<uint64_t>(offset) * factor;
+        if (shift == 0) {
+            return product;
+        }
+        return (product + (1ULL << (shift - 1))) >> shift;
+    }
+
+    /**
+     * @param estimate result of scale(), a few steps above or below the exact quotient
+     * @param maxQuotient not below the exact quotient
+     * @return round(numerator / divisor), ties up
+     */
+    static inline uint32_t roundQuotient(uint64_t estimate, uint64_t numerator, uint32_t divisor,
+                                         uint32_t maxQuotient) {
+        // Clamped first, quotient * divisor cannot overflow then
+        uint32_t quotient = (estimate > maxQuotient) ? maxQuotient : static_cast<uint32_t>(estimate);
+        uint64_t product = static_cast<uint64_t>(quotient) * divisor;
+        // Too high while quotient - numerator / divisor > 1/2
+        while (product > numerator && 2 * (product - numerator) > divisor) {
+            quotient--;
+            product -= divisor;
+        }
+        // Too low while numerator / divisor - quotient >= 1/2
+        while (numerator >= product && 2 * (numerator - product) >= divisor) {
+            quotient++;
+            product += divisor;
+        }
+        return quotient;
+    }
+
+    /**
+     * Rounding up the factors can push the top of the interval above rawMax
+     */
+    static inline uint32_t clampRaw(uint64_t raw, uint32_t rawMax) {
+        return (raw > rawMax) ? rawMax : static_cast<uint32_t>(raw);
+    }
+
+    /**
+     * Quantizes value - min to fractionBits fraction bits, clamped to [0, range]
+     */
+    static inline uint32_t fixedOffset(float value, long minValue, uint32_t range, uint8_t fractionBits) {
+        float offset = (value - static_cast<float>(minValue)) * static_cast<float>(1UL << fractionBits);
+        float limit = static_cast<float>(range) * static_cast<float>(1UL << fractionBits);
+        if (!(offset > 0)) {
+            return 0;  // also NaN
+        }
+        if (offset >= limit) {
+            return static_cast<uint32_t>(range) << fractionBits;
+        }
+        return static_cast<uint32_t>(offset + 0.5f);
+    }
+};
+
+/**
+ * Mapping with compile-time factors:
+ *
+ *   typedef CanFixedPointMapping<SENSOR_TEMPERATURE_INTERVAL_MIN,
+ *                                SENSOR_TEMPERATURE_INTERVAL_MAX, 16> TemperatureMapping;
+ *   uint32_t raw = TemperatureMapping::encodeFloat(21.5f);
+ */
+template <long MIN, long MAX, uint8_t LENGTH>
+class CanFixedPointMapping {
+   public:
+    static_assert(MAX > MIN, "CanFixedPointMapping: MAX must be above MIN");
+    static_assert(LENGTH >= 1 && LENGTH <= 32, "CanFixedPointMapping: LENGTH must be 1 to 32 bits");
+
+    static constexpr uint32_t RAW_MAX = CanFixedPoint::rawMax(LENGTH);
+    static constexpr uint32_t RANGE = static_cast<uint32_t>(MAX - MIN);
+    static constexpr uint8_t ENCODE_SHIFT = CanFixedPoint::factorShift(RAW_MAX, RANGE);
+    static constexpr uint32_t ENCODE_FACTOR = CanFixedPoint::factor(RAW_MAX, RANGE, ENCODE_SHIFT);
+    static constexpr uint8_t DECODE_SHIFT = CanFixedPoint::factorShift(RANGE, RAW_MAX);
+    static constexpr uint32_t DECODE_FACTOR = CanFixedPoint::factor(RANGE, RAW_MAX, DECODE_SHIFT);
+    static constexpr uint8_t FRACTION_BITS = CanFixedPoint::fractionBits(RANGE);
+
+    static constexpr bool ENCODE_EXACT = CanFixedPoint::roundsExactly(RANGE, RANGE, 0, ENCODE_SHIFT);
+    static constexpr bool ENCODE_FIXED_EXACT =
+        CanFixedPoint::roundsExactly(RANGE, RANGE, FRACTION_BITS, ENCODE_SHIFT);
+    static constexpr bool DECODE_EXACT = CanFixedPoint::roundsExactly(RAW_MAX, RAW_MAX, 0, DECODE_SHIFT);
+    static constexpr bool DECODE_FIXED_EXACT =
+        CanFixedPoint::roundsExactly(RAW_MAX, RAW_MAX, FRACTION_BITS, DECODE_SHIFT);
+
+    static inline long minValue() { return MIN; }
+    static inline long maxValue() { return MAX; }
+    static inline uint8_t length() { return LENGTH; }
+
+    /**
+     * @param value clamped to [MIN, MAX]
+     */
+    static inline uint32_t encode(long value) {
+        uint32_t offset = (value <= MIN) ? 0 : (value >= MAX) ? RANGE : static_cast<uint32_t>(value - MIN);
+        uint64_t raw = CanFixedPoint::scale(offset, ENCODE_FACTOR, ENCODE_SHIFT);
+        if (ENCODE_EXACT) {
+            return CanFixedPoint::clampRaw(raw, RAW_MAX);
+        }
+        return CanFixedPoint::roundQuotient(raw, static_cast<uint64_t>(offset) * RAW_MAX, RANGE, RAW_MAX);
+    }
+
+    /**
+     * @param offset (value - MIN) * 2^FRACTION_BITS, clamped to RANGE * 2^FRACTION_BITS
+     */
+    static inline uint32_t encodeFixed(uint32_t offset) {
+        if (offset > (RANGE << FRACTION_BITS)) {
+            offset = RANGE << FRACTION_BITS;
+        }
+        uint64_t raw = CanFixedPoint::scale(offset, ENCODE_FACTOR, ENCODE_SHIFT + FRACTION_BITS);
+        if (ENCODE_FIXED_EXACT) {
+            return CanFixedPoint::clampRaw(raw, RAW_MAX);
+        }
+        return CanFixedPoint::roundQuotient(raw, static_cast<uint64_t>(offset) * RAW_MAX, RANGE << FRACTION_BITS,
+                                            RAW_MAX);
+    }
+
+    /**
+     * @param value clamped to [MIN, MAX]
+     */
+    static inline uint32_t encodeFloat(float value) {
+        return encodeFixed(CanFixedPoint::fixedOffset(value, MIN, RANGE, FRACTION_BITS));
+    }
+
+    /**
+     * @return (value - MIN) * 2^FRACTION_BITS
+     */
+    static inline uint32_t decodeFixed(uint32_t raw) {
+        uint64_t fixed = CanFixedPoint::scale(raw, DECODE_FACTOR, DECODE_SHIFT - FRACTION_BITS);
+        if (DECODE_FIXED_EXACT) {
+            return static_cast<uint32_t>(fixed);
+        }
+        return CanFixedPoint::roundQuotient(fixed, (static_cast<uint64_t>(raw) * RANGE) << FRACTION_BITS, RAW_MAX,
+                                            RANGE << FRACTION_BITS);
+    }
+
+    static inline long decode(uint32_t raw) {
+        uint64_t offset = CanFixedPoint::scale(raw, DECODE_FACTOR, DECODE_SHIFT);
+        if (DECODE_EXACT) {
+            return MIN + static_cast<long>(offset);
+        }
+        return MIN + static_cast<long>(
+                         CanFixedPoint::roundQuotient(offset, static_cast<uint64_t>(raw) * RANGE, RAW_MAX, RANGE));
+    }
+
+    static inline float decodeFloat(uint32_t raw) {
+        return static_cast<float>(MIN) +
+               static_cast<float>(decodeFixed(raw)) / static_cast<float>(1UL << FRACTION_BITS);
+    }
+};
+
+/**
+ * Mapping with factors computed at construction, for intervals only known at
+ * runtime. Construct it once, not per message.
+ */
+class CanFixedPointMapper {
+   public:
+    /**
+     * @param minValue must be below maxValue
+     * @param length 1 to 32 bits
+     */
+    CanFixedPointMapper(long minValue, long maxValue, uint8_t length)
+        : m_minValue(minValue),
+          m_maxValue(maxValue),
+          m_length(length),
+          m_rawMax(CanFixedPoint::rawMax(length)),
+          m_range(static_cast<uint32_t>(maxValue - minValue)),
+          m_encodeShift(CanFixedPoint::factorShift(m_rawMax, m_range)),
+          m_encodeFactor(CanFixedPoint::factor(m_rawMax, m_range, m_encodeShift)),
+          m_decodeShift(CanFixedPoint::factorShift(m_range, m_rawMax)),
+          m_decodeFactor(CanFixedPoint::factor(m_range, m_rawMax, m_decodeShift)),
+          m_fractionBits(CanFixedPoint::fractionBits(m_range)),
+          m_encodeExact(CanFixedPoint::roundsExactly(m_range, m_range, 0, m_encodeShift)),
+          m_encodeFixedExact(CanFixedPoint::roundsExactly(m_range, m_range, m_fractionBits, m_encodeShift)),
+          m_decodeExact(CanFixedPoint::roundsExactly(m_rawMax, m_rawMax, 0, m_decodeShift)),
+          m_decodeFixedExact(CanFixedPoint::roundsExactly(m_rawMax, m_rawMax, m_fractionBits, m_decodeShift)) {}
+
+    long minValue() const { return m_minValue; }
+    long maxValue() const { return m_maxValue; }
+    uint8_t length() const { return m_length; }
+    uint8_t fractionBits() const { return m_fractionBits; }
+
+    uint32_t encode(long value) const {
+        uint32_t offset = (value <= m_minValue) ? 0
+                          : (value >= m_maxValue) ? m_range
+                                                  : static_cast<uint32_t>(value - m_minValue);
+        uint64_t raw = CanFixedPoint::scale(offset, m_encodeFactor, m_encodeShift);
+        if (m_encodeExact) {
+            return CanFixedPoint::clampRaw(raw, m_rawMax);
+        }
+        return CanFixedPoint::roundQuotient(raw, static_cast<uint64_t>(offset) * m_rawMax, m_range, m_rawMax);
+    }
+
+    uint32_t encodeFixed(uint32_t offset) const {
+        if (offset > (m_range << m_fractionBits)) {
+            offset = m_range << m_fractionBits;
+        }
+        uint64_t raw = CanFixedPoint::scale(offset, m_encodeFactor, m_encodeShift + m_fractionBits);
+        if (m_encodeFixedExact) {
+            return CanFixedPoint::clampRaw(raw, m_rawMax);
+        }
+        return CanFixedPoint::roundQuotient(raw, static_cast<uint64_t>(offset) * m_rawMax, m_range << m_fractionBits,
+                                            m_rawMax);
+    }
+
+    uint32_t encodeFloat(float value) const {
+        return encodeFixed(CanFixedPoint::fixedOffset(value, m_minValue, m_range, m_fractionBits));
+    }
+
+    uint32_t decodeFixed(uint32_t raw) const {
+        uint64_t fixed = CanFixedPoint::scale(raw, m_decodeFactor, m_decodeShift - m_fractionBits);
+        if (m_decodeFixedExact) {
+            return static_cast<uint32_t>(fixed);
+        }
+        return CanFixedPoint::roundQuotient(fixed, (static_cast<uint64_t>(raw) * m_range) << m_fractionBits,
+                                            m_rawMax, m_range << m_fractionBits);
+    }
+
+    long decode(uint32_t raw) const {
+        uint64_t offset = CanFixedPoint::scale(raw, m_decodeFactor, m_decodeShift);
+        if (m_decodeExact) {
+            return m_minValue + static_cast<long>(offset);
+        }
+        return m_minValue + static_cast<long>(CanFixedPoint::roundQuotient(
+                                offset, static_cast<uint64_t>(raw) * m_range, m_rawMax, m_range));
+    }
+
+    float decodeFloat(uint32_t raw) const {
+        return static_cast<float>(m_minValue) +
+               static_cast<float>(decodeFixed(raw)) / static_cast<float>(1UL << m_fractionBits);
+    }
+
+   private:
+    long m_minValue;
+    long m_maxValue;
+    uint8_t m_length;
+    uint32_t m_rawMax;
+    uint32_t m_range;
+    uint8_t m_encodeShift;
+    uint32_t m_encodeFactor;
+    uint8_t m_decodeShift;
+    uint32_t m_decodeFactor;
+    uint8_t m_fractionBits;
+    bool m_encodeExact;
+    bool m_encodeFixedExact;
+    bool m_decodeExact;
+    bool m_decodeFixedExact;
+};
+
+#endif  // SAILINGROBOT_CANFIXEDPOINTMAPPING_H
@@ -0,0 +1,124 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanIsoTp.cpp
+ *
+ * Purpose:
+ *    Segmentation and flow control of CanIsoTpSender
+ *
+ * Developer Notes:
+ *    Arduino and RPI.
+ *
+ ***************************************************************************************/
+
+#include "CanIsoTp.h"
+
+CanIsoTpSender::CanIsoTpSender(uint32_t messageId, uint32_t flowControlId, uint32_t timeoutUs)
+    : m_messageId(messageId),
+      m_flowControlId(flowControlId),
+      m_timeoutUs(timeoutUs),
+      m_state(ISOTP_SENDER_IDLE),
+      m_data(NULL),
+      m_length(0),
+      m_sent(0),
+      m_sequence(0),
+      m_blockSize(0),
+      m_blockCount(0),
+      m_waitFrames(0),
+      m_separationUs(0),
+      m_separationPending(false),
+      m_lastEventUs(0) {}
+
+bool CanIsoTpSender::start(const uint8_t* data, uint16_t length) {
+    if (busy() || length == 0 || length > CanIsoTp::MAX_LENGTH) {
+        return false;
+    }
+    m_data = data;
+    m_length = length;
+    m_sent = 0;
+    m_state = ISOTP_SENDER_SENDING;
+    return true;
+}
+
+bool CanIsoTpSender::next(uint32_t nowUs, CanMsg& frame) {
+    if (m_state == ISOTP_SENDER_WAITING_FLOW_CONTROL && nowUs - m_lastEventUs > m_timeoutUs) {
+        m_state = ISOTP_SENDER_FAILED;
+    }
+    if (m_state != ISOTP_SENDER_SENDING) {
+        return false;
+    }
+
+    if (m_sent == 0) {
+        CanIsoTp::initFrame(frame, m_messageId);
+        if (m_length <= CanIsoTp::SINGLE_FRAME_DATA_SIZE) {
+            frame.data[0] = static_cast<uint8_t>((CanIsoTp::SINGLE_FRAME << 4) | m_length);
+            memcpy(&frame.data[1], m_data, m_length);
+            m_sent = m_length;
+            m_state = ISOTP_SENDER_COMPLETE;
+            return true;
+        }
+        frame.data[0] = static_cast<uint8_t>((CanIsoTp::FIRST_FRAME << 4) | (m_length >> 8));
+        frame.data[1] = static_cast<uint8_t>(m_length);
+        memcpy(&frame.data[2], m_data, CanIsoTp::FIRST_FRAME_DATA_SIZE);
+        m_sent = CanIsoTp::FIRST_FRAME_DATA_SIZE;
+        m_sequence = 1;
+        m_waitFrames = 0;
+        m_lastEventUs = nowUs;
+        m_state = ISOTP_SENDER_WAITING_FLOW_CONTROL;
+        return true;
+    }
+
+    if (m_separationPending && nowUs - m_lastEventUs < m_separationUs) {
+        return false;
+    }
+
+    CanIsoTp::initFrame(frame, m_messageId);
+    uint16_t size = m_length - m_sent;
+    if (size > CanIsoTp::CONSECUTIVE_FRAME_DATA_SIZE) {
+        size = CanIsoTp::CONSECUTIVE_FRAME_DATA_SIZE;
+    }
+    frame.data[0] = static_cast<uint8_t>((CanIsoTp::CONSECUTIVE_FRAME << 4) | m_sequence);
+    memcpy(&frame.data[1], &m_data[m_sent], size);
+    m_sent += size;
+    m_sequence = (m_sequence + 1) & 0x0F;
+    m_lastEventUs = nowUs;
+    m_separationPending = true;
+
+    if (m_sent == m_length) {
+        m_state = ISOTP_SENDER_COMPLETE;
+    } else if (m_blockSize != 0 && ++m_blockCount == m_blockSize) {
+        m_state = ISOTP_SENDER_WAITING_FLOW_CONTROL;
+    }
+    return true;
+}
+
+void CanIsoTpSender::onFrame(const CanMsg& frame, uint32_t nowUs) {
+    if (frame.id != m_flowControlId || m_state != ISOTP_SENDER_WAITING_FLOW_CONTROL || frame.header.length < 3 ||
+        CanIsoTp::frameType(frame) != CanIsoTp::FLOW_CONTROL_FRAME) {
+        return;
+    }
+
+    switch (frame.data[0] & 0x0F) {
+        case CanIsoTp::FLOW_CONTINUE_TO_SEND:
+            m_blockSize = frame.data[1];
+            m_blockCount = 0;
+            m_separationUs = CanIsoTp::decodeSeparationTime(frame.data[2]);
+            m_separationPending = false;
+            m_waitFrames = 0;
+            m_lastEventUs = nowUs;
+            m_state = ISOTP_SENDER_SENDING;
+            break;
+
+        case CanIsoTp::FLOW_WAIT:
+            // The receiver is busy, restarts the flow control timeout
+            if (++m_waitFrames > MAX_WAIT_FRAMES) {
+                m_state = ISOTP_SENDER_FAILED;
+            }
+            m_lastEventUs = nowUs;
+            break;
+
+        default:  // overflow or invalid flow status
+            m_state = ISOTP_SENDER_FAILED;
+            break;
+    }
+}
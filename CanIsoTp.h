@@ -0,0 +1,372 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanIsoTp.h
+ *
+ * Purpose:
+ *    ISO-TP (ISO 15765-2) transport of payloads longer than a frame, up to 4095 bytes,
+ *    between two ids given by the caller: single frames, first and consecutive frames,
+ *    flow control with block size and separation time. Replaces the PART_1, PART_2...
+ *    ids of the messages split by hand.
+ *
+ *      // Sender, flow control frames of the receiver come on MSG_ID_CONFIG_FLOW_CONTROL
+ *      CanIsoTpSender sender(MSG_ID_CONFIG_TRANSFER, MSG_ID_CONFIG_FLOW_CONTROL);
+ *      sender.start(configuration, sizeof(configuration));
+ *      while (sender.busy()) {
+ *          if (receiveFrame(rx)) { sender.onFrame(rx, micros()); }
+ *          if (sender.next(micros(), tx)) { sendFrame(tx); }
+ *      }
+ *
+ *      // Receiver, 8 frames per block, 500 us between the frames
+ *      CanIsoTpReceiver<256> receiver(MSG_ID_CONFIG_TRANSFER, MSG_ID_CONFIG_FLOW_CONTROL, 8, 500);
+ *      switch (receiver.onFrame(rx, micros(), flowControl)) {
+ *          case ISOTP_FRAME_SEND_FLOW_CONTROL: sendFrame(flowControl); break;
+ *          case ISOTP_FRAME_COMPLETE: apply(receiver.data(), receiver.length()); break;
+ *          default: break;
+ *      }
+ *
+ * Developer Notes:
+ *    Arduino and RPI. Times are in microseconds (micros() on Arduino) and may wrap
+ *    around.
+ *
+ *    The frame starts with the ISO-TP protocol byte(s) instead of ending with the
+ *    error byte of INDEX_ERROR_CODE: a single frame carries 7 bytes, a first frame 6,
+ *    a consecutive frame 7. Frames are always 8 bytes long, padded with PADDING.
+ *    The ids are extended if they do not fit in 11 bits.
+ *
+ *    The receiver stores the payload in a buffer of MAX_PAYLOAD bytes inside the
+ *    object, longer transfers are refused with an overflow flow control frame. The
+ *    sender does not copy the payload, it must stay valid until the transfer ends.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANISOTP_H
+#define SAILINGROBOT_CANISOTP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "canbus_defs.h"
+
+class CanIsoTp {
+   public:
+    static const uint16_t MAX_LENGTH = 4095;
+    static const uint8_t FRAME_SIZE = 8;
+    static const uint8_t SINGLE_FRAME_DATA_SIZE = 7;
+    static const uint8_t FIRST_FRAME_DATA_SIZE = 6;
+    static const uint8_t CONSECUTIVE_FRAME_DATA_SIZE = 7;
+    static const uint8_t PADDING = 0xCC;
+    static const uint32_t DEFAULT_TIMEOUT_US = 1000000;  // N_Bs and N_Cr of ISO 15765-2
+
+    // Frame types, high nibble of the first byte
+    static const uint8_t SINGLE_FRAME = 0x0;
+    static const uint8_t FIRST_FRAME = 0x1;
+    static const uint8_t CONSECUTIVE_FRAME = 0x2;
+    static const uint8_t FLOW_CONTROL_FRAME = 0x3;
+
+    // Flow status of the flow control frames
+    static const uint8_t FLOW_CONTINUE_TO_SEND = 0x0;
+    static const uint8_t FLOW_WAIT = 0x1;
+    static const uint8_t FLOW_OVERFLOW = 0x2;
+
+    static inline uint8_t frameType(const CanMsg& frame) { return frame.data[0] >> 4; }
+
+    /**
+     * @return the STmin byte of a separation time, rounded up to what it can express:
+     *         100 us steps below 1 ms, 1 ms steps up to 127 ms
+     */
+    static inline uint8_t encodeSeparationTime(uint32_t separationUs) {
+        if (separationUs == 0) {
+            return 0;
+        }
+        if (separationUs <= 900) {
+            return static_cast<uint8_t>(0xF0 + (separationUs + 99) / 100);
+        }
+        uint32_t separationMs = (separationUs + 999) / 1000;
+        return static_cast<uint8_t>(separationMs > 127 ? 127 : separationMs);
+    }
+
+    /**
+     * @return the separation time of a STmin byte, 127 ms for the reserved values
+     */
+    static inline uint32_t decodeSeparationTime(uint8_t stMin) {
+        if (stMin <= 0x7F) {
+            return stMin * 1000UL;
+        }
+        if (stMin >= 0xF1 && stMin <= 0xF9) {
+            return (stMin - 0xF0) * 100UL;
+        }
+        return 127000UL;
+    }
+
+    /**
+     * Sets the id and the header of a frame and fills its data with PADDING
+     */
+    static inline void initFrame(CanMsg& frame, uint32_t messageId) {
+        frame.id = messageId;
+        frame.header.ide = (messageId > 0x7FF) ? 1 : 0;
+        frame.header.length = FRAME_SIZE;
+        memset(frame.data, PADDING, sizeof(frame.data));
+    }
+
+    static inline void flowControlFrame(CanMsg& frame, uint32_t messageId, uint8_t flowStatus, uint8_t blockSize,
+                                        uint8_t stMin) {
+        initFrame(frame, messageId);
+        frame.data[0] = static_cast<uint8_t>((FLOW_CONTROL_FRAME << 4) | flowStatus);
+        frame.data[1] = blockSize;
+        frame.data[2] = stMin;
+    }
+};
+
+enum CanIsoTpResult {
+    ISOTP_FRAME_IGNORED,            // not a data frame of this receiver
+    ISOTP_FRAME_PENDING,            // frame stored, the transfer is not complete yet
+    ISOTP_FRAME_SEND_FLOW_CONTROL,  // send the flow control frame, also set for transfers refused as too long
+    ISOTP_FRAME_COMPLETE,           // data() holds the payload
+    ISOTP_FRAME_DROPPED             // invalid or unexpected frame, see the statistics
+};
+
+struct CanIsoTpStatistics {
+    uint32_t completed;
+    uint32_t timedOut;        // no consecutive frame for timeoutUs
+    uint32_t interrupted;     // new transfer started before the previous one completed
+    uint32_t sequenceErrors;  // consecutive frame lost or repeated, the transfer is dropped
+    uint32_t overflows;       // longer than MAX_PAYLOAD
+    uint32_t invalid;         // wrong length or unexpected consecutive frame
+};
+
+/**
+ * Reassembles the transfers received on one id. MAX_PAYLOAD is the size of the
+ * reassembly buffer.
+ */
+template <uint16_t MAX_PAYLOAD>
+class CanIsoTpReceiver {
+    static_assert(MAX_PAYLOAD > 0 && MAX_PAYLOAD <= CanIsoTp::MAX_LENGTH,
+                  "CanIsoTpReceiver: MAX_PAYLOAD must be 1 to 4095 bytes");
+
+   public:
+    /**
+     * @param messageId id of the data frames
+     * @param flowControlId id of the flow control frames sent back
+     * @param blockSize consecutive frames between two flow control frames, 0 for all of them
+     * @param separationUs minimum time the sender leaves between two consecutive frames
+     */
+    CanIsoTpReceiver(uint32_t messageId, uint32_t flowControlId, uint8_t blockSize = 0, uint32_t separationUs = 0,
+                     uint32_t timeoutUs = CanIsoTp::DEFAULT_TIMEOUT_US)
+        : m_messageId(messageId),
+          m_flowControlId(flowControlId),
+          m_blockSize(blockSize),
+          m_stMin(CanIsoTp::encodeSeparationTime(separationUs)),
+          m_timeoutUs(timeoutUs),
+          m_active(false),
+          m_length(0),
+          m_received(0) {
+        memset(&m_statistics, 0, sizeof(m_statistics));
+    }
+
+    /**
+     * @param flowControl set when ISOTP_FRAME_SEND_FLOW_CONTROL is returned
+     */
+    CanIsoTpResult onFrame(const CanMsg& frame, uint32_t nowUs, CanMsg& flowControl) {
+        if (frame.id != m_messageId || frame.header.length == 0) {
+            return ISOTP_FRAME_IGNORED;
+        }
+        expire(nowUs);
+
+        switch (CanIsoTp::frameType(frame)) {
+            case CanIsoTp::SINGLE_FRAME: {
+                uint8_t length = frame.data[0] & 0x0F;
+                if (length == 0 || length > CanIsoTp::SINGLE_FRAME_DATA_SIZE || length >= frame.header.length) {
+                    m_statistics.invalid++;
+                    return ISOTP_FRAME_DROPPED;
+                }
+                interrupt();
+                if (length > MAX_PAYLOAD) {
+                    m_statistics.overflows++;
+                    return ISOTP_FRAME_DROPPED;
+                }
+                memcpy(m_data, &frame.data[1], length);
+                m_length = length;
+                m_received = length;
+                m_statistics.completed++;
+                return ISOTP_FRAME_COMPLETE;
+            }
+
+            case CanIsoTp::FIRST_FRAME: {
+                uint16_t length = static_cast<uint16_t>(((frame.data[0] & 0x0F) << 8) | frame.data[1]);
+                if (length <= CanIsoTp::SINGLE_FRAME_DATA_SIZE || frame.header.length < CanIsoTp::FRAME_SIZE) {
+                    m_statistics.invalid++;
+                    return ISOTP_FRAME_DROPPED;
+                }
+                interrupt();
+                if (length > MAX_PAYLOAD) {
+                    m_statistics.overflows++;
+                    CanIsoTp::flowControlFrame(flowControl, m_flowControlId, CanIsoTp::FLOW_OVERFLOW, 0, 0);
+                    return ISOTP_FRAME_SEND_FLOW_CONTROL;
+                }
+                memcpy(m_data, &frame.data[2], CanIsoTp::FIRST_FRAME_DATA_SIZE);
+                m_length = length;
+                m_received = CanIsoTp::FIRST_FRAME_DATA_SIZE;
+                m_nextSequence = 1;
+                m_blockCount = 0;
+                m_lastFrameUs = nowUs;
+                m_active = true;
+                CanIsoTp::flowControlFrame(flowControl, m_flowControlId, CanIsoTp::FLOW_CONTINUE_TO_SEND, m_blockSize,
+                                           m_stMin);
+                return ISOTP_FRAME_SEND_FLOW_CONTROL;
+            }
+
+            case CanIsoTp::CONSECUTIVE_FRAME: {
+                if (!m_active) {
+                    m_statistics.invalid++;
+                    return ISOTP_FRAME_DROPPED;
+                }
+                if ((frame.data[0] & 0x0F) != m_nextSequence) {
+                    m_statistics.sequenceErrors++;
+                    m_active = false;
+                    return ISOTP_FRAME_DROPPED;
+                }
+                uint16_t size = m_length - m_received;
+                if (size > CanIsoTp::CONSECUTIVE_FRAME_DATA_SIZE) {
+                    size = CanIsoTp::CONSECUTIVE_FRAME_DATA_SIZE;
+                }
+                if (size >= frame.header.length) {
+                    m_statistics.invalid++;
+                    m_active = false;
+                    return ISOTP_FRAME_DROPPED;
+                }
+                memcpy(&m_data[m_received], &frame.data[1], size);
+                m_received += size;
+                m_nextSequence = (m_nextSequence + 1) & 0x0F;
+                m_lastFrameUs = nowUs;
+
+                if (m_received == m_length) {
+                    m_active = false;
+                    m_statistics.completed++;
+                    return ISOTP_FRAME_COMPLETE;
+                }
+                if (m_blockSize != 0 && ++m_blockCount == m_blockSize) {
+                    m_blockCount = 0;
+                    CanIsoTp::flowControlFrame(flowControl, m_flowControlId, CanIsoTp::FLOW_CONTINUE_TO_SEND, m_blockSize,
+                                               m_stMin);
+                    return ISOTP_FRAME_SEND_FLOW_CONTROL;
+                }
+                return ISOTP_FRAME_PENDING;
+            }
+
+            default:
+                return ISOTP_FRAME_IGNORED;
+        }
+    }
+
+    /**
+     * Drops the transfer in progress if no frame came for timeoutUs. Also done by
+     * onFrame(), calling it is only needed to update the statistics.
+     */
+    void expire(uint32_t nowUs) {
+        if (m_active && nowUs - m_lastFrameUs > m_timeoutUs) {
+            m_active = false;
+            m_statistics.timedOut++;
+        }
+    }
+
+    bool busy() const { return m_active; }
+
+    /**
+     * Payload of the last complete transfer, valid until the next first or single frame
+     */
+    const uint8_t* data() const { return m_data; }
+    uint16_t length() const { return m_active ? 0 : m_length; }
+
+    const CanIsoTpStatistics& statistics() const { return m_statistics; }
+
+   private:
+    void interrupt() {
+        if (m_active) {
+            m_active = false;
+            m_statistics.interrupted++;
+        }
+    }
+
+    uint32_t m_messageId;
+    uint32_t m_flowControlId;
+    uint8_t m_blockSize;
+    uint8_t m_stMin;
+    uint32_t m_timeoutUs;
+
+    bool m_active;
+    uint16_t m_length;
+    uint16_t m_received;
+    uint8_t m_nextSequence;
+    uint8_t m_blockCount;
+    uint32_t m_lastFrameUs;
+    CanIsoTpStatistics m_statistics;
+    uint8_t m_data[MAX_PAYLOAD];
+};
+
+enum CanIsoTpSenderState {
+    ISOTP_SENDER_IDLE,
+    ISOTP_SENDER_SENDING,
+    ISOTP_SENDER_WAITING_FLOW_CONTROL,
+    ISOTP_SENDER_COMPLETE,
+    ISOTP_SENDER_FAILED  // flow control timeout, overflow reported by the receiver or too many wait frames
+};
+
+/**
+ * Sends one transfer at a time on one id
+ */
+class CanIsoTpSender {
+   public:
+    static const uint8_t MAX_WAIT_FRAMES = 10;
+
+    /**
+     * @param messageId id of the data frames
+     * @param flowControlId id of the flow control frames of the receiver
+     * @param timeoutUs maximum wait for a flow control frame
+     */
+    CanIsoTpSender(uint32_t messageId, uint32_t flowControlId, uint32_t timeoutUs = CanIsoTp::DEFAULT_TIMEOUT_US);
+
+    /**
+     * @param data kept by pointer until the transfer is complete or failed
+     * @return false if a transfer is in progress or length is 0 or above 4095
+     */
+    bool start(const uint8_t* data, uint16_t length);
+
+    /**
+     * @param frame set if true is returned
+     * @return true if a frame is to be sent now, false while waiting for the flow
+     *         control or the separation time, and once the transfer ended
+     */
+    bool next(uint32_t nowUs, CanMsg& frame);
+
+    /**
+     * Flow control frames of the receiver, other frames are ignored
+     */
+    void onFrame(const CanMsg& frame, uint32_t nowUs);
+
+    void abort() { m_state = ISOTP_SENDER_IDLE; }
+
+    bool busy() const { return m_state == ISOTP_SENDER_SENDING || m_state == ISOTP_SENDER_WAITING_FLOW_CONTROL; }
+
+    CanIsoTpSenderState state() const { return m_state; }
+
+   private:
+    uint32_t m_messageId;
+    uint32_t m_flowControlId;
+    uint32_t m_timeoutUs;
+
+    CanIsoTpSenderState m_state;
+    const uint8_t* m_data;
+    uint16_t m_length;
+    uint16_t m_sent;
+    uint8_t m_sequence;
+    uint8_t m_blockSize;
+    uint8_t m_blockCount;
+    uint8_t m_waitFrames;
+    uint32_t m_separationUs;
+    bool m_separationPending;  // no wait before the first frame of a block
+    uint32_t m_lastEventUs;    // last frame sent or flow control received
+};
+
+#endif  // SAILINGROBOT_CANISOTP_H
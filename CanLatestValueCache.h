@@ -0,0 +1,165 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanLatestValueCache.h
+ *
+ * Purpose:
+ *    Keeps the most recent CanMsg of every message id of CanMessageRegistry, and of
+ *    every current sensor ID, together with its receive timestamp. Readers poll the
+ *    current state without locks or allocation.
+ *
+ * Developer Notes:
+ *    RPI only, relies on std::atomic.
+ *
+ *    Each slot is a seqlock: a single writer thread (the bus reader) bumps the slot
+ *    sequence to an odd value, writes the frame and bumps it again; readers retry
+ *    when the sequence was odd or changed while they copied the frame. The frame is
+ *    stored in atomics so the concurrent copy is not a data race.
+ *
+ *    The frame is written with release stores and read with acquire loads rather
+ *    than relaxed accesses between fences: a reader that sees any field of a newer
+ *    write then sees its odd sequence too, and its second sequence load cannot move
+ *    before the field loads. Same cost on x86 (plain moves), and ThreadSanitizer
+ *    follows it, while it does not support std::atomic_thread_fence.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANLATESTVALUECACHE_H
+#define SAILINGROBOT_CANLATESTVALUECACHE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+#include "CanMessageRegistry.h"
+#include "CanMessageSchema.h"
+#include "CanPayload.h"
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "CanLatestValueCache.h is only available on the RPI"
+#endif
+
+struct CanTimestampedMsg {
+    CanMsg message;
+    uint64_t timestampNs;
+};
+
+class CanLatestValueCache {
+   public:
+    static const uint8_t CURRENT_SENSOR_COUNT = 1 << CurrentSensorData::SensorId::LENGTH;
+
+    CanLatestValueCache() {}
+
+    CanLatestValueCache(const CanLatestValueCache&) = delete;
+    CanLatestValueCache& operator=(const CanLatestValueCache&) = delete;
+
+    /**
+     * Writer side, a single thread only. Stores message as the latest value of its id,
+     * and of its sensor ID for MSG_ID_CURRENT_SENSOR_DATA.
+     *
+     * @param timestampNs receive time, any monotonic clock
+     * @return false if the id is not in CanMessageRegistry
+     */
+    bool update(const CanMsg& message, uint64_t timestampNs) {
+        uint8_t slot = CanMessageRegistry::slotOf(message.id);
+        if (slot == CanMessageRegistry::NO_SLOT) {
+            return false;
+        }
+        m_messageSlots[slot].write(message, timestampNs);
+
+        if (message.id == MSG_ID_CURRENT_SENSOR_DATA) {
+            m_currentSensorSlots[CurrentSensorData::SensorId::decode(message)].write(message, timestampNs);
+        }
+        return true;
+    }
+
+    /**
+     * Writer side, timestamped with std::chrono::steady_clock
+     */
+    bool update(const CanMsg& message) {
+        return update(message, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch()).count()));
+    }
+
+    /**
+     * Reader side, safe from any number of threads
+     * @return false if no message of this id was received yet
+     */
+    bool read(uint32_t messageId, CanTimestampedMsg& latest) const {
+        uint8_t slot = CanMessageRegistry::slotOf(messageId);
+        if (slot == CanMessageRegistry::NO_SLOT) {
+            return false;
+        }
+        return m_messageSlots[slot].read(latest);
+    }
+
+    /**
+     * Reader side, latest MSG_ID_CURRENT_SENSOR_DATA sent by the given sensor
+     * @return false if no message of this sensor was received yet
+     */
+    bool readCurrentSensor(uint8_t sensorId, CanTimestampedMsg& latest) const {
+        if (sensorId >= CURRENT_SENSOR_COUNT) {
+            return false;
+        }
+        return m_currentSensorSlots[sensorId].read(latest);
+    }
+
+   private:
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> sequence;  // 0 until the first write, odd while writing
+        std::atomic<uint32_t> id;
+        std::atomic<uint16_t> header;    // ide << 8 | length
+        std::atomic<uint64_t> payload;
+        std::atomic<uint64_t> timestampNs;
+
+        Slot() : sequence(0), id(0), header(0), payload(0), timestampNs(0) {}
+
+        void write(const CanMsg& message, uint64_t timestamp) {
+            uint32_t start = sequence.load(std::memory_order_relaxed);
+            sequence.store(start + 1, std::memory_order_relaxed);
+
+            // Each release store publishes the odd sequence above
+            id.store(message.id, std::memory_order_release);
+            header.store(static_cast<uint16_t>(message.header.ide << 8 | message.header.length),
+                         std::memory_order_release);
+            payload.store(CanPayload::load(message.data), std::memory_order_release);
+            timestampNs.store(timestamp, std::memory_order_release);
+
+            sequence.store(start + 2, std::memory_order_release);
+        }
+
+        bool read(CanTimestampedMsg& latest) const {
+            uint32_t start;
+            uint16_t readHeader;
+            uint64_t readPayload;
+            for (;;) {
+                start = sequence.load(std::memory_order_acquire);
+                if (start == 0) {
+                    return false;
+                }
+                if (start & 1) {
+                    continue;  // a write is in progress
+                }
+                // Acquire loads, the sequence load below stays after them
+                latest.message.id = id.load(std::memory_order_acquire);
+                readHeader = header.load(std::memory_order_acquire);
+                readPayload = payload.load(std::memory_order_acquire);
+                latest.timestampNs = timestampNs.load(std::memory_order_acquire);
+
+                if (sequence.load(std::memory_order_relaxed) == start) {
+                    break;
+                }
+            }
+            latest.message.header.ide = static_cast<uint8_t>(readHeader >> 8);
+            latest.message.header.length = static_cast<uint8_t>(readHeader);
+            CanPayload::store(readPayload, latest.message.data);
+            return true;
+        }
+    };
+
+    Slot m_messageSlots[CanMessageRegistry::SLOT_COUNT];
+    Slot m_currentSensorSlots[CURRENT_SENSOR_COUNT];
+};
+
+#endif  // SAILINGROBOT_CANLATESTVALUECACHE_H
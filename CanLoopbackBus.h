@@ -0,0 +1,140 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanLoopbackBus.h
+ *
+ * Purpose:
+ *    In-process bus with the send()/receive() functions of SocketCanTransport, to run
+ *    the RPI bus code against simulated nodes without hardware or a vcan interface.
+ *
+ *      bool marineSensor(const CanMsg& frame, CanLoopbackBus& bus, void* context) {
+ *          if (frame.id == MSG_ID_MARINE_SENSOR_REQUEST) { bus.inject(reading); }
+ *          return true;
+ *      }
+ *
+ *      CanLoopbackBus bus;
+ *      bus.addNode(marineSensor, NULL);
+ *
+ * Developer Notes:
+ *    RPI only, single thread: the nodes are called from send() and inject() their
+ *    replies in the receive queue. receive() never waits, the frames must be there.
+ *
+ *    The receive queue holds RECEIVE_CAPACITY frames, inject() drops the frames that
+ *    do not fit and counts them.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANLOOPBACKBUS_H
+#define SAILINGROBOT_CANLOOPBACKBUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "CanLoopbackBus.h is only available on the RPI"
+#endif
+
+class CanLoopbackBus;
+
+/**
+ * Simulated node, called with every frame sent on the bus
+ * @return false to make send() fail on this frame
+ */
+typedef bool (*CanLoopbackNode)(const CanMsg& frame, CanLoopbackBus& bus, void* context);
+
+class CanLoopbackBus {
+   public:
+    static const size_t RECEIVE_CAPACITY = 256;
+    static const size_t MAX_NODES = 8;
+
+    CanLoopbackBus() : m_nodeCount(0), m_readIndex(0), m_queued(0), m_sent(0), m_dropped(0) {}
+
+    CanLoopbackBus(const CanLoopbackBus&) = delete;
+    CanLoopbackBus& operator=(const CanLoopbackBus&) = delete;
+
+    /**
+     * @return false if there are already MAX_NODES nodes
+     */
+    bool addNode(CanLoopbackNode node, void* context) {
+        if (m_nodeCount == MAX_NODES) {
+            return false;
+        }
+        m_nodes[m_nodeCount].node = node;
+        m_nodes[m_nodeCount].context = context;
+        m_nodeCount++;
+        return true;
+    }
+
+    /**
+     * Queues a frame for receive(), as if a node had sent it
+     * @return false if the receive queue is full, the frame is then dropped
+     */
+    bool inject(const CanMsg& message) {
+        if (m_queued == RECEIVE_CAPACITY) {
+            m_dropped++;
+            return false;
+        }
+        m_queue[(m_readIndex + m_queued) % RECEIVE_CAPACITY] = message;
+        m_queued++;
+        return true;
+    }
+
+    /**
+     * Same as SocketCanTransport::receive(), never waits
+     * @return the number of frames received
+     */
+    int receive(CanMsg* messages, size_t maxCount, uint64_t* timestampsNs = NULL, int timeoutMs = -1) {
+        (void)timeoutMs;
+        size_t count = 0;
+        while (count < maxCount && m_queued > 0) {
+            messages[count] = m_queue[m_readIndex];
+            if (timestampsNs != NULL) {
+                timestampsNs[count] = 0;
+            }
+            m_readIndex = (m_readIndex + 1) % RECEIVE_CAPACITY;
+            m_queued--;
+            count++;
+        }
+        return static_cast<int>(count);
+    }
+
+    /**
+     * Same as SocketCanTransport::send(), every node gets each frame
+     * @return the number of frames sent, stops at the first frame a node refuses
+     */
+    int send(const CanMsg* messages, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            for (size_t n = 0; n < m_nodeCount; n++) {
+                if (!m_nodes[n].node(messages[i], *this, m_nodes[n].context)) {
+                    return static_cast<int>(i);
+                }
+            }
+            m_sent++;
+        }
+        return static_cast<int>(count);
+    }
+
+    size_t queued() const { return m_queued; }
+    uint32_t sent() const { return m_sent; }
+    uint32_t dropped() const { return m_dropped; }
+
+   private:
+    struct Node {
+        CanLoopbackNode node;
+        void* context;
+    };
+
+    Node m_nodes[MAX_NODES];
+    size_t m_nodeCount;
+
+    CanMsg m_queue[RECEIVE_CAPACITY];
+    size_t m_readIndex;
+    size_t m_queued;
+
+    uint32_t m_sent;
+    uint32_t m_dropped;
+};
+
+#endif  // SAILINGROBOT_CANLOOPBACKBUS_H
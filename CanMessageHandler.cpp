@@ -11,110 +11,76 @@
  *    There is only 7 bytes of data that can be encoded by using this class,
  *    because the last byte of the CanMsg is reserved for an error message.
  *
- *    TODO: implement the use of bitsets for the actuators (already done but commented in the files), and
- *    modify the CANbus files to delete the conversion steps from int8_t[8] to bitset<64> on the
- *    arduino scripts and raspberry files (hardware nodes mostly)
- *    TODO: update the error handling for all the messages
+ *    TODO: delete the calls to canMsgToBitset() and bitsetToCanMsg() from the arduino scripts
+ *    and raspberry files (hardware nodes mostly), they are no longer needed.
+ *    The error field of each message id is described in CanMessageRegistry.cpp
  *
  ***************************************************************************************/
 
 #include "CanMessageHandler.h"
 
-CanMessageHandler::CanMessageHandler(CanMsg message) : m_message(message){
-
+CanMessageHandler::CanMessageHandler(CanMsg message)
+    : m_messageId(message.id),
+      m_ide(message.header.ide),
+      m_length(message.header.length) {
+#if CANBUS_BYTEWISE_CODEC
+    memcpy(m_data, message.data, sizeof(m_data));
+#else
+    m_payload = CanPayload::load(message.data);
+#endif
 }
 
-CanMessageHandler::CanMessageHandler(uint32_t messageId) {
-    m_message.id = messageId;
-    m_message.header.ide = 0;
-    m_message.header.length = 8;
-    for(auto& byteData : m_message.data) {
-        byteData = 0;
-    }
-
-    m_message.data[INDEX_ERROR_CODE] = NO_ERRORS;
+CanMessageHandler::CanMessageHandler(uint32_t messageId)
+    : m_messageId(messageId), m_ide(0), m_length(8) {
+#if CANBUS_BYTEWISE_CODEC
+    memset(m_data, 0, sizeof(m_data));
+#else
+    m_payload = 0;
+#endif
+    setByte(INDEX_ERROR_CODE, NO_ERRORS);
 }
 
 uint32_t CanMessageHandler::getMessageId() {
-    return m_message.id;
+    return m_messageId;
 }
 
 CanMsg CanMessageHandler::getMessage() {
-    return m_message;
+    CanMsg message;
+    message.id = m_messageId;
+    message.header.ide = m_ide;
+    message.header.length = m_length;
+#if CANBUS_BYTEWISE_CODEC
+    memcpy(message.data, m_data, sizeof(m_data));
+#else
+    CanPayload::store(m_payload, message.data);
+#endif
+    return message;
 }
 
 std::bitset<64> CanMessageHandler::getMessageInBitset() {
-    return m_message_bitset;
+    #ifndef ON_ARDUINO_BOARD
+    return std::bitset<64>(getPayload());
+    #else
+    // ArduinoSTL bitset can only be built from an unsigned long
+    uint64_t payload = getPayload();
+    std::bitset<64> payloadBitset(static_cast<unsigned long>(payload >> 32));
+    payloadBitset <<= 32;
+    payloadBitset |= std::bitset<64>(static_cast<unsigned long>(payload & 0xFFFFFFFFUL));
+    return payloadBitset;
+    #endif
 }
 
 uint8_t CanMessageHandler::getErrorMessage() {
-    uint8_t errorMessage;
-    switch(m_message.id) {
-
-        case MSG_ID_CURRENT_SENSOR_REQUEST:
-            getData(&errorMessage, CURRENT_SENSOR_ERROR_START, 
-                     CURRENT_SENSOR_ERROR_DATASIZE, CURRENT_SENSOR_ERROR_IN_BYTE);
-            break;
-
-        case MSG_ID_MARINE_SENSOR_DATA:
-            getData(&errorMessage, SENSOR_ERROR_START, SENSOR_ERROR_DATASIZE, SENSOR_ERROR_IN_BYTE);
-            break;
-
-        default:
-            errorMessage = m_message.data[INDEX_ERROR_CODE];
-            break;
-
-    }
-    return errorMessage;
+    return CanFieldCodec::getErrorMessage(fields(), m_messageId);
 }
 
 void CanMessageHandler::setErrorMessage(uint8_t errorMessage) {
-
-    switch(m_message.id) {
-
-        case MSG_ID_CURRENT_SENSOR_REQUEST:
-            if(errorMessage >= 8) {
-                #ifndef ON_ARDUINO_BOARD
-                Logger::error("In CanMessageHandler::setErrorMessage(): error code value > current_sensor_max_error_value. Wrong error coded.");
-                #endif
-                // encode error 7('111') to make sure an error is still coded
-                encodeMessage(7, CURRENT_SENSOR_ERROR_START, 
-                               CURRENT_SENSOR_ERROR_DATASIZE, CURRENT_SENSOR_ERROR_IN_BYTE); 
-            } else {
-                encodeMessage(errorMessage, CURRENT_SENSOR_ERROR_START,
-                               CURRENT_SENSOR_ERROR_DATASIZE, CURRENT_SENSOR_ERROR_IN_BYTE);
-            }
-            break;
-
-        case MSG_ID_MARINE_SENSOR_DATA:
-            encodeMessage(errorMessage, SENSOR_ERROR_START, SENSOR_ERROR_DATASIZE, SENSOR_ERROR_IN_BYTE);
-            break;
-
-        default:  // other part of the code still use this version
-            if (m_message.data[INDEX_ERROR_CODE] == NO_ERRORS) {
-                m_message.data[INDEX_ERROR_CODE] = errorMessage;
-            }
-            break;
-                   
-    }
-
+    CanFieldCodec::setErrorMessage(fields(), m_messageId, errorMessage);
 }
 
 bool CanMessageHandler::canMsgToBitset() {
-    m_message_bitset = 0;
-
-    m_message_bitset |= (static_cast<std::bitset<64>>(m_message.data[7]));  // Arduino crash when shifting a bitset by zero...
-                                                              // So we do the first iteration before the loop in this case
-
-    for(int i=1; i<8; i++){
-        m_message_bitset |= (static_cast<std::bitset<64>>(m_message.data[7-i])) << i*8;
-    }
-
-    if(!(m_message_bitset.any())){ // In case of overflow and some other wrong operations, the returned bitset is zeros only
-        // Check if we are compiling for arduino board, so we don't use the logger on it, arduino use AVR architecture. 
-        #ifndef ON_ARDUINO_BOARD
-        Logger::error("In CanMessageHandler::canMsgToBitset(): Data bits are unset, most likely a wrong operation");
-        #endif 
+    if(getPayload() == 0){ // In case of overflow and some other wrong operations, the payload is zeros only
+        CAN_DIAG_ERROR(CAN_DIAG_EMPTY_PAYLOAD, "In CanMessageHandler::canMsgToBitset(): Data bits are unset, most likely a wrong operation");
 
         return false;
     }
@@ -122,11 +88,6 @@ bool CanMessageHandler::canMsgToBitset() {
 }
 
 bool CanMessageHandler::bitsetToCanMsg() { // no false output at the moment
-    for(int i=0; i<8; i++) {
-        m_message.data[i] = 0; // reset here before copying in the bitset
-        getData(&(m_message.data[i]), 7-i, 1, true);
-    }
-
     return true;
 }
 
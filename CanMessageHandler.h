@@ -12,8 +12,11 @@
  *    class, because the last byte of the CanMsg is reserved for an error message.
  *
  * Developer Notes:
- *    WARNING: ArduinoStl library used have no to_ullong function, we are limited to 4 bytes read (getData()) on Arduino boards.
- *             On the Raspberry PI side there is no problem for 8 bytes read.
+ *    The 8 data bytes are held in a single 64 bits word (see CanPayload.h), both the
+ *    byte-indexed and the bit-indexed functions read and write that word. On Arduino
+ *    boards they are kept as bytes and fields go through CanBitField.h instead, the
+ *    results are the same. The bit-indexed functions are the ones of CanFieldCodec.h,
+ *    shared with CanMessageView.h.
  *    NEED to install ArduinoSTL, easy to do from ArduinoIDE with the library manager
  *
  ***************************************************************************************/
@@ -24,13 +27,15 @@
 #include <stdint.h>
 
 #include "Float16Compressor.h"
+#include "CanBitField.h"
+#include "CanDiagnostics.h"
+#include "CanFieldCodec.h"
+#include "CanFixedPointMapping.h"
+#include "CanPayload.h"
+#include "CanQuantizer.h"
 #include "CanUtility.h"
 #include "canbus_defs.h"
 
-#if (defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_MEGA) || defined(ARDUINO_AVR_NANO))
- #define ON_ARDUINO_BOARD
-#endif
-
 #ifdef ON_ARDUINO_BOARD    // NEED to install ArduinoSTL library, easy to do from ArduinoIDE with the library manager
  #include <math.h>
  #include <bitset>
@@ -52,9 +57,38 @@ class CanMessageHandler {
     int currentDataWriteIndex = 0;
     int currentDataReadIndex = 0;
 
-    CanMsg m_message;
-    std::bitset<64> m_message_bitset;
-    // NOTE: m_message and m_message_bitset can currently be filled separately
+    uint32_t m_messageId;
+    uint8_t m_ide;
+    uint8_t m_length;
+#if CANBUS_BYTEWISE_CODEC
+    uint8_t m_data[CanPayload::PAYLOAD_SIZE_IN_BYTES];  // CanMsg.data, see CanBitField.h
+#else
+    uint64_t m_payload;  // CanMsg.data, big-endian, see CanPayload.h
+#endif
+
+    // Storage of the bit-indexed functions, see CanFieldCodec.h
+#if CANBUS_BYTEWISE_CODEC
+    uint8_t* fields() { return m_data; }
+    const uint8_t* fields() const { return m_data; }
+#else
+    uint64_t& fields() { return m_payload; }
+    const uint64_t& fields() const { return m_payload; }
+#endif
+
+#if CANBUS_BYTEWISE_CODEC
+    uint8_t getByte(int index) const { return m_data[index]; }
+
+    void setByte(int index, uint8_t value) { m_data[index] = value; }
+#else
+    uint8_t getByte(int index) const {
+        return static_cast<uint8_t>(m_payload >> CanPayload::byteShift(index));
+    }
+
+    void setByte(int index, uint8_t value) {
+        uint32_t shift = CanPayload::byteShift(index);
+        m_payload = (m_payload & ~(0xFFULL << shift)) | (static_cast<uint64_t>(value) << shift);
+    }
+#endif
 
    public:
     /**
@@ -90,10 +124,20 @@ class CanMessageHandler {
     CanMsg getMessage();
 
     /**
-     * Retrieves the constructed CanMsg from handler
-     * @return the current CanMsg
+     * Retrieves the payload of the CanMsg as a bitset
+     * @return the current payload, bit 0 is the lowest bit of CanMsg.data[7]
+     */
+    std::bitset<64> getMessageInBitset();
+
+    /**
+     * Retrieves the payload of the CanMsg as a word, see CanPayload.h for the byte order
+     * @return the current payload
      */
-    std::bitset<64> getMessageInBitset(); // rename to getBitsetMessage (currently filled separately from message)
+#if CANBUS_BYTEWISE_CODEC
+    uint64_t getPayload() const { return CanPayload::load(m_data); }
+#else
+    uint64_t getPayload() const { return m_payload; }
+#endif
 
     /**
      * Get an value between 0 - 255 used as an error message
@@ -109,12 +153,13 @@ class CanMessageHandler {
     void setErrorMessage(uint8_t errorMessage);
 
     /**
-     * Converts CanMsg.data into a bitset, hold by m_message_bitset
+     * Kept for compatibility, CanMsg.data and the bitset are the same payload word.
+     * @return false if no data bit is set
      */
     bool canMsgToBitset();
 
     /**
-     * Converts bitset to CanMsg.data
+     * Kept for compatibility, CanMsg.data and the bitset are the same payload word.
      */
     bool bitsetToCanMsg();
 
@@ -143,7 +188,7 @@ class CanMessageHandler {
         }
 
         for (int i = 0; i < lengthInBytes; i++) {
-            tmp_data_holder = (uint32_t)m_message.data[currentDataReadIndex + i] << (i * 8);
+            tmp_data_holder = (uint32_t)getByte(currentDataReadIndex + i) << (i * 8);
             *dataToSet += (T)(tmp_data_holder);
         }
         currentDataReadIndex += lengthInBytes;
@@ -151,57 +196,10 @@ class CanMessageHandler {
         return *dataToSet != static_cast<T>(DATA_NOT_VALID);
     }
 
-    // WARNING: this version get the data from the bitset only
-    // WARNING: use ONLY with UNSIGNED types to avoid random behavior
+    // T MUST be an unsigned integer type, checked at compile time on the RPI, see CanFieldCodec.h
     template <class T> 
     bool getData(T *dataToSet, uint start, uint length, bool varInBytes = true) {
-        #ifndef ON_ARDUINO_BOARD
-        if(!std::is_unsigned<T>::value) {
-            Logger::warning("In CanMessageHandler::getData(): Casting to SIGNED type, can lead to wrong data!");   
-        }
-        #endif
-        if(varInBytes) { length *= 8; start  *= 8; }
-
-        std::bitset<64> data_container; // init to zero
-        //std::bitset<64> mask((pow(2,length+start)-1)-(pow(2,start)-1));
-        std::bitset<64> mask((pow(2,length)-1));
-
-        if(start > 0) {  // Arduino fails to shift by zero a bitset...
-            mask <<= start;
-            data_container = (m_message_bitset & mask) >> start;
-        } else {
-            data_container = (m_message_bitset & mask);
-        }
-        
-        #ifndef ON_ARDUINO_BOARD
-        *dataToSet = static_cast<T>(data_container.to_ullong()); // NOTE: could add an option to return a bitset or not?
-        #else
-        // WARNING: ArduinoStl library used have no to_ullong function, we are limited to 4 bytes read on Arduino boards.
-        // NOTE   : please find a cleaner solution. Current solution consists in using the bitset constructor from a
-        //          string, so we convert the bitset<64> into string and then move its c_str() pointer by 32 so we have
-        //          the right side half of the bitset<64> used for the bitset<32> constructor.
-        //          The additional explicit declarations of templates are required by the arduino as the compiler have a
-        //          hard time resolving them by itself.
-        std::bitset<32> arduino_sized_bitset(static_cast<std::string>(data_container.to_string<char, std::string::traits_type, std::string::allocator_type>().c_str()+32));
-        *dataToSet = static_cast<T>(arduino_sized_bitset.to_ulong());  
-        #endif
-
-        if (start + length > 64) { // mask will be zero in this case
-            #ifndef ON_ARDUINO_BOARD
-            Logger::error("In CanMessageHandler::getData(): Wrong reading parameters");
-            #endif
-            return false;
-        }
-        if(!(data_container.any())){ // In case of overflow and some other wrong operations, the returned bitset is zeros only,
-                                     // but it can be a data in some cases.
-            #ifndef ON_ARDUINO_BOARD
-            // This log appears too many times when nothing wrong is happening, commented for now
-            // Logger::warning("In CanMessageHandler::getData(): Data bits are unset");
-            #endif
-            return false;
-        }
-
-        return true;        
+        return CanFieldCodec::getData(fields(), dataToSet, start, length, varInBytes);
     }
 
     /**
@@ -255,7 +253,7 @@ class CanMessageHandler {
 
         if (success) {
             if (varInBytes) { length *= 8; start *= 8; }
-            uint32_t maxValueFittingInGivenLength = (pow(2, length) - 1);
+            uint32_t maxValueFittingInGivenLength = static_cast<uint32_t>(CanPayload::mask(length));
             *dataToSet = static_cast<T>(CanUtility::mapInterval(
                 data, 0, maxValueFittingInGivenLength, minValue, maxValue));
             return true;
@@ -265,6 +263,31 @@ class CanMessageHandler {
         }
     }
 
+    /**
+     * Same as getMappedData() above with a fixed-point mapping, integer arithmetic only.
+     * Meant for the boards without FPU, see CanFixedPointMapping.h
+     *
+     * @param mapping a CanFixedPointMapping<MIN, MAX, LENGTH> or a CanFixedPointMapper,
+     *                its length must be the field length in bits
+     * @return false if data is not valid
+     */
+    template <class T, class Mapping>
+    bool getMappedData(T* dataToSet, uint start, uint length, bool varInBytes, const Mapping& mapping) {
+        return CanFieldCodec::getMappedData(fields(), dataToSet, start, length, varInBytes, mapping);
+    }
+
+    /**
+     * Gets a field packed with a quantizer, see CanQuantizer.h
+     *
+     * @param quantizer a MiniFloat or a ScaledInteger, its length must be the field
+     *                  length in bits
+     * @return false if data is not valid, a raw 0 included as for getData()
+     */
+    template <class Quantizer>
+    bool getQuantizedData(float* dataToSet, uint start, uint length, bool varInBytes, const Quantizer& quantizer) {
+        return CanFieldCodec::getQuantizedData(fields(), dataToSet, start, length, varInBytes, quantizer);
+    }
+
     /**
      * Encodes a clean positive integer value into canMsg.
      * Note: data value MUST be within the range of the lengthInBytes parameter
@@ -287,68 +310,18 @@ class CanMessageHandler {
 
         for (int i = 0; i < lengthInBytes; i++) {
             int dataIndex = currentDataWriteIndex + i;
-            m_message.data[dataIndex] = (data >> 8 * i) & 0xff;
+            setByte(dataIndex, (data >> 8 * i) & 0xff);
         }
         currentDataWriteIndex += lengthInBytes;
         return true;
     }
 
-    // @data MUST be an unsigned int to avoid potential random behavior
-    // NOTE: ONLY ENCODING THE BITSET at the moment
+    // @data MUST be an integer, checked at compile time on the RPI. Negative values are
+    // encoded as two's complement truncated to length bits.
+    // The field is overwritten, bits of data above length are dropped
     template <class T>
     bool encodeMessage(T data, uint start, uint length, bool varInBytes = true) {
-            /* IMPLEMENT THIS LATER
-        int ERROR_CANMSG_ENCODING_OUT_OF_BOUND = 2;
-        int ERROR_CANMSG_MASK_HAS_NO_BIT_SET = 3;
-        int ERROR_CANMSG_OVERWRITING = 4; // more a warning than an error  */
-        #ifndef ON_ARDUINO_BOARD
-        if(std::is_unsigned<T>::value) {
-            Logger::warning("In CanMessageHandler::encodeMessage(): Casting to SIGNED type, can lead to wrong data!");
-        }
-        #endif
-        // add an if check: if b_data >> max value --> overflow
-        if (varInBytes) { length *= 8; start *= 8; } // for simpler access using bytes
-        std::bitset<64> b_data(data); // if data is a signed int, it'll get through a ulong or ullong cast
-
-        // NOTE: Masks usage disabled for encoding as it leads to data corruption on the arduino side
-        //std::bitset<64> mask(pow(2,length)-1);
-
-        if(start > 0){ // again Arduino can't shift this bitset by zero...
-            //mask <<= start;
-
-            // Shift and use mask(just later). IMPORTANT: if length is not high enough, or start is too high, data corruption will occur here
-            b_data <<= start;
-        }
-/*
-        if ((m_message_bitset&mask).any()) { // simple check, does not take into account that a zero could be data
-            #ifndef ON_ARDUINO_BOARD
-            Logger::warning("Warning, overwriting data in the container");
-            #endif
-            //setErrorMessage(ERROR_CANMSG_OVERWRITING);
-        }
-*/        
-        //b_data &= mask;
-
-        // Set error message
-        if (start > 64) {
-            #ifndef ON_ARDUINO_BOARD
-            Logger::error("In CanMessageHandler::encodeMessage(): start > 64 ---> overflow!");
-            #endif
-            //setErrorMessage(ERROR_CANMSG_ENCODING_OUT_OF_BOUND);
-            return false;
-        }
-/*        if (!mask.any()) { // Assuming we never want an unset mask, it is a way to catch some unmatching length and start value
-                             // because mask is still 0 when overflowing at constructor step
-            #ifndef ON_ARDUINO_BOARD
-            Logger::error("In CanMessageHandler::encodeMessage(): Mask has no bits set, check LENGTH and START params.\n");
-            #endif
-            //setErrorMessage(ERROR_CANMSG_MASK_HAS_NO_BIT_SET);
-            return false;
-        }
-*/
-        // Merging to container
-        m_message_bitset |= b_data;   
-        return true;
+        return CanFieldCodec::encodeMessage(fields(), data, start, length, varInBytes);
     }
 
     /**
@@ -398,13 +371,40 @@ class CanMessageHandler {
         if(varInBytes) { start *= 8; length *= 8; varInBytes =false; }; 
         // NOTE: Set varInBytes to false on this step or the call to encodeMessage will re-multiply by 8 start and length
 
-        uint32_t maxValueFittingInGivenLength = (pow(2, length) - 1);
+        uint32_t maxValueFittingInGivenLength = static_cast<uint32_t>(CanPayload::mask(length));
         uint32_t mappedData = static_cast<uint32_t>(CanUtility::mapInterval(
             data, minValue, maxValue, 0, maxValueFittingInGivenLength));
 
         return encodeMessage(mappedData, start, length, varInBytes);
     }
 
+    /**
+     * Same as encodeMappedMessage() above with a fixed-point mapping, integer arithmetic
+     * only, rounded to the nearest step. Meant for the boards without FPU, see
+     * CanFixedPointMapping.h
+     *
+     * @param mapping a CanFixedPointMapping<MIN, MAX, LENGTH> or a CanFixedPointMapper,
+     *                its length must be the field length in bits
+     * @return false if data is outside of the mapping interval or the lengths differ
+     */
+    template <class T, class Mapping>
+    bool encodeMappedMessage(T data, uint start, uint length, bool varInBytes, const Mapping& mapping) {
+        return CanFieldCodec::encodeMappedMessage(fields(), data, start, length, varInBytes, mapping);
+    }
+
+    /**
+     * Encodes a value with a quantizer, to the nearest value of the quantizer, see
+     * CanQuantizer.h
+     *
+     * @param quantizer a MiniFloat or a ScaledInteger, its length must be the field
+     *                  length in bits
+     * @return false if data is NaN, outside of the quantizer range or the lengths differ
+     */
+    template <class Quantizer>
+    bool encodeQuantized(float data, uint start, uint length, bool varInBytes, const Quantizer& quantizer) {
+        return CanFieldCodec::encodeQuantized(fields(), data, start, length, varInBytes, quantizer);
+    }
+
    
      bool generateHeader(int msgType) ;
 };
@@ -0,0 +1,127 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMessageRegistry.cpp
+ *
+ * Purpose:
+ *    Descriptor table of the message ids and the dispatcher using it
+ *
+ * Developer Notes:
+ *    ID_TO_SLOT is generated at compile time from MESSAGE_DESCRIPTOR_IDS. The tables
+ *    are in flash on Arduino boards, read them through CanMessageRegistry only.
+ *
+ ***************************************************************************************/
+
+#include "CanMessageRegistry.h"
+#include "CanMessageSchema.h"
+
+namespace {
+
+template <class Message>
+void decodeTyped(const CanMsg& message, void* decoded) {
+    *static_cast<Message*>(decoded) = Message::fromMessage(message);
+}
+
+// Byte CanMsg.data[7], historically used as error byte by most messages
+const uint8_t LEGACY_ERROR_START = 0;
+const uint8_t LEGACY_ERROR_LENGTH = 8;
+
+const uint8_t SENSOR_ERROR_START_BIT = CAN_FIELD(SENSOR_ERROR)::START_BIT;
+const uint8_t SENSOR_ERROR_LENGTH = CAN_FIELD(SENSOR_ERROR)::LENGTH;
+const uint8_t CURRENT_SENSOR_ERROR_START_BIT = CAN_FIELD(CURRENT_SENSOR_ERROR)::START_BIT;
+const uint8_t CURRENT_SENSOR_ERROR_LENGTH = CAN_FIELD(CURRENT_SENSOR_ERROR)::LENGTH;
+const uint8_t CURRENT_SENSOR_ERROR_MAX = CAN_FIELD(CURRENT_SENSOR_ERROR)::MASK;
+
+// Same order as MESSAGE_DESCRIPTORS
+constexpr uint32_t MESSAGE_DESCRIPTOR_IDS[CanMessageRegistry::SLOT_COUNT] = {
+    MSG_ID_AU_CONTROL,
+    MSG_ID_AU_FEEDBACK,
+    MSG_ID_RC_STATUS,
+    MSG_ID_SOLAR_PANEL_CONTROL_PART_1,
+    MSG_ID_SOLAR_PANEL_CONTROL_PART_2,
+    MSG_ID_MARINE_SENSOR_REQUEST,
+    MSG_ID_MARINE_SENSOR_DATA,
+    MSG_ID_CURRENT_SENSOR_REQUEST,
+    MSG_ID_CURRENT_SENSOR_DATA,
+    MSG_ID_WINCH_CONTROL,
+    MSG_ID_WINCH_FEEDBACK,
+};
+
+constexpr uint8_t findSlot(uint32_t messageId, uint8_t slot = 0) {
+    return (slot >= CanMessageRegistry::SLOT_COUNT)
+               ? CanMessageRegistry::NO_SLOT
+               : (MESSAGE_DESCRIPTOR_IDS[slot] == messageId) ? slot : findSlot(messageId, slot + 1);
+}
+
+}  // namespace
+
+#define SLOT(offset) findSlot(CanMessageRegistry::FIRST_ID + (offset))
+#define SLOTS_10(offset)                                                                   \
+    SLOT(offset), SLOT(offset + 1), SLOT(offset + 2), SLOT(offset + 3), SLOT(offset + 4), \
+        SLOT(offset + 5), SLOT(offset + 6), SLOT(offset + 7), SLOT(offset + 8), SLOT(offset + 9)
+
+static_assert(CanMessageRegistry::ID_RANGE == 102, "ID_TO_SLOT initializer must cover the id range");
+
+const uint8_t CanMessageRegistry::ID_TO_SLOT[CanMessageRegistry::ID_RANGE] CAN_REGISTRY_TABLE_ATTRIBUTE = {
+    SLOTS_10(0),  SLOTS_10(10), SLOTS_10(20), SLOTS_10(30), SLOTS_10(40), SLOTS_10(50),
+    SLOTS_10(60), SLOTS_10(70), SLOTS_10(80), SLOTS_10(90), SLOT(100),    SLOT(101)};
+
+#undef SLOTS_10
+#undef SLOT
+
+const CanMessageDescriptor CanMessageRegistry::MESSAGE_DESCRIPTORS[CanMessageRegistry::SLOT_COUNT]
+    CAN_REGISTRY_TABLE_ATTRIBUTE = {
+    {MSG_ID_AU_CONTROL, LEGACY_ERROR_START, LEGACY_ERROR_LENGTH, 0xFF, true, &decodeTyped<AuControl>},
+    {MSG_ID_AU_FEEDBACK, LEGACY_ERROR_START, LEGACY_ERROR_LENGTH, 0xFF, true, &decodeTyped<AuFeedback>},
+    {MSG_ID_RC_STATUS, LEGACY_ERROR_START, LEGACY_ERROR_LENGTH, 0xFF, true, &decodeTyped<RcStatus>},
+    {MSG_ID_SOLAR_PANEL_CONTROL_PART_1, LEGACY_ERROR_START, LEGACY_ERROR_LENGTH, 0xFF, true, NULL},
+    {MSG_ID_SOLAR_PANEL_CONTROL_PART_2, LEGACY_ERROR_START, LEGACY_ERROR_LENGTH, 0xFF, true, NULL},
+    {MSG_ID_MARINE_SENSOR_REQUEST, LEGACY_ERROR_START, LEGACY_ERROR_LENGTH, 0xFF, true, NULL},
+    {MSG_ID_MARINE_SENSOR_DATA, SENSOR_ERROR_START_BIT, SENSOR_ERROR_LENGTH, 0xFF, false,
+     &decodeTyped<MarineSensorData>},
+    {MSG_ID_CURRENT_SENSOR_REQUEST, CURRENT_SENSOR_ERROR_START_BIT, CURRENT_SENSOR_ERROR_LENGTH,
+     CURRENT_SENSOR_ERROR_MAX, false, NULL},
+    {MSG_ID_CURRENT_SENSOR_DATA, CURRENT_SENSOR_ERROR_START_BIT, CURRENT_SENSOR_ERROR_LENGTH,
+     CURRENT_SENSOR_ERROR_MAX, false, &decodeTyped<CurrentSensorData>},
+    {MSG_ID_WINCH_CONTROL, LEGACY_ERROR_START, LEGACY_ERROR_LENGTH, 0xFF, true, NULL},
+    {MSG_ID_WINCH_FEEDBACK, LEGACY_ERROR_START, LEGACY_ERROR_LENGTH, 0xFF, true, NULL},
+};
+
+const CanMessageDescriptor CanMessageRegistry::DEFAULT_DESCRIPTOR CAN_REGISTRY_TABLE_ATTRIBUTE = {
+    0, LEGACY_ERROR_START, LEGACY_ERROR_LENGTH, 0xFF, true, NULL};
+
+CanMessageDispatcher::CanMessageDispatcher() {
+    for (auto& handler : m_handlers) {
+        handler.callback = NULL;
+        handler.context = NULL;
+    }
+    m_defaultHandler.callback = NULL;
+    m_defaultHandler.context = NULL;
+}
+
+bool CanMessageDispatcher::setHandler(uint32_t messageId, CanMessageCallback callback, void* context) {
+    uint8_t slot = CanMessageRegistry::slotOf(messageId);
+    if (slot == CanMessageRegistry::NO_SLOT) {
+        return false;
+    }
+    m_handlers[slot].callback = callback;
+    m_handlers[slot].context = context;
+    return true;
+}
+
+void CanMessageDispatcher::setDefaultHandler(CanMessageCallback callback, void* context) {
+    m_defaultHandler.callback = callback;
+    m_defaultHandler.context = context;
+}
+
+bool CanMessageDispatcher::dispatch(const CanMsg& message) const {
+    uint8_t slot = CanMessageRegistry::slotOf(message.id);
+    const Handler& handler = (slot != CanMessageRegistry::NO_SLOT && m_handlers[slot].callback)
+                                 ? m_handlers[slot]
+                                 : m_defaultHandler;
+    if (handler.callback == NULL) {
+        return false;
+    }
+    handler.callback(message, handler.context);
+    return true;
+}
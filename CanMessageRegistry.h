@@ -0,0 +1,141 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMessageRegistry.h
+ *
+ * Purpose:
+ *    Per message id description (error field layout, typed decoder) and a dispatcher
+ *    calling the handler registered for a message id. Lookups are a single index
+ *    into a dense table covering the ids of canbus_id_defs.h.
+ *
+ * Developer Notes:
+ *    To add a message type, add its id to canbus_id_defs.h and its descriptor to
+ *    MESSAGE_DESCRIPTORS in CanMessageRegistry.cpp. The id must lie within
+ *    [FIRST_ID, LAST_ID], widen the range if needed.
+ *
+ *    The tables are kept in flash on Arduino boards, descriptors are returned by copy.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANMESSAGEREGISTRY_H
+#define SAILINGROBOT_CANMESSAGEREGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #include <avr/pgmspace.h>
+ #define CAN_REGISTRY_TABLE_ATTRIBUTE PROGMEM
+#else
+ #define CAN_REGISTRY_TABLE_ATTRIBUTE
+#endif
+
+typedef void (*CanMessageCallback)(const CanMsg& message, void* context);
+
+/**
+ * Decodes message into the typed struct of its id (see CanMessageSchema.h)
+ * pointed to by decoded
+ */
+typedef void (*CanMessageDecoder)(const CanMsg& message, void* decoded);
+
+struct CanMessageDescriptor {
+    uint32_t id;
+    uint8_t errorStart;          // in bits, see CanPayload.h for the bit order
+    uint8_t errorLength;         // in bits
+    uint8_t errorMaxValue;       // larger error codes are clamped to this value
+    bool keepFirstError;         // an error already set is not overwritten
+    CanMessageDecoder decoder;   // NULL if the message has no typed struct
+};
+
+class CanMessageRegistry {
+   public:
+    static const uint32_t FIRST_ID = MSG_ID_AU_CONTROL;
+    static const uint32_t LAST_ID = MSG_ID_WINCH_FEEDBACK;
+    static const uint32_t ID_RANGE = LAST_ID - FIRST_ID + 1;
+
+    static const uint8_t SLOT_COUNT = 11;
+    static const uint8_t NO_SLOT = 0xFF;
+
+    /**
+     * @return the dense slot of a known message id in [0, SLOT_COUNT), NO_SLOT otherwise
+     */
+    static inline uint8_t slotOf(uint32_t messageId) {
+        uint32_t index = messageId - FIRST_ID;  // ids below FIRST_ID wrap around
+        if (index >= ID_RANGE) {
+            return NO_SLOT;
+        }
+#ifdef ON_ARDUINO_BOARD
+        return pgm_read_byte(&ID_TO_SLOT[index]);
+#else
+        return ID_TO_SLOT[index];
+#endif
+    }
+
+    /**
+     * @return the descriptor of a message id, the default descriptor for unknown ids
+     */
+    static inline CanMessageDescriptor descriptor(uint32_t messageId) {
+        uint8_t slot = slotOf(messageId);
+        return readDescriptor((slot != NO_SLOT) ? &MESSAGE_DESCRIPTORS[slot] : &DEFAULT_DESCRIPTOR);
+    }
+
+    static inline CanMessageDescriptor descriptorAt(uint8_t slot) {
+        return readDescriptor(&MESSAGE_DESCRIPTORS[slot]);
+    }
+
+   private:
+    static const uint8_t ID_TO_SLOT[ID_RANGE];
+    static const CanMessageDescriptor MESSAGE_DESCRIPTORS[SLOT_COUNT];
+    static const CanMessageDescriptor DEFAULT_DESCRIPTOR;
+
+    static inline CanMessageDescriptor readDescriptor(const CanMessageDescriptor* tableEntry) {
+#ifdef ON_ARDUINO_BOARD
+        CanMessageDescriptor descriptor;
+        memcpy_P(&descriptor, tableEntry, sizeof(descriptor));
+        return descriptor;
+#else
+        return *tableEntry;
+#endif
+    }
+};
+
+/**
+ * Calls the handler registered for the id of each message
+ */
+class CanMessageDispatcher {
+   public:
+    CanMessageDispatcher();
+
+    /**
+     * Registers the handler of a message id, replacing any previous one
+     *
+     * @param messageId an id of canbus_id_defs.h
+     * @param callback the handler, NULL to remove it
+     * @param context passed back to the handler
+     * @return false if the id is not in CanMessageRegistry
+     */
+    bool setHandler(uint32_t messageId, CanMessageCallback callback, void* context = NULL);
+
+    /**
+     * Registers the handler called for ids without a handler of their own
+     */
+    void setDefaultHandler(CanMessageCallback callback, void* context = NULL);
+
+    /**
+     * @return true if a handler was called
+     */
+    bool dispatch(const CanMsg& message) const;
+
+   private:
+    struct Handler {
+        CanMessageCallback callback;
+        void* context;
+    };
+
+    Handler m_handlers[CanMessageRegistry::SLOT_COUNT];
+    Handler m_defaultHandler;
+};
+
+#endif  // SAILINGROBOT_CANMESSAGEREGISTRY_H
@@ -0,0 +1,348 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMessageSchema.h
+ *
+ * Purpose:
+ *    Compile-time descriptors for the fields of canbus_datamappings_defs.h and typed
+ *    message structs built from them. The layout is resolved by the compiler, so
+ *    encoding or decoding a field is a fixed shift and mask on the payload word.
+ *
+ * Developer Notes:
+ *    Bit positions follow the bit-indexed API of CanMessageHandler, see CanPayload.h.
+ *
+ *    CAN_FIELD(NAME) gives the descriptor of the NAME_START / NAME_DATASIZE /
+ *    NAME_IN_BYTE triplet, e.g. CAN_FIELD(SENSOR_PH).
+ *
+ *    The typed structs hold the raw encoded values. Mapping them back to physical
+ *    units (interval mapping, Float16Compressor...) is left to the caller.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANMESSAGESCHEMA_H
+#define SAILINGROBOT_CANMESSAGESCHEMA_H
+
+#include <stdint.h>
+
+#include "CanPayload.h"
+#include "canbus_defs.h"
+
+#define CAN_FIELD(NAME) CanField<NAME##_START, NAME##_DATASIZE, NAME##_IN_BYTE>
+
+/**
+ * Smallest unsigned type able to hold a field of LENGTH bits
+ */
+template <uint32_t LENGTH, bool FITS_8 = (LENGTH <= 8), bool FITS_16 = (LENGTH <= 16),
+          bool FITS_32 = (LENGTH <= 32)>
+struct CanFieldValue {
+    typedef uint64_t type;
+};
+template <uint32_t LENGTH, bool FITS_16, bool FITS_32>
+struct CanFieldValue<LENGTH, true, FITS_16, FITS_32> {
+    typedef uint8_t type;
+};
+template <uint32_t LENGTH, bool FITS_32>
+struct CanFieldValue<LENGTH, false, true, FITS_32> {
+    typedef uint16_t type;
+};
+template <uint32_t LENGTH>
+struct CanFieldValue<LENGTH, false, false, true> {
+    typedef uint32_t type;
+};
+
+/**
+ * Descriptor of one field of the payload word
+ *
+ * @tparam START start position, in bytes or bits depending on IN_BYTE
+ * @tparam DATASIZE length, in bytes or bits depending on IN_BYTE
+ * @tparam IN_BYTE non zero if START and DATASIZE are given in bytes
+ */
+template <uint32_t START, uint32_t DATASIZE, uint32_t IN_BYTE>
+struct CanField {
+    static const uint32_t START_BIT = IN_BYTE ? START * 8 : START;
+    static const uint32_t LENGTH = IN_BYTE ? DATASIZE * 8 : DATASIZE;
+
+    static_assert(LENGTH > 0, "CanField: field has no bits");
+    static_assert(START_BIT + LENGTH <= 64, "CanField: field does not fit in the 64 bits payload");
+
+    static const uint64_t MASK = (LENGTH >= 64) ? ~0ULL : ((1ULL << LENGTH) - 1);
+
+    typedef typename CanFieldValue<LENGTH>::type ValueType;
+
+    /**
+     * @param payload the payload word
+     * @return the raw value of the field
+     */
+    static inline ValueType get(uint64_t payload) {
+        return static_cast<ValueType>((payload >> START_BIT) & MASK);
+    }
+
+    /**
+     * Replaces the field in the payload word, bits above LENGTH in value are dropped
+     *
+     * @return the updated payload word
+     */
+    static inline uint64_t set(uint64_t payload, uint64_t value) {
+        return (payload & ~(MASK << START_BIT)) | ((value & MASK) << START_BIT);
+    }
+
+    static inline ValueType decode(const CanMsg& message) {
+        return get(CanPayload::load(message.data));
+    }
+
+    static inline void encode(CanMsg& message, uint64_t value) {
+        CanPayload::store(set(CanPayload::load(message.data), value), message.data);
+    }
+};
+
+/**
+ * True if the two fields share at least one bit
+ */
+template <class A, class B>
+struct CanFieldsOverlap {
+    static const bool value =
+        A::START_BIT < B::START_BIT + B::LENGTH && B::START_BIT < A::START_BIT + A::LENGTH;
+};
+
+/**
+ * True if Field shares at least one bit with one of Others
+ */
+template <class Field, class... Others>
+struct CanFieldOverlapsAny {
+    static const bool value = false;
+};
+template <class Field, class Other, class... Others>
+struct CanFieldOverlapsAny<Field, Other, Others...> {
+    static const bool value = CanFieldsOverlap<Field, Other>::value || CanFieldOverlapsAny<Field, Others...>::value;
+};
+
+/**
+ * True if no two of the fields share a bit, every pair is checked
+ */
+template <class... Fields>
+struct CanFieldsDisjoint {
+    static const bool value = true;
+};
+template <class Field, class... Others>
+struct CanFieldsDisjoint<Field, Others...> {
+    static const bool value = !CanFieldOverlapsAny<Field, Others...>::value && CanFieldsDisjoint<Others...>::value;
+};
+
+/**
+ * Returns a clean CanMsg of the given id carrying the given payload
+ */
+inline CanMsg makeCanMsg(uint32_t messageId, uint64_t payload) {
+    CanMsg message;
+    message.id = messageId;
+    message.header.ide = 0;
+    message.header.length = 8;
+    CanPayload::store(payload, message.data);
+    return message;
+}
+
+/**
+ * MSG_ID_MARINE_SENSOR_DATA
+ */
+struct MarineSensorData {
+    static const uint32_t ID = MSG_ID_MARINE_SENSOR_DATA;
+
+    typedef CAN_FIELD(SENSOR_PH) Ph;
+    typedef CAN_FIELD(SENSOR_CONDUCTIVETY) Conductivity;
+    typedef CAN_FIELD(SENSOR_TEMPERATURE) Temperature;
+    typedef CAN_FIELD(SENSOR_ERROR) Error;
+
+    static_assert(CanFieldsDisjoint<Ph, Conductivity, Temperature, Error>::value,
+                  "MarineSensorData: overlapping fields");
+
+    Ph::ValueType ph;
+    Conductivity::ValueType conductivity;
+    Temperature::ValueType temperature;
+    Error::ValueType error;
+
+    static inline MarineSensorData fromPayload(uint64_t payload) {
+        MarineSensorData data;
+        data.ph = Ph::get(payload);
+        data.conductivity = Conductivity::get(payload);
+        data.temperature = Temperature::get(payload);
+        data.error = Error::get(payload);
+        return data;
+    }
+
+    inline uint64_t toPayload() const {
+        uint64_t payload = 0;
+        payload = Ph::set(payload, ph);
+        payload = Conductivity::set(payload, conductivity);
+        payload = Temperature::set(payload, temperature);
+        payload = Error::set(payload, error);
+        return payload;
+    }
+
+    static inline MarineSensorData fromMessage(const CanMsg& message) {
+        return fromPayload(CanPayload::load(message.data));
+    }
+
+    inline CanMsg toMessage() const { return makeCanMsg(ID, toPayload()); }
+};
+
+/**
+ * MSG_ID_AU_CONTROL
+ *
+ * NOTE: WINDVANE_SELFSTEERING_ON shares its position with WINDVANE_SELFSTEERING_ANGLE,
+ *       it is left out until the layout is fixed in canbus_datamappings_defs.h.
+ */
+struct AuControl {
+    static const uint32_t ID = MSG_ID_AU_CONTROL;
+
+    typedef CAN_FIELD(RUDDER_ANGLE) Rudder;
+    typedef CAN_FIELD(WINGSAIL_ANGLE) Wingsail;
+    typedef CAN_FIELD(WINDVANE_SELFSTEERING_ANGLE) WindvaneSelfSteeringAngle;
+
+    static_assert(CanFieldsDisjoint<Rudder, Wingsail, WindvaneSelfSteeringAngle>::value,
+                  "AuControl: overlapping fields");
+
+    Rudder::ValueType rudder;
+    Wingsail::ValueType wingsail;
+    WindvaneSelfSteeringAngle::ValueType windvaneSelfSteeringAngle;
+
+    static inline AuControl fromPayload(uint64_t payload) {
+        AuControl data;
+        data.rudder = Rudder::get(payload);
+        data.wingsail = Wingsail::get(payload);
+        data.windvaneSelfSteeringAngle = WindvaneSelfSteeringAngle::get(payload);
+        return data;
+    }
+
+    inline uint64_t toPayload() const {
+        uint64_t payload = 0;
+        payload = Rudder::set(payload, rudder);
+        payload = Wingsail::set(payload, wingsail);
+        payload = WindvaneSelfSteeringAngle::set(payload, windvaneSelfSteeringAngle);
+        return payload;
+    }
+
+    static inline AuControl fromMessage(const CanMsg& message) {
+        return fromPayload(CanPayload::load(message.data));
+    }
+
+    inline CanMsg toMessage() const { return makeCanMsg(ID, toPayload()); }
+};
+
+/**
+ * MSG_ID_AU_FEEDBACK
+ */
+struct AuFeedback {
+    static const uint32_t ID = MSG_ID_AU_FEEDBACK;
+
+    typedef CAN_FIELD(RUDDER_ANGLE) Rudder;
+    typedef CAN_FIELD(WINGSAIL_ANGLE) Wingsail;
+    typedef CAN_FIELD(WINDVANE_SELFSTEERING_ANGLE) WindvaneSelfSteeringAngle;
+    typedef CAN_FIELD(WINDVANE_ACTUATOR_POSITION) WindvaneActuatorPosition;
+
+    static_assert(CanFieldsDisjoint<Rudder, Wingsail, WindvaneSelfSteeringAngle, WindvaneActuatorPosition>::value,
+                  "AuFeedback: overlapping fields");
+
+    Rudder::ValueType rudder;
+    Wingsail::ValueType wingsail;
+    WindvaneSelfSteeringAngle::ValueType windvaneSelfSteeringAngle;
+    WindvaneActuatorPosition::ValueType windvaneActuatorPosition;
+
+    static inline AuFeedback fromPayload(uint64_t payload) {
+        AuFeedback data;
+        data.rudder = Rudder::get(payload);
+        data.wingsail = Wingsail::get(payload);
+        data.windvaneSelfSteeringAngle = WindvaneSelfSteeringAngle::get(payload);
+        data.windvaneActuatorPosition = WindvaneActuatorPosition::get(payload);
+        return data;
+    }
+
+    inline uint64_t toPayload() const {
+        uint64_t payload = 0;
+        payload = Rudder::set(payload, rudder);
+        payload = Wingsail::set(payload, wingsail);
+        payload = WindvaneSelfSteeringAngle::set(payload, windvaneSelfSteeringAngle);
+        payload = WindvaneActuatorPosition::set(payload, windvaneActuatorPosition);
+        return payload;
+    }
+
+    static inline AuFeedback fromMessage(const CanMsg& message) {
+        return fromPayload(CanPayload::load(message.data));
+    }
+
+    inline CanMsg toMessage() const { return makeCanMsg(ID, toPayload()); }
+};
+
+/**
+ * MSG_ID_RC_STATUS
+ */
+struct RcStatus {
+    static const uint32_t ID = MSG_ID_RC_STATUS;
+
+    typedef CAN_FIELD(RADIOCONTROLLER_ON) RadioControllerOn;
+
+    RadioControllerOn::ValueType radioControllerOn;
+
+    static inline RcStatus fromPayload(uint64_t payload) {
+        RcStatus data;
+        data.radioControllerOn = RadioControllerOn::get(payload);
+        return data;
+    }
+
+    inline uint64_t toPayload() const { return RadioControllerOn::set(0, radioControllerOn); }
+
+    static inline RcStatus fromMessage(const CanMsg& message) {
+        return fromPayload(CanPayload::load(message.data));
+    }
+
+    inline CanMsg toMessage() const { return makeCanMsg(ID, toPayload()); }
+};
+
+/**
+ * MSG_ID_CURRENT_SENSOR_DATA
+ * voltage and current are half precision floats, see Float16Compressor.h
+ */
+struct CurrentSensorData {
+    static const uint32_t ID = MSG_ID_CURRENT_SENSOR_DATA;
+
+    typedef CAN_FIELD(CURRENT_SENSOR_VOLTAGE) Voltage;
+    typedef CAN_FIELD(CURRENT_SENSOR_CURRENT) Current;
+    typedef CAN_FIELD(CURRENT_SENSOR_ERROR) Error;
+    typedef CAN_FIELD(CURRENT_SENSOR_ROL_NUM) RollingNumber;
+    typedef CAN_FIELD(CURRENT_SENSOR_ID) SensorId;
+
+    static_assert(CanFieldsDisjoint<Voltage, Current, Error, RollingNumber, SensorId>::value,
+                  "CurrentSensorData: overlapping fields");
+
+    Voltage::ValueType voltage;
+    Current::ValueType current;
+    Error::ValueType error;
+    RollingNumber::ValueType rollingNumber;
+    SensorId::ValueType sensorId;
+
+    static inline CurrentSensorData fromPayload(uint64_t payload) {
+        CurrentSensorData data;
+        data.voltage = Voltage::get(payload);
+        data.current = Current::get(payload);
+        data.error = Error::get(payload);
+        data.rollingNumber = RollingNumber::get(payload);
+        data.sensorId = SensorId::get(payload);
+        return data;
+    }
+
+    inline uint64_t toPayload() const {
+        uint64_t payload = 0;
+        payload = Voltage::set(payload, voltage);
+        payload = Current::set(payload, current);
+        payload = Error::set(payload, error);
+        payload = RollingNumber::set(payload, rollingNumber);
+        payload = SensorId::set(payload, sensorId);
+        return payload;
+    }
+
+    static inline CurrentSensorData fromMessage(const CanMsg& message) {
+        return fromPayload(CanPayload::load(message.data));
+    }
+
+    inline CanMsg toMessage() const { return makeCanMsg(ID, toPayload()); }
+};
+
+#endif  // SAILINGROBOT_CANMESSAGESCHEMA_H
@@ -0,0 +1,139 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMessageView.h
+ *
+ * Purpose:
+ *    Field access on a CanMsg, or on 8 data bytes, owned by the caller: a frame in a
+ *    ring buffer or a memory-mapped log is decoded or encoded where it is, without
+ *    the copies and the cursors of CanMessageHandler.
+ *
+ *      CanMessageView view(ring.front());
+ *      uint16_t temperature;
+ *      view.getData(&temperature, SENSOR_TEMPERATURE_START, SENSOR_TEMPERATURE_DATASIZE,
+ *                   SENSOR_TEMPERATURE_IN_BYTE);
+ *
+ *      CanMessageEncoder encoder(message);
+ *      encoder.encodeMessage(angle, RUDDER_ANGLE_START, RUDDER_ANGLE_DATASIZE, RUDDER_ANGLE_IN_BYTE);
+ *
+ * Developer Notes:
+ *    getData(), encodeMessage(), the fixed-point getMappedData()/encodeMappedMessage(),
+ *    getQuantizedData()/encodeQuantized() and the error message functions are the
+ *    bit-indexed ones of CanMessageHandler, both go through CanFieldCodec.h. The views
+ *    only hold a pointer, they must not outlive the frame.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANMESSAGEVIEW_H
+#define SAILINGROBOT_CANMESSAGEVIEW_H
+
+#include <stdint.h>
+
+#include "CanFieldCodec.h"
+#include "CanPayload.h"
+#include "CanQuantizer.h"
+#include "canbus_defs.h"
+
+/**
+ * Read-only view of a frame
+ */
+class CanMessageView {
+   public:
+    explicit CanMessageView(const CanMsg& message) : m_data(message.data), m_messageId(message.id) {}
+
+    /**
+     * @param data the 8 data bytes of a frame
+     * @param messageId only needed by getErrorMessage()
+     */
+    explicit CanMessageView(const uint8_t* data, uint32_t messageId = 0) : m_data(data), m_messageId(messageId) {}
+
+    uint32_t getMessageId() const { return m_messageId; }
+
+    uint64_t getPayload() const { return CanPayload::load(m_data); }
+
+    /**
+     * Same as CanMessageHandler::getData(T*, start, length, varInBytes)
+     * @return false if the field is out of bounds or zero
+     */
+    template <class T>
+    bool getData(T* dataToSet, uint32_t start, uint32_t length, bool varInBytes = true) const {
+        return CanFieldCodec::getData(m_data, dataToSet, start, length, varInBytes);
+    }
+
+    /**
+     * Same as CanMessageHandler::getMappedData() with a fixed-point mapping
+     */
+    template <class T, class Mapping>
+    bool getMappedData(T* dataToSet, uint32_t start, uint32_t length, bool varInBytes, const Mapping& mapping) const {
+        return CanFieldCodec::getMappedData(m_data, dataToSet, start, length, varInBytes, mapping);
+    }
+
+    /**
+     * Same as CanMessageHandler::getQuantizedData()
+     */
+    template <class Quantizer>
+    bool getQuantizedData(float* dataToSet, uint32_t start, uint32_t length, bool varInBytes, const Quantizer& quantizer) const {
+        return CanFieldCodec::getQuantizedData(m_data, dataToSet, start, length, varInBytes, quantizer);
+    }
+
+    /**
+     * Error field of the message id, see CanMessageRegistry.cpp
+     */
+    uint8_t getErrorMessage() const { return CanFieldCodec::getErrorMessage(m_data, m_messageId); }
+
+   private:
+    const uint8_t* m_data;
+    uint32_t m_messageId;
+};
+
+/**
+ * Encodes fields in place in a frame
+ */
+class CanMessageEncoder {
+   public:
+    explicit CanMessageEncoder(CanMsg& message) : m_data(message.data), m_messageId(message.id) {}
+
+    /**
+     * @param data the 8 data bytes of a frame
+     * @param messageId only needed by setErrorMessage()
+     */
+    explicit CanMessageEncoder(uint8_t* data, uint32_t messageId = 0) : m_data(data), m_messageId(messageId) {}
+
+    CanMessageView view() const { return CanMessageView(m_data, m_messageId); }
+
+    /**
+     * Same as CanMessageHandler::encodeMessage(T, start, length, varInBytes)
+     * @return false if the field is out of bounds
+     */
+    template <class T>
+    bool encodeMessage(T data, uint32_t start, uint32_t length, bool varInBytes = true) {
+        return CanFieldCodec::encodeMessage(m_data, data, start, length, varInBytes);
+    }
+
+    /**
+     * Same as CanMessageHandler::encodeMappedMessage() with a fixed-point mapping
+     */
+    template <class T, class Mapping>
+    bool encodeMappedMessage(T data, uint32_t start, uint32_t length, bool varInBytes, const Mapping& mapping) {
+        return CanFieldCodec::encodeMappedMessage(m_data, data, start, length, varInBytes, mapping);
+    }
+
+    /**
+     * Same as CanMessageHandler::encodeQuantized()
+     */
+    template <class Quantizer>
+    bool encodeQuantized(float data, uint32_t start, uint32_t length, bool varInBytes, const Quantizer& quantizer) {
+        return CanFieldCodec::encodeQuantized(m_data, data, start, length, varInBytes, quantizer);
+    }
+
+    /**
+     * Same as CanMessageHandler::setErrorMessage()
+     */
+    void setErrorMessage(uint8_t errorMessage) { CanFieldCodec::setErrorMessage(m_data, m_messageId, errorMessage); }
+
+   private:
+    uint8_t* m_data;
+    uint32_t m_messageId;
+};
+
+#endif  // SAILINGROBOT_CANMESSAGEVIEW_H
@@ -0,0 +1,277 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMsgRingBuffer.h
+ *
+ * Purpose:
+ *    Fixed capacity lock-free queues of CanMsg, to hand frames from the thread reading
+ *    the bus to the threads decoding them without blocking the reader.
+ *
+ *    CanMsgSpscRing: one producer thread, one consumer thread.
+ *    CanMsgMpscRing: any number of producer threads, one consumer thread.
+ *
+ * Developer Notes:
+ *    RPI only, relies on std::atomic.
+ *
+ *    Nothing is allocated after construction, the frames are stored inside the
+ *    object, so declare large rings static or allocate them once at startup.
+ *    A push on a full ring drops the frame and increments the overflow counter,
+ *    it never waits for the consumer.
+ *
+ *    The MPSC ring is the bounded queue by Dmitry Vyukov: every slot carries a
+ *    sequence number telling whether it is free for the position being pushed or
+ *    holds the frame of the position being popped.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANMSGRINGBUFFER_H
+#define SAILINGROBOT_CANMSGRINGBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "CanMsgRingBuffer.h is only available on the RPI"
+#endif
+
+const size_t CAN_RING_CACHE_LINE_SIZE = 64;
+
+template <size_t CAPACITY>
+class CanMsgSpscRing {
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "CanMsgSpscRing: CAPACITY must be a power of two");
+
+   public:
+    CanMsgSpscRing() : m_writeIndex(0), m_cachedReadIndex(0), m_readIndex(0), m_cachedWriteIndex(0), m_overflows(0) {}
+
+    CanMsgSpscRing(const CanMsgSpscRing&) = delete;
+    CanMsgSpscRing& operator=(const CanMsgSpscRing&) = delete;
+
+    /**
+     * Producer side
+     * @return false if the ring is full, the frame is then dropped
+     */
+    bool push(const CanMsg& message) { return push(&message, 1) == 1; }
+
+    /**
+     * Producer side, pushes as many frames as there is room for
+     * @return the number of frames pushed, the remaining ones are dropped
+     */
+    size_t push(const CanMsg* messages, size_t count) {
+        size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+        size_t freeSlots = CAPACITY - (writeIndex - m_cachedReadIndex);
+        if (freeSlots < count) {
+            m_cachedReadIndex = m_readIndex.load(std::memory_order_acquire);
+            freeSlots = CAPACITY - (writeIndex - m_cachedReadIndex);
+        }
+
+        size_t pushed = (count < freeSlots) ? count : freeSlots;
+        for (size_t i = 0; i < pushed; i++) {
+            m_buffer[(writeIndex + i) & (CAPACITY - 1)] = messages[i];
+        }
+        m_writeIndex.store(writeIndex + pushed, std::memory_order_release);
+
+        if (pushed < count) {
+            m_overflows.fetch_add(count - pushed, std::memory_order_relaxed);
+        }
+        return pushed;
+    }
+
+    /**
+     * Consumer side
+     * @return false if the ring is empty
+     */
+    bool pop(CanMsg& message) { return pop(&message, 1) == 1; }
+
+    /**
+     * Consumer side, pops up to maxCount frames
+     * @return the number of frames popped
+     */
+    size_t pop(CanMsg* messages, size_t maxCount) {
+        size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+        size_t available = m_cachedWriteIndex - readIndex;
+        if (available < maxCount) {
+            m_cachedWriteIndex = m_writeIndex.load(std::memory_order_acquire);
+            available = m_cachedWriteIndex - readIndex;
+        }
+
+        size_t popped = (maxCount < available) ? maxCount : available;
+        for (size_t i = 0; i < popped; i++) {
+            messages[i] = m_buffer[(readIndex + i) & (CAPACITY - 1)];
+        }
+        m_readIndex.store(readIndex + popped, std::memory_order_release);
+        return popped;
+    }
+
+    /**
+     * Approximate when called while the other side is running
+     */
+    size_t size() const {
+        return m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_acquire);
+    }
+
+    static size_t capacity() { return CAPACITY; }
+
+    /**
+     * @return the number of frames dropped because the ring was full
+     */
+    uint64_t overflowCount() const { return m_overflows.load(std::memory_order_relaxed); }
+
+   private:
+    // Producer cache line
+    alignas(CAN_RING_CACHE_LINE_SIZE) std::atomic<size_t> m_writeIndex;
+    size_t m_cachedReadIndex;
+
+    // Consumer cache line
+    alignas(CAN_RING_CACHE_LINE_SIZE) std::atomic<size_t> m_readIndex;
+    size_t m_cachedWriteIndex;
+
+    alignas(CAN_RING_CACHE_LINE_SIZE) std::atomic<uint64_t> m_overflows;
+
+    alignas(CAN_RING_CACHE_LINE_SIZE) CanMsg m_buffer[CAPACITY];
+};
+
+template <size_t CAPACITY>
+class CanMsgMpscRing {
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "CanMsgMpscRing: CAPACITY must be a power of two");
+
+   public:
+    CanMsgMpscRing() : m_writeIndex(0), m_readIndex(0), m_overflows(0) {
+        for (size_t i = 0; i < CAPACITY; i++) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    CanMsgMpscRing(const CanMsgMpscRing&) = delete;
+    CanMsgMpscRing& operator=(const CanMsgMpscRing&) = delete;
+
+    /**
+     * Producer side, safe from any number of threads
+     * @return false if the ring is full, the frame is then dropped
+     */
+    bool push(const CanMsg& message) {
+        size_t position = m_writeIndex.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = m_slots[position & (CAPACITY - 1)];
+            intptr_t difference = static_cast<intptr_t>(slot.sequence.load(std::memory_order_acquire)) -
+                                  static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (m_writeIndex.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.message = message;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                m_overflows.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = m_writeIndex.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Producer side, safe from any number of threads. The frames are reserved with a
+     * single atomic operation when there is room for all of them, otherwise they are
+     * pushed one by one until the ring is full.
+     *
+     * @return the number of frames pushed, the remaining ones are dropped
+     */
+    size_t push(const CanMsg* messages, size_t count) {
+        if (count == 0 || count > CAPACITY) {
+            return pushEach(messages, count);
+        }
+
+        size_t position = m_writeIndex.load(std::memory_order_relaxed);
+        for (;;) {
+            // The consumer frees slots in order, so if the last slot is free all are
+            Slot& last = m_slots[(position + count - 1) & (CAPACITY - 1)];
+            intptr_t difference = static_cast<intptr_t>(last.sequence.load(std::memory_order_acquire)) -
+                                  static_cast<intptr_t>(position + count - 1);
+            if (difference != 0) {
+                return pushEach(messages, count);
+            }
+            if (m_writeIndex.compare_exchange_weak(position, position + count, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            Slot& slot = m_slots[(position + i) & (CAPACITY - 1)];
+            slot.message = messages[i];
+            slot.sequence.store(position + i + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    /**
+     * Consumer side, a single thread only
+     * @return false if the ring is empty
+     */
+    bool pop(CanMsg& message) {
+        size_t position = m_readIndex.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[position & (CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            return false;
+        }
+        message = slot.message;
+        slot.sequence.store(position + CAPACITY, std::memory_order_release);
+        m_readIndex.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Consumer side, pops up to maxCount frames
+     * @return the number of frames popped
+     */
+    size_t pop(CanMsg* messages, size_t maxCount) {
+        size_t popped = 0;
+        while (popped < maxCount && pop(messages[popped])) {
+            popped++;
+        }
+        return popped;
+    }
+
+    /**
+     * Approximate when called while producers are running
+     */
+    size_t size() const {
+        return m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_acquire);
+    }
+
+    static size_t capacity() { return CAPACITY; }
+
+    /**
+     * @return the number of frames dropped because the ring was full
+     */
+    uint64_t overflowCount() const { return m_overflows.load(std::memory_order_relaxed); }
+
+   private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        CanMsg message;
+    };
+
+    size_t pushEach(const CanMsg* messages, size_t count) {
+        size_t pushed = 0;
+        while (pushed < count && push(messages[pushed])) {
+            pushed++;
+        }
+        if (pushed < count) {
+            // push() already counted the first dropped frame
+            m_overflows.fetch_add(count - pushed - 1, std::memory_order_relaxed);
+        }
+        return pushed;
+    }
+
+    alignas(CAN_RING_CACHE_LINE_SIZE) std::atomic<size_t> m_writeIndex;
+    alignas(CAN_RING_CACHE_LINE_SIZE) std::atomic<size_t> m_readIndex;
+    alignas(CAN_RING_CACHE_LINE_SIZE) std::atomic<uint64_t> m_overflows;
+    alignas(CAN_RING_CACHE_LINE_SIZE) Slot m_slots[CAPACITY];
+};
+
+#endif  // SAILINGROBOT_CANMSGRINGBUFFER_H
@@ -0,0 +1,95 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanPayload.h
+ *
+ * Purpose:
+ *    Conversion between the 8 data bytes of a CanMsg and the 64 bits word used
+ *    by the bit-indexed API.
+ *
+ * Developer Notes:
+ *    The data bytes are read as a big-endian word: CanMsg.data[0] holds bits 63..56
+ *    and CanMsg.data[7] holds bits 7..0. This is the same order canMsgToBitset() has
+ *    always used, so positions in canbus_datamappings_defs.h keep their meaning.
+ *
+ *    On the RPI the conversion is a single 8 bytes load or store plus a byte swap,
+ *    AVR has no wide loads so the byte loop is kept there.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANPAYLOAD_H
+#define SAILINGROBOT_CANPAYLOAD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && !defined(__AVR__)
+ #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  #define CANPAYLOAD_LOAD_SWAPPED
+ #elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  #define CANPAYLOAD_LOAD_NATIVE
+ #endif
+#endif
+
+class CanPayload {
+   public:
+    static const int PAYLOAD_SIZE_IN_BYTES = 8;
+
+    /**
+     * Reads 8 data bytes as a big-endian 64 bits word
+     *
+     * @param data pointer to the first of the 8 bytes
+     * @return the payload word
+     */
+    static inline uint64_t load(const uint8_t* data) {
+        uint64_t payload = 0;
+#if defined(CANPAYLOAD_LOAD_SWAPPED)
+        memcpy(&payload, data, PAYLOAD_SIZE_IN_BYTES);
+        payload = __builtin_bswap64(payload);
+#elif defined(CANPAYLOAD_LOAD_NATIVE)
+        memcpy(&payload, data, PAYLOAD_SIZE_IN_BYTES);
+#else
+        for (int i = 0; i < PAYLOAD_SIZE_IN_BYTES; i++) {
+            payload = (payload << 8) | data[i];
+        }
+#endif
+        return payload;
+    }
+
+    /**
+     * Writes a payload word back to 8 data bytes, big-endian
+     *
+     * @param payload the payload word
+     * @param data pointer to the first of the 8 bytes
+     */
+    static inline void store(uint64_t payload, uint8_t* data) {
+#if defined(CANPAYLOAD_LOAD_SWAPPED)
+        payload = __builtin_bswap64(payload);
+        memcpy(data, &payload, PAYLOAD_SIZE_IN_BYTES);
+#elif defined(CANPAYLOAD_LOAD_NATIVE)
+        memcpy(data, &payload, PAYLOAD_SIZE_IN_BYTES);
+#else
+        for (int i = PAYLOAD_SIZE_IN_BYTES - 1; i >= 0; i--) {
+            data[i] = static_cast<uint8_t>(payload);
+            payload >>= 8;
+        }
+#endif
+    }
+
+    /**
+     * @param length number of bits, 0 to 64
+     * @return a mask with the length lowest bits set
+     */
+    static inline uint64_t mask(uint32_t length) {
+        return (length >= 64) ? ~0ULL : ((1ULL << length) - 1);
+    }
+
+    /**
+     * Position of the byte CanMsg.data[index] in the payload word
+     */
+    static inline uint32_t byteShift(int index) {
+        return (PAYLOAD_SIZE_IN_BYTES - 1 - index) * 8;
+    }
+};
+
+#endif  // SAILINGROBOT_CANPAYLOAD_H
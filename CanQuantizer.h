@@ -0,0 +1,240 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanQuantizer.h
+ *
+ * Purpose:
+ *    Quantizers of float values into fields of any width, to pack more signals in a
+ *    frame than whole bytes and Float16Compressor allow:
+ *
+ *      MiniFloat<EXPONENT_BITS, MANTISSA_BITS, SIGNED, BIAS>  floating point, constant
+ *                                                             relative error
+ *      ScaledInteger<MIN, MAX, BITS>                          linear, constant absolute
+ *                                                             error
+ *
+ *      typedef MiniFloat<5, 6, false> Conductivity;    // 11 bits, 0 to 130048, 0.8 %
+ *      typedef ScaledInteger<-5, 40, 10> Temperature;  // 10 bits, 0.022 degrees
+ *
+ *      handler.encodeQuantized(21.5f, 0, Temperature::LENGTH, false, Temperature());
+ *      handler.getQuantizedData(&temperature, 0, Temperature::LENGTH, false, Temperature());
+ *
+ *    Both have the same interface: LENGTH, length(), quantize(), dequantize() and
+ *    errorBound(), the bound of |dequantize(quantize(value)) - value| for a value in
+ *    the range.
+ *
+ * Developer Notes:
+ *    Arduino and RPI.
+ *
+ *    MiniFloat follows IEEE 754 (bias, subnormals, round to nearest even) without
+ *    infinities and NaN: the largest exponent holds normal numbers, values above
+ *    maxValue() saturate, NaN gives 0. Unsigned MiniFloats store values below 0 as 0.
+ *    The conversions only use integer operations on the float bits, so the results
+ *    are the same with the AVR soft-float library and the RPI FPU.
+ *
+ *    ScaledInteger is a CanFixedPointMapping with float quantize()/dequantize(), see
+ *    CanFixedPointMapping.h for the arithmetic.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANQUANTIZER_H
+#define SAILINGROBOT_CANQUANTIZER_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CanFixedPointMapping.h"
+
+class CanQuantizer {
+   public:
+    static inline uint32_t floatBits(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static inline float bitsFloat(uint32_t bits) {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /**
+     * @param exponent -149 to 127
+     */
+    static inline float powerOfTwo(int32_t exponent) {
+        if (exponent < -126) {
+            return bitsFloat(1UL << (exponent + 149));
+        }
+        return bitsFloat(static_cast<uint32_t>(exponent + 127) << 23);
+    }
+
+    /**
+     * @return value / 2^shift rounded to nearest, ties to even, value below 2^24
+     */
+    static inline uint32_t roundShift(uint32_t value, uint8_t shift) {
+        if (shift == 0) {
+            return value;
+        }
+        if (shift > 24) {
+            return 0;
+        }
+        uint32_t quotient = value >> shift;
+        uint32_t remainder = value & ((1UL << shift) - 1);
+        uint32_t half = 1UL << (shift - 1);
+        if (remainder > half || (remainder == half && (quotient & 1))) {
+            quotient++;
+        }
+        return quotient;
+    }
+};
+
+/**
+ * Floating point field of SIGNED + EXPONENT_BITS + MANTISSA_BITS bits, sign first
+ *
+ * @tparam BIAS exponent bias, the IEEE one by default. A lower bias moves the range
+ *              up: maxValue() is about 2^(2^EXPONENT_BITS - 1 - BIAS). With 8 exponent
+ *              bits the default is 128: the largest exponent holds normal numbers,
+ *              127 would put it above the float ones. MANTISSA_BITS is then 22 at most.
+ */
+template <uint8_t EXPONENT_BITS, uint8_t MANTISSA_BITS, bool SIGNED = true,
+          int BIAS = (1 << (EXPONENT_BITS - 1)) - ((EXPONENT_BITS < 8) ? 1 : 0)>
+class MiniFloat {
+   public:
+    static_assert(EXPONENT_BITS >= 1 && EXPONENT_BITS <= 8, "MiniFloat: EXPONENT_BITS must be 1 to 8");
+    static_assert(MANTISSA_BITS <= 23, "MiniFloat: MANTISSA_BITS must be 0 to 23");
+    static_assert(EXPONENT_BITS < 8 || MANTISSA_BITS <= 22, "MiniFloat: 8 exponent bits take 22 mantissa bits at most");
+    // Every MiniFloat value must be exact as a float
+    static_assert((1 << EXPONENT_BITS) - 1 - BIAS <= 127, "MiniFloat: BIAS too low for a float");
+    static_assert(1 - BIAS - MANTISSA_BITS >= -149, "MiniFloat: BIAS too high for a float");
+
+    static const uint8_t LENGTH = (SIGNED ? 1 : 0) + EXPONENT_BITS + MANTISSA_BITS;
+    static const uint32_t MANTISSA_MASK = (1UL << MANTISSA_BITS) - 1;
+    static const uint32_t MAX_EXPONENT = (1UL << EXPONENT_BITS) - 1;
+    static const uint32_t MAX_MAGNITUDE = (MAX_EXPONENT << MANTISSA_BITS) | MANTISSA_MASK;
+    static const uint32_t SIGN_BIT = SIGNED ? (1UL << (EXPONENT_BITS + MANTISSA_BITS)) : 0;
+
+    static inline uint8_t length() { return LENGTH; }
+
+    static inline uint32_t quantize(float value) {
+        uint32_t bits = CanQuantizer::floatBits(value);
+        bool negative = (bits >> 31) != 0;
+        bits &= 0x7FFFFFFF;
+        if (bits == 0 || bits > 0x7F800000 || (negative && !SIGNED)) {
+            return 0;  // zero, NaN, or below the range
+        }
+
+        int32_t exponent = static_cast<int32_t>(bits >> 23) - 127;
+        uint32_t significand = (bits & 0x7FFFFF) | 0x800000;
+        if ((bits >> 23) == 0) {  // float subnormal, normalized
+            exponent = -126;
+            significand = bits;
+            while (!(significand & 0x800000)) {
+                significand <<= 1;
+                exponent--;
+            }
+        }
+
+        // Value is significand * 2^(exponent - 23), the rounding carry flows into the exponent
+        int32_t biasedExponent = exponent + BIAS;
+        uint32_t magnitude;
+        if (bits >= 0x7F800000 || biasedExponent > static_cast<int32_t>(MAX_EXPONENT)) {
+            magnitude = MAX_MAGNITUDE;
+        } else if (biasedExponent >= 1) {
+            magnitude = (static_cast<uint32_t>(biasedExponent) << MANTISSA_BITS) +
+                        CanQuantizer::roundShift(significand & 0x7FFFFF, 23 - MANTISSA_BITS);
+        } else {
+            int32_t shift = 23 - MANTISSA_BITS + 1 - biasedExponent;
+            magnitude = (shift > 24) ? 0 : CanQuantizer::roundShift(significand, static_cast<uint8_t>(shift));
+        }
+        if (magnitude > MAX_MAGNITUDE) {
+            magnitude = MAX_MAGNITUDE;
+        }
+        return (negative && magnitude != 0) ? (magnitude | SIGN_BIT) : magnitude;
+    }
+
+    static inline float dequantize(uint32_t raw) {
+        uint32_t sign = (SIGNED && (raw & SIGN_BIT)) ? 0x80000000UL : 0;
+        uint32_t exponent = (raw >> MANTISSA_BITS) & MAX_EXPONENT;
+        uint32_t mantissa = raw & MANTISSA_MASK;
+
+        int32_t floatExponent = static_cast<int32_t>(exponent) - BIAS + 127;
+        if (exponent == 0 || floatExponent <= 0) {
+            // Subnormal here or as a float, exact: the significand and the power of two are floats
+            uint32_t significand = (exponent == 0) ? mantissa : (mantissa | (1UL << MANTISSA_BITS));
+            int32_t scale = ((exponent == 0) ? 1 : static_cast<int32_t>(exponent)) - BIAS - MANTISSA_BITS;
+            float value = static_cast<float>(significand) * CanQuantizer::powerOfTwo(scale);
+            return sign ? -value : value;
+        }
+        return CanQuantizer::bitsFloat(sign | (static_cast<uint32_t>(floatExponent) << 23) |
+                                       (mantissa << (23 - MANTISSA_BITS)));
+    }
+
+    static inline float maxValue() { return dequantize(MAX_MAGNITUDE); }
+
+    static inline float minValue() { return SIGNED ? -maxValue() : 0.0f; }
+
+    /**
+     * @return half the distance between the two values around value, the largest
+     *         quantization error for values up to maxValue()
+     */
+    static inline float errorBound(float value) {
+        uint32_t magnitude = quantize(fabs(value)) & ~SIGN_BIT;
+        int32_t exponent = static_cast<int32_t>(magnitude >> MANTISSA_BITS);
+        // The step below a power of two is half the step above it
+        if (exponent > 1 && (magnitude & MANTISSA_MASK) == 0 &&
+            dequantize(magnitude) > static_cast<float>(fabs(value))) {
+            exponent--;
+        }
+        return static_cast<float>(ldexp(1.0, (exponent > 1 ? exponent : 1) - BIAS - MANTISSA_BITS - 1));
+    }
+
+    /**
+     * @return the largest quantization error over the range
+     */
+    static inline float errorBound() { return errorBound(maxValue()); }
+
+    /**
+     * @return the largest quantization error relative to the value, above the subnormals
+     */
+    static inline float relativeErrorBound() { return static_cast<float>(ldexp(1.0, -MANTISSA_BITS - 1)); }
+};
+
+/**
+ * Linear field of BITS bits over [MIN, MAX]
+ */
+template <long MIN, long MAX, uint8_t BITS>
+class ScaledInteger : public CanFixedPointMapping<MIN, MAX, BITS> {
+    typedef CanFixedPointMapping<MIN, MAX, BITS> Mapping;
+
+   public:
+    static const uint8_t LENGTH = BITS;
+
+    /**
+     * @param value clamped to [MIN, MAX]
+     */
+    static inline uint32_t quantize(float value) { return Mapping::encodeFloat(value); }
+
+    static inline float dequantize(uint32_t raw) { return Mapping::decodeFloat(raw); }
+
+    /**
+     * @return distance between two consecutive values
+     */
+    static inline float step() { return static_cast<float>(MAX - MIN) / static_cast<float>(Mapping::RAW_MAX); }
+
+    /**
+     * @return the largest quantization error over the range: half a step, the fixed-point
+     *         steps of encodeFloat() and decodeFixed(), and the float roundings of
+     *         value - MIN and of the decoded value
+     */
+    static inline float errorBound() {
+        double largest = (MAX > -MIN) ? static_cast<double>(MAX) : -static_cast<double>(MIN);
+        double bound = step() * 0.5 + ldexp(2.0, -Mapping::FRACTION_BITS) +
+                       ldexp(static_cast<double>(Mapping::RANGE) + 2 * largest, -24);
+        return static_cast<float>(bound);
+    }
+
+    static inline float errorBound(float) { return errorBound(); }
+};
+
+#endif  // SAILINGROBOT_CANQUANTIZER_H
@@ -0,0 +1,358 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanRequestClient.h
+ *
+ * Purpose:
+ *    Awaitable sensor requests: a request frame is sent right away, the coroutine
+ *    awaiting it is resumed by poll() when the response arrives or the timeout
+ *    expires. Any number of requests can be outstanding, all the sensors are read
+ *    in parallel instead of one after the other.
+ *
+ *      CanTask readSensors(CanRequestClient<SocketCanTransport>& client) {
+ *          CanRequest marine = client.requestMarineSensorData(500);
+ *          CanRequest current = client.requestCurrentSensorData(2, 200);
+ *
+ *          CanResponse marineResponse = co_await marine;
+ *          CanResponse currentResponse = co_await current;
+ *          if (marineResponse.ok()) { ... }
+ *      }
+ *
+ *      CanTask task = readSensors(client);
+ *      while (!task.done()) {
+ *          client.poll(10);
+ *      }
+ *
+ * Developer Notes:
+ *    RPI only, needs C++20 (-std=c++20) for the coroutines. Single thread: request(),
+ *    poll() and the coroutines all run on the event loop thread.
+ *
+ *    Bus is SocketCanTransport, CanLoopbackBus or any class with the same send() and
+ *    receive() functions.
+ *
+ *    Responses carry no request tag, a response completes the oldest outstanding
+ *    request with the same response id, and the same sensor id for
+ *    MSG_ID_CURRENT_SENSOR_DATA. Frames no request waits for are counted as unmatched.
+ *
+ *    The requests are kept in MAX_PENDING slots of the client, a CanRequest holds its
+ *    slot until it is awaited or destroyed and must not outlive the client.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANREQUESTCLIENT_H
+#define SAILINGROBOT_CANREQUESTCLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <exception>
+
+#include "CanMessageHandler.h"
+#include "CanMessageView.h"
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "CanRequestClient.h is only available on the RPI"
+#endif
+
+#ifndef __cpp_impl_coroutine
+ #error "CanRequestClient.h needs C++20 coroutines, build with -std=c++20"
+#endif
+
+#include <coroutine>
+
+enum CanRequestStatus {
+    CAN_REQUEST_PENDING,
+    CAN_REQUEST_COMPLETED,
+    CAN_REQUEST_TIMED_OUT,
+    CAN_REQUEST_SEND_FAILED,
+    CAN_REQUEST_TOO_MANY  // all the slots of the client are in use
+};
+
+struct CanResponse {
+    CanRequestStatus status;
+    CanMsg message;  // valid if status is CAN_REQUEST_COMPLETED
+
+    bool ok() const { return status == CAN_REQUEST_COMPLETED; }
+};
+
+/**
+ * Response a request waits for
+ */
+struct CanResponseMatch {
+    static const uint8_t ANY_SENSOR = 0xFF;
+
+    uint32_t messageId;
+    uint8_t sensorId;  // CURRENT_SENSOR_ID of MSG_ID_CURRENT_SENSOR_DATA, ANY_SENSOR for the other ids
+};
+
+/**
+ * Time in milliseconds, any monotonic clock
+ */
+typedef uint64_t (*CanRequestClock)();
+
+inline uint64_t canSteadyClockMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * Request slot of a CanRequestClient
+ */
+struct CanPendingRequest {
+    bool used;
+    CanRequestStatus status;
+    uint32_t sequence;  // order of the requests with the same response
+    uint64_t deadlineMs;
+    CanResponseMatch match;
+    CanMsg response;
+    std::coroutine_handle<> waiter;
+};
+
+/**
+ * Awaitable outstanding request, co_await gives the CanResponse
+ */
+class CanRequest {
+   public:
+    CanRequest(CanPendingRequest* slot, CanRequestStatus failure) : m_slot(slot), m_failure(failure) {}
+
+    CanRequest(CanRequest&& other) : m_slot(other.m_slot), m_failure(other.m_failure) { other.m_slot = nullptr; }
+
+    CanRequest(const CanRequest&) = delete;
+    CanRequest& operator=(const CanRequest&) = delete;
+    CanRequest& operator=(CanRequest&&) = delete;
+
+    ~CanRequest() { release(); }
+
+    bool await_ready() const noexcept { return m_slot == nullptr || m_slot->status != CAN_REQUEST_PENDING; }
+
+    void await_suspend(std::coroutine_handle<> waiter) noexcept { m_slot->waiter = waiter; }
+
+    CanResponse await_resume() {
+        CanResponse response = {};
+        if (m_slot == nullptr) {
+            response.status = m_failure;
+            return response;
+        }
+        response.status = m_slot->status;
+        response.message = m_slot->response;
+        release();
+        return response;
+    }
+
+   private:
+    void release() {
+        if (m_slot != nullptr) {
+            m_slot->used = false;
+            m_slot->waiter = nullptr;
+            m_slot = nullptr;
+        }
+    }
+
+    CanPendingRequest* m_slot;  // nullptr if the request failed to start
+    CanRequestStatus m_failure;
+};
+
+/**
+ * Coroutine started right away, destroyed with the object
+ */
+class CanTask {
+   public:
+    struct promise_type {
+        CanTask get_return_object() { return CanTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    CanTask(CanTask&& other) : m_handle(other.m_handle) { other.m_handle = nullptr; }
+
+    CanTask(const CanTask&) = delete;
+    CanTask& operator=(const CanTask&) = delete;
+    CanTask& operator=(CanTask&&) = delete;
+
+    ~CanTask() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    bool done() const { return !m_handle || m_handle.done(); }
+
+   private:
+    explicit CanTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+template <class Bus, size_t MAX_PENDING = 32>
+class CanRequestClient {
+   public:
+    static const size_t RECEIVE_BATCH_SIZE = 16;
+
+    /**
+     * @param clock time of the timeouts, replaced by a fake clock in tests
+     */
+    explicit CanRequestClient(Bus& bus, CanRequestClock clock = canSteadyClockMs)
+        : m_bus(bus), m_clock(clock), m_nextSequence(0), m_unmatched(0) {
+        for (size_t i = 0; i < MAX_PENDING; i++) {
+            m_slots[i].used = false;
+            m_slots[i].waiter = nullptr;
+        }
+    }
+
+    CanRequestClient(const CanRequestClient&) = delete;
+    CanRequestClient& operator=(const CanRequestClient&) = delete;
+
+    /**
+     * Sends requestFrame, the request is outstanding until a frame matching response
+     * is received or timeoutMs elapsed
+     */
+    CanRequest request(const CanMsg& requestFrame, CanResponseMatch response, uint32_t timeoutMs) {
+        CanPendingRequest* slot = freeSlot();
+        if (slot == nullptr) {
+            return CanRequest(nullptr, CAN_REQUEST_TOO_MANY);
+        }
+        // Taken before sending, a loopback node can answer from send()
+        slot->used = true;
+        slot->status = CAN_REQUEST_PENDING;
+        slot->sequence = m_nextSequence++;
+        slot->deadlineMs = m_clock() + timeoutMs;
+        slot->match = response;
+        slot->waiter = nullptr;
+
+        if (m_bus.send(&requestFrame, 1) != 1) {
+            slot->used = false;
+            return CanRequest(nullptr, CAN_REQUEST_SEND_FAILED);
+        }
+        return CanRequest(slot, CAN_REQUEST_PENDING);
+    }
+
+    /**
+     * Single reading of the marine sensors, answered with MSG_ID_MARINE_SENSOR_DATA
+     */
+    CanRequest requestMarineSensorData(uint32_t timeoutMs) {
+        CanMessageHandler handler(MSG_ID_MARINE_SENSOR_REQUEST);
+        handler.encodeMessage(REQUEST_CONTINOUS_READINGS_DATASIZE, 0);  // no continuous readings
+        handler.encodeMessage(REQUEST_READING_TIME_DATASIZE, 0);
+        return request(handler.getMessage(), {MSG_ID_MARINE_SENSOR_DATA, CanResponseMatch::ANY_SENSOR}, timeoutMs);
+    }
+
+    /**
+     * Reading of one current sensor, answered with the MSG_ID_CURRENT_SENSOR_DATA
+     * frame of that sensor
+     */
+    CanRequest requestCurrentSensorData(uint8_t sensorId, uint32_t timeoutMs) {
+        CanMessageHandler handler(MSG_ID_CURRENT_SENSOR_REQUEST);
+        handler.encodeMessage(sensorId, CURRENT_SENSOR_ID_START, CURRENT_SENSOR_ID_DATASIZE, CURRENT_SENSOR_ID_IN_BYTE);
+        return request(handler.getMessage(), {MSG_ID_CURRENT_SENSOR_DATA, sensorId}, timeoutMs);
+    }
+
+    /**
+     * Receives the frames of the bus, resumes the requests they answer, then the
+     * requests that timed out
+     *
+     * @param waitMs time to wait for a frame, passed to Bus::receive()
+     * @return the number of frames received, -1 on bus error
+     */
+    int poll(int waitMs = 0) {
+        CanMsg frames[RECEIVE_BATCH_SIZE];
+        int count = m_bus.receive(frames, RECEIVE_BATCH_SIZE, NULL, waitMs);
+        for (int i = 0; i < count; i++) {
+            dispatch(frames[i]);
+        }
+        expire();
+        return count;
+    }
+
+    /**
+     * For the loops that receive the frames themselves
+     * @return true if the frame answered a request
+     */
+    bool dispatch(const CanMsg& frame) {
+        uint8_t sensorId = CanResponseMatch::ANY_SENSOR;
+        if (frame.id == MSG_ID_CURRENT_SENSOR_DATA) {
+            CanMessageView(frame).getData(&sensorId, CURRENT_SENSOR_ID_START, CURRENT_SENSOR_ID_DATASIZE,
+                                          CURRENT_SENSOR_ID_IN_BYTE);
+        }
+
+        CanPendingRequest* oldest = nullptr;
+        for (size_t i = 0; i < MAX_PENDING; i++) {
+            CanPendingRequest& slot = m_slots[i];
+            if (!slot.used || slot.status != CAN_REQUEST_PENDING || slot.match.messageId != frame.id) {
+                continue;
+            }
+            if (slot.match.sensorId != CanResponseMatch::ANY_SENSOR && slot.match.sensorId != sensorId) {
+                continue;
+            }
+            // Sequence numbers wrap, compare their distance
+            if (oldest == nullptr || static_cast<int32_t>(slot.sequence - oldest->sequence) < 0) {
+                oldest = &slot;
+            }
+        }
+        if (oldest == nullptr) {
+            m_unmatched++;
+            return false;
+        }
+        oldest->response = frame;
+        complete(*oldest, CAN_REQUEST_COMPLETED);
+        return true;
+    }
+
+    /**
+     * Resumes the requests past their timeout, called by poll()
+     */
+    void expire() {
+        uint64_t nowMs = m_clock();
+        for (size_t i = 0; i < MAX_PENDING; i++) {
+            CanPendingRequest& slot = m_slots[i];
+            if (slot.used && slot.status == CAN_REQUEST_PENDING && nowMs >= slot.deadlineMs) {
+                complete(slot, CAN_REQUEST_TIMED_OUT);
+            }
+        }
+    }
+
+    /**
+     * @return the number of requests waiting for a response
+     */
+    size_t outstanding() const {
+        size_t count = 0;
+        for (size_t i = 0; i < MAX_PENDING; i++) {
+            if (m_slots[i].used && m_slots[i].status == CAN_REQUEST_PENDING) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    uint32_t unmatched() const { return m_unmatched; }
+
+   private:
+    CanPendingRequest* freeSlot() {
+        for (size_t i = 0; i < MAX_PENDING; i++) {
+            if (!m_slots[i].used) {
+                return &m_slots[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // The resumed coroutine can send new requests, the slots never move
+    static void complete(CanPendingRequest& slot, CanRequestStatus status) {
+        slot.status = status;
+        std::coroutine_handle<> waiter = slot.waiter;
+        slot.waiter = nullptr;
+        if (waiter) {
+            waiter.resume();
+        }
+    }
+
+    Bus& m_bus;
+    CanRequestClock m_clock;
+    CanPendingRequest m_slots[MAX_PENDING];
+    uint32_t m_nextSequence;
+    uint32_t m_unmatched;
+};
+
+#endif  // SAILINGROBOT_CANREQUESTCLIENT_H
@@ -0,0 +1,392 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanTransmitScheduler.h
+ *
+ * Purpose:
+ *    Periodic transmission of the message ids of a node, replacing the hand written
+ *    millis() loops: each id has a period, a phase and a priority class, and a bus
+ *    load budget bounds the bandwidth taken by the feedback and telemetry frames.
+ *
+ *      bool sendRudder(uint32_t messageId, void* context);   // builds and sends the frame
+ *
+ *      CanTransmitScheduler<4> scheduler(25000);              // 25 kbit/s budget
+ *      scheduler.addMessage(MSG_ID_AU_FEEDBACK, 100, CAN_PRIORITY_FEEDBACK, sendFeedback);
+ *      scheduler.addMessage(MSG_ID_MARINE_SENSOR_DATA, 1000, CAN_PRIORITY_TELEMETRY, sendSensors);
+ *
+ *      void loop() {
+ *          scheduler.poll(millis());
+ *      }
+ *
+ *    On the RPI, a thread sleeps msUntilNextDue() between two poll() calls.
+ *
+ * Developer Notes:
+ *    Works on Arduino and RPI, nothing is allocated. Times are in milliseconds and may
+ *    wrap around.
+ *
+ *    Pending messages are kept in a min-heap ordered by due time. poll() walks the due
+ *    part of the heap and sends the best priority class first, the earliest due within
+ *    a class. Control frames are always sent. The other classes take bits from a
+ *    token bucket refilled at the budget rate, sized with
+ *    CanUtility::worstCaseFrameBits(), and wait while it is empty. A message late by
+ *    more than one period skips the periods missed instead of sending a burst.
+ *
+ *    With AUTO_OFFSET, a message is placed in the middle of the largest gap between
+ *    the phases of the messages already added, so the frames are spread over time.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANTRANSMITSCHEDULER_H
+#define SAILINGROBOT_CANTRANSMITSCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CanUtility.h"
+#include "canbus_defs.h"
+
+/**
+ * Builds and sends the frame of messageId
+ * @return false if the frame could not be sent, it is then retried at the next poll()
+ */
+typedef bool (*CanTransmitCallback)(uint32_t messageId, void* context);
+
+enum CanTransmitPriority {
+    CAN_PRIORITY_CONTROL,    // never delayed by the budget
+    CAN_PRIORITY_FEEDBACK,
+    CAN_PRIORITY_TELEMETRY
+};
+
+struct CanTransmitStatistics {
+    uint32_t sent;
+    uint32_t failed;           // callback returned false
+    uint32_t skippedPeriods;   // periods missed because the node or the budget was too slow
+    uint32_t budgetDeferrals;  // poll() calls that left a due frame waiting for the budget
+};
+
+template <uint8_t CAPACITY>
+class CanTransmitScheduler {
+    static_assert(CAPACITY > 0 && CAPACITY < 0xFF, "CanTransmitScheduler: CAPACITY must be 1 to 254");
+
+   public:
+    static const uint32_t AUTO_OFFSET = 0xFFFFFFFFUL;
+    static const uint32_t NO_BUDGET = 0;
+    static const uint32_t NOTHING_SCHEDULED = 0xFFFFFFFFUL;
+
+    /**
+     * @param budgetBitsPerSecond bandwidth of the feedback and telemetry frames, NO_BUDGET
+     *                            for no limit
+     * @param burstBits size of the token bucket, a tenth of a second of budget if 0,
+     *                  raised by addMessage() to the largest frame so that every frame
+     *                  fits in a full bucket
+     */
+    explicit CanTransmitScheduler(uint32_t budgetBitsPerSecond = NO_BUDGET, uint32_t burstBits = 0)
+        : m_budgetBitsPerSecond(budgetBitsPerSecond),
+          m_burstBits(static_cast<int32_t>((burstBits != 0) ? burstBits : budgetBitsPerSecond / 10)),
+          m_tokens(m_burstBits),
+          m_refillRemainder(0),
+          m_lastRefillMs(0),
+          m_lastPollMs(0),
+          m_startMs(0),
+          m_started(false),
+          m_count(0) {
+        m_statistics.sent = 0;
+        m_statistics.failed = 0;
+        m_statistics.skippedPeriods = 0;
+        m_statistics.budgetDeferrals = 0;
+    }
+
+    /**
+     * @param periodMs time between two frames, above 0
+     * @param length data length of the frame, for the budget
+     * @param extendedId true for a 29 bits id, for the budget
+     * @param offsetMs phase of the first frame after the first poll(), AUTO_OFFSET to
+     *                 spread the frames
+     * @return false if the scheduler is full or periodMs is 0
+     */
+    bool addMessage(uint32_t messageId, uint32_t periodMs, CanTransmitPriority priority,
+                    CanTransmitCallback callback, void* context = NULL, uint8_t length = 8,
+                    bool extendedId = false, uint32_t offsetMs = AUTO_OFFSET) {
+        if (m_count == CAPACITY || periodMs == 0 || callback == NULL) {
+            return false;
+        }
+        if (offsetMs == AUTO_OFFSET) {
+            offsetMs = spreadOffset(periodMs);
+        }
+
+        Entry entry;
+        entry.messageId = messageId;
+        entry.periodMs = periodMs;
+        entry.offsetMs = offsetMs % periodMs;
+        entry.dueMs = m_startMs + entry.offsetMs;
+        if (m_started && before(entry.dueMs, m_lastPollMs)) {
+            // First frame at the next time of its phase
+            entry.dueMs += ((m_lastPollMs - entry.dueMs + periodMs - 1) / periodMs) * periodMs;
+        }
+        entry.frameBits = CanUtility::worstCaseFrameBits(length, extendedId);
+        if (m_budgetBitsPerSecond != NO_BUDGET && m_burstBits < entry.frameBits) {
+            // A smaller bucket never holds the tokens of the frame, e.g. the default
+            // burst below 1350 bit/s
+            if (m_tokens == m_burstBits) {
+                m_tokens = entry.frameBits;
+            }
+            m_burstBits = entry.frameBits;
+        }
+        entry.priority = static_cast<uint8_t>(priority);
+        entry.callback = callback;
+        entry.context = context;
+
+        m_heap[m_count] = entry;
+        siftUp(m_count);
+        m_count++;
+        return true;
+    }
+
+    /**
+     * Sends the frames that are due, best priority first
+     *
+     * @param nowMs current time in milliseconds, may wrap around
+     * @param maxFrames most frames sent by this call
+     * @return the number of frames sent
+     */
+    uint8_t poll(uint32_t nowMs, uint8_t maxFrames = CAPACITY) {
+        start(nowMs);
+        refill(nowMs);
+
+        uint8_t sentFrames = 0;
+        while (sentFrames < maxFrames) {
+            uint32_t waitMs;
+            uint8_t index = selectDue(nowMs, waitMs);
+            if (index == NONE) {
+                break;
+            }
+            Entry& entry = m_heap[index];
+            if (!affordable(entry)) {
+                m_statistics.budgetDeferrals++;
+                break;
+            }
+            if (!entry.callback(entry.messageId, entry.context)) {
+                m_statistics.failed++;
+                break;
+            }
+            m_statistics.sent++;
+            sentFrames++;
+            if (m_budgetBitsPerSecond != NO_BUDGET) {
+                m_tokens -= entry.frameBits;
+                if (m_tokens < -m_burstBits) {
+                    m_tokens = -m_burstBits;  // control frames can overdraw, up to one burst
+                }
+            }
+            reschedule(index, nowMs);
+        }
+        return sentFrames;
+    }
+
+    /**
+     * @return milliseconds until poll() has something to send, 0 if it has now,
+     *         NOTHING_SCHEDULED if no message was added
+     */
+    uint32_t msUntilNextDue(uint32_t nowMs) {
+        if (m_count == 0) {
+            return NOTHING_SCHEDULED;
+        }
+        start(nowMs);
+        refill(nowMs);
+
+        uint32_t waitMs;
+        uint8_t index = selectDue(nowMs, waitMs);
+        if (index == NONE) {
+            return waitMs;
+        }
+        const Entry& entry = m_heap[index];
+        if (affordable(entry)) {
+            return 0;
+        }
+        uint32_t missingBits = static_cast<uint32_t>(entry.frameBits - m_tokens);
+        uint32_t budgetWaitMs = (missingBits * 1000UL + m_budgetBitsPerSecond - 1) / m_budgetBitsPerSecond;
+        return (budgetWaitMs < waitMs) ? budgetWaitMs : waitMs;
+    }
+
+    const CanTransmitStatistics& statistics() const { return m_statistics; }
+
+    uint8_t messageCount() const { return m_count; }
+
+   private:
+    static const uint8_t NONE = 0xFF;
+    static const uint32_t MAX_REFILL_MS = 1000;  // the bucket is full by then, keeps the product in 32 bits
+
+    struct Entry {
+        uint32_t messageId;
+        uint32_t periodMs;
+        uint32_t offsetMs;
+        uint32_t dueMs;
+        uint16_t frameBits;
+        uint8_t priority;
+        CanTransmitCallback callback;
+        void* context;
+    };
+
+    static inline bool before(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) < 0; }
+
+    void start(uint32_t nowMs) {
+        m_lastPollMs = nowMs;
+        if (m_started) {
+            return;
+        }
+        m_started = true;
+        m_startMs = nowMs;
+        m_lastRefillMs = nowMs;
+        for (uint8_t i = 0; i < m_count; i++) {
+            m_heap[i].dueMs = nowMs + m_heap[i].offsetMs;  // same shift for all, still a heap
+        }
+    }
+
+    void refill(uint32_t nowMs) {
+        if (m_budgetBitsPerSecond == NO_BUDGET) {
+            return;
+        }
+        uint32_t elapsedMs = nowMs - m_lastRefillMs;
+        m_lastRefillMs = nowMs;
+        if (elapsedMs > MAX_REFILL_MS) {
+            elapsedMs = MAX_REFILL_MS;
+            m_refillRemainder = 0;
+        }
+        uint32_t bitsTimesThousand = elapsedMs * m_budgetBitsPerSecond + m_refillRemainder;
+        m_refillRemainder = bitsTimesThousand % 1000;
+        m_tokens += static_cast<int32_t>(bitsTimesThousand / 1000);
+        if (m_tokens > m_burstBits) {
+            m_tokens = m_burstBits;
+        }
+    }
+
+    bool affordable(const Entry& entry) const {
+        return m_budgetBitsPerSecond == NO_BUDGET || entry.priority == CAN_PRIORITY_CONTROL ||
+               m_tokens >= entry.frameBits;
+    }
+
+    /**
+     * Walks the due part of the heap
+     *
+     * @param waitMs set to the time until the next entry not due yet
+     * @return the due entry to send first, NONE if nothing is due
+     */
+    uint8_t selectDue(uint32_t nowMs, uint32_t& waitMs) const {
+        uint8_t stack[CAPACITY];
+        uint8_t stackSize = 0;
+        uint8_t best = NONE;
+        waitMs = NOTHING_SCHEDULED;
+
+        if (m_count > 0) {
+            stack[stackSize++] = 0;
+        }
+        while (stackSize > 0) {
+            uint8_t index = stack[--stackSize];
+            const Entry& entry = m_heap[index];
+            if (before(nowMs, entry.dueMs)) {
+                // Children are due even later
+                if (entry.dueMs - nowMs < waitMs) {
+                    waitMs = entry.dueMs - nowMs;
+                }
+                continue;
+            }
+            if (best == NONE || entry.priority < m_heap[best].priority ||
+                (entry.priority == m_heap[best].priority && before(entry.dueMs, m_heap[best].dueMs))) {
+                best = index;
+            }
+            for (uint8_t child = static_cast<uint8_t>(2 * index + 1); child <= 2 * index + 2 && child < m_count;
+                 child++) {
+                stack[stackSize++] = child;
+            }
+        }
+        return best;
+    }
+
+    void reschedule(uint8_t index, uint32_t nowMs) {
+        Entry& entry = m_heap[index];
+        entry.dueMs += entry.periodMs;
+        if (!before(nowMs, entry.dueMs)) {
+            uint32_t missed = (nowMs - entry.dueMs) / entry.periodMs + 1;
+            entry.dueMs += missed * entry.periodMs;
+            m_statistics.skippedPeriods += missed;
+        }
+        siftDown(index);
+    }
+
+    /**
+     * Middle of the largest gap between the phases, modulo periodMs, of the entries
+     */
+    uint32_t spreadOffset(uint32_t periodMs) const {
+        if (m_count == 0) {
+            return 0;
+        }
+        uint32_t phases[CAPACITY];
+        for (uint8_t i = 0; i < m_count; i++) {
+            uint32_t phase = (m_heap[i].dueMs - m_startMs) % periodMs;
+            uint8_t j = i;
+            for (; j > 0 && phases[j - 1] > phase; j--) {
+                phases[j] = phases[j - 1];
+            }
+            phases[j] = phase;
+        }
+
+        uint32_t gapStart = phases[m_count - 1];
+        uint32_t largestGap = periodMs - phases[m_count - 1] + phases[0];  // around the end of the period
+        for (uint8_t i = 1; i < m_count; i++) {
+            if (phases[i] - phases[i - 1] > largestGap) {
+                largestGap = phases[i] - phases[i - 1];
+                gapStart = phases[i - 1];
+            }
+        }
+        return (gapStart + largestGap / 2) % periodMs;
+    }
+
+    void siftUp(uint8_t index) {
+        while (index > 0) {
+            uint8_t parent = static_cast<uint8_t>((index - 1) / 2);
+            if (!before(m_heap[index].dueMs, m_heap[parent].dueMs)) {
+                break;
+            }
+            swap(index, parent);
+            index = parent;
+        }
+    }
+
+    void siftDown(uint8_t index) {
+        for (;;) {
+            uint8_t smallest = index;
+            uint8_t left = static_cast<uint8_t>(2 * index + 1);
+            uint8_t right = static_cast<uint8_t>(2 * index + 2);
+            if (left < m_count && before(m_heap[left].dueMs, m_heap[smallest].dueMs)) {
+                smallest = left;
+            }
+            if (right < m_count && before(m_heap[right].dueMs, m_heap[smallest].dueMs)) {
+                smallest = right;
+            }
+            if (smallest == index) {
+                return;
+            }
+            swap(index, smallest);
+            index = smallest;
+        }
+    }
+
+    void swap(uint8_t a, uint8_t b) {
+        Entry entry = m_heap[a];
+        m_heap[a] = m_heap[b];
+        m_heap[b] = entry;
+    }
+
+    uint32_t m_budgetBitsPerSecond;
+    int32_t m_burstBits;
+    int32_t m_tokens;
+    uint32_t m_refillRemainder;
+    uint32_t m_lastRefillMs;
+    uint32_t m_lastPollMs;
+    uint32_t m_startMs;
+    bool m_started;
+    uint8_t m_count;
+    CanTransmitStatistics m_statistics;
+    Entry m_heap[CAPACITY];
+};
+
+#endif  // SAILINGROBOT_CANTRANSMITSCHEDULER_H
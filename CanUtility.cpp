@@ -12,6 +12,69 @@
 
 #include "CanUtility.h"
 
+namespace {
+
+const uint16_t CRC15_POLYNOMIAL = 0x4599;
+const uint16_t CRC15_MASK = 0x7FFF;
+const uint8_t STUFF_RUN_LENGTH = 5;
+
+// CRC delimiter, ACK, end of frame and interframe space are never stuffed
+const uint16_t UNSTUFFED_TRAILER_BITS = 13;
+
+/**
+ * Follows the bits of a frame from SOF to the end of the CRC, computing the CRC and
+ * counting the stuff bits the transmitter adds
+ */
+struct FrameBitCounter {
+    uint16_t crc;
+    uint16_t bits;
+    uint16_t stuffBits;
+    uint8_t lastBit;
+    uint8_t runLength;
+
+    FrameBitCounter() : crc(0), bits(0), stuffBits(0), lastBit(0), runLength(0) {}
+
+    inline void stuff(uint8_t bit) {
+        bits++;
+        if (runLength != 0 && bit == lastBit) {
+            if (++runLength == STUFF_RUN_LENGTH) {
+                // The stuff bit is the complement and starts the next run
+                stuffBits++;
+                lastBit = static_cast<uint8_t>(!bit);
+                runLength = 1;
+            }
+        } else {
+            lastBit = bit;
+            runLength = 1;
+        }
+    }
+
+    /**
+     * Bits covered by the CRC, most significant first
+     */
+    inline void push(uint32_t value, uint8_t count) {
+        while (count > 0) {
+            count--;
+            uint8_t bit = static_cast<uint8_t>((value >> count) & 1);
+            uint8_t feedback = static_cast<uint8_t>(bit ^ ((crc >> 14) & 1));
+            crc = static_cast<uint16_t>((crc << 1) & CRC15_MASK);
+            if (feedback) {
+                crc ^= CRC15_POLYNOMIAL;
+            }
+            stuff(bit);
+        }
+    }
+
+    inline void pushCrc() {
+        uint16_t value = crc;
+        for (int i = 14; i >= 0; i--) {
+            stuff(static_cast<uint8_t>((value >> i) & 1));
+        }
+    }
+};
+
+}  // namespace
+
 float CanUtility::mapInterval(float val, float fromMin, float fromMax, float toMin, float toMax) {
     return ((val - fromMin) / (fromMax - fromMin)) * (toMax - toMin) + toMin;
 }
@@ -22,10 +85,45 @@ uint64_t CanUtility::calcSizeOfBytes(int noOfBytes) {
 
     int totalNumberOfBits = noOfBytes * NO_OF_BITS_PER_BYTE;
 
-    uint64_t sizeOfBytes = 1;
-    for(int i=0;i<totalNumberOfBits;i++) {
-        sizeOfBytes = sizeOfBytes*2;
+    // 2^64 does not fit, the former doubling loop gave 0 as well
+    if (totalNumberOfBits >= 64) {
+        return 0;
     }
+    return (totalNumberOfBits <= 0) ? 1 : (1ULL << totalNumberOfBits);
+}
 
-    return sizeOfBytes;
+uint16_t CanUtility::worstCaseFrameBits(uint8_t dataLength, bool extendedId) {
+    // Bits covered by stuffing: SOF to CRC, 34 + data with an 11 bits id, 54 + data with 29 bits
+    const uint16_t STUFFED_HEADER_BITS_STANDARD = 34;
+    const uint16_t STUFFED_HEADER_BITS_EXTENDED = 54;
+    if (dataLength > 8) {
+        dataLength = 8;
+    }
+    uint16_t stuffedBits = static_cast<uint16_t>(
+        (extendedId ? STUFFED_HEADER_BITS_EXTENDED : STUFFED_HEADER_BITS_STANDARD) + dataLength * 8);
+    // One stuff bit every 4 bits at worst, after the first 5
+    return static_cast<uint16_t>(stuffedBits + UNSTUFFED_TRAILER_BITS + (stuffedBits - 1) / 4);
+}
+
+uint16_t CanUtility::exactFrameBits(uint32_t messageId, bool extendedId, const uint8_t* data, uint8_t dataLength) {
+    if (dataLength > 8) {
+        dataLength = 8;
+    }
+    FrameBitCounter counter;
+    counter.push(0, 1);  // SOF
+    if (extendedId) {
+        counter.push(messageId >> 18, 11);            // base id
+        counter.push(0x3, 2);                         // SRR, IDE
+        counter.push(messageId & 0x3FFFFUL, 18);      // id extension
+        counter.push(0, 3);                           // RTR, r1, r0
+    } else {
+        counter.push(messageId & 0x7FFUL, 11);
+        counter.push(0, 3);                           // RTR, IDE, r0
+    }
+    counter.push(dataLength, 4);                      // DLC
+    for (uint8_t i = 0; i < dataLength; i++) {
+        counter.push(data[i], 8);
+    }
+    counter.pushCrc();
+    return static_cast<uint16_t>(counter.bits + counter.stuffBits + UNSTUFFED_TRAILER_BITS);
 }
@@ -39,6 +39,29 @@ class CanUtility {
      * @return The maximum value of the given no of bytes
      */
     static uint64_t calcSizeOfBytes(int noOfBytes);
+
+    /**
+     * Longest a frame can be on the bus, with the most stuff bits its header and data
+     * can need, including the 3 bits interframe space.
+     *
+     * @param dataLength 0 to 8 bytes
+     * @param extendedId true for a 29 bits id
+     * @return the frame length in bits
+     */
+    static uint16_t worstCaseFrameBits(uint8_t dataLength, bool extendedId);
+
+    /**
+     * Length of a data frame on the bus: the CRC-15 is computed and the stuff bits of
+     * the id, control, data and CRC fields are counted. Includes the 3 bits
+     * interframe space, like worstCaseFrameBits().
+     *
+     * @param messageId 11 or 29 bits id
+     * @param extendedId true for a 29 bits id
+     * @param data the data bytes, dataLength of them are read
+     * @param dataLength 0 to 8 bytes, the DLC
+     * @return the frame length in bits
+     */
+    static uint16_t exactFrameBits(uint32_t messageId, bool extendedId, const uint8_t* data, uint8_t dataLength);
 };
 
 #endif  // SAILINGROBOT_UTILITY_H
@@ -0,0 +1,294 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CandumpLog.cpp
+ *
+ * Purpose:
+ *    Parser of candump text lines and memory-mapped log reader
+ *
+ * Developer Notes:
+ *    Compiled out on Arduino boards, the Arduino IDE builds every source file of
+ *    the library.
+ *
+ ***************************************************************************************/
+
+#include "canbus_global_defs.h"
+
+#ifndef ON_ARDUINO_BOARD
+
+#include "CandumpLog.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../../SystemServices/Logger.h"
+
+namespace {
+
+const int NOT_HEX = -1;
+const uint32_t MAX_STANDARD_ID = 0x7FF;
+const uint32_t MAX_EXTENDED_ID = 0x1FFFFFFF;
+const int EXTENDED_ID_DIGITS = 8;
+const int NANOSECOND_DIGITS = 9;
+
+// Value of each character as a hex digit, NOT_HEX otherwise
+const int8_t HEX_VALUES[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+inline int hexValue(char character) {
+    return HEX_VALUES[static_cast<unsigned char>(character)];
+}
+
+inline bool isDigit(char character) {
+    return static_cast<unsigned int>(character - '0') < 10;
+}
+
+inline const char* skipSpaces(const char* position, const char* end) {
+    while (position < end && (*position == ' ' || *position == '\t' || *position == '\r')) {
+        position++;
+    }
+    return position;
+}
+
+/**
+ * Parses "(seconds.fraction)"
+ * @return the position after ')', NULL if it is not a timestamp
+ */
+const char* parseTimestamp(const char* position, const char* end, uint64_t& timestampNs) {
+    position++;  // '('
+    uint64_t seconds = 0;
+    const char* digits = position;
+    while (position < end && isDigit(*position)) {
+        seconds = seconds * 10 + static_cast<uint64_t>(*position - '0');
+        position++;
+    }
+    if (position == digits) {
+        return NULL;
+    }
+
+    uint64_t fraction = 0;
+    int fractionDigits = 0;
+    if (position < end && *position == '.') {
+        position++;
+        while (position < end && isDigit(*position)) {
+            if (fractionDigits < NANOSECOND_DIGITS) {
+                fraction = fraction * 10 + static_cast<uint64_t>(*position - '0');
+                fractionDigits++;
+            }
+            position++;
+        }
+    }
+    if (position == end || *position != ')') {
+        return NULL;
+    }
+    for (; fractionDigits < NANOSECOND_DIGITS; fractionDigits++) {
+        fraction *= 10;
+    }
+    timestampNs = seconds * 1000000000ULL + fraction;
+    return position + 1;
+}
+
+/**
+ * Parses "#0102..." or "#R", the position is on '#'
+ */
+bool parseLogData(const char* position, const char* end, CandumpFrame& frame) {
+    position++;
+    if (position < end && *position == '#') {
+        return false;  // CAN FD
+    }
+    if (position < end && *position == 'R') {
+        frame.remoteRequest = true;
+        position++;
+        if (position < end && isDigit(*position) && *position <= '8') {
+            frame.message.header.length = static_cast<uint8_t>(*position - '0');
+        }
+        return true;
+    }
+
+    uint8_t length = 0;
+    while (position < end) {
+        if (*position == '.') {
+            position++;
+            continue;
+        }
+        int high = hexValue(*position);
+        if (high == NOT_HEX) {
+            break;
+        }
+        if (position + 1 == end || length == sizeof(frame.message.data)) {
+            return false;
+        }
+        int low = hexValue(position[1]);
+        if (low == NOT_HEX) {
+            return false;
+        }
+        frame.message.data[length++] = static_cast<uint8_t>((high << 4) | low);
+        position += 2;
+    }
+    frame.message.header.length = length;
+    return true;
+}
+
+/**
+ * Parses "[8]  01 02 ..." or "[2]  remote request", the position is on '['
+ */
+bool parseScreenData(const char* position, const char* end, CandumpFrame& frame) {
+    position++;
+    unsigned int length = 0;
+    const char* digits = position;
+    while (position < end && isDigit(*position)) {
+        length = length * 10 + static_cast<unsigned int>(*position - '0');
+        position++;
+    }
+    if (position == digits || position == end || *position != ']' || length > sizeof(frame.message.data)) {
+        return false;
+    }
+    position = skipSpaces(position + 1, end);
+    frame.message.header.length = static_cast<uint8_t>(length);
+
+    if (position < end && *position == 'r') {
+        frame.remoteRequest = true;
+        return true;
+    }
+    for (unsigned int i = 0; i < length; i++) {
+        position = skipSpaces(position, end);
+        if (end - position < 2) {
+            return false;
+        }
+        int high = hexValue(position[0]);
+        int low = hexValue(position[1]);
+        if (high == NOT_HEX || low == NOT_HEX) {
+            return false;
+        }
+        frame.message.data[i] = static_cast<uint8_t>((high << 4) | low);
+        position += 2;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool CandumpParser::parseLine(const char* line, const char* end, CandumpFrame& frame) {
+    const char* position = skipSpaces(line, end);
+
+    frame.timestampNs = 0;
+    frame.hasTimestamp = false;
+    frame.remoteRequest = false;
+    memset(&frame.message, 0, sizeof(frame.message));
+
+    if (position < end && *position == '(') {
+        position = parseTimestamp(position, end, frame.timestampNs);
+        if (position == NULL) {
+            return false;
+        }
+        frame.hasTimestamp = true;
+        position = skipSpaces(position, end);
+    }
+
+    // Interface
+    const char* interfaceName = position;
+    while (position < end && *position != ' ' && *position != '\t') {
+        position++;
+    }
+    if (position == interfaceName || position - interfaceName > 0xFF) {
+        return false;
+    }
+    frame.interfaceName = interfaceName;
+    frame.interfaceLength = static_cast<uint8_t>(position - interfaceName);
+    position = skipSpaces(position, end);
+
+    // Id
+    uint32_t messageId = 0;
+    const char* idDigits = position;
+    int digit;
+    while (position < end && (digit = hexValue(*position)) != NOT_HEX) {
+        messageId = (messageId << 4) | static_cast<uint32_t>(digit);
+        position++;
+    }
+    int idLength = static_cast<int>(position - idDigits);
+    // Error frames have CAN_ERR_FLAG set above the 29 id bits
+    if (idLength == 0 || idLength > EXTENDED_ID_DIGITS || messageId > MAX_EXTENDED_ID) {
+        return false;
+    }
+    frame.message.id = messageId;
+    frame.message.header.ide = (idLength == EXTENDED_ID_DIGITS || messageId > MAX_STANDARD_ID) ? 1 : 0;
+
+    if (position < end && *position == '#') {
+        return parseLogData(position, end, frame);
+    }
+    position = skipSpaces(position, end);
+    if (position < end && *position == '[') {
+        return parseScreenData(position, end, frame);
+    }
+    return false;
+}
+
+CandumpReader::CandumpReader()
+    : m_fileDescriptor(-1), m_mapping(NULL), m_mappingSize(0), m_skippedLines(0) {}
+
+CandumpReader::~CandumpReader() {
+    close();
+}
+
+bool CandumpReader::open(const char* path) {
+    close();
+
+    m_fileDescriptor = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (m_fileDescriptor < 0) {
+        Logger::error("CandumpReader::open(): cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (fstat(m_fileDescriptor, &fileStatus) < 0) {
+        Logger::error("CandumpReader::open(): cannot stat %s: %s", path, strerror(errno));
+        close();
+        return false;
+    }
+    if (fileStatus.st_size == 0) {
+        return true;  // nothing to map, forEach() finds no frame
+    }
+    m_mappingSize = static_cast<size_t>(fileStatus.st_size);
+
+    void* mapping = mmap(NULL, m_mappingSize, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        Logger::error("CandumpReader::open(): mmap() of %s failed: %s", path, strerror(errno));
+        m_mappingSize = 0;
+        close();
+        return false;
+    }
+    m_mapping = static_cast<const char*>(mapping);
+    madvise(mapping, m_mappingSize, MADV_SEQUENTIAL);
+    return true;
+}
+
+void CandumpReader::close() {
+    if (m_mapping != NULL) {
+        munmap(const_cast<char*>(m_mapping), m_mappingSize);
+    }
+    if (m_fileDescriptor >= 0) {
+        ::close(m_fileDescriptor);
+    }
+    m_fileDescriptor = -1;
+    m_mapping = NULL;
+    m_mappingSize = 0;
+}
+
+#endif  // ON_ARDUINO_BOARD
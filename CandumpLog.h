@@ -0,0 +1,308 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CandumpLog.h
+ *
+ * Purpose:
+ *    Streaming parser of Linux candump text logs and replayer of the parsed frames.
+ *    Both the log format (candump -l) and the default screen format are understood:
+ *
+ *      (1436509052.249713) can0 2BD#0102030405060708
+ *      (1436509052.249713)  can0  2BD   [8]  01 02 03 04 05 06 07 08
+ *      can0  2BD   [8]  01 02 03 04 05 06 07 08
+ *
+ * Developer Notes:
+ *    RPI only.
+ *
+ *    Nothing is allocated per line: CandumpReader memory-maps a file, or reads a
+ *    pipe (e.g. zcat voyage.log.gz) in fixed chunks, and hands each parsed frame to
+ *    a callback. Lines that are not classic CAN frames (CAN FD, error frames, the
+ *    candump -t A date format, garbage) are skipped and counted.
+ *
+ *    Standard ids are printed with 3 hex digits and extended ids with 8, this is how
+ *    CanMsg.header.ide is set.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANDUMPLOG_H
+#define SAILINGROBOT_CANDUMPLOG_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "CandumpLog.h is only available on the RPI"
+#endif
+
+#include <unistd.h>
+
+struct CandumpFrame {
+    CanMsg message;
+    uint64_t timestampNs;  // 0 when the line has no timestamp
+    bool hasTimestamp;
+    bool remoteRequest;
+    const char* interfaceName;  // not null terminated, only valid during the callback
+    uint8_t interfaceLength;
+};
+
+class CandumpParser {
+   public:
+    /**
+     * Parses one line, without its line feed
+     *
+     * @param frame set when the line is a classic CAN frame
+     * @return false if the line is not a classic CAN frame
+     */
+    static bool parseLine(const char* line, const char* end, CandumpFrame& frame);
+
+    /**
+     * Parses the complete lines of a buffer, calling callback(const CandumpFrame&)
+     * for each frame
+     *
+     * @param skippedLines incremented for each line that is not a frame
+     * @return the number of bytes consumed, the start of an unterminated last line
+     *         is left to the caller
+     */
+    template <class Callback>
+    static size_t parseLines(const char* data, size_t size, Callback& callback, uint64_t& skippedLines) {
+        const char* line = data;
+        const char* end = data + size;
+        CandumpFrame frame;
+        while (line < end) {
+            const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+            if (lineEnd == NULL) {
+                break;
+            }
+            if (parseLine(line, lineEnd, frame)) {
+                callback(frame);
+            } else if (lineEnd != line) {
+                skippedLines++;
+            }
+            line = lineEnd + 1;
+        }
+        return line - data;
+    }
+};
+
+class CandumpReader {
+   public:
+    static const size_t STREAM_CHUNK_SIZE = 1 << 16;
+
+    CandumpReader();
+    ~CandumpReader();
+
+    CandumpReader(const CandumpReader&) = delete;
+    CandumpReader& operator=(const CandumpReader&) = delete;
+
+    /**
+     * Memory-maps a log file
+     * @return false on failure, the reason is logged
+     */
+    bool open(const char* path);
+
+    void close();
+
+    /**
+     * Calls callback(const CandumpFrame&) for every frame of the mapped file
+     * @return the number of frames
+     */
+    template <class Callback>
+    uint64_t forEach(Callback callback) {
+        uint64_t frames = 0;
+        Counting<Callback> counting = {callback, frames};
+        m_skippedLines = 0;
+        size_t consumed = CandumpParser::parseLines(m_mapping, m_mappingSize, counting, m_skippedLines);
+        // The last line may have no line feed
+        CandumpFrame frame;
+        if (consumed < m_mappingSize) {
+            if (CandumpParser::parseLine(m_mapping + consumed, m_mapping + m_mappingSize, frame)) {
+                counting(frame);
+            } else {
+                m_skippedLines++;
+            }
+        }
+        return frames;
+    }
+
+    /**
+     * Reads a log from a file descriptor (pipe, socket, stdin) in STREAM_CHUNK_SIZE
+     * chunks and calls callback(const CandumpFrame&) for every frame
+     *
+     * @return the number of frames, -1 on read error
+     */
+    template <class Callback>
+    int64_t forEachInStream(int fileDescriptor, Callback callback) {
+        uint64_t frames = 0;
+        Counting<Callback> counting = {callback, frames};
+        m_skippedLines = 0;
+        m_streamBuffer.resize(STREAM_CHUNK_SIZE);
+
+        size_t pending = 0;
+        bool skippingLine = false;  // in a line longer than the buffer, until its line feed
+        for (;;) {
+            if (pending == m_streamBuffer.size()) {
+                // A line longer than the buffer is not a frame, its tail must not be parsed
+                pending = 0;
+                skippingLine = true;
+                m_skippedLines++;
+            }
+            ssize_t bytesRead = read(fileDescriptor, &m_streamBuffer[pending], m_streamBuffer.size() - pending);
+            if (bytesRead < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            if (bytesRead == 0) {
+                break;
+            }
+            size_t available = pending + static_cast<size_t>(bytesRead);
+            size_t consumed = 0;
+            if (skippingLine) {
+                // pending is 0 while skipping
+                const char* lineEnd = static_cast<const char*>(memchr(&m_streamBuffer[0], '\n', available));
+                if (lineEnd == NULL) {
+                    continue;
+                }
+                consumed = static_cast<size_t>(lineEnd - &m_streamBuffer[0]) + 1;
+                skippingLine = false;
+            }
+            consumed += CandumpParser::parseLines(&m_streamBuffer[consumed], available - consumed, counting,
+                                                  m_skippedLines);
+            pending = available - consumed;
+            memmove(&m_streamBuffer[0], &m_streamBuffer[consumed], pending);
+        }
+
+        CandumpFrame frame;
+        if (pending > 0) {
+            if (CandumpParser::parseLine(&m_streamBuffer[0], &m_streamBuffer[pending], frame)) {
+                counting(frame);
+            } else {
+                m_skippedLines++;
+            }
+        }
+        return static_cast<int64_t>(frames);
+    }
+
+    /**
+     * @return the number of non empty lines of the last pass that were not frames
+     */
+    uint64_t skippedLines() const { return m_skippedLines; }
+
+   private:
+    template <class Callback>
+    struct Counting {
+        Callback& callback;
+        uint64_t& frames;
+
+        void operator()(const CandumpFrame& frame) {
+            frames++;
+            callback(frame);
+        }
+    };
+
+    int m_fileDescriptor;
+    const char* m_mapping;
+    size_t m_mappingSize;
+    uint64_t m_skippedLines;
+    std::vector<char> m_streamBuffer;
+};
+
+/**
+ * Re-emits frames with their recorded spacing, scaled by a speed factor, or as fast
+ * as the sink accepts them. Frames that are due at the same time are handed to the
+ * sink together, so that e.g. SocketCanTransport::send() gets whole batches:
+ *
+ *   CandumpReplayer replayer(CandumpReplayer::ACCELERATED, 10.0);
+ *   auto sink = [&](const CanMsg* messages, size_t count) {
+ *       return transport.send(messages, count) >= 0;
+ *   };
+ *   reader.forEach([&](const CandumpFrame& frame) { replayer.add(frame, sink); });
+ *   replayer.flush(sink);
+ */
+class CandumpReplayer {
+   public:
+    enum Timing { ORIGINAL, ACCELERATED, MAX_SPEED };
+
+    static const size_t MAX_BATCH_SIZE = 64;
+
+    /**
+     * @param speed factor applied to the recorded spacing with ACCELERATED
+     */
+    explicit CandumpReplayer(Timing timing, double speed = 1.0)
+        : m_timing(timing), m_speed((timing == ORIGINAL || speed <= 0) ? 1.0 : speed),
+          m_started(false), m_firstTimestampNs(0), m_batchSize(0), m_stopped(false) {}
+
+    /**
+     * Queues a frame, waiting until it is due. Queued frames are handed to
+     * sink(const CanMsg* messages, size_t count) before waiting or when the batch
+     * is full. The sink returns false to stop the replay.
+     *
+     * @return false once the sink has stopped the replay
+     */
+    template <class Sink>
+    bool add(const CandumpFrame& frame, Sink sink) {
+        if (m_stopped) {
+            return false;
+        }
+
+        if (m_timing != MAX_SPEED && frame.hasTimestamp) {
+            if (!m_started) {
+                m_started = true;
+                m_firstTimestampNs = frame.timestampNs;
+                m_startTime = std::chrono::steady_clock::now();
+            }
+            std::chrono::steady_clock::time_point due = dueTime(frame.timestampNs);
+            if (due > std::chrono::steady_clock::now()) {
+                if (!flush(sink)) {
+                    return false;
+                }
+                std::this_thread::sleep_until(due);
+            }
+        }
+
+        if (m_batchSize == MAX_BATCH_SIZE && !flush(sink)) {
+            return false;
+        }
+        m_batch[m_batchSize++] = frame.message;
+        return true;
+    }
+
+    /**
+     * Hands the queued frames to the sink, to be called after the last frame
+     * @return false once the sink has stopped the replay
+     */
+    template <class Sink>
+    bool flush(Sink sink) {
+        if (m_batchSize > 0 && !m_stopped) {
+            m_stopped = !sink(static_cast<const CanMsg*>(m_batch), m_batchSize);
+        }
+        m_batchSize = 0;
+        return !m_stopped;
+    }
+
+   private:
+    std::chrono::steady_clock::time_point dueTime(uint64_t timestampNs) const {
+        // Timestamps going backwards (log of several interfaces) are due immediately
+        uint64_t elapsedNs = (timestampNs > m_firstTimestampNs) ? timestampNs - m_firstTimestampNs : 0;
+        return m_startTime + std::chrono::nanoseconds(static_cast<int64_t>(elapsedNs / m_speed));
+    }
+
+    Timing m_timing;
+    double m_speed;
+    bool m_started;
+    uint64_t m_firstTimestampNs;
+    std::chrono::steady_clock::time_point m_startTime;
+    CanMsg m_batch[MAX_BATCH_SIZE];
+    size_t m_batchSize;
+    bool m_stopped;
+};
+
+#endif  // SAILINGROBOT_CANDUMPLOG_H
@@ -0,0 +1,243 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CurrentSensorSequenceTracker.h
+ *
+ * Purpose:
+ *    Receiver side of the current sensor header written by
+ *    CanMessageHandler::generateCurrentSensorHeader(): follows the 2 bits rolling number
+ *    of every sensor ID to find dropped, duplicated and reordered
+ *    MSG_ID_CURRENT_SENSOR_DATA frames, and estimates the frame rate of each sensor.
+ *
+ * Developer Notes:
+ *    RPI only, relies on std::atomic.
+ *
+ *    update() is called by a single thread (the bus reader). The counters and the
+ *    rate are relaxed atomics, statistics() can be called from any thread.
+ *
+ *    With a 2 bits rolling number the step from the previous frame is only known
+ *    modulo 4:
+ *      1  next frame
+ *      2  one frame lost
+ *      3  the frame lost just before the previous one arriving late (reordered) if
+ *         that rolling number was missing, otherwise two frames lost
+ *      0  duplicate if the payload is the same as the previous one, otherwise four
+ *         frames further
+ *    Once the rate is known, the time since the previous frame decides how many
+ *    times the rolling number wrapped. Only a frame late by one position can be
+ *    recognised as reordered, later ones count as a new gap.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CURRENTSENSORSEQUENCETRACKER_H
+#define SAILINGROBOT_CURRENTSENSORSEQUENCETRACKER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+#include "CanDiagnostics.h"
+#include "CanMessageSchema.h"
+#include "CanPayload.h"
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "CurrentSensorSequenceTracker.h is only available on the RPI"
+#endif
+
+enum CurrentSensorFrameStatus {
+    CURRENT_SENSOR_FRAME_FIRST,      // first frame of this sensor
+    CURRENT_SENSOR_FRAME_IN_ORDER,
+    CURRENT_SENSOR_FRAME_GAP,        // frames were lost before this one
+    CURRENT_SENSOR_FRAME_DUPLICATE,  // same frame as the previous one, drop it
+    CURRENT_SENSOR_FRAME_REORDERED,  // older than the previous frame, drop it
+    CURRENT_SENSOR_FRAME_INVALID     // not a MSG_ID_CURRENT_SENSOR_DATA frame
+};
+
+struct CurrentSensorSequenceStatistics {
+    uint32_t received;
+    uint32_t dropped;     // frames never received, lowered when one arrives late
+    uint32_t duplicates;
+    uint32_t reordered;
+    float rateHz;         // 0 until MIN_RATE_SAMPLES intervals were seen
+};
+
+class CurrentSensorSequenceTracker {
+   public:
+    typedef CurrentSensorData::SensorId SensorId;
+    typedef CurrentSensorData::RollingNumber RollingNumber;
+
+    static const uint8_t SENSOR_COUNT = 1 << SensorId::LENGTH;
+    static const uint8_t ROLLING_NUMBER_COUNT = 1 << RollingNumber::LENGTH;
+    static const uint32_t MIN_RATE_SAMPLES = 4;
+    static const uint32_t RATE_SMOOTHING_SHIFT = 3;  // each interval weighs 1/8 in the estimate
+
+    CurrentSensorSequenceTracker() {}
+
+    CurrentSensorSequenceTracker(const CurrentSensorSequenceTracker&) = delete;
+    CurrentSensorSequenceTracker& operator=(const CurrentSensorSequenceTracker&) = delete;
+
+    /**
+     * A frame should be passed on to the rest of the system
+     */
+    static inline bool isFresh(CurrentSensorFrameStatus status) {
+        return status == CURRENT_SENSOR_FRAME_FIRST || status == CURRENT_SENSOR_FRAME_IN_ORDER ||
+               status == CURRENT_SENSOR_FRAME_GAP;
+    }
+
+    /**
+     * Single thread only
+     *
+     * @param timestampNs receive time, any monotonic clock
+     */
+    CurrentSensorFrameStatus update(const CanMsg& message, uint64_t timestampNs) {
+        if (message.id != MSG_ID_CURRENT_SENSOR_DATA) {
+            return CURRENT_SENSOR_FRAME_INVALID;
+        }
+        uint64_t payload = CanPayload::load(message.data);
+        Sensor& sensor = m_sensors[SensorId::get(payload)];
+        uint8_t rollingNumber = RollingNumber::get(payload);
+        sensor.received.fetch_add(1, std::memory_order_relaxed);
+
+        if (!sensor.started) {
+            sensor.started = true;
+            accept(sensor, rollingNumber, payload, timestampNs, 0);
+            return CURRENT_SENSOR_FRAME_FIRST;
+        }
+
+        uint8_t step = static_cast<uint8_t>((rollingNumber - sensor.lastRollingNumber) & (ROLLING_NUMBER_COUNT - 1));
+        uint64_t elapsedNs = timestampNs - sensor.lastTimestampNs;
+
+        if (step == ROLLING_NUMBER_COUNT - 1 && (sensor.missingMask & (1 << rollingNumber))) {
+            sensor.missingMask &= static_cast<uint8_t>(~(1 << rollingNumber));
+            sensor.dropped.fetch_sub(1, std::memory_order_relaxed);
+            sensor.reordered.fetch_add(1, std::memory_order_relaxed);
+            return CURRENT_SENSOR_FRAME_REORDERED;
+        }
+
+        uint32_t frames = (step == 0) ? ROLLING_NUMBER_COUNT : step;
+        uint32_t expectedFrames = expectedFramesSince(sensor, elapsedNs);
+        if (step == 0 && payload == sensor.lastPayload && expectedFrames < ROLLING_NUMBER_COUNT / 2) {
+            sensor.duplicates.fetch_add(1, std::memory_order_relaxed);
+            return CURRENT_SENSOR_FRAME_DUPLICATE;
+        }
+        // Whole rolling number wraps missed, when the rate says so
+        while (expectedFrames > 0 && frames + ROLLING_NUMBER_COUNT / 2 < expectedFrames) {
+            frames += ROLLING_NUMBER_COUNT;
+        }
+
+        accept(sensor, rollingNumber, payload, timestampNs, frames);
+        if (frames > 1) {
+            sensor.dropped.fetch_add(frames - 1, std::memory_order_relaxed);
+            return CURRENT_SENSOR_FRAME_GAP;
+        }
+        return CURRENT_SENSOR_FRAME_IN_ORDER;
+    }
+
+    /**
+     * Single thread only, timestamped with std::chrono::steady_clock
+     */
+    CurrentSensorFrameStatus update(const CanMsg& message) {
+        return update(message, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch()).count()));
+    }
+
+    /**
+     * Safe from any number of threads
+     */
+    CurrentSensorSequenceStatistics statistics(uint8_t sensorId) const {
+        CurrentSensorSequenceStatistics statistics = {0, 0, 0, 0, 0.0f};
+        if (sensorId >= SENSOR_COUNT) {
+            return statistics;
+        }
+        const Sensor& sensor = m_sensors[sensorId];
+        statistics.received = sensor.received.load(std::memory_order_relaxed);
+        statistics.dropped = sensor.dropped.load(std::memory_order_relaxed);
+        statistics.duplicates = sensor.duplicates.load(std::memory_order_relaxed);
+        statistics.reordered = sensor.reordered.load(std::memory_order_relaxed);
+        uint64_t intervalNs = sensor.intervalNs.load(std::memory_order_relaxed);
+        if (intervalNs != 0) {
+            statistics.rateHz = 1e9f / static_cast<float>(intervalNs);
+        }
+        return statistics;
+    }
+
+   private:
+    struct alignas(64) Sensor {
+        CanCounter received;
+        CanCounter dropped;
+        CanCounter duplicates;
+        CanCounter reordered;
+        std::atomic<uint64_t> intervalNs;  // published once MIN_RATE_SAMPLES intervals were seen
+
+        // Writer side only
+        bool started;
+        uint8_t lastRollingNumber;
+        uint8_t missingMask;  // bit n set while rolling number n is missing
+        uint32_t intervalSamples;
+        uint64_t smoothedIntervalNs;
+        uint64_t lastPayload;
+        uint64_t lastTimestampNs;
+
+        Sensor()
+            : received(0),
+              dropped(0),
+              duplicates(0),
+              reordered(0),
+              intervalNs(0),
+              started(false),
+              lastRollingNumber(0),
+              missingMask(0),
+              intervalSamples(0),
+              smoothedIntervalNs(0),
+              lastPayload(0),
+              lastTimestampNs(0) {}
+    };
+
+    /**
+     * @return the number of frames the elapsed time stands for, 0 while the rate is unknown
+     */
+    static inline uint32_t expectedFramesSince(const Sensor& sensor, uint64_t elapsedNs) {
+        if (sensor.intervalSamples < MIN_RATE_SAMPLES || sensor.smoothedIntervalNs == 0) {
+            return 0;
+        }
+        uint64_t frames = (elapsedNs + sensor.smoothedIntervalNs / 2) / sensor.smoothedIntervalNs;
+        return (frames > 0xFFFF) ? 0xFFFF : static_cast<uint32_t>(frames);
+    }
+
+    /**
+     * Makes the frame the latest one of the sensor, frames since the previous one
+     */
+    static inline void accept(Sensor& sensor, uint8_t rollingNumber, uint64_t payload, uint64_t timestampNs,
+                              uint32_t frames) {
+        if (frames > 0) {
+            // The rolling numbers skipped are missing until they are reused
+            for (uint32_t i = 1; i < frames && i < ROLLING_NUMBER_COUNT; i++) {
+                sensor.missingMask |= static_cast<uint8_t>(1 << ((sensor.lastRollingNumber + i) & (ROLLING_NUMBER_COUNT - 1)));
+            }
+            updateInterval(sensor, (timestampNs - sensor.lastTimestampNs) / frames);
+        }
+        sensor.missingMask &= static_cast<uint8_t>(~(1 << rollingNumber));
+        sensor.lastRollingNumber = rollingNumber;
+        sensor.lastPayload = payload;
+        sensor.lastTimestampNs = timestampNs;
+    }
+
+    static inline void updateInterval(Sensor& sensor, uint64_t intervalNs) {
+        if (sensor.intervalSamples == 0) {
+            sensor.smoothedIntervalNs = intervalNs;
+        } else if (intervalNs >= sensor.smoothedIntervalNs) {
+            sensor.smoothedIntervalNs += (intervalNs - sensor.smoothedIntervalNs) >> RATE_SMOOTHING_SHIFT;
+        } else {
+            sensor.smoothedIntervalNs -= (sensor.smoothedIntervalNs - intervalNs) >> RATE_SMOOTHING_SHIFT;
+        }
+        sensor.intervalSamples++;
+        if (sensor.intervalSamples >= MIN_RATE_SAMPLES) {
+            sensor.intervalNs.store(sensor.smoothedIntervalNs, std::memory_order_relaxed);
+        }
+    }
+
+    Sensor m_sensors[SENSOR_COUNT];
+};
+
+#endif  // SAILINGROBOT_CURRENTSENSORSEQUENCETRACKER_H
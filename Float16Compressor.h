@@ -12,8 +12,29 @@
  *       Link to the source:
  *https://stackoverflow.com/questions/1659440/32-bit-to-16-bit-floating-point-conversion
  *
+ *       The array versions of compress() and decompress() run the same integer bit
+ *       tricks on 8 (AVX2, SSE2) or 4 (NEON) values at once, so their results are bit
+ *       identical to the scalar path. F16C is not used on purpose: its conversion rounds
+ *       and quiets NaNs differently from the scalar code.
+ *       AVX2 is only used if enabled at compile time (e.g. -mavx2 or -march=native).
+ *
  ***************************************************************************************/
 
+#ifndef SAILINGROBOT_FLOAT16COMPRESSOR_H
+#define SAILINGROBOT_FLOAT16COMPRESSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+ #include <immintrin.h>
+#elif defined(__SSE2__)
+ #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+ #define FLOAT16COMPRESSOR_NEON
+#endif
+
 class Float16Compressor {
     union Bits {
         float f;
@@ -44,6 +65,149 @@ class Float16Compressor {
     static int32_t const maxD = infC - maxC - 1;
     static int32_t const minD = minC - subC - 1;
 
+#if defined(__AVX2__)
+    static const size_t VECTOR_WIDTH = 8;
+
+    // v ^= (x ^ v) & mask
+    static inline __m256i select(__m256i mask, __m256i x, __m256i v) {
+        return _mm256_xor_si256(v, _mm256_and_si256(_mm256_xor_si256(x, v), mask));
+    }
+
+    static inline void compressVector(const float* values, uint16_t* compressed) {
+        __m256i v = _mm256_castps_si256(_mm256_loadu_ps(values));
+        __m256i sign = _mm256_and_si256(v, _mm256_set1_epi32(signN));
+        v = _mm256_xor_si256(v, sign);
+        sign = _mm256_srli_epi32(sign, shiftSign);
+        __m256i s = _mm256_cvttps_epi32(
+            _mm256_mul_ps(_mm256_castsi256_ps(_mm256_set1_epi32(mulN)), _mm256_castsi256_ps(v)));
+        v = select(_mm256_cmpgt_epi32(_mm256_set1_epi32(minN), v), s, v);
+        v = select(_mm256_and_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(infN), v),
+                                    _mm256_cmpgt_epi32(v, _mm256_set1_epi32(maxN))),
+                   _mm256_set1_epi32(infN), v);
+        v = select(_mm256_and_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(nanN), v),
+                                    _mm256_cmpgt_epi32(v, _mm256_set1_epi32(infN))),
+                   _mm256_set1_epi32(nanN), v);
+        v = _mm256_srli_epi32(v, shift);
+        v = select(_mm256_cmpgt_epi32(v, _mm256_set1_epi32(maxC)),
+                   _mm256_sub_epi32(v, _mm256_set1_epi32(maxD)), v);
+        v = select(_mm256_cmpgt_epi32(v, _mm256_set1_epi32(subC)),
+                   _mm256_sub_epi32(v, _mm256_set1_epi32(minD)), v);
+        v = _mm256_or_si256(v, sign);
+        // Sign extend the low 16 bits so the saturating pack keeps them unchanged
+        v = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(compressed), packed);
+    }
+
+    static inline void decompressVector(const uint16_t* compressed, float* values) {
+        __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(compressed)));
+        __m256i sign = _mm256_and_si256(v, _mm256_set1_epi32(signC));
+        v = _mm256_xor_si256(v, sign);
+        sign = _mm256_slli_epi32(sign, shiftSign);
+        v = select(_mm256_cmpgt_epi32(v, _mm256_set1_epi32(subC)),
+                   _mm256_add_epi32(v, _mm256_set1_epi32(minD)), v);
+        v = select(_mm256_cmpgt_epi32(v, _mm256_set1_epi32(maxC)),
+                   _mm256_add_epi32(v, _mm256_set1_epi32(maxD)), v);
+        __m256i s = _mm256_castps_si256(
+            _mm256_mul_ps(_mm256_castsi256_ps(_mm256_set1_epi32(mulC)), _mm256_cvtepi32_ps(v)));
+        __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(norC), v);
+        v = _mm256_slli_epi32(v, shift);
+        v = select(mask, s, v);
+        v = _mm256_or_si256(v, sign);
+        _mm256_storeu_ps(values, _mm256_castsi256_ps(v));
+    }
+#elif defined(__SSE2__)
+    static const size_t VECTOR_WIDTH = 8;
+
+    // v ^= (x ^ v) & mask
+    static inline __m128i select(__m128i mask, __m128i x, __m128i v) {
+        return _mm_xor_si128(v, _mm_and_si128(_mm_xor_si128(x, v), mask));
+    }
+
+    static inline __m128i compressLanes(const float* values) {
+        __m128i v = _mm_castps_si128(_mm_loadu_ps(values));
+        __m128i sign = _mm_and_si128(v, _mm_set1_epi32(signN));
+        v = _mm_xor_si128(v, sign);
+        sign = _mm_srli_epi32(sign, shiftSign);
+        __m128i s = _mm_cvttps_epi32(
+            _mm_mul_ps(_mm_castsi128_ps(_mm_set1_epi32(mulN)), _mm_castsi128_ps(v)));
+        v = select(_mm_cmpgt_epi32(_mm_set1_epi32(minN), v), s, v);
+        v = select(_mm_and_si128(_mm_cmpgt_epi32(_mm_set1_epi32(infN), v),
+                                 _mm_cmpgt_epi32(v, _mm_set1_epi32(maxN))),
+                   _mm_set1_epi32(infN), v);
+        v = select(_mm_and_si128(_mm_cmpgt_epi32(_mm_set1_epi32(nanN), v),
+                                 _mm_cmpgt_epi32(v, _mm_set1_epi32(infN))),
+                   _mm_set1_epi32(nanN), v);
+        v = _mm_srli_epi32(v, shift);
+        v = select(_mm_cmpgt_epi32(v, _mm_set1_epi32(maxC)), _mm_sub_epi32(v, _mm_set1_epi32(maxD)), v);
+        v = select(_mm_cmpgt_epi32(v, _mm_set1_epi32(subC)), _mm_sub_epi32(v, _mm_set1_epi32(minD)), v);
+        v = _mm_or_si128(v, sign);
+        // Sign extend the low 16 bits so the saturating pack keeps them unchanged
+        return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+    }
+
+    static inline __m128 decompressLanes(__m128i v) {
+        __m128i sign = _mm_and_si128(v, _mm_set1_epi32(signC));
+        v = _mm_xor_si128(v, sign);
+        sign = _mm_slli_epi32(sign, shiftSign);
+        v = select(_mm_cmpgt_epi32(v, _mm_set1_epi32(subC)), _mm_add_epi32(v, _mm_set1_epi32(minD)), v);
+        v = select(_mm_cmpgt_epi32(v, _mm_set1_epi32(maxC)), _mm_add_epi32(v, _mm_set1_epi32(maxD)), v);
+        __m128i s = _mm_castps_si128(_mm_mul_ps(_mm_castsi128_ps(_mm_set1_epi32(mulC)), _mm_cvtepi32_ps(v)));
+        __m128i mask = _mm_cmpgt_epi32(_mm_set1_epi32(norC), v);
+        v = _mm_slli_epi32(v, shift);
+        v = select(mask, s, v);
+        return _mm_castsi128_ps(_mm_or_si128(v, sign));
+    }
+
+    // SSE2 has no unsigned 32 to 16 bits pack, so values go 8 at a time through a signed pack
+    static inline void compressVector(const float* values, uint16_t* compressed) {
+        __m128i packed = _mm_packs_epi32(compressLanes(values), compressLanes(values + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(compressed), packed);
+    }
+
+    static inline void decompressVector(const uint16_t* compressed, float* values) {
+        __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(compressed));
+        __m128i zero = _mm_setzero_si128();
+        _mm_storeu_ps(values, decompressLanes(_mm_unpacklo_epi16(halves, zero)));
+        _mm_storeu_ps(values + 4, decompressLanes(_mm_unpackhi_epi16(halves, zero)));
+    }
+#elif defined(FLOAT16COMPRESSOR_NEON)
+    static const size_t VECTOR_WIDTH = 4;
+
+    static inline void compressVector(const float* values, uint16_t* compressed) {
+        int32x4_t v = vreinterpretq_s32_f32(vld1q_f32(values));
+        int32x4_t sign = vandq_s32(v, vdupq_n_s32(signN));
+        v = veorq_s32(v, sign);
+        uint32x4_t signU = vshrq_n_u32(vreinterpretq_u32_s32(sign), shiftSign);
+        int32x4_t s = vcvtq_s32_f32(
+            vmulq_f32(vreinterpretq_f32_s32(vdupq_n_s32(mulN)), vreinterpretq_f32_s32(v)));
+        v = vbslq_s32(vcgtq_s32(vdupq_n_s32(minN), v), s, v);
+        v = vbslq_s32(vandq_u32(vcgtq_s32(vdupq_n_s32(infN), v), vcgtq_s32(v, vdupq_n_s32(maxN))),
+                      vdupq_n_s32(infN), v);
+        v = vbslq_s32(vandq_u32(vcgtq_s32(vdupq_n_s32(nanN), v), vcgtq_s32(v, vdupq_n_s32(infN))),
+                      vdupq_n_s32(nanN), v);
+        v = vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(v), shift));
+        v = vbslq_s32(vcgtq_s32(v, vdupq_n_s32(maxC)), vsubq_s32(v, vdupq_n_s32(maxD)), v);
+        v = vbslq_s32(vcgtq_s32(v, vdupq_n_s32(subC)), vsubq_s32(v, vdupq_n_s32(minD)), v);
+        vst1_u16(compressed, vmovn_u32(vorrq_u32(vreinterpretq_u32_s32(v), signU)));
+    }
+
+    static inline void decompressVector(const uint16_t* compressed, float* values) {
+        int32x4_t v = vreinterpretq_s32_u32(vmovl_u16(vld1_u16(compressed)));
+        int32x4_t sign = vandq_s32(v, vdupq_n_s32(signC));
+        v = veorq_s32(v, sign);
+        sign = vshlq_n_s32(sign, shiftSign);
+        v = vbslq_s32(vcgtq_s32(v, vdupq_n_s32(subC)), vaddq_s32(v, vdupq_n_s32(minD)), v);
+        v = vbslq_s32(vcgtq_s32(v, vdupq_n_s32(maxC)), vaddq_s32(v, vdupq_n_s32(maxD)), v);
+        int32x4_t s = vreinterpretq_s32_f32(
+            vmulq_f32(vreinterpretq_f32_s32(vdupq_n_s32(mulC)), vcvtq_f32_s32(v)));
+        uint32x4_t mask = vcgtq_s32(vdupq_n_s32(norC), v);
+        v = vshlq_n_s32(v, shift);
+        v = vbslq_s32(mask, s, v);
+        vst1q_f32(values, vreinterpretq_f32_s32(vorrq_s32(v, sign)));
+    }
+#endif
+
    public:
     static uint16_t compress(float value) {
         Bits v, s;
@@ -79,4 +243,49 @@ class Float16Compressor {
         v.si |= sign;
         return v.f;
     }
+
+    /**
+     * Compresses an array of floats, bit identical to calling compress() on each value
+     *
+     * @param values the floats to compress
+     * @param compressed output array, at least n elements
+     * @param n number of values
+     */
+    static void compress(const float* values, uint16_t* compressed, size_t n) {
+        size_t i = 0;
+#if defined(__SSE2__) || defined(FLOAT16COMPRESSOR_NEON)
+        // A bound known before the loop lets the compiler bound the scalar tail
+        const size_t vectorEnd = n - n % VECTOR_WIDTH;
+        for (; i < vectorEnd; i += VECTOR_WIDTH) {
+            compressVector(values + i, compressed + i);
+        }
+#endif
+        for (; i < n; i++) {
+            compressed[i] = compress(values[i]);
+        }
+    }
+
+    /**
+     * Decompresses an array of half precision floats, bit identical to calling
+     * decompress() on each value
+     *
+     * @param compressed the half precision floats
+     * @param values output array, at least n elements
+     * @param n number of values
+     */
+    static void decompress(const uint16_t* compressed, float* values, size_t n) {
+        size_t i = 0;
+#if defined(__SSE2__) || defined(FLOAT16COMPRESSOR_NEON)
+        // A bound known before the loop lets the compiler bound the scalar tail
+        const size_t vectorEnd = n - n % VECTOR_WIDTH;
+        for (; i < vectorEnd; i += VECTOR_WIDTH) {
+            decompressVector(compressed + i, values + i);
+        }
+#endif
+        for (; i < n; i++) {
+            values[i] = decompress(compressed[i]);
+        }
+    }
 };
+
+#endif  // SAILINGROBOT_FLOAT16COMPRESSOR_H
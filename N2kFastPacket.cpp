@@ -0,0 +1,208 @@
+/****************************************************************************************
+ *
+ * File:
+ *    N2kFastPacket.cpp
+ *
+ * Purpose:
+ *    Fast-packet PGN list and fragmenter of N2kMsgArd
+ *
+ * Developer Notes:
+ *    The PGN list is kept in flash on Arduino boards.
+ *
+ ***************************************************************************************/
+
+#include "N2kFastPacket.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #include <avr/pgmspace.h>
+ #define N2K_PGN_TABLE_ATTRIBUTE PROGMEM
+ #define N2K_READ_PGN(ADDRESS) pgm_read_dword(ADDRESS)
+#else
+ #define N2K_PGN_TABLE_ATTRIBUTE
+ #define N2K_READ_PGN(ADDRESS) (*(ADDRESS))
+#endif
+
+namespace {
+
+const uint32_t PROPRIETARY_FAST_PACKET_FIRST_PGN = 130816;
+const uint32_t PROPRIETARY_FAST_PACKET_LAST_PGN = 131071;
+
+// Standard fast-packet PGNs, sorted
+const uint32_t FAST_PACKET_PGNS[] N2K_PGN_TABLE_ATTRIBUTE = {
+    126208,  // NMEA request/command/acknowledge group function
+    126464,  // PGN list
+    126720,  // Proprietary addressable
+    126983,  // Alert
+    126984,  // Alert response
+    126985,  // Alert text
+    126986,  // Alert configuration
+    126987,  // Alert threshold
+    126988,  // Alert value
+    126996,  // Product information
+    126998,  // Configuration information
+    127233,  // Man overboard notification
+    127237,  // Heading/track control
+    127489,  // Engine parameters, dynamic
+    127496,  // Trip parameters, vessel
+    127497,  // Trip parameters, engine
+    127498,  // Engine parameters, static
+    127503,  // AC input status
+    127504,  // AC output status
+    127506,  // DC detailed status
+    127507,  // Charger status
+    127509,  // Inverter status
+    127510,  // Charger configuration status
+    127511,  // Inverter configuration status
+    127512,  // AGS configuration status
+    127513,  // Battery configuration status
+    127514,  // AGS status
+    128275,  // Distance log
+    128520,  // Tracked target data
+    129029,  // GNSS position data
+    129038,  // AIS class A position report
+    129039,  // AIS class B position report
+    129040,  // AIS class B extended position report
+    129041,  // AIS aids to navigation report
+    129044,  // Datum
+    129045,  // User datum
+    129284,  // Navigation data
+    129285,  // Navigation route/WP information
+    129301,  // Time to/from mark
+    129302,  // Bearing and distance between two marks
+    129538,  // GNSS control status
+    129540,  // GNSS sats in view
+    129541,  // GPS almanac data
+    129542,  // GNSS pseudorange noise statistics
+    129545,  // GNSS RAIM output
+    129547,  // GNSS pseudorange error statistics
+    129549,  // DGNSS corrections
+    129551,  // GNSS differential correction receiver signal
+    129556,  // GLONASS almanac data
+    129792,  // AIS DGNSS broadcast binary message
+    129793,  // AIS UTC and date report
+    129794,  // AIS class A static and voyage related data
+    129795,  // AIS addressed binary message
+    129796,  // AIS acknowledge
+    129797,  // AIS binary broadcast message
+    129798,  // AIS SAR aircraft position report
+    129799,  // Radio frequency/mode/power
+    129800,  // AIS UTC/date inquiry
+    129801,  // AIS addressed safety related message
+    129802,  // AIS safety related broadcast message
+    129803,  // AIS interrogation
+    129804,  // AIS assignment mode command
+    129805,  // AIS data link management message
+    129806,  // AIS channel management
+    129807,  // AIS class B group assignment
+    129808,  // DSC call information
+    129809,  // AIS class B static data, part A
+    129810,  // AIS class B static data, part B
+    130060,  // Label
+    130061,  // Channel source configuration
+    130064,  // Route and WP service, database list
+    130065,  // Route and WP service, route list
+    130066,  // Route and WP service, route/WP list attributes
+    130067,  // Route and WP service, route - WP name and position
+    130068,  // Route and WP service, route - WP name
+    130069,  // Route and WP service, XTE limit and navigation method
+    130070,  // Route and WP service, WP comment
+    130071,  // Route and WP service, route comment
+    130072,  // Route and WP service, database comment
+    130073,  // Route and WP service, radius of turn
+    130074,  // Route and WP service, WP list - WP name and position
+    130320,  // Tide station data
+    130321,  // Salinity station data
+    130322,  // Current station data
+    130323,  // Meteorological station data
+    130324,  // Moored buoy station data
+    130567,  // Watermaker input setting and status
+    130577,  // Direction data
+    130578,  // Vessel speed components
+};
+
+const size_t FAST_PACKET_PGN_COUNT = sizeof(FAST_PACKET_PGNS) / sizeof(FAST_PACKET_PGNS[0]);
+
+}  // namespace
+
+bool N2kFastPacket::isFastPacketPgn(uint32_t pgn) {
+    if (pgn >= PROPRIETARY_FAST_PACKET_FIRST_PGN && pgn <= PROPRIETARY_FAST_PACKET_LAST_PGN) {
+        return true;
+    }
+    if (pgn < N2K_READ_PGN(&FAST_PACKET_PGNS[0]) || pgn > N2K_READ_PGN(&FAST_PACKET_PGNS[FAST_PACKET_PGN_COUNT - 1])) {
+        return false;
+    }
+
+    size_t low = 0;
+    size_t high = FAST_PACKET_PGN_COUNT;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        uint32_t middlePgn = N2K_READ_PGN(&FAST_PACKET_PGNS[middle]);
+        if (middlePgn == pgn) {
+            return true;
+        }
+        if (middlePgn < pgn) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+N2kFastPacketFragmenter::N2kFastPacketFragmenter(const N2kMsgArd& message, uint8_t sequenceId)
+    : m_message(message),
+      m_canId(N2kCanId::make(message.PGN, message.Priority, message.Source, message.Destination)),
+      m_sequenceId(sequenceId % N2kFastPacket::SEQUENCE_ID_COUNT),
+      m_dataLength(0),
+      m_frameCount(0),
+      m_nextFrame(0),
+      m_fastPacket(N2kFastPacket::isFastPacketPgn(message.PGN)) {
+    if (message.DataLen < 0 || message.DataLen > N2kFastPacket::MAX_DATA_SIZE ||
+        (!m_fastPacket && message.DataLen > N2kFastPacket::FRAME_SIZE)) {
+        return;  // no frame
+    }
+    m_dataLength = static_cast<uint8_t>(message.DataLen);
+    m_frameCount = m_fastPacket ? N2kFastPacket::frameCount(m_dataLength) : 1;
+}
+
+bool N2kFastPacketFragmenter::next(CanMsg& frame) {
+    if (m_nextFrame >= m_frameCount) {
+        return false;
+    }
+
+    frame.id = m_canId;
+    frame.header.ide = 1;
+
+    if (!m_fastPacket) {
+        frame.header.length = m_dataLength;
+        memset(frame.data, N2kFastPacket::PADDING, sizeof(frame.data));
+        memcpy(frame.data, m_message.Data, m_dataLength);
+        m_nextFrame++;
+        return true;
+    }
+
+    frame.header.length = N2kFastPacket::FRAME_SIZE;
+    memset(frame.data, N2kFastPacket::PADDING, sizeof(frame.data));
+    frame.data[0] = static_cast<uint8_t>((m_sequenceId << 5) | m_nextFrame);
+
+    uint8_t offset;
+    uint8_t size;
+    uint8_t* destination;
+    if (m_nextFrame == 0) {
+        frame.data[1] = m_dataLength;
+        offset = 0;
+        size = N2kFastPacket::FIRST_FRAME_DATA_SIZE;
+        destination = &frame.data[2];
+    } else {
+        offset = N2kFastPacket::FIRST_FRAME_DATA_SIZE + (m_nextFrame - 1) * N2kFastPacket::NEXT_FRAME_DATA_SIZE;
+        size = N2kFastPacket::NEXT_FRAME_DATA_SIZE;
+        destination = &frame.data[1];
+    }
+    if (offset + size > m_dataLength) {
+        size = m_dataLength - offset;
+    }
+    memcpy(destination, &m_message.Data[offset], size);
+
+    m_nextFrame++;
+    return true;
+}
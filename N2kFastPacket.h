@@ -0,0 +1,387 @@
+/****************************************************************************************
+ *
+ * File:
+ *    N2kFastPacket.h
+ *
+ * Purpose:
+ *    NMEA 2000 fast-packet transport: reassembly of 8 bytes frames into N2kMsgArd and
+ *    fragmentation of N2kMsgArd into frames, plus the 29 bits id <-> PGN, priority,
+ *    source and destination conversions.
+ *
+ * Developer Notes:
+ *    Arduino and RPI.
+ *
+ *    Fast-packet frames start with a byte holding the sequence id (3 high bits) and
+ *    the frame counter (5 low bits). Frame 0 then holds the total length and 6 data
+ *    bytes, the following frames 7 data bytes each, 223 bytes at most.
+ *
+ *    The reassembler has a fixed pool of N sessions keyed by (PGN, source, sequence
+ *    id), memory is N * ~240 bytes and the cost of a frame is a scan of the N keys.
+ *    Frames are stored at their final position as they arrive, so reordered frames
+ *    are fine and only a bit per frame is kept to know when a message is complete.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_N2KFASTPACKET_H
+#define SAILINGROBOT_N2KFASTPACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "canbus_defs.h"
+
+class N2kCanId {
+   public:
+    static const uint8_t BROADCAST_ADDRESS = 0xFF;
+
+    /**
+     * @return the PGN of a 29 bits id, without the destination of PDU1 PGNs
+     */
+    static inline uint32_t pgn(uint32_t canId) {
+        uint8_t pduFormat = static_cast<uint8_t>(canId >> 16);
+        uint32_t pgn = (canId >> 8) & 0x3FFFF;
+        if (pduFormat < PDU2_FIRST_FORMAT) {
+            pgn &= 0x3FF00;
+        }
+        return pgn;
+    }
+
+    static inline uint8_t priority(uint32_t canId) { return static_cast<uint8_t>((canId >> 26) & 0x7); }
+
+    static inline uint8_t source(uint32_t canId) { return static_cast<uint8_t>(canId); }
+
+    /**
+     * @return the destination address of PDU1 PGNs, BROADCAST_ADDRESS for PDU2 PGNs
+     */
+    static inline uint8_t destination(uint32_t canId) {
+        uint8_t pduFormat = static_cast<uint8_t>(canId >> 16);
+        return (pduFormat < PDU2_FIRST_FORMAT) ? static_cast<uint8_t>(canId >> 8) : BROADCAST_ADDRESS;
+    }
+
+    /**
+     * @param destination only used for PDU1 PGNs
+     * @return the 29 bits id
+     */
+    static inline uint32_t make(uint32_t pgn, uint8_t priority, uint8_t source, uint8_t destination) {
+        uint32_t canId = (static_cast<uint32_t>(priority & 0x7) << 26) | ((pgn & 0x3FFFF) << 8) | source;
+        if (static_cast<uint8_t>(pgn >> 8) < PDU2_FIRST_FORMAT) {
+            canId = (canId & ~0xFF00UL) | (static_cast<uint32_t>(destination) << 8);
+        }
+        return canId;
+    }
+
+   private:
+    static const uint8_t PDU2_FIRST_FORMAT = 240;
+};
+
+class N2kFastPacket {
+   public:
+    static const uint8_t FRAME_SIZE = 8;
+    static const uint8_t FIRST_FRAME_DATA_SIZE = 6;
+    static const uint8_t NEXT_FRAME_DATA_SIZE = 7;
+    static const uint8_t MAX_FRAME_COUNT = 32;
+    static const uint8_t MAX_DATA_SIZE = FIRST_FRAME_DATA_SIZE + (MAX_FRAME_COUNT - 1) * NEXT_FRAME_DATA_SIZE;
+    static const uint8_t SEQUENCE_ID_COUNT = 8;
+    static const uint8_t PADDING = 0xFF;
+
+    /**
+     * @return true if the PGN is sent as fast-packet, from a built-in list of the
+     *         standard fast-packet PGNs and the proprietary range 130816-131071
+     */
+    static bool isFastPacketPgn(uint32_t pgn);
+
+    static inline uint8_t frameCount(uint8_t dataLength) {
+        if (dataLength <= FIRST_FRAME_DATA_SIZE) {
+            return 1;
+        }
+        return static_cast<uint8_t>(1 + (dataLength - FIRST_FRAME_DATA_SIZE + NEXT_FRAME_DATA_SIZE - 1) /
+                                            NEXT_FRAME_DATA_SIZE);
+    }
+
+    /**
+     * @return the bytes a frame must hold: its header and its share of the data, 8 for
+     *         every frame but the last one of the message
+     */
+    static inline uint8_t frameLength(uint8_t frameNumber, uint8_t dataLength) {
+        if (frameNumber == 0) {
+            return 2 + ((dataLength < FIRST_FRAME_DATA_SIZE) ? dataLength : FIRST_FRAME_DATA_SIZE);
+        }
+        uint8_t offset = FIRST_FRAME_DATA_SIZE + (frameNumber - 1) * NEXT_FRAME_DATA_SIZE;
+        uint8_t size = (dataLength > offset) ? dataLength - offset : 0;
+        return 1 + ((size < NEXT_FRAME_DATA_SIZE) ? size : NEXT_FRAME_DATA_SIZE);
+    }
+
+    static inline uint8_t sequenceId(const CanMsg& frame) { return frame.data[0] >> 5; }
+
+    static inline uint8_t frameNumber(const CanMsg& frame) { return frame.data[0] & 0x1F; }
+};
+
+enum N2kFastPacketResult {
+    N2K_FRAME_PENDING,   // frame stored, the message is not complete yet
+    N2K_FRAME_COMPLETE,  // the output message is complete
+    N2K_FRAME_DROPPED    // invalid or duplicate frame, see the statistics
+};
+
+struct N2kFastPacketStatistics {
+    uint32_t completed;
+    uint32_t timedOut;   // sessions dropped after timeoutMs without a frame
+    uint32_t evicted;    // sessions dropped because the pool was full
+    uint32_t restarted;  // frame 0 received again before the session completed
+    uint32_t duplicates;
+    uint32_t invalid;    // frame counter or length out of range, or frame too short
+};
+
+/**
+ * Reassembles fast-packet frames into N2kMsgArd:
+ *
+ *   N2kFastPacketReassembler<4> reassembler;
+ *   N2kMsgArd message;
+ *   if (reassembler.addFrame(frame, millis(), message) == N2K_FRAME_COMPLETE) {
+ *       ...
+ *   }
+ *
+ * Single frame PGNs are converted directly. N is the number of messages that can be
+ * in progress at the same time.
+ */
+template <uint8_t N>
+class N2kFastPacketReassembler {
+   public:
+    static const uint32_t DEFAULT_TIMEOUT_MS = 750;  // NMEA 2000 maximum time between frames
+
+    explicit N2kFastPacketReassembler(uint32_t timeoutMs = DEFAULT_TIMEOUT_MS) : m_timeoutMs(timeoutMs) {
+        reset();
+    }
+
+    void reset() {
+        for (uint8_t i = 0; i < N; i++) {
+            m_sessions[i].active = false;
+        }
+        memset(&m_statistics, 0, sizeof(m_statistics));
+    }
+
+    /**
+     * @param frame a frame with a 29 bits NMEA 2000 id
+     * @param nowMs current time in milliseconds, may wrap around
+     * @param message set when N2K_FRAME_COMPLETE is returned
+     */
+    N2kFastPacketResult addFrame(const CanMsg& frame, uint32_t nowMs, N2kMsgArd& message) {
+        uint32_t pgn = N2kCanId::pgn(frame.id);
+        if (!N2kFastPacket::isFastPacketPgn(pgn)) {
+            setHeader(message, frame.id);
+            message.DataLen = (frame.header.length > N2kFastPacket::FRAME_SIZE) ? N2kFastPacket::FRAME_SIZE
+                                                                                : frame.header.length;
+            memcpy(message.Data, frame.data, message.DataLen);
+            return N2K_FRAME_COMPLETE;
+        }
+        if (frame.header.length < 2) {
+            m_statistics.invalid++;
+            return N2K_FRAME_DROPPED;
+        }
+
+        uint8_t source = N2kCanId::source(frame.id);
+        uint8_t sequenceId = N2kFastPacket::sequenceId(frame);
+        uint8_t frameNumber = N2kFastPacket::frameNumber(frame);
+
+        Session* session = findSession(pgn, source, sequenceId, nowMs);
+        if (frameNumber == 0 && session->frameMask & 1) {
+            m_statistics.restarted++;
+            session->frameMask = 0;
+            session->shortFrame = 0;
+        }
+        if (session->frameMask & (1UL << frameNumber)) {
+            m_statistics.duplicates++;
+            return N2K_FRAME_DROPPED;
+        }
+
+        if (frameNumber == 0) {
+            uint8_t dataLength = frame.data[1];
+            uint8_t frameCount = N2kFastPacket::frameCount(dataLength);
+            if (dataLength > N2kFastPacket::MAX_DATA_SIZE || (session->frameMask & ~allFrames(frameCount)) != 0 ||
+                frame.header.length < N2kFastPacket::frameLength(0, dataLength) ||
+                (session->shortFrame != 0 &&
+                 session->shortFrameLength < N2kFastPacket::frameLength(session->shortFrame, dataLength))) {
+                // Longer than allowed, frames already stored past the announced length,
+                // or a frame shorter than its share of the data
+                m_statistics.invalid++;
+                session->active = false;
+                return N2K_FRAME_DROPPED;
+            }
+            session->dataLength = dataLength;
+            session->frameCount = frameCount;
+            session->canId = frame.id;
+            memcpy(session->data, &frame.data[2], N2kFastPacket::FIRST_FRAME_DATA_SIZE);
+        } else {
+            if (session->frameMask & 1) {
+                if (frameNumber >= session->frameCount) {
+                    m_statistics.invalid++;
+                    return N2K_FRAME_DROPPED;
+                }
+                if (frame.header.length < N2kFastPacket::frameLength(frameNumber, session->dataLength)) {
+                    m_statistics.invalid++;
+                    session->active = false;  // its data is lost, the message cannot complete
+                    return N2K_FRAME_DROPPED;
+                }
+            } else if (frame.header.length < N2kFastPacket::FRAME_SIZE) {
+                // Before frame 0 the length is unknown: only the last frame may be short,
+                // it is checked once frame 0 arrives
+                if (session->shortFrame != 0) {
+                    m_statistics.invalid++;
+                    session->active = false;
+                    return N2K_FRAME_DROPPED;
+                }
+                session->shortFrame = frameNumber;
+                session->shortFrameLength = frame.header.length;
+            }
+            uint8_t offset = N2kFastPacket::FIRST_FRAME_DATA_SIZE +
+                             (frameNumber - 1) * N2kFastPacket::NEXT_FRAME_DATA_SIZE;
+            memcpy(&session->data[offset], &frame.data[1], N2kFastPacket::NEXT_FRAME_DATA_SIZE);
+        }
+        session->frameMask |= 1UL << frameNumber;
+        session->lastFrameMs = nowMs;
+
+        if ((session->frameMask & 1) && session->frameMask == allFrames(session->frameCount)) {
+            setHeader(message, session->canId);
+            message.DataLen = session->dataLength;
+            memcpy(message.Data, session->data, session->dataLength);
+            session->active = false;
+            m_statistics.completed++;
+            return N2K_FRAME_COMPLETE;
+        }
+        return N2K_FRAME_PENDING;
+    }
+
+    /**
+     * Drops the sessions without a frame for more than timeoutMs. Also done when
+     * a new session needs a slot, calling it is only needed to update the statistics.
+     */
+    void expire(uint32_t nowMs) {
+        for (uint8_t i = 0; i < N; i++) {
+            if (m_sessions[i].active && nowMs - m_sessions[i].lastFrameMs > m_timeoutMs) {
+                m_sessions[i].active = false;
+                m_statistics.timedOut++;
+            }
+        }
+    }
+
+    uint8_t activeSessions() const {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < N; i++) {
+            count += m_sessions[i].active ? 1 : 0;
+        }
+        return count;
+    }
+
+    const N2kFastPacketStatistics& statistics() const { return m_statistics; }
+
+   private:
+    struct Session {
+        uint32_t pgn;
+        uint32_t canId;
+        uint32_t frameMask;
+        uint32_t lastFrameMs;
+        uint8_t source;
+        uint8_t sequenceId;
+        uint8_t dataLength;
+        uint8_t frameCount;
+        uint8_t shortFrame;        // frame shorter than 8 bytes received before frame 0, 0 if none
+        uint8_t shortFrameLength;
+        bool active;
+        uint8_t data[N2kFastPacket::MAX_DATA_SIZE];
+    };
+
+    static inline uint32_t allFrames(uint8_t frameCount) {
+        return (frameCount >= 32) ? 0xFFFFFFFFUL : ((1UL << frameCount) - 1);
+    }
+
+    static inline void setHeader(N2kMsgArd& message, uint32_t canId) {
+        message.PGN = N2kCanId::pgn(canId);
+        message.Priority = N2kCanId::priority(canId);
+        message.Source = N2kCanId::source(canId);
+        message.Destination = N2kCanId::destination(canId);
+    }
+
+    /**
+     * @return the session of the key, a new one if there is none
+     */
+    Session* findSession(uint32_t pgn, uint8_t source, uint8_t sequenceId, uint32_t nowMs) {
+        Session* freeSession = NULL;
+        Session* oldestSession = NULL;
+        for (uint8_t i = 0; i < N; i++) {
+            Session& session = m_sessions[i];
+            if (session.active && nowMs - session.lastFrameMs > m_timeoutMs) {
+                session.active = false;
+                m_statistics.timedOut++;
+            }
+            if (!session.active) {
+                if (freeSession == NULL) {
+                    freeSession = &session;
+                }
+                continue;
+            }
+            if (session.pgn == pgn && session.source == source && session.sequenceId == sequenceId) {
+                return &session;
+            }
+            if (oldestSession == NULL || nowMs - session.lastFrameMs > nowMs - oldestSession->lastFrameMs) {
+                oldestSession = &session;
+            }
+        }
+
+        if (freeSession == NULL) {
+            freeSession = oldestSession;
+            m_statistics.evicted++;
+        }
+        freeSession->active = true;
+        freeSession->pgn = pgn;
+        freeSession->source = source;
+        freeSession->sequenceId = sequenceId;
+        freeSession->frameMask = 0;
+        freeSession->shortFrame = 0;
+        freeSession->frameCount = N2kFastPacket::MAX_FRAME_COUNT;
+        freeSession->lastFrameMs = nowMs;
+        return freeSession;
+    }
+
+    uint32_t m_timeoutMs;
+    Session m_sessions[N];
+    N2kFastPacketStatistics m_statistics;
+};
+
+/**
+ * Splits a N2kMsgArd into frames, one call to next() per frame:
+ *
+ *   N2kFastPacketFragmenter fragmenter(message, sequenceId++);
+ *   CanMsg frame;
+ *   while (fragmenter.next(frame)) {
+ *       send(frame);
+ *   }
+ *
+ * Messages of single frame PGNs give one frame of DataLen bytes, fast-packet frames
+ * are always 8 bytes long, padded with 0xFF.
+ */
+class N2kFastPacketFragmenter {
+   public:
+    /**
+     * @param message kept by reference, it must outlive the fragmenter
+     * @param sequenceId 0-7, to be incremented by the sender for each message of a PGN
+     */
+    N2kFastPacketFragmenter(const N2kMsgArd& message, uint8_t sequenceId);
+
+    /**
+     * @return false once all frames have been produced, or if DataLen is invalid
+     */
+    bool next(CanMsg& frame);
+
+    uint8_t frameCount() const { return m_frameCount; }
+
+   private:
+    const N2kMsgArd& m_message;
+    uint32_t m_canId;
+    uint8_t m_sequenceId;
+    uint8_t m_dataLength;
+    uint8_t m_frameCount;
+    uint8_t m_nextFrame;
+    bool m_fastPacket;
+};
+
+#endif  // SAILINGROBOT_N2KFASTPACKET_H
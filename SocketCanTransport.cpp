@@ -0,0 +1,266 @@
+/****************************************************************************************
+ *
+ * File:
+ *    SocketCanTransport.cpp
+ *
+ * Purpose:
+ *    Linux SocketCAN adapter sending and receiving CanMsg in batches
+ *
+ * Developer Notes:
+ *    Compiled out on Arduino boards, the Arduino IDE builds every source file of
+ *    the library.
+ *
+ ***************************************************************************************/
+
+#include "canbus_global_defs.h"
+
+#ifndef ON_ARDUINO_BOARD
+
+#include "SocketCanTransport.h"
+#include "CanMessageRegistry.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../../SystemServices/Logger.h"
+
+namespace {
+
+const uint32_t MAX_STANDARD_ID = CAN_SFF_MASK;
+
+inline void canFrameToCanMsg(const struct can_frame& frame, CanMsg& message) {
+    message.id = frame.can_id & ((frame.can_id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+    message.header.ide = (frame.can_id & CAN_EFF_FLAG) ? 1 : 0;
+    message.header.length = frame.can_dlc;
+    memcpy(message.data, frame.data, sizeof(message.data));
+}
+
+inline void canMsgToCanFrame(const CanMsg& message, struct can_frame& frame) {
+    bool extended = message.header.ide || message.id > MAX_STANDARD_ID;
+    frame.can_id = extended ? ((message.id & CAN_EFF_MASK) | CAN_EFF_FLAG) : (message.id & CAN_SFF_MASK);
+    frame.can_dlc = (message.header.length > CAN_MAX_DLEN) ? CAN_MAX_DLEN : message.header.length;
+    memcpy(frame.data, message.data, sizeof(frame.data));
+}
+
+inline struct can_filter makeFilter(uint32_t messageId, uint32_t idMask, bool extended) {
+    struct can_filter filter;
+    if (extended) {
+        filter.can_id = (messageId & CAN_EFF_MASK) | CAN_EFF_FLAG;
+        filter.can_mask = (idMask & CAN_EFF_MASK) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+    } else {
+        filter.can_id = messageId & CAN_SFF_MASK;
+        filter.can_mask = (idMask & CAN_SFF_MASK) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+    }
+    return filter;
+}
+
+}  // namespace
+
+SocketCanTransport::SocketCanTransport() : m_socket(-1), m_kernelTimestamps(false) {
+    memset(m_rxHeaders, 0, sizeof(m_rxHeaders));
+    memset(m_txHeaders, 0, sizeof(m_txHeaders));
+    for (size_t i = 0; i < MAX_BATCH_SIZE; i++) {
+        m_rxVectors[i].iov_base = &m_rxFrames[i];
+        m_rxVectors[i].iov_len = sizeof(struct can_frame);
+        m_rxHeaders[i].msg_hdr.msg_iov = &m_rxVectors[i];
+        m_rxHeaders[i].msg_hdr.msg_iovlen = 1;
+
+        m_txVectors[i].iov_base = &m_txFrames[i];
+        m_txVectors[i].iov_len = sizeof(struct can_frame);
+        m_txHeaders[i].msg_hdr.msg_iov = &m_txVectors[i];
+        m_txHeaders[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+SocketCanTransport::~SocketCanTransport() {
+    close();
+}
+
+bool SocketCanTransport::open(const char* interfaceName, bool kernelTimestamps) {
+    close();
+
+    m_socket = socket(PF_CAN, SOCK_RAW | SOCK_CLOEXEC, CAN_RAW);
+    if (m_socket < 0) {
+        Logger::error("SocketCanTransport::open(): socket() failed: %s", strerror(errno));
+        return false;
+    }
+
+    struct sockaddr_can address;
+    memset(&address, 0, sizeof(address));
+    address.can_family = AF_CAN;
+    address.can_ifindex = static_cast<int>(if_nametoindex(interfaceName));
+    if (address.can_ifindex == 0) {
+        Logger::error("SocketCanTransport::open(): unknown interface %s", interfaceName);
+        close();
+        return false;
+    }
+
+    if (bind(m_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) {
+        Logger::error("SocketCanTransport::open(): bind() on %s failed: %s", interfaceName, strerror(errno));
+        close();
+        return false;
+    }
+
+    m_kernelTimestamps = kernelTimestamps;
+    if (kernelTimestamps) {
+        int enable = 1;
+        if (setsockopt(m_socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0) {
+            Logger::warning("SocketCanTransport::open(): kernel timestamps unavailable: %s", strerror(errno));
+            m_kernelTimestamps = false;
+        }
+    }
+    return true;
+}
+
+void SocketCanTransport::close() {
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+}
+
+bool SocketCanTransport::applyFilters(const struct can_filter* filters, size_t count) {
+    if (setsockopt(m_socket, SOL_CAN_RAW, CAN_RAW_FILTER, filters,
+                   static_cast<socklen_t>(count * sizeof(struct can_filter))) < 0) {
+        Logger::error("SocketCanTransport::setFilters(): setsockopt() failed: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool SocketCanTransport::setFilters(const uint32_t* messageIds, size_t count) {
+    if (count > MAX_FILTERS) {
+        Logger::error("SocketCanTransport::setFilters(): more than %zu filters", MAX_FILTERS);
+        return false;
+    }
+    struct can_filter filters[MAX_FILTERS];
+    for (size_t i = 0; i < count; i++) {
+        bool extended = messageIds[i] > MAX_STANDARD_ID;
+        filters[i] = makeFilter(messageIds[i], extended ? CAN_EFF_MASK : CAN_SFF_MASK, extended);
+    }
+    return applyFilters(filters, count);
+}
+
+bool SocketCanTransport::setFilters(const CanIdRange* ranges, size_t count) {
+    struct can_filter filters[MAX_FILTERS];
+    size_t filterCount = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t first = ranges[i].first;
+        uint64_t last = ranges[i].last;
+        while (first <= last) {
+            bool extended = first > MAX_STANDARD_ID;
+            uint64_t spaceLast = extended ? CAN_EFF_MASK : MAX_STANDARD_ID;
+            uint64_t rangeLast = (last < spaceLast) ? last : spaceLast;
+
+            // Largest aligned power of two block starting at first and ending within the range
+            uint64_t blockSize = 1;
+            while ((first & (blockSize * 2 - 1)) == 0 && first + blockSize * 2 - 1 <= rangeLast) {
+                blockSize *= 2;
+            }
+
+            if (filterCount == MAX_FILTERS) {
+                Logger::error("SocketCanTransport::setFilters(): ranges need more than %zu filters", MAX_FILTERS);
+                return false;
+            }
+            filters[filterCount++] = makeFilter(static_cast<uint32_t>(first),
+                                                static_cast<uint32_t>(~(blockSize - 1)), extended);
+            first += blockSize;
+        }
+    }
+    return applyFilters(filters, filterCount);
+}
+
+bool SocketCanTransport::acceptRegistryIds() {
+    CanIdRange range = {CanMessageRegistry::FIRST_ID, CanMessageRegistry::LAST_ID};
+    return setFilters(&range, 1);
+}
+
+int SocketCanTransport::receive(CanMsg* messages, size_t maxCount, uint64_t* timestampsNs, int timeoutMs) {
+    if (m_socket < 0) {
+        return -1;
+    }
+    if (maxCount > MAX_BATCH_SIZE) {
+        maxCount = MAX_BATCH_SIZE;
+    }
+
+    // recvmmsg() timeout is only checked between frames, so wait with poll() instead
+    struct pollfd pollDescriptor = {m_socket, POLLIN, 0};
+    int ready = poll(&pollDescriptor, 1, timeoutMs);
+    if (ready <= 0) {
+        if (ready < 0 && errno != EINTR) {
+            Logger::error("SocketCanTransport::receive(): poll() failed: %s", strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+
+    for (size_t i = 0; i < maxCount; i++) {
+        if (m_kernelTimestamps) {
+            m_rxHeaders[i].msg_hdr.msg_control = m_rxControl[i];
+            m_rxHeaders[i].msg_hdr.msg_controllen = sizeof(m_rxControl[i]);
+        } else {
+            m_rxHeaders[i].msg_hdr.msg_control = NULL;
+            m_rxHeaders[i].msg_hdr.msg_controllen = 0;
+        }
+    }
+
+    int received = recvmmsg(m_socket, m_rxHeaders, static_cast<unsigned int>(maxCount), MSG_DONTWAIT, NULL);
+    if (received < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        Logger::error("SocketCanTransport::receive(): recvmmsg() failed: %s", strerror(errno));
+        return -1;
+    }
+
+    for (int i = 0; i < received; i++) {
+        canFrameToCanMsg(m_rxFrames[i], messages[i]);
+
+        if (timestampsNs) {
+            timestampsNs[i] = 0;
+            if (m_kernelTimestamps) {
+                for (struct cmsghdr* control = CMSG_FIRSTHDR(&m_rxHeaders[i].msg_hdr); control != NULL;
+                     control = CMSG_NXTHDR(&m_rxHeaders[i].msg_hdr, control)) {
+                    if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SCM_TIMESTAMPNS) {
+                        struct timespec stamp;
+                        memcpy(&stamp, CMSG_DATA(control), sizeof(stamp));
+                        timestampsNs[i] = static_cast<uint64_t>(stamp.tv_sec) * 1000000000ULL +
+                                          static_cast<uint64_t>(stamp.tv_nsec);
+                    }
+                }
+            }
+        }
+    }
+    return received;
+}
+
+int SocketCanTransport::send(const CanMsg* messages, size_t count) {
+    if (m_socket < 0) {
+        return -1;
+    }
+    if (count > MAX_BATCH_SIZE) {
+        count = MAX_BATCH_SIZE;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        canMsgToCanFrame(messages[i], m_txFrames[i]);
+    }
+
+    int sent = sendmmsg(m_socket, m_txHeaders, static_cast<unsigned int>(count), 0);
+    if (sent < 0) {
+        if (errno == EAGAIN || errno == ENOBUFS || errno == EINTR) {
+            return 0;  // the interface queue is full, the caller retries later
+        }
+        Logger::error("SocketCanTransport::send(): sendmmsg() failed: %s", strerror(errno));
+        return -1;
+    }
+    return sent;
+}
+
+#endif  // ON_ARDUINO_BOARD
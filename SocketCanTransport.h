@@ -0,0 +1,134 @@
+/****************************************************************************************
+ *
+ * File:
+ *    SocketCanTransport.h
+ *
+ * Purpose:
+ *    Linux SocketCAN adapter sending and receiving CanMsg in batches, one recvmmsg()
+ *    or sendmmsg() system call per batch instead of one read()/write() per frame.
+ *
+ * Developer Notes:
+ *    RPI (Linux) only.
+ *
+ *    All kernel buffers are allocated with the object, nothing is allocated while
+ *    sending or receiving. Frames are converted between struct can_frame and CanMsg
+ *    in place of the hand written conversions of each process.
+ *
+ *    To try it without hardware, use a virtual interface:
+ *      sudo modprobe vcan
+ *      sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_SOCKETCANTRANSPORT_H
+#define SAILINGROBOT_SOCKETCANTRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "canbus_defs.h"
+
+#ifdef ON_ARDUINO_BOARD
+ #error "SocketCanTransport.h is only available on the RPI"
+#endif
+
+#include <linux/can.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+
+/**
+ * Inclusive range of message ids accepted by the kernel filters
+ */
+struct CanIdRange {
+    uint32_t first;
+    uint32_t last;
+};
+
+class SocketCanTransport {
+   public:
+    static const size_t MAX_BATCH_SIZE = 64;
+    static const size_t MAX_FILTERS = 64;
+
+    SocketCanTransport();
+    ~SocketCanTransport();
+
+    SocketCanTransport(const SocketCanTransport&) = delete;
+    SocketCanTransport& operator=(const SocketCanTransport&) = delete;
+
+    /**
+     * Opens a raw CAN socket bound to an interface
+     *
+     * @param interfaceName e.g. "can0" or "vcan0"
+     * @param kernelTimestamps if true, receive() can return the kernel receive time
+     * @return false on failure, the reason is logged
+     */
+    bool open(const char* interfaceName, bool kernelTimestamps = false);
+
+    void close();
+
+    bool isOpen() const { return m_socket >= 0; }
+
+    /**
+     * Only lets the given ids through the kernel, standard or extended depending
+     * on the id value
+     *
+     * @return false if the filters could not be set
+     */
+    bool setFilters(const uint32_t* messageIds, size_t count);
+
+    /**
+     * Only lets ids within the given ranges through the kernel. Each range is split
+     * into aligned id/mask filters, MAX_FILTERS at most in total.
+     *
+     * @return false if the filters could not be set or there are too many of them
+     */
+    bool setFilters(const CanIdRange* ranges, size_t count);
+
+    /**
+     * Only lets the ids of CanMessageRegistry through the kernel
+     */
+    bool acceptRegistryIds();
+
+    /**
+     * Receives up to maxCount frames with a single system call
+     *
+     * @param messages output array
+     * @param maxCount clamped to MAX_BATCH_SIZE
+     * @param timestampsNs optional output array, kernel receive time (CLOCK_REALTIME)
+     *                     if the socket was opened with kernelTimestamps, 0 otherwise
+     * @param timeoutMs time to wait for the first frame, -1 waits forever, 0 does not wait
+     * @return the number of frames received, 0 on timeout, -1 on error
+     */
+    int receive(CanMsg* messages, size_t maxCount, uint64_t* timestampsNs = NULL, int timeoutMs = -1);
+
+    /**
+     * Sends up to count frames with a single system call
+     *
+     * @param count clamped to MAX_BATCH_SIZE
+     * @return the number of frames sent, -1 on error
+     */
+    int send(const CanMsg* messages, size_t count);
+
+    /**
+     * For integration into an existing poll()/epoll loop
+     */
+    int fileDescriptor() const { return m_socket; }
+
+   private:
+    bool applyFilters(const struct can_filter* filters, size_t count);
+
+    int m_socket;
+    bool m_kernelTimestamps;
+
+    struct can_frame m_rxFrames[MAX_BATCH_SIZE];
+    struct iovec m_rxVectors[MAX_BATCH_SIZE];
+    struct mmsghdr m_rxHeaders[MAX_BATCH_SIZE];
+    char m_rxControl[MAX_BATCH_SIZE][CMSG_SPACE(sizeof(struct timespec))];
+
+    struct can_frame m_txFrames[MAX_BATCH_SIZE];
+    struct iovec m_txVectors[MAX_BATCH_SIZE];
+    struct mmsghdr m_txHeaders[MAX_BATCH_SIZE];
+};
+
+#endif  // SAILINGROBOT_SOCKETCANTRANSPORT_H
@@ -0,0 +1,183 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanBitFieldAvrBenchmark.cpp
+ *
+ * Purpose:
+ *    Cost per field of the byte-wise codec (CanBitField.h) and of the payload word
+ *    path (CanField in CanMessageSchema.h) on an Arduino UNO (ATmega328P, 16 MHz):
+ *    one noinline get and set function per field and codec, so that avr-nm gives their
+ *    flash size and -fstack-usage their SRAM, and a Timer1 loop counting their cycles.
+ *
+ *    Build and measure with benchmark/avr_field_costs.sh. The cycles are printed as
+ *    CSV on the serial port at 115200 bauds, by simavr or by an UNO flashed with the
+ *    .hex: field,bits,bytewise_get,bytewise_set,word_get,word_set
+ *
+ * Developer Notes:
+ *    Bare metal, avr-libc only: no Arduino core, so that only the codec is measured.
+ *    The cycles are the median of RUNS calls minus the cost of calling an empty
+ *    function, with interrupts off.
+ *
+ ***************************************************************************************/
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include <stdint.h>
+
+#include "../CanBitField.h"
+#include "../CanMessageSchema.h"
+
+#define NOINLINE __attribute__((noinline))
+
+// Every bit-indexed field of canbus_datamappings_defs.h
+#define CANBUS_AVR_FIELDS              \
+    FIELD(SENSOR_PH)                   \
+    FIELD(SENSOR_CONDUCTIVETY)         \
+    FIELD(SENSOR_TEMPERATURE)          \
+    FIELD(SENSOR_ERROR)                \
+    FIELD(RUDDER_ANGLE)                \
+    FIELD(WINGSAIL_ANGLE)              \
+    FIELD(WINDVANE_SELFSTEERING_ANGLE) \
+    FIELD(WINDVANE_ACTUATOR_POSITION)  \
+    FIELD(WINDVANE_SELFSTEERING_ON)    \
+    FIELD(RADIOCONTROLLER_ON)          \
+    FIELD(CURRENT_SENSOR_CURRENT)      \
+    FIELD(CURRENT_SENSOR_VOLTAGE)      \
+    FIELD(CURRENT_SENSOR_ID)           \
+    FIELD(CURRENT_SENSOR_ROL_NUM)      \
+    FIELD(CURRENT_SENSOR_ERROR)
+
+namespace {
+
+const uint8_t RUNS = 9;
+
+/**
+ * Value type of CanBitField for a field
+ */
+template <uint32_t LENGTH>
+struct BitFieldValue {
+    typedef typename CanFieldValue<(LENGTH <= 32) ? 32 : 64>::type type;
+};
+
+uint8_t g_data[CanPayload::PAYLOAD_SIZE_IN_BYTES];
+volatile uint64_t g_sink;
+
+#define FIELD(NAME)                                                                                   \
+    NOINLINE void bytewiseGet_##NAME() {                                                              \
+        typedef CAN_FIELD(NAME) Field;                                                                \
+        g_sink = CanBitField::get<BitFieldValue<Field::LENGTH>::type>(g_data, Field::START_BIT,       \
+                                                                      Field::LENGTH);                 \
+    }                                                                                                 \
+    NOINLINE void bytewiseSet_##NAME() {                                                              \
+        typedef CAN_FIELD(NAME) Field;                                                                \
+        CanBitField::set<BitFieldValue<Field::LENGTH>::type>(                                         \
+            g_data, Field::START_BIT, Field::LENGTH,                                                  \
+            static_cast<BitFieldValue<Field::LENGTH>::type>(g_sink));                                 \
+    }                                                                                                 \
+    NOINLINE void wordGet_##NAME() {                                                                  \
+        typedef CAN_FIELD(NAME) Field;                                                                \
+        g_sink = Field::get(CanPayload::load(g_data));                                                \
+    }                                                                                                 \
+    NOINLINE void wordSet_##NAME() {                                                                  \
+        typedef CAN_FIELD(NAME) Field;                                                                \
+        CanPayload::store(Field::set(CanPayload::load(g_data), g_sink), g_data);                      \
+    }
+CANBUS_AVR_FIELDS
+#undef FIELD
+
+NOINLINE void empty() {
+    __asm__ __volatile__("" ::: "memory");
+}
+
+void serialBegin() {
+    // 115200 bauds at 16 MHz, double speed
+    UCSR0A = _BV(U2X0);
+    UBRR0 = 16;
+    UCSR0B = _BV(TXEN0);
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+}
+
+void serialWrite(char c) {
+    while (!(UCSR0A & _BV(UDRE0))) {
+    }
+    UCSR0A = _BV(U2X0) | _BV(TXC0);  // TXC0 cleared, set again once c is sent
+    UDR0 = c;
+}
+
+void serialPrint(const char* text) {
+    while (*text) {
+        serialWrite(*text++);
+    }
+}
+
+void serialPrint(uint32_t value) {
+    char digits[10];
+    uint8_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (count > 0) {
+        serialWrite(digits[--count]);
+    }
+}
+
+/**
+ * @return Timer1 cycles of one call, median of RUNS
+ */
+uint16_t cycles(void (*function)()) {
+    uint16_t samples[RUNS];
+    for (uint8_t run = 0; run < RUNS; run++) {
+        for (uint8_t i = 0; i < sizeof(g_data); i++) {
+            g_data[i] = static_cast<uint8_t>(0xA5 + 37 * (i + run));
+        }
+        g_sink = 0x0123456789ABCDEFULL * (run + 1);
+        uint16_t start = TCNT1;
+        function();
+        uint16_t end = TCNT1;
+        samples[run] = static_cast<uint16_t>(end - start);
+    }
+    for (uint8_t i = 1; i < RUNS; i++) {
+        for (uint8_t j = i; j > 0 && samples[j - 1] > samples[j]; j--) {
+            uint16_t sample = samples[j];
+            samples[j] = samples[j - 1];
+            samples[j - 1] = sample;
+        }
+    }
+    return samples[RUNS / 2];
+}
+
+void printCycles(uint16_t measured, uint16_t overhead) {
+    serialWrite(',');
+    serialPrint(static_cast<uint32_t>(measured > overhead ? measured - overhead : 0));
+}
+
+}  // namespace
+
+int main() {
+    cli();
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);  // CPU clock, no prescaler
+    serialBegin();
+
+    uint16_t overhead = cycles(empty);
+    serialPrint("field,bits,bytewise_get,bytewise_set,word_get,word_set\r\n");
+#define FIELD(NAME)                                              \
+    serialPrint(#NAME ",");                                      \
+    serialPrint(static_cast<uint32_t>(CAN_FIELD(NAME)::LENGTH)); \
+    printCycles(cycles(bytewiseGet_##NAME), overhead);           \
+    printCycles(cycles(bytewiseSet_##NAME), overhead);           \
+    printCycles(cycles(wordGet_##NAME), overhead);               \
+    printCycles(cycles(wordSet_##NAME), overhead);               \
+    serialPrint("\r\n");
+    CANBUS_AVR_FIELDS
+#undef FIELD
+
+    // Last byte out, then sleep with interrupts off: simavr stops there
+    while (!(UCSR0A & _BV(TXC0))) {
+    }
+    sleep_enable();
+    sleep_cpu();
+    return 0;
+}
@@ -0,0 +1,393 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanCodecBenchmark.cpp
+ *
+ * Purpose:
+ *    Micro-benchmarks of the encode/decode, mapping and Float16 paths, run on the RPI
+ *    or any Linux host. No bus, network or external service is needed.
+ *
+ *    Reports ns/op and frames/s (ops/s for the non-frame cases). With --json every
+ *    result is printed as one JSON object per line, so runs can be compared from one
+ *    release to the next.
+ *
+ * Developer Notes:
+ *    Built by the CMakeLists.txt of the repository, with a Logger stub outside of the
+ *    SailingRobot tree:
+ *      cmake -S .. -B ../build && cmake --build ../build --target CanCodecBenchmark
+ *
+ *    Add -DCMAKE_CXX_FLAGS=-DCANBUS_BYTEWISE_CODEC=1 to time the handler with the
+ *    Arduino codec.
+ *
+ *    Usage: CanCodecBenchmark [--json] [--iterations N]
+ *
+ ***************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "../CanBatchDecoder.h"
+#include "../CanBitField.h"
+#include "../CanFixedPointMapping.h"
+#include "../CanMessageHandler.h"
+#include "../CanMessageSchema.h"
+#include "../CanMessageView.h"
+#include "../CanUtility.h"
+#include "../Float16Compressor.h"
+
+namespace {
+
+const size_t FRAME_POOL_SIZE = 4096;
+const size_t FLOAT16_ARRAY_SIZE = 1 << 20;
+
+volatile uint64_t g_sink;  // keeps the compiler from dropping the measured work
+
+bool g_jsonOutput = false;
+size_t g_iterations = 1000000;
+
+struct FieldCase {
+    const char* name;
+    uint32_t start;
+    uint32_t length;
+    bool inByte;
+    long int intervalMin;
+    long int intervalMax;
+    bool mapped;
+};
+
+const FieldCase FIELD_CASES[] = {
+    {"SENSOR_PH", SENSOR_PH_START, SENSOR_PH_DATASIZE, SENSOR_PH_IN_BYTE,
+     SENSOR_PH_INTERVAL_MIN, SENSOR_PH_INTERVAL_MAX, true},
+    {"SENSOR_CONDUCTIVETY", SENSOR_CONDUCTIVETY_START, SENSOR_CONDUCTIVETY_DATASIZE,
+     SENSOR_CONDUCTIVETY_IN_BYTE, SENSOR_CONDUCTIVETY_INTERVAL_MIN,
+     SENSOR_CONDUCTIVETY_INTERVAL_MAX, true},
+    {"SENSOR_TEMPERATURE", SENSOR_TEMPERATURE_START, SENSOR_TEMPERATURE_DATASIZE,
+     SENSOR_TEMPERATURE_IN_BYTE, SENSOR_TEMPERATURE_INTERVAL_MIN,
+     SENSOR_TEMPERATURE_INTERVAL_MAX, true},
+    {"SENSOR_ERROR", SENSOR_ERROR_START, SENSOR_ERROR_DATASIZE, SENSOR_ERROR_IN_BYTE, 0, 0, false},
+    {"RUDDER_ANGLE", RUDDER_ANGLE_START, RUDDER_ANGLE_DATASIZE, RUDDER_ANGLE_IN_BYTE,
+     MIN_RUDDER_ANGLE, MAX_RUDDER_ANGLE, true},
+    {"WINGSAIL_ANGLE", WINGSAIL_ANGLE_START, WINGSAIL_ANGLE_DATASIZE, WINGSAIL_ANGLE_IN_BYTE,
+     MIN_WINGSAIL_ANGLE, MAX_WINGSAIL_ANGLE, true},
+    {"WINDVANE_SELFSTEERING_ANGLE", WINDVANE_SELFSTEERING_ANGLE_START,
+     WINDVANE_SELFSTEERING_ANGLE_DATASIZE, WINDVANE_SELFSTEERING_ANGLE_IN_BYTE,
+     WINDVANE_SELFSTEERING_ANGLE_MIN, WINDVANE_SELFSTEERING_ANGLE_MAX, true},
+    {"WINDVANE_ACTUATOR_POSITION", WINDVANE_ACTUATOR_POSITION_START,
+     WINDVANE_ACTUATOR_POSITION_DATASIZE, WINDVANE_ACTUATOR_POSITION_IN_BYTE != 0, 0, 0, false},
+    {"WINDVANE_SELFSTEERING_ON", WINDVANE_SELFSTEERING_ON_START, WINDVANE_SELFSTEERING_ON_DATASIZE,
+     WINDVANE_SELFSTEERING_ON_IN_BYTE, 0, 0, false},
+    {"RADIOCONTROLLER_ON", RADIOCONTROLLER_ON_START, RADIOCONTROLLER_ON_DATASIZE,
+     RADIOCONTROLLER_ON_IN_BYTE != 0, 0, 0, false},
+    {"CURRENT_SENSOR_CURRENT", CURRENT_SENSOR_CURRENT_START, CURRENT_SENSOR_CURRENT_DATASIZE,
+     CURRENT_SENSOR_CURRENT_IN_BYTE, 0, 0, false},
+    {"CURRENT_SENSOR_VOLTAGE", CURRENT_SENSOR_VOLTAGE_START, CURRENT_SENSOR_VOLTAGE_DATASIZE,
+     CURRENT_SENSOR_VOLTAGE_IN_BYTE, 0, 0, false},
+    {"CURRENT_SENSOR_ID", CURRENT_SENSOR_ID_START, CURRENT_SENSOR_ID_DATASIZE,
+     CURRENT_SENSOR_ID_IN_BYTE, 0, 0, false},
+    {"CURRENT_SENSOR_ROL_NUM", CURRENT_SENSOR_ROL_NUM_START, CURRENT_SENSOR_ROL_NUM_DATASIZE,
+     CURRENT_SENSOR_ROL_NUM_IN_BYTE, 0, 0, false},
+    {"CURRENT_SENSOR_ERROR", CURRENT_SENSOR_ERROR_START, CURRENT_SENSOR_ERROR_DATASIZE,
+     CURRENT_SENSOR_ERROR_IN_BYTE, 0, 0, false},
+};
+
+std::vector<CanMsg> g_frames;
+
+uint32_t nextRandom() {
+    static uint32_t state = 0x12345678;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void fillFramePool() {
+    g_frames.resize(FRAME_POOL_SIZE);
+    for (size_t i = 0; i < FRAME_POOL_SIZE; i++) {
+        g_frames[i].id = MSG_ID_MARINE_SENSOR_DATA;
+        g_frames[i].header.ide = 0;
+        g_frames[i].header.length = 8;
+        for (int b = 0; b < 8; b++) {
+            g_frames[i].data[b] = static_cast<uint8_t>(nextRandom());
+        }
+    }
+}
+
+void report(const char* group, const char* name, size_t operations, double elapsedNs) {
+    double nsPerOp = elapsedNs / static_cast<double>(operations);
+    double opsPerSecond = nsPerOp > 0 ? 1e9 / nsPerOp : 0;
+    if (g_jsonOutput) {
+        printf("{\"group\":\"%s\",\"name\":\"%s\",\"operations\":%zu,\"ns_per_op\":%.3f,"
+               "\"ops_per_s\":%.0f}\n",
+               group, name, operations, nsPerOp, opsPerSecond);
+    } else {
+        printf("%-28s %-32s %10.2f ns/op %14.0f /s\n", group, name, nsPerOp, opsPerSecond);
+    }
+}
+
+/**
+ * Runs f(i) for i in [0, operations) and reports the mean time per call
+ */
+template <class F>
+void run(const char* group, const char* name, size_t operations, F f) {
+    // Warm up caches and branch predictors
+    for (size_t i = 0; i < operations / 10 + 1; i++) {
+        f(i);
+    }
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < operations; i++) {
+        f(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    report(group, name, operations,
+           static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()));
+}
+
+/**
+ * Runs f() repeats times, f() handling elements items per call, and reports the mean
+ * time per item
+ */
+template <class F>
+void runBatch(const char* group, const char* name, size_t elements, size_t repeats, F f) {
+    f();
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < repeats; i++) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    report(group, name, elements * repeats,
+           static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()));
+}
+
+void benchmarkBitIndexedFields() {
+    for (const FieldCase& field : FIELD_CASES) {
+        run("encode_bit_indexed", field.name, g_iterations, [&field](size_t i) {
+            CanMessageHandler handler(MSG_ID_MARINE_SENSOR_DATA);
+            handler.encodeMessage(static_cast<uint64_t>(i), field.start, field.length, field.inByte);
+            g_sink = g_sink + handler.getMessage().data[0];
+        });
+        run("decode_bit_indexed", field.name, g_iterations, [&field](size_t i) {
+            CanMessageHandler handler(g_frames[i % FRAME_POOL_SIZE]);
+            uint64_t value;
+            handler.getData(&value, field.start, field.length, field.inByte);
+            g_sink = g_sink + value;
+        });
+        if (field.mapped) {
+            run("decode_mapped_bit_indexed", field.name, g_iterations, [&field](size_t i) {
+                CanMessageHandler handler(g_frames[i % FRAME_POOL_SIZE]);
+                float value;
+                handler.getMappedData(&value, field.start, field.length, field.inByte,
+                                      field.intervalMin, field.intervalMax);
+                g_sink = g_sink + static_cast<uint64_t>(value);
+            });
+            CanFixedPointMapper mapper(field.intervalMin, field.intervalMax,
+                                       static_cast<uint8_t>(field.inByte ? field.length * 8 : field.length));
+            run("decode_fixed_bit_indexed", field.name, g_iterations, [&field, &mapper](size_t i) {
+                CanMessageHandler handler(g_frames[i % FRAME_POOL_SIZE]);
+                float value;
+                handler.getMappedData(&value, field.start, field.length, field.inByte, mapper);
+                g_sink = g_sink + static_cast<uint64_t>(value);
+            });
+        }
+    }
+}
+
+void benchmarkBitFieldCodec() {
+    for (const FieldCase& field : FIELD_CASES) {
+        uint8_t start = static_cast<uint8_t>(field.inByte ? field.start * 8 : field.start);
+        uint8_t length = static_cast<uint8_t>(field.inByte ? field.length * 8 : field.length);
+        run("decode_bytewise", field.name, g_iterations, [start, length](size_t i) {
+            g_sink = g_sink + CanBitField::get<uint32_t>(g_frames[i % FRAME_POOL_SIZE].data, start, length);
+        });
+        run("encode_bytewise", field.name, g_iterations, [start, length](size_t i) {
+            CanMsg& frame = g_frames[i % FRAME_POOL_SIZE];
+            CanBitField::set<uint32_t>(frame.data, start, length, static_cast<uint32_t>(i));
+            g_sink = g_sink + frame.data[i % 8];
+        });
+    }
+}
+
+void benchmarkMessageView() {
+    for (const FieldCase& field : FIELD_CASES) {
+        run("decode_view", field.name, g_iterations, [&field](size_t i) {
+            CanMessageView view(g_frames[i % FRAME_POOL_SIZE]);
+            uint64_t value;
+            view.getData(&value, field.start, field.length, field.inByte);
+            g_sink = g_sink + value;
+        });
+        run("encode_view", field.name, g_iterations, [&field](size_t i) {
+            CanMsg& frame = g_frames[i % FRAME_POOL_SIZE];
+            CanMessageEncoder encoder(frame);
+            encoder.encodeMessage(static_cast<uint64_t>(i), field.start, field.length, field.inByte);
+            g_sink = g_sink + frame.data[i % 8];
+        });
+    }
+}
+
+void benchmarkByteIndexedFields() {
+    for (const FieldCase& field : FIELD_CASES) {
+        if (!field.inByte || field.length > 4) {
+            continue;  // the byte-indexed API only handles whole bytes, up to 4 of them
+        }
+        int lengthInBytes = static_cast<int>(field.length);
+        run("encode_byte_indexed", field.name, g_iterations, [lengthInBytes](size_t i) {
+            CanMessageHandler handler(MSG_ID_MARINE_SENSOR_DATA);
+            handler.encodeMessage(lengthInBytes, static_cast<uint32_t>(i));
+            g_sink = g_sink + handler.getMessage().data[0];
+        });
+        run("decode_byte_indexed", field.name, g_iterations, [lengthInBytes](size_t i) {
+            CanMessageHandler handler(g_frames[i % FRAME_POOL_SIZE]);
+            uint32_t value;
+            handler.getData(&value, lengthInBytes);
+            g_sink = g_sink + value;
+        });
+    }
+}
+
+void benchmarkTypedMessages() {
+    run("decode_typed", "MarineSensorData", g_iterations, [](size_t i) {
+        MarineSensorData data = MarineSensorData::fromMessage(g_frames[i % FRAME_POOL_SIZE]);
+        g_sink = g_sink + data.ph + data.conductivity + data.temperature + data.error;
+    });
+    run("encode_typed", "MarineSensorData", g_iterations, [](size_t i) {
+        MarineSensorData data = {static_cast<uint8_t>(i), static_cast<uint32_t>(i),
+                                 static_cast<uint16_t>(i), 0};
+        g_sink = g_sink + data.toMessage().data[3];
+    });
+    run("decode_typed", "CurrentSensorData", g_iterations, [](size_t i) {
+        CurrentSensorData data = CurrentSensorData::fromMessage(g_frames[i % FRAME_POOL_SIZE]);
+        g_sink = g_sink + data.voltage + data.current + data.sensorId + data.rollingNumber;
+    });
+    run("decode_typed", "AuFeedback", g_iterations, [](size_t i) {
+        AuFeedback data = AuFeedback::fromMessage(g_frames[i % FRAME_POOL_SIZE]);
+        g_sink = g_sink + data.rudder + data.wingsail + data.windvaneSelfSteeringAngle;
+    });
+}
+
+void benchmarkBatchDecoder() {
+    std::vector<uint8_t> ph(FRAME_POOL_SIZE), error(FRAME_POOL_SIZE), sensorId(FRAME_POOL_SIZE),
+        rollingNumber(FRAME_POOL_SIZE);
+    std::vector<uint32_t> conductivity(FRAME_POOL_SIZE);
+    std::vector<uint16_t> temperature(FRAME_POOL_SIZE);
+    std::vector<float> voltage(FRAME_POOL_SIZE), current(FRAME_POOL_SIZE), mapped(FRAME_POOL_SIZE);
+
+    MarineSensorColumns marineColumns = {ph.data(), conductivity.data(), temperature.data(), error.data()};
+    CurrentSensorColumns currentColumns = {voltage.data(), current.data(), error.data(),
+                                           rollingNumber.data(), sensorId.data()};
+    size_t repeats = g_iterations / FRAME_POOL_SIZE + 1;
+
+    runBatch("decode_batch", "MarineSensorData", FRAME_POOL_SIZE, repeats, [&]() {
+        CanBatchDecoder::decode(g_frames.data(), FRAME_POOL_SIZE, marineColumns);
+    });
+    runBatch("decode_batch", "CurrentSensorData", FRAME_POOL_SIZE, repeats, [&]() {
+        CanBatchDecoder::decode(g_frames.data(), FRAME_POOL_SIZE, currentColumns);
+    });
+    runBatch("decode_batch", "SENSOR_TEMPERATURE mapped", FRAME_POOL_SIZE, repeats, [&]() {
+        CanBatchDecoder::decodeMappedColumn<CAN_FIELD(SENSOR_TEMPERATURE)>(
+            g_frames.data(), FRAME_POOL_SIZE, mapped.data(), SENSOR_TEMPERATURE_INTERVAL_MIN,
+            SENSOR_TEMPERATURE_INTERVAL_MAX);
+    });
+    g_sink = g_sink + ph[1] + sensorId[2] + static_cast<uint64_t>(mapped[3]);
+}
+
+void benchmarkConversions() {
+    run("conversion", "canMsgToBitset+bitsetToCanMsg", g_iterations, [](size_t i) {
+        CanMessageHandler handler(g_frames[i % FRAME_POOL_SIZE]);
+        handler.canMsgToBitset();
+        handler.bitsetToCanMsg();
+        g_sink = g_sink + handler.getMessage().data[i % 8];
+    });
+    run("conversion", "getMessageInBitset", g_iterations, [](size_t i) {
+        CanMessageHandler handler(g_frames[i % FRAME_POOL_SIZE]);
+        g_sink = g_sink + handler.getMessageInBitset().count();
+    });
+}
+
+void benchmarkMapping() {
+    run("mapping", "CanUtility::mapInterval", g_iterations, [](size_t i) {
+        g_sink = g_sink + static_cast<uint64_t>(
+            CanUtility::mapInterval(static_cast<float>(i & 0xFFFF), 0, 65535, -5, 40) + 5);
+    });
+    run("mapping", "CanUtility::calcSizeOfBytes", g_iterations, [](size_t i) {
+        g_sink = g_sink + CanUtility::calcSizeOfBytes(static_cast<int>(i & 3) + 1);
+    });
+    run("frame_bits", "CanUtility::exactFrameBits", g_iterations, [](size_t i) {
+        const CanMsg& frame = g_frames[i % FRAME_POOL_SIZE];
+        g_sink = g_sink + CanUtility::exactFrameBits(frame.id, frame.header.ide != 0, frame.data, frame.header.length);
+    });
+
+    typedef CanFixedPointMapping<SENSOR_TEMPERATURE_INTERVAL_MIN, SENSOR_TEMPERATURE_INTERVAL_MAX, 16>
+        TemperatureMapping;
+    const CanFixedPointMapper temperatureMapper(SENSOR_TEMPERATURE_INTERVAL_MIN, SENSOR_TEMPERATURE_INTERVAL_MAX, 16);
+    run("mapping", "CanFixedPointMapping::encodeFloat", g_iterations, [](size_t i) {
+        g_sink = g_sink + TemperatureMapping::encodeFloat(static_cast<float>(i & 0xFFFF) / 1456.0f - 5);
+    });
+    run("mapping", "CanFixedPointMapping::decodeFloat", g_iterations, [](size_t i) {
+        g_sink = g_sink + static_cast<uint64_t>(TemperatureMapping::decodeFloat(static_cast<uint32_t>(i & 0xFFFF)) + 5);
+    });
+    run("mapping", "CanFixedPointMapper::encode", g_iterations, [&temperatureMapper](size_t i) {
+        g_sink = g_sink + temperatureMapper.encode(static_cast<long>(i % 45) - 5);
+    });
+    run("mapping", "CanFixedPointMapper::decodeFloat", g_iterations, [&temperatureMapper](size_t i) {
+        g_sink = g_sink + static_cast<uint64_t>(temperatureMapper.decodeFloat(static_cast<uint32_t>(i & 0xFFFF)) + 5);
+    });
+}
+
+void benchmarkFloat16() {
+    std::vector<float> floats(FLOAT16_ARRAY_SIZE);
+    std::vector<uint16_t> halves(FLOAT16_ARRAY_SIZE);
+    for (size_t i = 0; i < FLOAT16_ARRAY_SIZE; i++) {
+        floats[i] = static_cast<float>(static_cast<int32_t>(nextRandom() % 200000) - 100000) / 1000.0f;
+    }
+
+    run("float16_scalar", "compress", FLOAT16_ARRAY_SIZE, [&](size_t i) {
+        halves[i] = Float16Compressor::compress(floats[i]);
+    });
+    run("float16_scalar", "decompress", FLOAT16_ARRAY_SIZE, [&](size_t i) {
+        floats[i] = Float16Compressor::decompress(halves[i]);
+    });
+    runBatch("float16_batch", "compress", FLOAT16_ARRAY_SIZE, 16, [&]() {
+        Float16Compressor::compress(floats.data(), halves.data(), FLOAT16_ARRAY_SIZE);
+    });
+    runBatch("float16_batch", "decompress", FLOAT16_ARRAY_SIZE, 16, [&]() {
+        Float16Compressor::decompress(halves.data(), floats.data(), FLOAT16_ARRAY_SIZE);
+    });
+    g_sink = g_sink + halves[FLOAT16_ARRAY_SIZE / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            g_jsonOutput = true;
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            char* end;
+            g_iterations = strtoul(argv[++i], &end, 10);
+            if (*end != '\0' || g_iterations == 0) {
+                fprintf(stderr, "%s: --iterations must be a positive integer\n", argv[0]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [--json] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    fillFramePool();
+
+    benchmarkBitIndexedFields();
+    benchmarkBitFieldCodec();
+    benchmarkMessageView();
+    benchmarkByteIndexedFields();
+    benchmarkTypedMessages();
+    benchmarkBatchDecoder();
+    benchmarkConversions();
+    benchmarkMapping();
+    benchmarkFloat16();
+
+    return 0;
+}
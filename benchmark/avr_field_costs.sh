@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# Flash, stack and cycles of each field with the byte-wise codec (CanBitField.h) and
+# the payload word path, on an Arduino UNO (ATmega328P, 16 MHz).
+#
+#   benchmark/avr_field_costs.sh [build directory]
+#
+# Needs avr-g++, avr-libc and binutils-avr (the Arduino IDE has them in
+# hardware/tools/avr/bin, put it in PATH). The cycles need simavr; without it, flash
+# build/CanBitFieldAvrBenchmark.hex on an UNO and read the serial port at 115200 bauds.
+#
+# Compiled with the flags of the Arduino IDE, without -flto so that every function
+# keeps its own size and stack usage.
+
+set -e
+
+SOURCE_DIR=$(cd "$(dirname "$0")/.." && pwd)
+BUILD_DIR=${1:-"$SOURCE_DIR/_avr_build"}
+CXX=${AVR_CXX:-avr-g++}
+MCU=atmega328p
+
+mkdir -p "$BUILD_DIR"
+cd "$BUILD_DIR"
+
+"$CXX" -mmcu=$MCU -DF_CPU=16000000UL -DARDUINO_AVR_UNO -Os -std=gnu++11 -fno-exceptions \
+    -fno-threadsafe-statics -ffunction-sections -fdata-sections -fstack-usage -Wall -Wextra \
+    -Wl,--gc-sections -o CanBitFieldAvrBenchmark.elf "$SOURCE_DIR/benchmark/CanBitFieldAvrBenchmark.cpp"
+avr-objcopy -O ihex -R .eeprom CanBitFieldAvrBenchmark.elf CanBitFieldAvrBenchmark.hex
+avr-objdump -d -C CanBitFieldAvrBenchmark.elf > CanBitFieldAvrBenchmark.lst
+
+echo "Whole program (avr-size):"
+avr-size -C --mcu=$MCU CanBitFieldAvrBenchmark.elf
+
+# Function sizes from the symbol table, stack from the .su file of the compiler
+echo
+echo "field,function,flash_bytes,stack_bytes"
+avr-nm -S -C CanBitFieldAvrBenchmark.elf |
+    awk '$3 ~ /^[tT]$/ && match($0, /::(bytewise|word)(Get|Set)_[A-Z_]+/) {
+             print substr($0, RSTART + 2, RLENGTH - 2), $2
+         }' |
+    while read -r function size; do
+        size=$((0x$size))
+        field=${function#*_}
+        stack=$(awk -v f="$function" '$0 ~ "::" f "\\(" { print $(NF - 1) }' CanBitFieldAvrBenchmark*.su | head -n 1)
+        echo "$field,${function%%_*},$size,${stack:-?}"
+    done | sort
+
+echo
+if command -v simavr > /dev/null; then
+    echo "Cycles (simavr, median of 9 calls):"
+    simavr -m $MCU -f 16000000 CanBitFieldAvrBenchmark.elf 2>&1 | tr -d '\r'
+else
+    echo "simavr not found: flash CanBitFieldAvrBenchmark.hex for the cycles"
+fi
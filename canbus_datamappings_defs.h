@@ -53,6 +53,18 @@ const int REQUEST_CONTINOUS_READINGS_DATASIZE = 1;
 const int REQUEST_READING_TIME_DATASIZE = 4;
 //-----------------------------------------------------------
 
+// Used by solar panel control messages, in bytes in this order
+const int SOLAR_PANEL_LATITUDE_DATASIZE = 4;
+const int SOLAR_PANEL_LONGITUDE_DATASIZE = 4;
+
+const int SOLAR_PANEL_TIME_DATASIZE = 4;
+const int SOLAR_PANEL_HEADING_DATASIZE = 4;
+//-----------------------------------------------------------
+
+// Used by winch control and winch feedback messages
+const int WINCH_EXTENDED_LENGTH_DATASIZE = 2;
+//-----------------------------------------------------------
+
 // Used by AU Control and AU Feedback messages
 /**
  * Rudder should go from -30 to +30 degrees
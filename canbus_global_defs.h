@@ -14,4 +14,8 @@
 #ifndef CANBUS_GLOBAL_DEFS_H
 #define CANBUS_GLOBAL_DEFS_H
 
+#if (defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_MEGA) || defined(ARDUINO_AVR_NANO))
+ #define ON_ARDUINO_BOARD
+#endif
+
 #endif  // CANBUS_GLOBAL_DEFS_H
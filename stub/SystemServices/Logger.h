@@ -0,0 +1,50 @@
+/****************************************************************************************
+ *
+ * File:
+ *    Logger.h
+ *
+ * Purpose:
+ *    Stand-in for the SailingRobot SystemServices Logger, for building the library,
+ *    the benchmark and the tests outside of the SailingRobot tree. Messages go to
+ *    stderr.
+ *
+ * Developer Notes:
+ *    Only the calls this library makes are provided. CMakeLists.txt puts this file
+ *    where "../../../SystemServices/Logger.h" finds it.
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_LOGGER_STUB_H
+#define SAILINGROBOT_LOGGER_STUB_H
+
+#include <stdio.h>
+
+class Logger {
+   public:
+    template <typename... Args>
+    static void error(const char* format, Args... args) {
+        log("[ERROR] ", format, args...);
+    }
+
+    template <typename... Args>
+    static void warning(const char* format, Args... args) {
+        log("[WARNING] ", format, args...);
+    }
+
+    template <typename... Args>
+    static void info(const char* format, Args... args) {
+        log("[INFO] ", format, args...);
+    }
+
+   private:
+    static void log(const char* level, const char* format) { fprintf(stderr, "%s%s\n", level, format); }
+
+    template <typename... Args>
+    static void log(const char* level, const char* format, Args... args) {
+        fputs(level, stderr);
+        fprintf(stderr, format, args...);
+        fputc('\n', stderr);
+    }
+};
+
+#endif  // SAILINGROBOT_LOGGER_STUB_H
@@ -0,0 +1,92 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanBitFieldTest.cpp
+ *
+ * Purpose:
+ *    CanBitField::get and set, with uint32_t and uint64_t, against the shift and mask
+ *    on the CanPayload word for every field start + length <= 64, on random payloads
+ *    and values, and bytesTouched() against the bytes holding the field.
+ *
+ ***************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CanBitField.h"
+#include "CanPayload.h"
+#include "CanTest.h"
+
+namespace {
+
+const int RUNS = 200;
+
+uint64_t randomWord() {
+    uint64_t word = 0;
+    for (int i = 0; i < 4; i++) {
+        word = (word << 16) ^ static_cast<uint64_t>(rand());
+    }
+    return word;
+}
+
+uint64_t setWord(uint64_t payload, uint8_t start, uint8_t length, uint64_t value) {
+    uint64_t mask = CanPayload::mask(length) << start;
+    return (payload & ~mask) | ((value << start) & mask);
+}
+
+// Bytes of the payload word holding bits of [start, start + length)
+uint64_t touchedBytesMask(uint8_t start, uint8_t length) {
+    uint64_t mask = 0;
+    for (uint8_t bit = start; bit < start + length; bit++) {
+        mask |= 0xFFULL << (bit & ~7);
+    }
+    return mask;
+}
+
+void checkField(uint8_t start, uint8_t length) {
+    uint64_t fieldMask = CanPayload::mask(length);
+    for (int i = 0; i < RUNS; i++) {
+        uint64_t payload = randomWord();
+        uint64_t value = randomWord();
+        uint8_t data[CanPayload::PAYLOAD_SIZE_IN_BYTES];
+        CanPayload::store(payload, data);
+
+        uint64_t expected = (payload >> start) & fieldMask;
+        CAN_CHECK(CanBitField::get<uint64_t>(data, start, length) == expected);
+
+        uint64_t updated = setWord(payload, start, length, value);
+        uint8_t written[CanPayload::PAYLOAD_SIZE_IN_BYTES];
+        memcpy(written, data, sizeof(data));
+        CanBitField::set<uint64_t>(written, start, length, value);
+        CAN_CHECK(CanPayload::load(written) == updated);
+
+        if (length <= 32) {
+            CAN_CHECK(CanBitField::get<uint32_t>(data, start, length) == static_cast<uint32_t>(expected));
+
+            memcpy(written, data, sizeof(data));
+            CanBitField::set<uint32_t>(written, start, length, static_cast<uint32_t>(value));
+            CAN_CHECK(CanPayload::load(written) == updated);
+        }
+    }
+    CAN_CHECK(CanBitField::bytesTouched(start, length) ==
+              static_cast<uint8_t>(__builtin_popcountll(touchedBytesMask(start, length)) / 8));
+}
+
+}  // namespace
+
+int main() {
+    for (uint8_t length = 1; length <= 64; length++) {
+        for (uint8_t start = 0; start + length <= 64; start++) {
+            checkField(start, length);
+        }
+    }
+
+    // an empty field reads as 0 and is never written
+    uint8_t data[CanPayload::PAYLOAD_SIZE_IN_BYTES];
+    CanPayload::store(~0ULL, data);
+    CanBitField::set<uint64_t>(data, 10, 0, 0);
+    CAN_CHECK(CanPayload::load(data) == ~0ULL);
+    CAN_CHECK(CanBitField::get<uint64_t>(data, 10, 0) == 0);
+    CAN_CHECK(CanBitField::bytesTouched(10, 0) == 0);
+    return canTestResult();
+}
@@ -0,0 +1,132 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanBusLoadMonitorTest.cpp
+ *
+ * Purpose:
+ *    CanBusLoadMonitor counts per id and over the sliding window, then one thread
+ *    recording while others take snapshots. Also built with ThreadSanitizer as
+ *    CanBusLoadMonitorTsanTest when the compiler supports it.
+ *
+ ***************************************************************************************/
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "CanBusLoadMonitor.h"
+#include "CanTest.h"
+
+namespace {
+
+const uint64_t MS = 1000000ULL;
+
+CanMsg makeFrame(uint32_t id, bool extended, uint8_t length, uint8_t seed) {
+    CanMsg frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.id = id;
+    frame.header.ide = extended ? 1 : 0;
+    frame.header.length = length;
+    for (uint8_t i = 0; i < 8; i++) {
+        frame.data[i] = static_cast<uint8_t>(seed * 17 + i);
+    }
+    return frame;
+}
+
+void checkCounts() {
+    CanBusLoadMonitor monitor(250000, 1000);
+    uint32_t controlBits = 0;
+    uint32_t otherBits = 0;
+    uint64_t startNs = 5000 * MS;
+    for (uint8_t i = 0; i < 100; i++) {
+        CanMsg control = makeFrame(MSG_ID_AU_CONTROL, false, 8, i);
+        uint16_t bits = monitor.record(control, startNs + i * MS);
+        CAN_CHECK(bits == CanUtility::exactFrameBits(control.id, false, control.data, 8));
+        controlBits += bits;
+        // Extended ids are other messages, even with a registry id
+        otherBits += monitor.record(makeFrame(MSG_ID_AU_CONTROL, true, 3, i), startNs + i * MS);
+    }
+
+    CanBusLoadSnapshot load;
+    monitor.snapshot(startNs + 200 * MS, load);
+    uint8_t slot = CanMessageRegistry::slotOf(MSG_ID_AU_CONTROL);
+    CAN_CHECK(load.windowNs == 200 * MS);
+    CAN_CHECK(load.frames == 200);
+    CAN_CHECK(load.ids[slot].messageId == MSG_ID_AU_CONTROL);
+    CAN_CHECK(load.ids[slot].frames == 100);
+    CAN_CHECK(load.ids[slot].bytesPerSecond == 800 / 0.2f);
+    CAN_CHECK(load.ids[slot].bitsPerSecond == static_cast<float>(controlBits) / 0.2f);
+    CAN_CHECK(load.ids[CanBusLoadMonitor::OTHER_IDS].frames == 100);
+    CAN_CHECK(load.bits == controlBits + otherBits);
+    CAN_CHECK(load.worstCaseBits == 100 * (CanUtility::worstCaseFrameBits(8, false) +
+                                          CanUtility::worstCaseFrameBits(3, true)));
+    CAN_CHECK(load.bits <= load.worstCaseBits);
+
+    // Out of the window
+    monitor.snapshot(startNs + 1200 * MS, load);
+    CAN_CHECK(load.frames == 0);
+    CAN_CHECK(load.utilization == 0.0f);
+}
+
+/**
+ * One thread records frames every 10 us over several windows while others take
+ * snapshots; the last snapshot must count exactly the frames of its window
+ */
+void checkConcurrentSnapshots() {
+    const uint32_t FRAME_COUNT = 400000;
+    const uint64_t FRAME_INTERVAL_NS = 10000;
+    const uint64_t BUCKET_NS = 100 * MS;
+    CanBusLoadMonitor monitor(1000000, 1000);
+    std::atomic<uint64_t> recordedNs(0);
+    std::atomic<bool> done(false);
+
+    std::thread writer([&]() {
+        for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+            uint64_t timestampNs = (i + 1) * FRAME_INTERVAL_NS;
+            monitor.record(makeFrame(MSG_ID_MARINE_SENSOR_DATA + (i % 3), false, 8, static_cast<uint8_t>(i)),
+                           timestampNs);
+            recordedNs.store(timestampNs, std::memory_order_relaxed);
+        }
+        done.store(true);
+    });
+
+    std::vector<std::thread> readers;
+    std::atomic<uint32_t> badSnapshots(0);
+    for (int r = 0; r < 3; r++) {
+        readers.push_back(std::thread([&]() {
+            CanBusLoadSnapshot load;
+            while (!done.load()) {
+                monitor.snapshot(recordedNs.load(std::memory_order_relaxed), load);
+                // A window holds at most 10 buckets of frames, plus one being reset
+                if (load.frames > 11 * BUCKET_NS / FRAME_INTERVAL_NS || !(load.utilization >= 0.0f)) {
+                    badSnapshots++;
+                }
+            }
+        }));
+    }
+
+    writer.join();
+    for (size_t r = 0; r < readers.size(); r++) {
+        readers[r].join();
+    }
+    CAN_CHECK(badSnapshots.load() == 0);
+
+    uint64_t nowNs = FRAME_COUNT * FRAME_INTERVAL_NS;
+    uint64_t windowStartNs = (nowNs / BUCKET_NS - (CanBusLoadMonitor::BUCKET_COUNT - 1)) * BUCKET_NS;
+    uint32_t expected = 0;
+    for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+        expected += ((i + 1) * FRAME_INTERVAL_NS >= windowStartNs) ? 1 : 0;
+    }
+    CanBusLoadSnapshot load;
+    monitor.snapshot(nowNs, load);
+    CAN_CHECK(load.frames == expected);
+}
+
+}  // namespace
+
+int main() {
+    checkCounts();
+    checkConcurrentSnapshots();
+    return canTestResult();
+}
@@ -0,0 +1,193 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanCaptureFileTest.cpp
+ *
+ * Purpose:
+ *    CanCaptureReader queries against a scan of every record: interleaved ids over
+ *    several blocks, time ordered or not, with the stored index, without it (file not
+ *    closed) and with corrupted index entries that must be rejected.
+ *
+ * Developer Notes:
+ *    The capture files are written in /tmp and removed at the end.
+ *
+ ***************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#include "CanCaptureFile.h"
+#include "CanTest.h"
+
+namespace {
+
+const uint64_t RECORD_COUNT = 3 * CanCaptureIndex::RECORDS_PER_BLOCK + 123;
+const uint32_t IDS[] = {0x100, 0x101, 0x102, 0x1ABCDEF, 0x7FF};
+const size_t ID_COUNT = sizeof(IDS) / sizeof(IDS[0]);
+
+struct Capture {
+    std::vector<CanMsg> messages;
+    std::vector<uint64_t> timestamps;
+};
+
+Capture makeCapture(bool timeOrdered) {
+    Capture capture;
+    uint64_t timestampNs = 1000;
+    srand(1);
+    for (uint64_t i = 0; i < RECORD_COUNT; i++) {
+        CanMsg message;
+        memset(&message, 0, sizeof(message));
+        // Mostly one id, the others in bursts, one of them only at the end
+        size_t idIndex = (i % 7 == 0) ? 1 : (i % 97 < 5) ? 2 : (i > RECORD_COUNT - 50) ? 4 : 0;
+        message.id = (i % 1000 == 500) ? IDS[3] : IDS[idIndex];
+        message.header.ide = message.id > 0x7FF ? 1 : 0;
+        message.header.length = static_cast<uint8_t>(i % 9);
+        for (int byte = 0; byte < 8; byte++) {
+            message.data[byte] = static_cast<uint8_t>(i >> (byte * 8));
+        }
+        timestampNs += static_cast<uint64_t>(rand() % 3);
+        capture.messages.push_back(message);
+        capture.timestamps.push_back(timeOrdered ? timestampNs : 1000 + static_cast<uint64_t>(rand() % 100000));
+    }
+    return capture;
+}
+
+bool writeCapture(const char* path, const Capture& capture) {
+    CanCaptureWriter writer;
+    if (!writer.open(path)) {
+        return false;
+    }
+    for (size_t i = 0; i < capture.messages.size(); i++) {
+        if (!writer.append(capture.messages[i], capture.timestamps[i])) {
+            return false;
+        }
+    }
+    return writer.close();
+}
+
+uint64_t countRecords(const Capture& capture, uint32_t messageId) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < capture.messages.size(); i++) {
+        count += (capture.messages[i].id == messageId) ? 1 : 0;
+    }
+    return count;
+}
+
+void checkQuery(const CanCaptureReader& reader, const Capture& capture, uint32_t messageId, uint64_t fromNs,
+                uint64_t toNs) {
+    std::vector<uint64_t> expected;
+    for (size_t i = 0; i < capture.messages.size(); i++) {
+        if ((messageId == CanCaptureReader::ANY_ID || capture.messages[i].id == messageId) &&
+            capture.timestamps[i] >= fromNs && capture.timestamps[i] <= toNs) {
+            expected.push_back(i);
+        }
+    }
+
+    std::vector<uint64_t> found;
+    uint64_t matches = reader.forEach(messageId, fromNs, toNs, [&](const CanCaptureRecord& record) {
+        // The payload holds the record number
+        uint64_t recordNumber = 0;
+        for (int byte = 0; byte < 8; byte++) {
+            recordNumber |= static_cast<uint64_t>(record.data[byte]) << (byte * 8);
+        }
+        found.push_back(recordNumber);
+    });
+    CAN_CHECK(matches == found.size());
+    CAN_CHECK(found == expected);
+}
+
+void checkQueries(const char* path, const Capture& capture, bool storedIndex) {
+    CanCaptureReader reader;
+    CAN_CHECK(reader.open(path));
+    CAN_CHECK(reader.recordCount() == capture.messages.size());
+    CAN_CHECK(reader.hasStoredIndex() == storedIndex);
+
+    uint64_t first = capture.timestamps.front();
+    uint64_t last = capture.timestamps.back();
+    const uint64_t intervals[][2] = {{0, UINT64_MAX}, {first, first}, {first + 100, first + 4000},
+                                     {last - 10, last}, {last + 1, UINT64_MAX}, {30000, 30010}};
+    for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+        for (size_t id = 0; id < ID_COUNT; id++) {
+            checkQuery(reader, capture, IDS[id], intervals[i][0], intervals[i][1]);
+        }
+        checkQuery(reader, capture, 0x555, intervals[i][0], intervals[i][1]);
+        checkQuery(reader, capture, CanCaptureReader::ANY_ID, intervals[i][0], intervals[i][1]);
+    }
+}
+
+/**
+ * Overwrites 8 bytes of the file at offset from the end
+ */
+void patchFromEnd(const char* path, long offsetFromEnd, uint64_t value) {
+    FILE* file = fopen(path, "r+b");
+    CAN_CHECK(file != NULL);
+    if (file == NULL) {
+        return;
+    }
+    fseek(file, -offsetFromEnd, SEEK_END);
+    fwrite(&value, sizeof(value), 1, file);
+    fclose(file);
+}
+
+}  // namespace
+
+int main() {
+    char path[] = "/tmp/CanCaptureFileTestXXXXXX";
+    int fileDescriptor = mkstemp(path);
+    if (fileDescriptor < 0) {
+        printf("cannot create a file in /tmp, skipped\n");
+        return CAN_TEST_SKIPPED;
+    }
+    close(fileDescriptor);
+
+    for (int timeOrdered = 1; timeOrdered >= 0; timeOrdered--) {
+        Capture capture = makeCapture(timeOrdered != 0);
+
+        CAN_CHECK(writeCapture(path, capture));
+        checkQueries(path, capture, true);
+
+        // Records but no index, as after a crash
+        CAN_CHECK(truncate(path, sizeof(CanCaptureFileHeader) + RECORD_COUNT * sizeof(CanCaptureRecord)) == 0);
+        checkQueries(path, capture, false);
+
+        // Postings: the last record number of the file, of the greatest id, points past the records
+        uint32_t lastId = *std::max_element(IDS, IDS + ID_COUNT);
+        CAN_CHECK(writeCapture(path, capture));
+        patchFromEnd(path, sizeof(CanCaptureTrailer) + sizeof(uint64_t), RECORD_COUNT + 1000000);
+        {
+            CanCaptureReader reader;
+            CAN_CHECK(reader.open(path));
+            CAN_CHECK(reader.hasStoredIndex());
+            uint64_t matches = reader.forEach(lastId, 0, UINT64_MAX, [](const CanCaptureRecord&) {});
+            CAN_CHECK(matches == countRecords(capture, lastId) - 1);
+        }
+
+        // Id entry: the last list runs past the record numbers
+        uint64_t listsSize = RECORD_COUNT * sizeof(uint64_t);
+        CAN_CHECK(writeCapture(path, capture));
+        patchFromEnd(path, sizeof(CanCaptureTrailer) + listsSize + 8, 1000);
+        checkQueries(path, capture, false);
+
+        // Block entry: record count above RECORDS_PER_BLOCK
+        long blocksEnd = sizeof(CanCaptureTrailer) + listsSize + ID_COUNT * sizeof(CanCaptureIdEntry);
+        CAN_CHECK(writeCapture(path, capture));
+        patchFromEnd(path, blocksEnd + 8, CanCaptureIndex::RECORDS_PER_BLOCK + 1);
+        checkQueries(path, capture, false);
+
+        // Block entry: first record past the records
+        CAN_CHECK(writeCapture(path, capture));
+        patchFromEnd(path, blocksEnd + 16, RECORD_COUNT);
+        checkQueries(path, capture, false);
+
+        // Trailer: block count not matching the file size
+        CAN_CHECK(writeCapture(path, capture));
+        patchFromEnd(path, sizeof(CanCaptureTrailer) - 16, 1000);
+        checkQueries(path, capture, false);
+    }
+
+    unlink(path);
+    return canTestResult();
+}
@@ -0,0 +1,14 @@
+# The DBC exported by the tool built on the imported headers must be the one they
+# were imported from
+#
+#   cmake -DTOOL=<CanDbcToolRoundTrip> -DEXPECTED=<imported dbc> -DOUTPUT=<dbc> -P CanDbcRoundTrip.cmake
+
+execute_process(COMMAND ${TOOL} export ${OUTPUT} RESULT_VARIABLE result OUTPUT_QUIET)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "export to ${OUTPUT} failed")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${EXPECTED} ${OUTPUT} RESULT_VARIABLE different)
+if(different)
+    message(FATAL_ERROR "${OUTPUT} differs from ${EXPECTED}")
+endif()
@@ -0,0 +1,79 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanDbcRoundTripTest.cpp
+ *
+ * Purpose:
+ *    Built against the headers CanDbcTool imported from its own export (see
+ *    test/CMakeLists.txt), with CanRequestClient.h as the RPI builds it: the generated
+ *    encode/decode functions against CanField, and against the bytes in order written
+ *    by CanMessageHandler::encodeMessage(lengthInBytes, data).
+ *
+ ***************************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "CanMessageHandler.h"
+#include "CanMessageSchema.h"
+#include "CanRequestClient.h"
+#include "CanTest.h"
+#include "canbus_codec_defs.h"
+
+namespace {
+
+const int RUNS = 100000;
+
+uint64_t randomWord() {
+    uint64_t word = 0;
+    for (int i = 0; i < 4; i++) {
+        word = (word << 16) ^ static_cast<uint64_t>(rand());
+    }
+    return word;
+}
+
+#define CHECK_FIELD(NAME, FUNCTION)                                                   \
+    CAN_CHECK(decode##FUNCTION(payload) == CAN_FIELD(NAME)::get(payload));           \
+    CAN_CHECK(encode##FUNCTION(payload, value) == CAN_FIELD(NAME)::set(payload, value))
+
+void checkFields() {
+    for (int i = 0; i < RUNS; i++) {
+        uint64_t payload = randomWord();
+        uint64_t value = randomWord();
+        CHECK_FIELD(SENSOR_PH, SensorPh);
+        CHECK_FIELD(SENSOR_CONDUCTIVETY, SensorConductivety);
+        CHECK_FIELD(SENSOR_TEMPERATURE, SensorTemperature);
+        CHECK_FIELD(RUDDER_ANGLE, RudderAngle);
+        CHECK_FIELD(WINDVANE_SELFSTEERING_ON, WindvaneSelfsteeringOn);
+        CHECK_FIELD(CURRENT_SENSOR_ID, CurrentSensorId);
+        CHECK_FIELD(CURRENT_SENSOR_ERROR, CurrentSensorError);
+    }
+}
+
+void checkBytesInOrder() {
+    for (int i = 0; i < RUNS; i++) {
+        uint8_t continuous = static_cast<uint8_t>(rand());
+        uint32_t interval = static_cast<uint32_t>(randomWord());
+        CanMessageHandler request(MSG_ID_MARINE_SENSOR_REQUEST);
+        request.encodeMessage(REQUEST_CONTINOUS_READINGS_DATASIZE, continuous);
+        request.encodeMessage(REQUEST_READING_TIME_DATASIZE, interval);
+        uint64_t payload = request.getPayload();
+        CAN_CHECK(decodeRequestContinousReadings(payload) == continuous);
+        CAN_CHECK(decodeRequestReadingTime(payload) == interval);
+        CAN_CHECK(encodeRequestReadingTime(encodeRequestContinousReadings(0, continuous), interval) == payload);
+
+        uint16_t length = static_cast<uint16_t>(rand());
+        CanMessageHandler winch(MSG_ID_WINCH_CONTROL);
+        winch.encodeMessage(WINCH_EXTENDED_LENGTH_DATASIZE, length);
+        CAN_CHECK(decodeWinchExtendedLength(winch.getPayload()) == length);
+        CAN_CHECK(encodeWinchExtendedLength(0, length) == winch.getPayload());
+    }
+}
+
+}  // namespace
+
+int main() {
+    checkFields();
+    checkBytesInOrder();
+    return canTestResult();
+}
@@ -0,0 +1,137 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanDeadbandFilterTest.cpp
+ *
+ * Purpose:
+ *    CanDeadbandFilter: changes within and beyond the deadband, drift against the last
+ *    frame sent, bits outside the fields, the heartbeat across a wrap of the clock,
+ *    forceNext(), the limits of the filter and the rejected half precision fields.
+ *
+ ***************************************************************************************/
+
+#include "CanDeadbandFilter.h"
+#include "CanMessageSchema.h"
+#include "CanTest.h"
+
+namespace {
+
+typedef MarineSensorData::Temperature Temperature;
+typedef MarineSensorData::Ph Ph;
+
+CanMsg marineFrame(uint16_t temperature, uint8_t ph, uint8_t error = 0) {
+    MarineSensorData data;
+    data.ph = ph;
+    data.conductivity = 1234;
+    data.temperature = temperature;
+    data.error = error;
+    return data.toMessage();
+}
+
+void checkDeadband() {
+    CanDeadbandFilter<2, 2> filter(0);
+    CAN_CHECK(filter.addField<Temperature>(MSG_ID_MARINE_SENSOR_DATA, 20));
+    CAN_CHECK(filter.addField<Ph>(MSG_ID_MARINE_SENSOR_DATA, 1));
+
+    CAN_CHECK(filter.shouldSend(marineFrame(1000, 7), 0));  // first frame
+    CAN_CHECK(!filter.shouldSend(marineFrame(1000, 7), 10));
+    CAN_CHECK(!filter.shouldSend(marineFrame(1020, 7), 20));
+    CAN_CHECK(!filter.shouldSend(marineFrame(980, 8), 30));
+    CAN_CHECK(!filter.shouldSend(marineFrame(980, 6), 40));
+    CAN_CHECK(filter.shouldSend(marineFrame(1021, 7), 50));
+    CAN_CHECK(filter.shouldSend(marineFrame(1021, 9), 60));
+    // the reference is the last frame sent: 1021 then 9
+    CAN_CHECK(!filter.shouldSend(marineFrame(1031, 8), 70));
+    CAN_CHECK(!filter.shouldSend(marineFrame(1041, 8), 80));
+    CAN_CHECK(filter.shouldSend(marineFrame(1042, 8), 90));
+    CAN_CHECK(filter.shouldSend(marineFrame(1000, 8), 100));
+    CAN_CHECK(!filter.shouldSend(marineFrame(1000, 8), 200000));  // no heartbeat
+
+    // no deadband outside the fields: conductivity and error
+    CAN_CHECK(filter.shouldSend(marineFrame(1000, 8, 1), 110));
+    CanMsg frame = marineFrame(1000, 8, 1);
+    MarineSensorData::Conductivity::encode(frame, 1235);
+    CAN_CHECK(filter.shouldSend(frame, 120));
+    CAN_CHECK(!filter.shouldSend(frame, 130));
+
+    // ids not added are always sent
+    CanMsg other = makeCanMsg(MSG_ID_RC_STATUS, 0);
+    CAN_CHECK(filter.shouldSend(other, 140));
+    CAN_CHECK(filter.shouldSend(other, 150));
+}
+
+void checkHeartbeat() {
+    CanDeadbandFilter<2, 1> filter(1000);
+    CAN_CHECK(filter.addField<Temperature>(MSG_ID_MARINE_SENSOR_DATA, 20));
+    CanMsg frame = marineFrame(1000, 7);
+
+    // the clock wraps between the first frame and the heartbeat
+    const uint32_t start = 0xFFFFFFFFUL - 500;
+    CAN_CHECK(filter.shouldSend(frame, start));
+    CAN_CHECK(!filter.shouldSend(frame, start + 999));
+    CAN_CHECK(!filter.shouldSend(marineFrame(1010, 7), start + 999));
+    CAN_CHECK(filter.shouldSend(frame, start + 1000));
+    // a change restarts the interval
+    CAN_CHECK(filter.shouldSend(marineFrame(1100, 7), start + 1500));
+    CAN_CHECK(!filter.shouldSend(marineFrame(1100, 7), start + 2499));
+    CAN_CHECK(filter.shouldSend(marineFrame(1100, 7), start + 2500));
+
+    // per id heartbeat, the default applies to the ids added by addField()
+    const uint32_t rcId = MSG_ID_RC_STATUS;
+    CAN_CHECK(filter.setHeartbeat(rcId, 100));
+    CanMsg rc = makeCanMsg(rcId, 0);
+    CAN_CHECK(filter.shouldSend(rc, 0));
+    CAN_CHECK(!filter.shouldSend(rc, 99));
+    CAN_CHECK(filter.shouldSend(rc, 100));
+    CAN_CHECK(filter.setHeartbeat(rcId, 0));
+    CAN_CHECK(!filter.shouldSend(rc, 100000));
+
+    filter.forceNext(rcId);
+    CAN_CHECK(filter.shouldSend(rc, 100001));
+    CAN_CHECK(!filter.shouldSend(rc, 100002));
+    filter.forceNext(MSG_ID_AU_CONTROL);  // not added, nothing to do
+}
+
+void checkLimits() {
+    CanDeadbandFilter<1, 2> filter;
+    CAN_CHECK(!filter.addField(MSG_ID_MARINE_SENSOR_DATA, 0, 0, 1));
+    CAN_CHECK(!filter.addField(MSG_ID_MARINE_SENSOR_DATA, 0, 33, 1));
+    CAN_CHECK(!filter.addField(MSG_ID_MARINE_SENSOR_DATA, 60, 8, 1));
+    CAN_CHECK(filter.addField(MSG_ID_MARINE_SENSOR_DATA, 56, 8, 1));
+    CAN_CHECK(filter.addField<Ph>(MSG_ID_MARINE_SENSOR_DATA, 1));
+    CAN_CHECK(!filter.addField<Temperature>(MSG_ID_MARINE_SENSOR_DATA, 1));  // fields full
+    CAN_CHECK(!filter.addField<Ph>(MSG_ID_AU_CONTROL, 1));                   // ids full
+    CAN_CHECK(!filter.setHeartbeat(MSG_ID_AU_CONTROL, 10));
+}
+
+void checkFloat16Rejected() {
+    CanDeadbandFilter<1, 2> filter;
+    CAN_CHECK(!filter.addField<CurrentSensorData::Voltage>(MSG_ID_CURRENT_SENSOR_DATA, 10));
+    CAN_CHECK(!filter.addField<CurrentSensorData::Current>(MSG_ID_CURRENT_SENSOR_DATA, 10));
+    CAN_CHECK(!filter.addField(MSG_ID_CURRENT_SENSOR_DATA, 8, 16, 10));  // across both
+    CAN_CHECK(!filter.addField(MSG_ID_CURRENT_SENSOR_DATA, 31, 1, 10));
+    // the same bits of another message are fine, so are the other fields
+    CAN_CHECK(filter.addField<CurrentSensorData::Error>(MSG_ID_CURRENT_SENSOR_DATA, 1));
+
+    // any change of voltage or current is sent
+    CurrentSensorData data = CurrentSensorData();
+    data.voltage = 0x4000;
+    CAN_CHECK(filter.shouldSend(data.toMessage(), 0));
+    data.voltage = 0x4001;
+    CAN_CHECK(filter.shouldSend(data.toMessage(), 1));
+    data.error = 1;
+    CAN_CHECK(!filter.shouldSend(data.toMessage(), 2));
+
+    CanDeadbandFilter<1, 1> other;
+    CAN_CHECK(other.addField<CurrentSensorData::Voltage>(MSG_ID_AU_CONTROL, 10));
+}
+
+}  // namespace
+
+int main() {
+    checkDeadband();
+    checkHeartbeat();
+    checkLimits();
+    checkFloat16Rejected();
+    return canTestResult();
+}
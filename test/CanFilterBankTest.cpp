@@ -0,0 +1,226 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanFilterBankTest.cpp
+ *
+ * Purpose:
+ *    CanFilterBank against a brute-force reference evaluating every rule as added:
+ *    random rules and frames, ids on the rule boundaries, batches, removeSubscriber()
+ *    and an extended range refused as a whole when the rules are full.
+ *
+ ***************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "CanFilterBank.h"
+#include "CanTest.h"
+
+namespace {
+
+const int FRAME_COUNT = 100000;
+
+struct Rule {
+    uint8_t subscriber;
+    bool extendedId;
+    bool range;
+    uint32_t first;  // messageId of an (id, mask) rule
+    uint32_t last;   // idMask of an (id, mask) rule
+};
+
+class ReferenceBank {
+   public:
+    void add(const Rule& rule) { m_rules.push_back(rule); }
+
+    void removeSubscriber(uint8_t subscriber) {
+        std::vector<Rule> kept;
+        for (size_t i = 0; i < m_rules.size(); i++) {
+            if (m_rules[i].subscriber != subscriber) {
+                kept.push_back(m_rules[i]);
+            }
+        }
+        m_rules.swap(kept);
+    }
+
+    uint32_t match(const CanMsg& frame) const {
+        bool extended = frame.header.ide != 0 || frame.id > CanFilterBank::MAX_STANDARD_ID;
+        uint32_t id = frame.id & CanFilterBank::MAX_EXTENDED_ID;
+        uint32_t subscribers = 0;
+        for (size_t i = 0; i < m_rules.size(); i++) {
+            const Rule& rule = m_rules[i];
+            if (rule.extendedId != extended) {
+                continue;
+            }
+            uint32_t space = extended ? CanFilterBank::MAX_EXTENDED_ID : CanFilterBank::MAX_STANDARD_ID;
+            bool matches = rule.range ? (id >= rule.first && id <= rule.last)
+                                      : ((id & rule.last & space) == (rule.first & rule.last & space));
+            if (matches) {
+                subscribers |= 1UL << rule.subscriber;
+            }
+        }
+        return subscribers;
+    }
+
+   private:
+    std::vector<Rule> m_rules;
+};
+
+uint32_t randomId(bool extendedId) {
+    uint32_t id = (static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand());
+    return id & (extendedId ? CanFilterBank::MAX_EXTENDED_ID : CanFilterBank::MAX_STANDARD_ID);
+}
+
+/**
+ * Adds a random rule to both banks, ranges are short or long
+ */
+void addRandomRule(CanFilterBank& bank, ReferenceBank& reference, std::vector<uint32_t>& boundaries) {
+    Rule rule;
+    rule.subscriber = static_cast<uint8_t>(rand() % CanFilterBank::MAX_SUBSCRIBERS);
+    rule.extendedId = (rand() % 2) == 0;
+    rule.range = (rand() % 2) == 0;
+    if (rule.range) {
+        rule.first = randomId(rule.extendedId);
+        uint32_t length = (rand() % 2) ? static_cast<uint32_t>(rand() % 20) : randomId(rule.extendedId) >> 4;
+        uint32_t space = rule.extendedId ? CanFilterBank::MAX_EXTENDED_ID : CanFilterBank::MAX_STANDARD_ID;
+        rule.last = (rule.first + length > space) ? space : rule.first + length;
+        size_t before = bank.extendedRuleCount();
+        if (!bank.addRange(rule.subscriber, rule.first, rule.last, rule.extendedId)) {
+            CAN_CHECK(rule.extendedId && bank.extendedRuleCount() == before);  // rolled back
+            return;
+        }
+    } else {
+        rule.first = randomId(rule.extendedId);
+        // Masks with a few bits cleared, as real ones
+        rule.last = ~((1UL << (rand() % 6)) - 1) & ~(rand() % 2 ? (1UL << (rand() % 29)) : 0UL);
+        if (!bank.addIdMask(rule.subscriber, rule.first, rule.last, rule.extendedId)) {
+            CAN_CHECK(rule.extendedId);
+            return;
+        }
+    }
+    reference.add(rule);
+    boundaries.push_back(rule.first);
+    boundaries.push_back(rule.last);
+}
+
+CanMsg randomFrame(const std::vector<uint32_t>& boundaries) {
+    CanMsg frame;
+    memset(&frame, 0, sizeof(frame));
+    bool extended = (rand() % 2) == 0;
+    frame.header.ide = extended ? 1 : 0;
+    frame.header.length = 8;
+    switch (rand() % 4) {
+        case 0:
+            frame.id = randomId(extended);
+            break;
+        case 1:
+            // Standard frames with an id above 11 bits count as extended
+            frame.id = randomId(true);
+            break;
+        default:
+            // Around a range bound or a rule id
+            frame.id = boundaries.empty()
+                           ? 0
+                           : boundaries[static_cast<size_t>(rand()) % boundaries.size()] + (rand() % 3) - 1;
+            frame.id &= CanFilterBank::MAX_EXTENDED_ID;
+            break;
+    }
+    return frame;
+}
+
+void checkFrames(const CanFilterBank& bank, const ReferenceBank& reference, const std::vector<uint32_t>& boundaries) {
+    const size_t BATCH_SIZE = 37;
+    CanMsg frames[BATCH_SIZE];
+    uint32_t subscribers[BATCH_SIZE];
+    for (int i = 0; i < FRAME_COUNT; i += BATCH_SIZE) {
+        for (size_t j = 0; j < BATCH_SIZE; j++) {
+            frames[j] = randomFrame(boundaries);
+        }
+        bank.match(frames, BATCH_SIZE, subscribers);
+        for (size_t j = 0; j < BATCH_SIZE; j++) {
+            uint32_t expected = reference.match(frames[j]);
+            CAN_CHECK(bank.match(frames[j]) == expected);
+            CAN_CHECK(subscribers[j] == expected);
+        }
+    }
+}
+
+void checkRandomRules(unsigned seed, int ruleCount) {
+    srand(seed);
+    CanFilterBank bank;
+    ReferenceBank reference;
+    std::vector<uint32_t> boundaries;
+    for (int i = 0; i < ruleCount; i++) {
+        addRandomRule(bank, reference, boundaries);
+    }
+    checkFrames(bank, reference, boundaries);
+
+    for (uint8_t subscriber = 0; subscriber < CanFilterBank::MAX_SUBSCRIBERS; subscriber += 3) {
+        bank.removeSubscriber(subscriber);
+        reference.removeSubscriber(subscriber);
+    }
+    checkFrames(bank, reference, boundaries);
+}
+
+/**
+ * The example of the header: actuators 700-704, winch 800-801, sensors 710-721
+ */
+void checkSubscribers() {
+    CanFilterBank bank;
+    CAN_CHECK(bank.addRange(0, 700, 704));
+    CAN_CHECK(bank.addRange(1, 800, 801));
+    CAN_CHECK(bank.addRange(2, 710, 721));
+    CAN_CHECK(!bank.addRange(CanFilterBank::MAX_SUBSCRIBERS, 700, 704));
+    CAN_CHECK(!bank.addRange(0, 705, 704));
+
+    CanMsg frame;
+    memset(&frame, 0, sizeof(frame));
+    const uint32_t ids[] = {699, 700, 704, 705, 709, 710, 721, 722, 800, 801, 802};
+    const uint32_t expected[] = {0, 1, 1, 0, 0, 4, 4, 0, 2, 2, 0};
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        frame.id = ids[i];
+        CAN_CHECK(bank.match(frame) == expected[i]);
+    }
+    // Same ids on 29 bits are other messages
+    frame.header.ide = 1;
+    frame.id = 700;
+    CAN_CHECK(bank.match(frame) == 0);
+}
+
+/**
+ * A range needing more rules than left is refused without any rule added
+ */
+void checkFullRules() {
+    CanFilterBank bank;
+    for (size_t i = 0; i < CanFilterBank::MAX_EXTENDED_RULES - 2; i++) {
+        CAN_CHECK(bank.addIdMask(1, static_cast<uint32_t>(0x100000 + i), CanFilterBank::MAX_EXTENDED_ID, true));
+    }
+    // 0x1001 to 0x1010 takes 5 blocks
+    CAN_CHECK(!bank.addRange(2, 0x1001, 0x1010, true));
+    CAN_CHECK(bank.extendedRuleCount() == CanFilterBank::MAX_EXTENDED_RULES - 2);
+
+    CanMsg frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.header.ide = 1;
+    frame.id = 0x1001;
+    CAN_CHECK(bank.match(frame) == 0);
+    frame.id = 0x100000 + CanFilterBank::MAX_EXTENDED_RULES - 3;
+    CAN_CHECK(bank.match(frame) == 2);
+
+    CAN_CHECK(bank.addRange(2, 0x1000, 0x1001, true));
+    CAN_CHECK(bank.addIdMask(3, 0x55, 0, true));
+    CAN_CHECK(!bank.addIdMask(3, 0x56, 0, true));
+    frame.id = 0x1001;
+    CAN_CHECK(bank.match(frame) == (4 | 8));
+}
+
+}  // namespace
+
+int main() {
+    checkSubscribers();
+    checkFullRules();
+    checkRandomRules(1, 10);
+    checkRandomRules(2, 60);
+    checkRandomRules(3, 200);
+    return canTestResult();
+}
@@ -0,0 +1,193 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanFixedPointMappingTest.cpp
+ *
+ * Purpose:
+ *    Exhaustive check of CanFixedPointMapping and CanFixedPointMapper against the
+ *    exact rational results, rounded to nearest with ties up, for the mapped fields of
+ *    canbus_datamappings_defs.h: every value of encode(), every fixed-point offset of
+ *    encodeFixed(), every raw value of decode() and decodeFixed(). Then sampled inputs
+ *    of extreme intervals and lengths.
+ *
+ * Developer Notes:
+ *    The exact results are computed incrementally (input * numerator / divisor as
+ *    quotient and remainder) to keep the 2^32 raw values of SENSOR_CONDUCTIVETY fast.
+ *
+ ***************************************************************************************/
+
+#include <stdlib.h>
+
+#include "CanFixedPointMapping.h"
+#include "CanTest.h"
+#include "canbus_datamappings_defs.h"
+
+namespace {
+
+/**
+ * round(input * numerator / divisor), ties up, for input = 0, 1, 2, ...
+ */
+class ExactQuotients {
+   public:
+    ExactQuotients(uint64_t numerator, uint64_t divisor)
+        : m_divisor(divisor),
+          m_stepQuotient(numerator / divisor),
+          m_stepRemainder(numerator % divisor),
+          m_quotient(0),
+          m_remainder(0) {}
+
+    uint64_t rounded() const { return m_quotient + ((2 * m_remainder >= m_divisor) ? 1 : 0); }
+
+    void next() {
+        m_quotient += m_stepQuotient;
+        m_remainder += m_stepRemainder;
+        if (m_remainder >= m_divisor) {
+            m_remainder -= m_divisor;
+            m_quotient++;
+        }
+    }
+
+   private:
+    uint64_t m_divisor;
+    uint64_t m_stepQuotient;
+    uint64_t m_stepRemainder;
+    uint64_t m_quotient;
+    uint64_t m_remainder;
+};
+
+uint64_t exactQuotient(uint64_t input, uint64_t numerator, uint64_t divisor) {
+    unsigned __int128 product = static_cast<unsigned __int128>(input) * numerator;
+    return static_cast<uint64_t>((2 * product + divisor) / (2 * static_cast<unsigned __int128>(divisor)));
+}
+
+/**
+ * Counts the mismatches of one function, only the first ones are reported by CAN_CHECK
+ */
+struct Mismatches {
+    uint64_t count;
+    uint64_t firstInput;
+};
+
+void report(const char* name, const char* function, const Mismatches& mismatches) {
+    if (mismatches.count > 0) {
+        printf("%s::%s(): %llu wrong results, first for %llu\n", name, function,
+               static_cast<unsigned long long>(mismatches.count),
+               static_cast<unsigned long long>(mismatches.firstInput));
+    }
+    CAN_CHECK(mismatches.count == 0);
+}
+
+void count(Mismatches& mismatches, bool match, uint64_t input) {
+    if (!match) {
+        if (mismatches.count == 0) {
+            mismatches.firstInput = input;
+        }
+        mismatches.count++;
+    }
+}
+
+/**
+ * Every input of the four integer functions
+ */
+template <class Mapping>
+void checkExhaustive(const char* name, const Mapping& mapping, uint32_t rawMax, uint8_t fractionBits) {
+    uint32_t range = static_cast<uint32_t>(mapping.maxValue() - mapping.minValue());
+    uint32_t fixedRange = range << fractionBits;
+
+    Mismatches encode = {0, 0};
+    ExactQuotients exactEncode(rawMax, range);
+    for (uint64_t offset = 0; offset <= range; offset++, exactEncode.next()) {
+        long value = mapping.minValue() + static_cast<long>(offset);
+        count(encode, mapping.encode(value) == exactEncode.rounded(), offset);
+    }
+    report(name, "encode", encode);
+    CAN_CHECK(mapping.encode(mapping.minValue() - 1) == 0);
+    CAN_CHECK(mapping.encode(mapping.maxValue() + 1) == rawMax);
+
+    Mismatches encodeFixed = {0, 0};
+    ExactQuotients exactEncodeFixed(rawMax, fixedRange);
+    for (uint64_t offset = 0; offset <= fixedRange; offset++, exactEncodeFixed.next()) {
+        count(encodeFixed, mapping.encodeFixed(static_cast<uint32_t>(offset)) == exactEncodeFixed.rounded(),
+              offset);
+    }
+    report(name, "encodeFixed", encodeFixed);
+    CAN_CHECK(mapping.encodeFixed(fixedRange + 1) == rawMax);
+
+    Mismatches decode = {0, 0};
+    Mismatches decodeFixed = {0, 0};
+    ExactQuotients exactDecode(range, rawMax);
+    ExactQuotients exactDecodeFixed(fixedRange, rawMax);
+    for (uint64_t raw = 0; raw <= rawMax; raw++, exactDecode.next(), exactDecodeFixed.next()) {
+        count(decode,
+              mapping.decode(static_cast<uint32_t>(raw)) ==
+                  mapping.minValue() + static_cast<long>(exactDecode.rounded()),
+              raw);
+        count(decodeFixed, mapping.decodeFixed(static_cast<uint32_t>(raw)) == exactDecodeFixed.rounded(), raw);
+    }
+    report(name, "decode", decode);
+    report(name, "decodeFixed", decodeFixed);
+}
+
+template <long MIN, long MAX, uint8_t LENGTH>
+void checkField(const char* name) {
+    typedef CanFixedPointMapping<MIN, MAX, LENGTH> Mapping;
+    checkExhaustive(name, Mapping(), Mapping::RAW_MAX, Mapping::FRACTION_BITS);
+
+    // Same results at runtime, the raw values of 32 bits fields are only sampled
+    CanFixedPointMapper mapper(MIN, MAX, LENGTH);
+    if (LENGTH < 32) {
+        checkExhaustive(name, mapper, Mapping::RAW_MAX, Mapping::FRACTION_BITS);
+    }
+    CAN_CHECK(mapper.fractionBits() == Mapping::FRACTION_BITS);
+    for (uint64_t raw = 0; raw <= Mapping::RAW_MAX; raw += 1 + (Mapping::RAW_MAX >> 16)) {
+        CAN_CHECK(mapper.decode(static_cast<uint32_t>(raw)) == Mapping::decode(static_cast<uint32_t>(raw)));
+        CAN_CHECK(mapper.decodeFixed(static_cast<uint32_t>(raw)) == Mapping::decodeFixed(static_cast<uint32_t>(raw)));
+    }
+}
+
+/**
+ * Sampled inputs, with the bounds, of intervals and lengths no field uses
+ */
+void checkSampled(long minValue, long maxValue, uint8_t length) {
+    CanFixedPointMapper mapping(minValue, maxValue, length);
+    uint32_t rawMax = CanFixedPoint::rawMax(length);
+    uint32_t range = static_cast<uint32_t>(maxValue - minValue);
+    uint32_t fixedRange = range << mapping.fractionBits();
+
+    srand(length);
+    for (int i = 0; i < 100000; i++) {
+        uint32_t offset = (i < 3) ? (i == 0 ? 0 : i == 1 ? range : range / 2) : static_cast<uint32_t>(rand()) % range;
+        CAN_CHECK(mapping.encode(minValue + static_cast<long>(offset)) == exactQuotient(offset, rawMax, range));
+
+        uint32_t fixed = (i < 3) ? (i == 0 ? 0 : i == 1 ? fixedRange : fixedRange / 2)
+                                 : static_cast<uint32_t>(rand()) % fixedRange;
+        CAN_CHECK(mapping.encodeFixed(fixed) == exactQuotient(fixed, rawMax, fixedRange));
+
+        uint32_t raw = (i < 3) ? (i == 0 ? 0 : i == 1 ? rawMax : rawMax / 2)
+                               : static_cast<uint32_t>((static_cast<uint64_t>(rand()) << 16 ^ rand()) % rawMax);
+        CAN_CHECK(mapping.decode(raw) == minValue + static_cast<long>(exactQuotient(raw, range, rawMax)));
+        CAN_CHECK(mapping.decodeFixed(raw) == exactQuotient(raw, fixedRange, rawMax));
+    }
+}
+
+}  // namespace
+
+int main() {
+    checkField<SENSOR_PH_INTERVAL_MIN, SENSOR_PH_INTERVAL_MAX, 8 * SENSOR_PH_DATASIZE>("SENSOR_PH");
+    checkField<SENSOR_CONDUCTIVETY_INTERVAL_MIN, SENSOR_CONDUCTIVETY_INTERVAL_MAX, 8 * SENSOR_CONDUCTIVETY_DATASIZE>(
+        "SENSOR_CONDUCTIVETY");
+    checkField<SENSOR_TEMPERATURE_INTERVAL_MIN, SENSOR_TEMPERATURE_INTERVAL_MAX, 8 * SENSOR_TEMPERATURE_DATASIZE>(
+        "SENSOR_TEMPERATURE");
+    checkField<MIN_RUDDER_ANGLE, MAX_RUDDER_ANGLE, 8 * RUDDER_ANGLE_DATASIZE>("RUDDER_ANGLE");
+    checkField<MIN_WINGSAIL_ANGLE, MAX_WINGSAIL_ANGLE, 8 * WINGSAIL_ANGLE_DATASIZE>("WINGSAIL_ANGLE");
+    checkField<WINDVANE_SELFSTEERING_ANGLE_MIN, WINDVANE_SELFSTEERING_ANGLE_MAX,
+               8 * WINDVANE_SELFSTEERING_ANGLE_DATASIZE>("WINDVANE_SELFSTEERING_ANGLE");
+
+    checkSampled(0, 1, 32);
+    checkSampled(-2000000000L, 2000000000L, 32);
+    checkSampled(0, 4000000000L, 31);
+    checkSampled(0, 1000000000L, 1);
+    checkSampled(-7, 1000, 24);
+    checkSampled(0, 200000, 20);
+    return canTestResult();
+}
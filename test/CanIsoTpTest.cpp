@@ -0,0 +1,256 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanIsoTpTest.cpp
+ *
+ * Purpose:
+ *    CanIsoTpSender against CanIsoTpReceiver on a simulated clock: every length from
+ *    1 to 600 bytes for block sizes 0 to 3 and separation times of 0, 300 us and 2 ms,
+ *    across the wraparound of the microsecond clock too. Then the overflow flow
+ *    control, and the error paths: sequence error, FLOW_WAIT limit, flow control and
+ *    consecutive frame timeouts, a first frame interrupting a transfer.
+ *
+ ***************************************************************************************/
+
+#include <string.h>
+
+#include "CanIsoTp.h"
+#include "CanTest.h"
+
+namespace {
+
+const uint32_t DATA_ID = 0x7E0;
+const uint32_t FLOW_CONTROL_ID = 0x7E8;
+const uint16_t MAX_PAYLOAD = 600;
+const uint32_t TICK_US = 50;
+
+uint8_t g_payload[CanIsoTp::MAX_LENGTH];
+
+void fillPayload(uint16_t length, uint8_t seed) {
+    for (uint16_t i = 0; i < length; i++) {
+        g_payload[i] = static_cast<uint8_t>(i * 7 + seed + (i >> 8));
+    }
+}
+
+CanMsg dataFrame(uint8_t firstByte, uint8_t secondByte) {
+    CanMsg frame;
+    CanIsoTp::initFrame(frame, DATA_ID);
+    frame.data[0] = firstByte;
+    frame.data[1] = secondByte;
+    return frame;
+}
+
+/**
+ * Runs a transfer to the end, checks what the receiver got and the flow control
+ * the sender followed
+ */
+template <uint16_t RECEIVER_PAYLOAD>
+void checkTransfer(uint16_t length, uint8_t blockSize, uint32_t separationUs, uint32_t startUs) {
+    fillPayload(length, static_cast<uint8_t>(blockSize + separationUs));
+    CanIsoTpSender sender(DATA_ID, FLOW_CONTROL_ID);
+    CanIsoTpReceiver<RECEIVER_PAYLOAD> receiver(DATA_ID, FLOW_CONTROL_ID, blockSize, separationUs);
+    uint32_t effectiveSeparationUs = CanIsoTp::decodeSeparationTime(CanIsoTp::encodeSeparationTime(separationUs));
+
+    CAN_CHECK(sender.start(g_payload, length));
+    uint32_t nowUs = startUs;
+    uint32_t lastConsecutiveUs = 0;
+    bool blockStarted = false;  // a consecutive frame was sent since the last flow control
+    int framesInBlock = 0;
+    int completions = 0;
+    bool separationKept = true;
+    bool blockSizeKept = true;
+
+    for (int step = 0; step < 1000000 && sender.busy(); step++) {
+        CanMsg frame;
+        if (!sender.next(nowUs, frame)) {
+            nowUs += TICK_US;
+            continue;
+        }
+        if (CanIsoTp::frameType(frame) == CanIsoTp::CONSECUTIVE_FRAME) {
+            if (blockStarted && nowUs - lastConsecutiveUs < effectiveSeparationUs) {
+                separationKept = false;
+            }
+            if (blockSize != 0 && ++framesInBlock > blockSize) {
+                blockSizeKept = false;
+            }
+            blockStarted = true;
+            lastConsecutiveUs = nowUs;
+        }
+
+        CanMsg flowControl;
+        switch (receiver.onFrame(frame, nowUs, flowControl)) {
+            case ISOTP_FRAME_SEND_FLOW_CONTROL:
+                CAN_CHECK(flowControl.id == FLOW_CONTROL_ID);
+                sender.onFrame(flowControl, nowUs);
+                blockStarted = false;
+                framesInBlock = 0;
+                break;
+            case ISOTP_FRAME_COMPLETE:
+                completions++;
+                break;
+            case ISOTP_FRAME_PENDING:
+                break;
+            default:
+                CAN_CHECK(false);
+                break;
+        }
+    }
+
+    if (length > RECEIVER_PAYLOAD) {
+        CAN_CHECK(sender.state() == ISOTP_SENDER_FAILED);
+        CAN_CHECK(receiver.statistics().overflows == 1);
+        CAN_CHECK(completions == 0);
+        return;
+    }
+    CAN_CHECK(sender.state() == ISOTP_SENDER_COMPLETE);
+    CAN_CHECK(completions == 1 && receiver.statistics().completed == 1);
+    CAN_CHECK(receiver.length() == length);
+    CAN_CHECK(memcmp(receiver.data(), g_payload, length) == 0);
+    CAN_CHECK(separationKept);
+    CAN_CHECK(blockSizeKept);
+    CAN_CHECK(receiver.statistics().timedOut == 0 && receiver.statistics().sequenceErrors == 0);
+}
+
+void checkRoundTrips() {
+    const uint32_t separations[] = {0, 300, 2000};
+    // from 0 and a few milliseconds before the clock wraps around
+    const uint32_t starts[] = {0, 0xFFFFFFFFUL - 4000};
+    for (uint16_t length = 1; length <= MAX_PAYLOAD; length++) {
+        for (uint8_t blockSize = 0; blockSize <= 3; blockSize++) {
+            for (size_t s = 0; s < sizeof(separations) / sizeof(separations[0]); s++) {
+                for (size_t t = 0; t < sizeof(starts) / sizeof(starts[0]); t++) {
+                    checkTransfer<MAX_PAYLOAD>(length, blockSize, separations[s], starts[t]);
+                }
+            }
+        }
+    }
+}
+
+void checkOverflow() {
+    checkTransfer<100>(101, 0, 0, 0);
+    checkTransfer<100>(CanIsoTp::MAX_LENGTH, 2, 300, 0);
+    checkTransfer<100>(100, 2, 300, 0);
+
+    // a single frame longer than the buffer is dropped, no flow control for it
+    CanIsoTpReceiver<4> receiver(DATA_ID, FLOW_CONTROL_ID);
+    CanMsg flowControl;
+    CAN_CHECK(receiver.onFrame(dataFrame(0x05, 1), 0, flowControl) == ISOTP_FRAME_DROPPED);
+    CAN_CHECK(receiver.statistics().overflows == 1);
+}
+
+void checkSequenceError() {
+    CanIsoTpReceiver<MAX_PAYLOAD> receiver(DATA_ID, FLOW_CONTROL_ID);
+    CanMsg flowControl;
+    CAN_CHECK(receiver.onFrame(dataFrame(0x10, 30), 0, flowControl) == ISOTP_FRAME_SEND_FLOW_CONTROL);
+    CAN_CHECK(receiver.onFrame(dataFrame(0x21, 0), 100, flowControl) == ISOTP_FRAME_PENDING);
+    CAN_CHECK(receiver.onFrame(dataFrame(0x23, 0), 200, flowControl) == ISOTP_FRAME_DROPPED);  // 0x22 lost
+    CAN_CHECK(receiver.statistics().sequenceErrors == 1);
+    CAN_CHECK(!receiver.busy());
+
+    // the rest of the transfer is unexpected
+    CAN_CHECK(receiver.onFrame(dataFrame(0x24, 0), 300, flowControl) == ISOTP_FRAME_DROPPED);
+    CAN_CHECK(receiver.statistics().invalid == 1);
+    CAN_CHECK(receiver.statistics().completed == 0);
+}
+
+void checkWaitLimit() {
+    fillPayload(20, 1);
+    CanIsoTpSender sender(DATA_ID, FLOW_CONTROL_ID);
+    CanMsg frame;
+    CanMsg flowControl;
+    CAN_CHECK(sender.start(g_payload, 20));
+    CAN_CHECK(sender.next(0, frame) && CanIsoTp::frameType(frame) == CanIsoTp::FIRST_FRAME);
+
+    // each FLOW_WAIT restarts the flow control timeout
+    uint32_t nowUs = 0;
+    CanIsoTp::flowControlFrame(flowControl, FLOW_CONTROL_ID, CanIsoTp::FLOW_WAIT, 0, 0);
+    for (uint8_t i = 0; i < CanIsoTpSender::MAX_WAIT_FRAMES; i++) {
+        nowUs += CanIsoTp::DEFAULT_TIMEOUT_US - 1;
+        CAN_CHECK(!sender.next(nowUs, frame));
+        sender.onFrame(flowControl, nowUs);
+        CAN_CHECK(sender.state() == ISOTP_SENDER_WAITING_FLOW_CONTROL);
+    }
+    sender.onFrame(flowControl, nowUs);
+    CAN_CHECK(sender.state() == ISOTP_SENDER_FAILED);
+    CAN_CHECK(!sender.busy());
+
+    // a continue to send after some waits resets their count
+    CanIsoTpSender resumed(DATA_ID, FLOW_CONTROL_ID);
+    CAN_CHECK(resumed.start(g_payload, 20) && resumed.next(0, frame));
+    for (uint8_t i = 0; i < CanIsoTpSender::MAX_WAIT_FRAMES; i++) {
+        resumed.onFrame(flowControl, 0);
+    }
+    CanMsg continueToSend;
+    CanIsoTp::flowControlFrame(continueToSend, FLOW_CONTROL_ID, CanIsoTp::FLOW_CONTINUE_TO_SEND, 1, 0);
+    resumed.onFrame(continueToSend, 0);
+    CAN_CHECK(resumed.next(0, frame) && resumed.state() == ISOTP_SENDER_WAITING_FLOW_CONTROL);
+    for (uint8_t i = 0; i < CanIsoTpSender::MAX_WAIT_FRAMES; i++) {
+        resumed.onFrame(flowControl, 0);
+    }
+    CAN_CHECK(resumed.state() == ISOTP_SENDER_WAITING_FLOW_CONTROL);
+}
+
+void checkTimeouts() {
+    fillPayload(20, 2);
+    CanMsg frame;
+
+    // no flow control, also across the clock wraparound
+    const uint32_t starts[] = {1000, 0xFFFFFFFFUL - 10};
+    for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); s++) {
+        CanIsoTpSender sender(DATA_ID, FLOW_CONTROL_ID);
+        CAN_CHECK(sender.start(g_payload, 20) && sender.next(starts[s], frame));
+        CAN_CHECK(!sender.next(starts[s] + CanIsoTp::DEFAULT_TIMEOUT_US, frame));
+        CAN_CHECK(sender.state() == ISOTP_SENDER_WAITING_FLOW_CONTROL);
+        CAN_CHECK(!sender.next(starts[s] + CanIsoTp::DEFAULT_TIMEOUT_US + 1, frame));
+        CAN_CHECK(sender.state() == ISOTP_SENDER_FAILED);
+    }
+
+    // no consecutive frame
+    CanIsoTpReceiver<MAX_PAYLOAD> receiver(DATA_ID, FLOW_CONTROL_ID, 0, 0, 5000);
+    CanMsg flowControl;
+    CAN_CHECK(receiver.onFrame(dataFrame(0x10, 20), 0xFFFFFFFFUL - 1000, flowControl) ==
+              ISOTP_FRAME_SEND_FLOW_CONTROL);
+    CAN_CHECK(receiver.onFrame(dataFrame(0x21, 0), 3999, flowControl) == ISOTP_FRAME_PENDING);  // 5000 us later
+    receiver.expire(3999 + 5000);
+    CAN_CHECK(receiver.busy());
+    receiver.expire(3999 + 5001);
+    CAN_CHECK(!receiver.busy());
+    CAN_CHECK(receiver.statistics().timedOut == 1);
+    CAN_CHECK(receiver.onFrame(dataFrame(0x22, 0), 3999 + 5002, flowControl) == ISOTP_FRAME_DROPPED);
+}
+
+void checkInterruption() {
+    CanIsoTpReceiver<MAX_PAYLOAD> receiver(DATA_ID, FLOW_CONTROL_ID);
+    CanMsg flowControl;
+    CAN_CHECK(receiver.onFrame(dataFrame(0x10, 40), 0, flowControl) == ISOTP_FRAME_SEND_FLOW_CONTROL);
+    CAN_CHECK(receiver.onFrame(dataFrame(0x21, 0), 10, flowControl) == ISOTP_FRAME_PENDING);
+    CAN_CHECK(receiver.length() == 0);  // nothing complete while a transfer is in progress
+
+    // a new first frame, 8 bytes long: 6 in the first frame and 2 in one consecutive frame
+    CanMsg first = dataFrame(0x10, 8);
+    memcpy(&first.data[2], "abcdef", 6);
+    CAN_CHECK(receiver.onFrame(first, 20, flowControl) == ISOTP_FRAME_SEND_FLOW_CONTROL);
+    CAN_CHECK(receiver.statistics().interrupted == 1);
+    CanMsg consecutive = dataFrame(0x21, 'g');
+    consecutive.data[2] = 'h';
+    CAN_CHECK(receiver.onFrame(consecutive, 30, flowControl) == ISOTP_FRAME_COMPLETE);
+    CAN_CHECK(receiver.length() == 8 && memcmp(receiver.data(), "abcdefgh", 8) == 0);
+
+    // a single frame interrupts too
+    CAN_CHECK(receiver.onFrame(dataFrame(0x10, 40), 40, flowControl) == ISOTP_FRAME_SEND_FLOW_CONTROL);
+    CAN_CHECK(receiver.onFrame(dataFrame(0x01, 'z'), 50, flowControl) == ISOTP_FRAME_COMPLETE);
+    CAN_CHECK(receiver.statistics().interrupted == 2);
+    CAN_CHECK(receiver.length() == 1 && receiver.data()[0] == 'z');
+}
+
+}  // namespace
+
+int main() {
+    checkRoundTrips();
+    checkOverflow();
+    checkSequenceError();
+    checkWaitLimit();
+    checkTimeouts();
+    checkInterruption();
+    return canTestResult();
+}
@@ -0,0 +1,159 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanLatestValueCacheTest.cpp
+ *
+ * Purpose:
+ *    CanLatestValueCache slots: the latest frame of each id and of each current
+ *    sensor, the ids outside of CanMessageRegistry, then one writer thread against
+ *    reader threads, which must never see a frame mixing two writes. Also built with
+ *    ThreadSanitizer as CanLatestValueCacheTsanTest when the compiler supports it.
+ *
+ ***************************************************************************************/
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "CanLatestValueCache.h"
+#include "CanTest.h"
+
+namespace {
+
+const uint32_t WRITES = 50000;
+const int READERS = 3;
+
+CanMsg makeFrame(uint32_t id, uint64_t payload) {
+    CanMsg frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.id = id;
+    frame.header.length = 8;
+    CanPayload::store(payload, frame.data);
+    return frame;
+}
+
+CanMsg currentSensorFrame(uint8_t sensorId, uint16_t current) {
+    CanMsg frame = makeFrame(MSG_ID_CURRENT_SENSOR_DATA, 0);
+    CurrentSensorData::SensorId::encode(frame, sensorId);
+    CurrentSensorData::Current::encode(frame, current);
+    return frame;
+}
+
+void checkSlots() {
+    CanLatestValueCache cache;
+    CanTimestampedMsg latest;
+    CAN_CHECK(!cache.read(MSG_ID_MARINE_SENSOR_DATA, latest));  // nothing received yet
+
+    CAN_CHECK(cache.update(makeFrame(MSG_ID_MARINE_SENSOR_DATA, 1), 10));
+    CAN_CHECK(cache.update(makeFrame(MSG_ID_MARINE_SENSOR_DATA, 2), 20));
+    CAN_CHECK(cache.update(makeFrame(MSG_ID_AU_CONTROL, 3), 30));
+    CAN_CHECK(cache.read(MSG_ID_MARINE_SENSOR_DATA, latest));
+    CAN_CHECK(latest.message.id == MSG_ID_MARINE_SENSOR_DATA);
+    CAN_CHECK(CanPayload::load(latest.message.data) == 2 && latest.timestampNs == 20);
+    CAN_CHECK(cache.read(MSG_ID_AU_CONTROL, latest));
+    CAN_CHECK(CanPayload::load(latest.message.data) == 3 && latest.timestampNs == 30);
+    CAN_CHECK(!cache.read(MSG_ID_WINCH_CONTROL, latest));
+
+    // the ids of the registry range without a slot, and the ids around it
+    for (uint32_t id = 0; id < 2000; id++) {
+        if (CanMessageRegistry::slotOf(id) == CanMessageRegistry::NO_SLOT) {
+            CAN_CHECK(!cache.update(makeFrame(id, 4), 40));
+            CAN_CHECK(!cache.read(id, latest));
+        }
+    }
+    CAN_CHECK(!cache.read(0xFFFFFFFF, latest));
+}
+
+void checkCurrentSensorSlots() {
+    CanLatestValueCache cache;
+    CanTimestampedMsg latest;
+    for (uint8_t sensorId = 0; sensorId < CanLatestValueCache::CURRENT_SENSOR_COUNT; sensorId++) {
+        CAN_CHECK(!cache.readCurrentSensor(sensorId, latest));
+    }
+
+    for (uint16_t round = 0; round < 3; round++) {
+        for (uint8_t sensorId = 0; sensorId < CanLatestValueCache::CURRENT_SENSOR_COUNT; sensorId++) {
+            CAN_CHECK(cache.update(currentSensorFrame(sensorId, static_cast<uint16_t>(round * 100 + sensorId)),
+                                   round * 1000 + sensorId));
+        }
+    }
+    for (uint8_t sensorId = 0; sensorId < CanLatestValueCache::CURRENT_SENSOR_COUNT; sensorId++) {
+        CAN_CHECK(cache.readCurrentSensor(sensorId, latest));
+        CAN_CHECK(CurrentSensorData::SensorId::decode(latest.message) == sensorId);
+        CAN_CHECK(CurrentSensorData::Current::decode(latest.message) == 200 + sensorId);
+        CAN_CHECK(latest.timestampNs == 2000u + sensorId);
+    }
+    CAN_CHECK(!cache.readCurrentSensor(CanLatestValueCache::CURRENT_SENSOR_COUNT, latest));
+    CAN_CHECK(!cache.readCurrentSensor(0xFF, latest));
+
+    // the id slot holds the last sensor written
+    CAN_CHECK(cache.read(MSG_ID_CURRENT_SENSOR_DATA, latest));
+    CAN_CHECK(CurrentSensorData::SensorId::decode(latest.message) == CanLatestValueCache::CURRENT_SENSOR_COUNT - 1);
+}
+
+// Every field of the write n is derived from n, a torn read mixes two values of n
+uint64_t payloadOf(uint32_t n) {
+    return (static_cast<uint64_t>(n) << 32) | static_cast<uint32_t>(~n);
+}
+
+bool consistent(const CanTimestampedMsg& latest, uint32_t* n) {
+    *n = static_cast<uint32_t>(latest.timestampNs);
+    return latest.message.id == MSG_ID_MARINE_SENSOR_DATA && latest.message.header.length == *n % 9 &&
+           CanPayload::load(latest.message.data) == payloadOf(*n);
+}
+
+void checkConcurrentReads() {
+    CanLatestValueCache cache;
+    std::atomic<bool> writing(true);
+    std::vector<int> tornReads(READERS, 0);
+    std::vector<int> goingBack(READERS, 0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < READERS; r++) {
+        readers.push_back(std::thread([&cache, &writing, &tornReads, &goingBack, r]() {
+            uint32_t last = 0;
+            CanTimestampedMsg latest;
+            while (writing.load(std::memory_order_relaxed)) {
+                uint32_t n;
+                if (!cache.read(MSG_ID_MARINE_SENSOR_DATA, latest)) {
+                    continue;
+                }
+                if (!consistent(latest, &n)) {
+                    tornReads[r]++;
+                } else if (n < last) {
+                    goingBack[r]++;
+                } else {
+                    last = n;
+                }
+            }
+        }));
+    }
+
+    for (uint32_t n = 1; n <= WRITES; n++) {
+        CanMsg frame = makeFrame(MSG_ID_MARINE_SENSOR_DATA, payloadOf(n));
+        frame.header.length = static_cast<uint8_t>(n % 9);
+        cache.update(frame, n);
+        if (n % 64 == 0) {
+            std::this_thread::yield();  // let the readers run between writes on a single core
+        }
+    }
+    writing.store(false, std::memory_order_relaxed);
+    for (size_t r = 0; r < readers.size(); r++) {
+        readers[r].join();
+        CAN_CHECK(tornReads[r] == 0);
+        CAN_CHECK(goingBack[r] == 0);
+    }
+
+    CanTimestampedMsg latest;
+    uint32_t n;
+    CAN_CHECK(cache.read(MSG_ID_MARINE_SENSOR_DATA, latest) && consistent(latest, &n) && n == WRITES);
+}
+
+}  // namespace
+
+int main() {
+    checkSlots();
+    checkCurrentSensorSlots();
+    checkConcurrentReads();
+    return canTestResult();
+}
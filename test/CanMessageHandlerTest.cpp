@@ -0,0 +1,226 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMessageHandlerTest.cpp
+ *
+ * Purpose:
+ *    CanMessageHandler against a bit by bit model of the payload, where bit i is bit
+ *    i % 8 of CanMsg.data[7 - i / 8]: every field of canbus_datamappings_defs.h read
+ *    and written with the bit-indexed and byte-indexed functions, the byte order of
+ *    getMessage(), getPayload() and getMessageInBitset() against CanPayload::load()
+ *    and store(), the sequential getData() / encodeMessage(), and canMsgToBitset() /
+ *    bitsetToCanMsg() leaving the payload as it is. Also built with the Arduino codec
+ *    as CanMessageHandlerBytewiseTest.
+ *
+ ***************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CanMessageHandler.h"
+#include "CanTest.h"
+
+namespace {
+
+const int RUNS = 2000;
+
+struct FieldLayout {
+    const char* name;
+    uint32_t messageId;
+    uint32_t start;
+    uint32_t size;
+    bool inBytes;
+};
+
+#define FIELD_LAYOUT(NAME, ID) \
+    { #NAME, ID, static_cast<uint32_t>(NAME##_START), static_cast<uint32_t>(NAME##_DATASIZE), NAME##_IN_BYTE != 0 }
+
+const FieldLayout FIELDS[] = {
+    FIELD_LAYOUT(SENSOR_PH, MSG_ID_MARINE_SENSOR_DATA),
+    FIELD_LAYOUT(SENSOR_CONDUCTIVETY, MSG_ID_MARINE_SENSOR_DATA),
+    FIELD_LAYOUT(SENSOR_TEMPERATURE, MSG_ID_MARINE_SENSOR_DATA),
+    FIELD_LAYOUT(SENSOR_ERROR, MSG_ID_MARINE_SENSOR_DATA),
+    FIELD_LAYOUT(RUDDER_ANGLE, MSG_ID_AU_CONTROL),
+    FIELD_LAYOUT(WINGSAIL_ANGLE, MSG_ID_AU_CONTROL),
+    FIELD_LAYOUT(WINDVANE_SELFSTEERING_ANGLE, MSG_ID_AU_CONTROL),
+    FIELD_LAYOUT(WINDVANE_ACTUATOR_POSITION, MSG_ID_AU_FEEDBACK),
+    FIELD_LAYOUT(WINDVANE_SELFSTEERING_ON, MSG_ID_AU_CONTROL),
+    FIELD_LAYOUT(RADIOCONTROLLER_ON, MSG_ID_RC_STATUS),
+    FIELD_LAYOUT(CURRENT_SENSOR_CURRENT, MSG_ID_CURRENT_SENSOR_DATA),
+    FIELD_LAYOUT(CURRENT_SENSOR_VOLTAGE, MSG_ID_CURRENT_SENSOR_DATA),
+    FIELD_LAYOUT(CURRENT_SENSOR_ID, MSG_ID_CURRENT_SENSOR_DATA),
+    FIELD_LAYOUT(CURRENT_SENSOR_ROL_NUM, MSG_ID_CURRENT_SENSOR_DATA),
+    FIELD_LAYOUT(CURRENT_SENSOR_ERROR, MSG_ID_CURRENT_SENSOR_DATA),
+};
+
+// The model, one bit at a time
+
+bool modelBit(const uint8_t* data, uint32_t bit) {
+    return (data[7 - bit / 8] >> (bit % 8)) & 1;
+}
+
+uint64_t modelGet(const uint8_t* data, uint32_t start, uint32_t length) {
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        value |= static_cast<uint64_t>(modelBit(data, start + i)) << i;
+    }
+    return value;
+}
+
+void modelSet(uint8_t* data, uint32_t start, uint32_t length, uint64_t value) {
+    for (uint32_t i = 0; i < length; i++) {
+        uint8_t& byte = data[7 - (start + i) / 8];
+        uint8_t mask = static_cast<uint8_t>(1 << ((start + i) % 8));
+        byte = ((value >> i) & 1) ? (byte | mask) : (byte & ~mask);
+    }
+}
+
+uint64_t randomWord() {
+    uint64_t word = 0;
+    for (int i = 0; i < 4; i++) {
+        word = (word << 16) ^ static_cast<uint64_t>(rand());
+    }
+    return word;
+}
+
+CanMsg randomFrame(uint32_t messageId) {
+    CanMsg frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.id = messageId;
+    frame.header.length = 8;
+    for (int i = 0; i < 8; i++) {
+        frame.data[i] = static_cast<uint8_t>(rand());
+    }
+    return frame;
+}
+
+bool sameFrame(const CanMsg& first, const CanMsg& second) {
+    return first.id == second.id && first.header.ide == second.header.ide &&
+           first.header.length == second.header.length && memcmp(first.data, second.data, 8) == 0;
+}
+
+void checkField(const FieldLayout& field) {
+    const uint32_t startBit = field.inBytes ? field.start * 8 : field.start;
+    const uint32_t length = field.inBytes ? field.size * 8 : field.size;
+    const unsigned long failures = g_canTestFailures;
+    for (int i = 0; i < RUNS; i++) {
+        CanMsg frame = randomFrame(field.messageId);
+        if (i == 0) {
+            modelSet(frame.data, startBit, length, 0);
+        }
+        uint64_t expected = modelGet(frame.data, startBit, length);
+
+        CanMessageHandler handler(frame);
+        uint64_t value = ~0ULL;
+        CAN_CHECK(handler.getData(&value, startBit, length, false) == (expected != 0));
+        CAN_CHECK(value == expected);
+        if (field.inBytes) {
+            value = ~0ULL;
+            CAN_CHECK(handler.getData(&value, field.start, field.size, true) == (expected != 0));
+            CAN_CHECK(value == expected);
+        }
+
+        uint64_t newValue = randomWord();
+        CanMsg modelFrame = frame;
+        modelSet(modelFrame.data, startBit, length, newValue);
+        CAN_CHECK(handler.encodeMessage(newValue, startBit, length, false));
+        CAN_CHECK(sameFrame(handler.getMessage(), modelFrame));
+        if (field.inBytes) {
+            CanMessageHandler byteHandler(frame);
+            CAN_CHECK(byteHandler.encodeMessage(newValue, field.start, field.size, true));
+            CAN_CHECK(sameFrame(byteHandler.getMessage(), modelFrame));
+        }
+    }
+    if (g_canTestFailures != failures) {
+        fprintf(stderr, "in field %s\n", field.name);
+    }
+}
+
+void checkByteOrder() {
+    for (int i = 0; i < RUNS; i++) {
+        CanMsg frame = randomFrame(MSG_ID_MARINE_SENSOR_DATA);
+        frame.header.ide = i % 2;
+        CanMessageHandler handler(frame);
+
+        uint64_t word = 0;
+        for (int byte = 0; byte < 8; byte++) {
+            word = (word << 8) | frame.data[byte];
+        }
+        CAN_CHECK(handler.getPayload() == word);
+        CAN_CHECK(handler.getPayload() == CanPayload::load(frame.data));
+        CAN_CHECK(sameFrame(handler.getMessage(), frame));
+
+        uint8_t stored[8];
+        CanPayload::store(handler.getPayload(), stored);
+        CAN_CHECK(memcmp(stored, frame.data, 8) == 0);
+
+        std::bitset<64> bits = handler.getMessageInBitset();
+        bool sameBits = true;
+        for (uint32_t bit = 0; bit < 64; bit++) {
+            sameBits = sameBits && bits[bit] == modelBit(frame.data, bit);
+        }
+        CAN_CHECK(sameBits);
+    }
+
+    // a new message: zero payload but the error byte, 8 bytes, standard id
+    CanMessageHandler handler(MSG_ID_AU_CONTROL);
+    CanMsg message = handler.getMessage();
+    CAN_CHECK(handler.getMessageId() == MSG_ID_AU_CONTROL);
+    CAN_CHECK(message.id == MSG_ID_AU_CONTROL && message.header.ide == 0 && message.header.length == 8);
+    CAN_CHECK(handler.getPayload() == (static_cast<uint64_t>(NO_ERRORS) << 56));
+    CAN_CHECK(handler.getErrorMessage() == NO_ERRORS);
+}
+
+void checkSequential() {
+    CanMessageHandler handler(MSG_ID_AU_CONTROL);
+    // little-endian from data[0], one field after the other
+    CAN_CHECK(handler.encodeMessage(2, 0x1234));
+    CAN_CHECK(handler.encodeMessage(1, 0xAB));
+    CAN_CHECK(handler.encodeMessage(4, 0x89ABCDEFUL));
+    CAN_CHECK(!handler.encodeMessage(1, 0x55));  // data[7] is the error byte
+    CanMsg message = handler.getMessage();
+    const uint8_t expected[7] = {0x34, 0x12, 0xAB, 0xEF, 0xCD, 0xAB, 0x89};
+    CAN_CHECK(memcmp(message.data, expected, sizeof(expected)) == 0);
+
+    CanMessageHandler reader(message);
+    uint16_t first = 0;
+    uint8_t second = 0;
+    uint32_t third = 0;
+    CAN_CHECK(reader.getData(&first, 2) && first == 0x1234);
+    CAN_CHECK(reader.getData(&second, 1) && second == 0xAB);
+    CAN_CHECK(reader.getData(&third, 4) && third == 0x89ABCDEFUL);
+    CAN_CHECK(!reader.getData(&second, 1));
+}
+
+void checkConversions() {
+    for (int i = 0; i < RUNS; i++) {
+        CanMsg frame = randomFrame(MSG_ID_CURRENT_SENSOR_DATA);
+        frame.data[i % 8] |= 1;  // never all zero
+        CanMessageHandler handler(frame);
+        CAN_CHECK(handler.canMsgToBitset());
+        CAN_CHECK(handler.bitsetToCanMsg());
+        CAN_CHECK(sameFrame(handler.getMessage(), frame));
+        CAN_CHECK(handler.getPayload() == CanPayload::load(frame.data));
+    }
+
+    // an empty payload is reported but left as it is
+    CanMsg empty = randomFrame(MSG_ID_RC_STATUS);
+    memset(empty.data, 0, sizeof(empty.data));
+    CanMessageHandler handler(empty);
+    CAN_CHECK(!handler.canMsgToBitset());
+    CAN_CHECK(handler.bitsetToCanMsg());
+    CAN_CHECK(sameFrame(handler.getMessage(), empty));
+}
+
+}  // namespace
+
+int main() {
+    srand(1);
+    for (size_t i = 0; i < sizeof(FIELDS) / sizeof(FIELDS[0]); i++) {
+        checkField(FIELDS[i]);
+    }
+    checkByteOrder();
+    checkSequential();
+    checkConversions();
+    return canTestResult();
+}
@@ -0,0 +1,259 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMessageRegistryTest.cpp
+ *
+ * Purpose:
+ *    CanMessageRegistry slots of every id of the range and around it, the error field
+ *    of each descriptor against getErrorMessage()/setErrorMessage() of
+ *    CanMessageHandler (keepFirstError, the 3 bits error of the current sensor
+ *    messages), the typed decoders, and CanMessageDispatcher.
+ *
+ ***************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CanMessageHandler.h"
+#include "CanMessageRegistry.h"
+#include "CanMessageSchema.h"
+#include "CanTest.h"
+
+namespace {
+
+const uint32_t KNOWN_IDS[] = {
+    MSG_ID_AU_CONTROL,
+    MSG_ID_AU_FEEDBACK,
+    MSG_ID_RC_STATUS,
+    MSG_ID_SOLAR_PANEL_CONTROL_PART_1,
+    MSG_ID_SOLAR_PANEL_CONTROL_PART_2,
+    MSG_ID_MARINE_SENSOR_REQUEST,
+    MSG_ID_MARINE_SENSOR_DATA,
+    MSG_ID_CURRENT_SENSOR_REQUEST,
+    MSG_ID_CURRENT_SENSOR_DATA,
+    MSG_ID_WINCH_CONTROL,
+    MSG_ID_WINCH_FEEDBACK,
+};
+const size_t KNOWN_ID_COUNT = sizeof(KNOWN_IDS) / sizeof(KNOWN_IDS[0]);
+
+bool isKnown(uint32_t messageId) {
+    for (size_t i = 0; i < KNOWN_ID_COUNT; i++) {
+        if (KNOWN_IDS[i] == messageId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t randomWord() {
+    uint64_t word = 0;
+    for (int i = 0; i < 4; i++) {
+        word = (word << 16) ^ static_cast<uint64_t>(rand());
+    }
+    return word;
+}
+
+/**
+ * Error field layout written out from canbus_datamappings_defs.h, apart from
+ * CanMessageRegistry.cpp
+ */
+struct ErrorField {
+    uint8_t start;
+    uint8_t length;
+    uint8_t maxValue;
+    bool keepFirstError;
+};
+
+ErrorField expectedErrorField(uint32_t messageId) {
+    if (messageId == MSG_ID_MARINE_SENSOR_DATA) {
+        ErrorField field = {MarineSensorData::Error::START_BIT, MarineSensorData::Error::LENGTH, 0xFF, false};
+        return field;
+    }
+    if (messageId == MSG_ID_CURRENT_SENSOR_REQUEST || messageId == MSG_ID_CURRENT_SENSOR_DATA) {
+        ErrorField field = {CurrentSensorData::Error::START_BIT, CurrentSensorData::Error::LENGTH, 7, false};
+        return field;
+    }
+    ErrorField field = {0, 8, 0xFF, true};  // CanMsg.data[7], also for unknown ids
+    return field;
+}
+
+void checkSlots() {
+    bool slotUsed[CanMessageRegistry::SLOT_COUNT] = {};
+    for (size_t i = 0; i < KNOWN_ID_COUNT; i++) {
+        uint8_t slot = CanMessageRegistry::slotOf(KNOWN_IDS[i]);
+        CAN_CHECK(slot < CanMessageRegistry::SLOT_COUNT);
+        if (slot < CanMessageRegistry::SLOT_COUNT) {
+            CAN_CHECK(!slotUsed[slot]);
+            slotUsed[slot] = true;
+            CAN_CHECK(CanMessageRegistry::descriptorAt(slot).id == KNOWN_IDS[i]);
+            CAN_CHECK(CanMessageRegistry::descriptor(KNOWN_IDS[i]).id == KNOWN_IDS[i]);
+        }
+    }
+    CAN_CHECK(KNOWN_ID_COUNT == CanMessageRegistry::SLOT_COUNT);
+
+    for (uint32_t id = CanMessageRegistry::FIRST_ID; id <= CanMessageRegistry::LAST_ID; id++) {
+        if (!isKnown(id)) {
+            CAN_CHECK(CanMessageRegistry::slotOf(id) == CanMessageRegistry::NO_SLOT);
+            CAN_CHECK(CanMessageRegistry::descriptor(id).id == 0);
+        }
+    }
+    const uint32_t outside[] = {0,
+                                1,
+                                CanMessageRegistry::FIRST_ID - 1,
+                                CanMessageRegistry::LAST_ID + 1,
+                                CanMessageRegistry::FIRST_ID + 256,
+                                0x7FF,
+                                0x1FFFFFFF,
+                                0xFFFFFFFF,
+                                CanMessageRegistry::FIRST_ID - CanMessageRegistry::ID_RANGE};
+    for (size_t i = 0; i < sizeof(outside) / sizeof(outside[0]); i++) {
+        CAN_CHECK(CanMessageRegistry::slotOf(outside[i]) == CanMessageRegistry::NO_SLOT);
+        CAN_CHECK(CanMessageRegistry::descriptor(outside[i]).id == 0);
+    }
+}
+
+uint8_t readField(uint64_t payload, const ErrorField& field) {
+    return static_cast<uint8_t>((payload >> field.start) & ((1U << field.length) - 1));
+}
+
+void checkErrorFields() {
+    for (uint32_t id = CanMessageRegistry::FIRST_ID - 2; id <= CanMessageRegistry::LAST_ID + 2; id++) {
+        ErrorField field = expectedErrorField(id);
+        CanMessageDescriptor descriptor = CanMessageRegistry::descriptor(id);
+        CAN_CHECK(descriptor.errorStart == field.start && descriptor.errorLength == field.length);
+        CAN_CHECK(descriptor.errorMaxValue == field.maxValue && descriptor.keepFirstError == field.keepFirstError);
+
+        uint64_t fieldMask = static_cast<uint64_t>((1U << field.length) - 1) << field.start;
+        for (int run = 0; run < 40; run++) {
+            uint64_t payload = randomWord();
+            if (run % 4 == 0) {
+                payload &= ~fieldMask;  // no error yet
+            }
+            CanMsg message = makeCanMsg(id, payload);
+            uint8_t current = readField(payload, field);
+            CAN_CHECK(CanMessageHandler(message).getErrorMessage() == current);
+            if (field.length == 8 && field.start == 0) {
+                CAN_CHECK(current == message.data[7]);
+            }
+
+            for (unsigned int code = 0; code < 256; code += (code < 16) ? 1 : 17) {
+                CanMessageHandler handler(message);
+                handler.setErrorMessage(static_cast<uint8_t>(code));
+                uint8_t written = (code > field.maxValue) ? field.maxValue : static_cast<uint8_t>(code);
+                uint8_t expected = (field.keepFirstError && current != NO_ERRORS) ? current : written;
+                uint64_t result = CanPayload::load(handler.getMessage().data);
+                CAN_CHECK(readField(result, field) == expected);
+                CAN_CHECK(handler.getErrorMessage() == expected);
+                CAN_CHECK((result & ~fieldMask) == (payload & ~fieldMask));  // the other bits are kept
+            }
+        }
+    }
+
+    // the 3 bits of the current sensor error, next to the rolling number and sensor id
+    CanMsg message = makeCanMsg(MSG_ID_CURRENT_SENSOR_DATA, 0);
+    CurrentSensorData::RollingNumber::encode(message, 3);
+    CurrentSensorData::SensorId::encode(message, 7);
+    CanMessageHandler handler(message);
+    handler.setErrorMessage(200);
+    CanMsg result = handler.getMessage();
+    CAN_CHECK(CurrentSensorData::Error::decode(result) == 7);
+    CAN_CHECK(CurrentSensorData::RollingNumber::decode(result) == 3);
+    CAN_CHECK(CurrentSensorData::SensorId::decode(result) == 7);
+    handler.setErrorMessage(2);  // not kept: overwritten
+    CAN_CHECK(CurrentSensorData::Error::decode(handler.getMessage()) == 2);
+
+    // the legacy byte keeps the first error
+    CanMessageHandler legacy(MSG_ID_WINCH_CONTROL);
+    legacy.setErrorMessage(5);
+    legacy.setErrorMessage(6);
+    CAN_CHECK(legacy.getErrorMessage() == 5 && legacy.getMessage().data[7] == 5);
+}
+
+void checkDecoders() {
+    CanMsg message = makeCanMsg(MSG_ID_MARINE_SENSOR_DATA, randomWord());
+    MarineSensorData marine;
+    CanMessageRegistry::descriptor(MSG_ID_MARINE_SENSOR_DATA).decoder(message, &marine);
+    CAN_CHECK(marine.toPayload() == MarineSensorData::fromMessage(message).toPayload());
+
+    message = makeCanMsg(MSG_ID_CURRENT_SENSOR_DATA, randomWord());
+    CurrentSensorData current;
+    CanMessageRegistry::descriptor(MSG_ID_CURRENT_SENSOR_DATA).decoder(message, &current);
+    CAN_CHECK(current.toPayload() == CurrentSensorData::fromMessage(message).toPayload());
+
+    message = makeCanMsg(MSG_ID_AU_CONTROL, randomWord());
+    AuControl control;
+    CanMessageRegistry::descriptor(MSG_ID_AU_CONTROL).decoder(message, &control);
+    CAN_CHECK(control.toPayload() == AuControl::fromMessage(message).toPayload());
+
+    message = makeCanMsg(MSG_ID_AU_FEEDBACK, randomWord());
+    AuFeedback feedback;
+    CanMessageRegistry::descriptor(MSG_ID_AU_FEEDBACK).decoder(message, &feedback);
+    CAN_CHECK(feedback.toPayload() == AuFeedback::fromMessage(message).toPayload());
+
+    message = makeCanMsg(MSG_ID_RC_STATUS, randomWord());
+    RcStatus status;
+    CanMessageRegistry::descriptor(MSG_ID_RC_STATUS).decoder(message, &status);
+    CAN_CHECK(status.toPayload() == RcStatus::fromMessage(message).toPayload());
+
+    CAN_CHECK(CanMessageRegistry::descriptor(MSG_ID_WINCH_CONTROL).decoder == NULL);
+    CAN_CHECK(CanMessageRegistry::descriptor(MSG_ID_MARINE_SENSOR_REQUEST).decoder == NULL);
+    CAN_CHECK(CanMessageRegistry::descriptor(0).decoder == NULL);
+}
+
+struct Calls {
+    uint32_t lastId;
+    int count;
+};
+
+void recordCall(const CanMsg& message, void* context) {
+    Calls* calls = static_cast<Calls*>(context);
+    calls->lastId = message.id;
+    calls->count++;
+}
+
+void checkDispatcher() {
+    CanMessageDispatcher dispatcher;
+    Calls handlerCalls[KNOWN_ID_COUNT] = {};
+    Calls defaultCalls = {};
+
+    CAN_CHECK(!dispatcher.dispatch(makeCanMsg(MSG_ID_AU_CONTROL, 0)));  // no handler at all
+    for (size_t i = 0; i < KNOWN_ID_COUNT; i++) {
+        CAN_CHECK(dispatcher.setHandler(KNOWN_IDS[i], recordCall, &handlerCalls[i]));
+    }
+    CAN_CHECK(!dispatcher.setHandler(MSG_ID_AU_CONTROL + 50, recordCall, &defaultCalls));
+    CAN_CHECK(!dispatcher.setHandler(0xFFFFFFFF, recordCall, &defaultCalls));
+
+    for (size_t i = 0; i < KNOWN_ID_COUNT; i++) {
+        CAN_CHECK(dispatcher.dispatch(makeCanMsg(KNOWN_IDS[i], 0)));
+        CAN_CHECK(handlerCalls[i].count == 1 && handlerCalls[i].lastId == KNOWN_IDS[i]);
+    }
+    CAN_CHECK(!dispatcher.dispatch(makeCanMsg(MSG_ID_AU_CONTROL + 50, 0)));
+
+    dispatcher.setDefaultHandler(recordCall, &defaultCalls);
+    CAN_CHECK(dispatcher.dispatch(makeCanMsg(MSG_ID_AU_CONTROL + 50, 0)));
+    CAN_CHECK(dispatcher.dispatch(makeCanMsg(0x1FFFFFFF, 0)));
+    CAN_CHECK(defaultCalls.count == 2 && defaultCalls.lastId == 0x1FFFFFFF);
+
+    // removed: the default handler takes over
+    CAN_CHECK(dispatcher.setHandler(MSG_ID_WINCH_FEEDBACK, NULL));
+    CAN_CHECK(dispatcher.dispatch(makeCanMsg(MSG_ID_WINCH_FEEDBACK, 0)));
+    CAN_CHECK(defaultCalls.count == 3 && defaultCalls.lastId == MSG_ID_WINCH_FEEDBACK);
+    CAN_CHECK(handlerCalls[KNOWN_ID_COUNT - 1].count == 1);
+
+    // replaced
+    Calls replaced = {};
+    CAN_CHECK(dispatcher.setHandler(MSG_ID_AU_CONTROL, recordCall, &replaced));
+    CAN_CHECK(dispatcher.dispatch(makeCanMsg(MSG_ID_AU_CONTROL, 0)));
+    CAN_CHECK(replaced.count == 1 && handlerCalls[0].count == 1);
+}
+
+}  // namespace
+
+int main() {
+    srand(1);
+    checkSlots();
+    checkErrorFields();
+    checkDecoders();
+    checkDispatcher();
+    return canTestResult();
+}
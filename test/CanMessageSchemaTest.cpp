@@ -0,0 +1,130 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMessageSchemaTest.cpp
+ *
+ * Purpose:
+ *    The typed fields and structs of CanMessageSchema.h against getData() and
+ *    encodeMessage() of CanMessageHandler, bit-indexed and byte-indexed, on random
+ *    payloads, for every field of every struct. Also CanFieldsDisjoint on fields that
+ *    overlap without being neighbours.
+ *
+ ***************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "CanMessageHandler.h"
+#include "CanMessageSchema.h"
+#include "CanTest.h"
+
+namespace {
+
+const int RUNS = 2000;
+
+typedef CanField<0, 8, false> LowByte;
+typedef CanField<8, 8, false> SecondByte;
+typedef CanField<4, 2, false> InLowByte;
+static_assert(CanFieldsDisjoint<>::value && CanFieldsDisjoint<LowByte>::value, "CanFieldsDisjoint: trivial cases");
+static_assert(CanFieldsDisjoint<LowByte, SecondByte>::value, "CanFieldsDisjoint: neighbours");
+// every pair is checked, not only the neighbours in the list
+static_assert(!CanFieldsDisjoint<LowByte, SecondByte, InLowByte>::value, "CanFieldsDisjoint: first and last");
+static_assert(!CanFieldsDisjoint<SecondByte, LowByte, InLowByte>::value, "CanFieldsDisjoint: last two");
+static_assert(!CanFieldsDisjoint<CAN_FIELD(WINDVANE_SELFSTEERING_ANGLE), CAN_FIELD(RUDDER_ANGLE),
+                                 CAN_FIELD(WINDVANE_SELFSTEERING_ON)>::value,
+              "CanFieldsDisjoint: WINDVANE_SELFSTEERING_ON is in WINDVANE_SELFSTEERING_ANGLE");
+
+uint64_t randomWord() {
+    uint64_t word = 0;
+    for (int i = 0; i < 4; i++) {
+        word = (word << 16) ^ static_cast<uint64_t>(rand());
+    }
+    return word;
+}
+
+bool sameData(const CanMsg& first, const CanMsg& second) {
+    return memcmp(first.data, second.data, sizeof(first.data)) == 0;
+}
+
+/**
+ * Field::decode() and encode() against the handler, bit-indexed and, for whole bytes,
+ * byte-indexed
+ */
+template <class Field>
+void checkField(uint32_t messageId) {
+    const bool wholeBytes = Field::START_BIT % 8 == 0 && Field::LENGTH % 8 == 0;
+    for (int i = 0; i < RUNS; i++) {
+        CanMsg message = makeCanMsg(messageId, randomWord());
+        CanMessageHandler handler(message);
+        uint64_t value = 0xFFFF;
+        handler.getData(&value, Field::START_BIT, Field::LENGTH, false);
+        CAN_CHECK(value == Field::decode(message));
+        if (wholeBytes) {
+            value = 0xFFFF;
+            handler.getData(&value, Field::START_BIT / 8, Field::LENGTH / 8, true);
+            CAN_CHECK(value == Field::decode(message));
+        }
+
+        uint64_t newValue = randomWord();
+        CanMsg typed = message;
+        Field::encode(typed, newValue);
+        CAN_CHECK(Field::decode(typed) == static_cast<typename Field::ValueType>(newValue & Field::MASK));
+        CAN_CHECK(handler.encodeMessage(newValue, Field::START_BIT, Field::LENGTH, false));
+        CAN_CHECK(sameData(handler.getMessage(), typed));
+        if (wholeBytes) {
+            CanMessageHandler byteHandler(message);
+            CAN_CHECK(byteHandler.encodeMessage(newValue, Field::START_BIT / 8, Field::LENGTH / 8, true));
+            CAN_CHECK(sameData(byteHandler.getMessage(), typed));
+        }
+    }
+}
+
+// The fields of source set one by one with the handler
+void encodeWithHandler(CanMessageHandler&, const CanMsg&) {}
+
+template <class Field, class... Others>
+void encodeWithHandler(CanMessageHandler& handler, const CanMsg& source, Field, Others... others) {
+    CAN_CHECK(handler.encodeMessage(Field::decode(source), Field::START_BIT, Field::LENGTH, false));
+    encodeWithHandler(handler, source, others...);
+}
+
+template <class Message, class... Fields>
+void checkMessage() {
+    int fields[] = {(checkField<Fields>(Message::ID), 0)...};
+    (void)fields;
+
+    for (int i = 0; i < RUNS; i++) {
+        CanMsg message = makeCanMsg(Message::ID, randomWord());
+        CanMsg typed = Message::fromMessage(message).toMessage();
+        CanMessageHandler handler(makeCanMsg(Message::ID, 0));
+        encodeWithHandler(handler, message, Fields()...);
+        CanMsg expected = handler.getMessage();
+        CAN_CHECK(typed.id == Message::ID && typed.header.length == 8 && typed.header.ide == 0);
+        CAN_CHECK(sameData(typed, expected));
+        CAN_CHECK(Message::fromPayload(CanPayload::load(message.data)).toPayload() == CanPayload::load(typed.data));
+    }
+}
+
+}  // namespace
+
+int main() {
+    srand(1);
+    checkMessage<MarineSensorData, MarineSensorData::Ph, MarineSensorData::Conductivity,
+                 MarineSensorData::Temperature, MarineSensorData::Error>();
+    checkMessage<AuControl, AuControl::Rudder, AuControl::Wingsail, AuControl::WindvaneSelfSteeringAngle>();
+    checkMessage<AuFeedback, AuFeedback::Rudder, AuFeedback::Wingsail, AuFeedback::WindvaneSelfSteeringAngle,
+                 AuFeedback::WindvaneActuatorPosition>();
+    checkMessage<RcStatus, RcStatus::RadioControllerOn>();
+    checkMessage<CurrentSensorData, CurrentSensorData::Voltage, CurrentSensorData::Current,
+                 CurrentSensorData::Error, CurrentSensorData::RollingNumber, CurrentSensorData::SensorId>();
+
+    // the struct members hold what the fields decode
+    CanMsg message = makeCanMsg(MSG_ID_CURRENT_SENSOR_DATA, randomWord());
+    CurrentSensorData data = CurrentSensorData::fromMessage(message);
+    CAN_CHECK(data.voltage == CurrentSensorData::Voltage::decode(message));
+    CAN_CHECK(data.current == CurrentSensorData::Current::decode(message));
+    CAN_CHECK(data.error == CurrentSensorData::Error::decode(message));
+    CAN_CHECK(data.rollingNumber == CurrentSensorData::RollingNumber::decode(message));
+    CAN_CHECK(data.sensorId == CurrentSensorData::SensorId::decode(message));
+    return canTestResult();
+}
@@ -0,0 +1,201 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMessageViewTest.cpp
+ *
+ * Purpose:
+ *    CanMessageView and CanMessageEncoder against CanMessageHandler on random frames:
+ *    every field of canbus_datamappings_defs.h with a start position, plain, mapped
+ *    and quantized, the error field of every message id and the out of bounds fields.
+ *    Results, return values and frames must be the same.
+ *
+ ***************************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CanFixedPointMapping.h"
+#include "CanMessageHandler.h"
+#include "CanMessageRegistry.h"
+#include "CanMessageView.h"
+#include "CanQuantizer.h"
+#include "CanTest.h"
+#include "canbus_datamappings_defs.h"
+
+namespace {
+
+const int RUNS = 20000;
+
+uint64_t randomWord() {
+    uint64_t word = 0;
+    for (int i = 0; i < 4; i++) {
+        word = (word << 16) ^ static_cast<uint64_t>(rand());
+    }
+    return word;
+}
+
+CanMsg randomMessage(uint32_t messageId) {
+    CanMsg message;
+    message.id = messageId;
+    message.header.ide = 0;
+    message.header.length = 8;
+    CanPayload::store(randomWord(), message.data);
+    return message;
+}
+
+bool sameData(const CanMsg& a, const CanMsg& b) {
+    return memcmp(a.data, b.data, sizeof(a.data)) == 0;
+}
+
+void checkField(uint32_t start, uint32_t length, bool varInBytes) {
+    for (int i = 0; i < RUNS; i++) {
+        CanMsg message = randomMessage(MSG_ID_MARINE_SENSOR_DATA);
+        CanMessageHandler handler(message);
+        CanMessageView view(message);
+
+        uint64_t fromHandler;
+        uint64_t fromView;
+        bool handlerValid = handler.getData(&fromHandler, start, length, varInBytes);
+        CAN_CHECK(view.getData(&fromView, start, length, varInBytes) == handlerValid);
+        CAN_CHECK(fromView == fromHandler);
+
+        uint8_t narrowFromHandler;
+        uint8_t narrowFromView;
+        handlerValid = handler.getData(&narrowFromHandler, start, length, varInBytes);
+        CAN_CHECK(view.getData(&narrowFromView, start, length, varInBytes) == handlerValid);
+        CAN_CHECK(narrowFromView == narrowFromHandler);
+
+        uint64_t value = randomWord();
+        CanMessageEncoder encoder(message);
+        CAN_CHECK(encoder.encodeMessage(value, start, length, varInBytes) ==
+                  handler.encodeMessage(value, start, length, varInBytes));
+        CAN_CHECK(sameData(handler.getMessage(), message));
+    }
+}
+
+template <class Mapping>
+void checkMappedField(uint32_t start, uint32_t length, bool varInBytes, const Mapping& mapping) {
+    for (int i = 0; i < RUNS; i++) {
+        CanMsg message = randomMessage(MSG_ID_MARINE_SENSOR_DATA);
+        CanMessageHandler handler(message);
+        CanMessageView view(message);
+
+        float fromHandler;
+        float fromView;
+        bool handlerValid = handler.getMappedData(&fromHandler, start, length, varInBytes, mapping);
+        CAN_CHECK(view.getMappedData(&fromView, start, length, varInBytes, mapping) == handlerValid);
+        CAN_CHECK(fromView == fromHandler);
+
+        // a tenth of the values outside of the interval
+        long span = mapping.maxValue() - mapping.minValue();
+        float value = static_cast<float>(mapping.minValue()) +
+                      static_cast<float>(span) * (static_cast<float>(rand() % 11000) / 10000.0f - 0.05f);
+        CanMessageEncoder encoder(message);
+        CAN_CHECK(encoder.encodeMappedMessage(value, start, length, varInBytes, mapping) ==
+                  handler.encodeMappedMessage(value, start, length, varInBytes, mapping));
+        CAN_CHECK(sameData(handler.getMessage(), message));
+    }
+}
+
+template <class Quantizer>
+void checkQuantizedField(uint32_t start, uint32_t length, bool varInBytes, const Quantizer& quantizer) {
+    for (int i = 0; i < RUNS; i++) {
+        CanMsg message = randomMessage(MSG_ID_CURRENT_SENSOR_DATA);
+        CanMessageHandler handler(message);
+        CanMessageView view(message);
+
+        float fromHandler;
+        float fromView;
+        bool handlerValid = handler.getQuantizedData(&fromHandler, start, length, varInBytes, quantizer);
+        CAN_CHECK(view.getQuantizedData(&fromView, start, length, varInBytes, quantizer) == handlerValid);
+        CAN_CHECK(memcmp(&fromView, &fromHandler, sizeof(float)) == 0);  // NaN included
+
+        float value = quantizer.maxValue() * (static_cast<float>(rand() % 2200) / 1000.0f - 1.1f);
+        CanMessageEncoder encoder(message);
+        CAN_CHECK(encoder.encodeQuantized(value, start, length, varInBytes, quantizer) ==
+                  handler.encodeQuantized(value, start, length, varInBytes, quantizer));
+        CAN_CHECK(sameData(handler.getMessage(), message));
+    }
+}
+
+#define CHECK_FIELD(NAME) checkField(NAME##_START, NAME##_DATASIZE, NAME##_IN_BYTE)
+
+void checkFields() {
+    CHECK_FIELD(SENSOR_PH);
+    CHECK_FIELD(SENSOR_CONDUCTIVETY);
+    CHECK_FIELD(SENSOR_TEMPERATURE);
+    CHECK_FIELD(SENSOR_ERROR);
+    CHECK_FIELD(RUDDER_ANGLE);
+    CHECK_FIELD(WINGSAIL_ANGLE);
+    CHECK_FIELD(WINDVANE_SELFSTEERING_ANGLE);
+    CHECK_FIELD(WINDVANE_ACTUATOR_POSITION);
+    CHECK_FIELD(WINDVANE_SELFSTEERING_ON);
+    CHECK_FIELD(RADIOCONTROLLER_ON);
+    CHECK_FIELD(CURRENT_SENSOR_CURRENT);
+    CHECK_FIELD(CURRENT_SENSOR_VOLTAGE);
+    CHECK_FIELD(CURRENT_SENSOR_ID);
+    CHECK_FIELD(CURRENT_SENSOR_ROL_NUM);
+    CHECK_FIELD(CURRENT_SENSOR_ERROR);
+
+    // out of bounds, in bytes and in bits
+    checkField(7, 2, true);
+    checkField(60, 5, false);
+}
+
+void checkMappedFields() {
+    checkMappedField(SENSOR_PH_START, SENSOR_PH_DATASIZE, SENSOR_PH_IN_BYTE,
+                     CanFixedPointMapping<SENSOR_PH_INTERVAL_MIN, SENSOR_PH_INTERVAL_MAX, 8>());
+    checkMappedField(SENSOR_CONDUCTIVETY_START, SENSOR_CONDUCTIVETY_DATASIZE, SENSOR_CONDUCTIVETY_IN_BYTE,
+                     CanFixedPointMapping<SENSOR_CONDUCTIVETY_INTERVAL_MIN, SENSOR_CONDUCTIVETY_INTERVAL_MAX, 32>());
+    checkMappedField(SENSOR_TEMPERATURE_START, SENSOR_TEMPERATURE_DATASIZE, SENSOR_TEMPERATURE_IN_BYTE,
+                     CanFixedPointMapping<SENSOR_TEMPERATURE_INTERVAL_MIN, SENSOR_TEMPERATURE_INTERVAL_MAX, 16>());
+    checkMappedField(WINDVANE_SELFSTEERING_ANGLE_START, WINDVANE_SELFSTEERING_ANGLE_DATASIZE,
+                     WINDVANE_SELFSTEERING_ANGLE_IN_BYTE,
+                     CanFixedPointMapping<WINDVANE_SELFSTEERING_ANGLE_MIN, WINDVANE_SELFSTEERING_ANGLE_MAX, 16>());
+
+    // mapping and field lengths differ
+    checkMappedField(SENSOR_PH_START, SENSOR_PH_DATASIZE, SENSOR_PH_IN_BYTE,
+                     CanFixedPointMapping<SENSOR_PH_INTERVAL_MIN, SENSOR_PH_INTERVAL_MAX, 7>());
+}
+
+void checkQuantizedFields() {
+    checkQuantizedField(CURRENT_SENSOR_CURRENT_START, CURRENT_SENSOR_CURRENT_DATASIZE, CURRENT_SENSOR_CURRENT_IN_BYTE,
+                        MiniFloat<5, 10>());
+    checkQuantizedField(CURRENT_SENSOR_VOLTAGE_START, CURRENT_SENSOR_VOLTAGE_DATASIZE, CURRENT_SENSOR_VOLTAGE_IN_BYTE,
+                        ScaledInteger<0, 60, 16>());
+    checkQuantizedField(CURRENT_SENSOR_VOLTAGE_START, CURRENT_SENSOR_VOLTAGE_DATASIZE, CURRENT_SENSOR_VOLTAGE_IN_BYTE,
+                        MiniFloat<4, 3>());
+}
+
+// Every id of the registry range and a few around it, for each error code
+void checkErrorMessages() {
+    for (uint32_t messageId = CanMessageRegistry::FIRST_ID - 2; messageId <= CanMessageRegistry::LAST_ID + 2;
+         messageId++) {
+        for (uint32_t code = 0; code <= 0xFF; code++) {
+            CanMsg message = randomMessage(messageId);
+            if (code % 2 == 0) {
+                memset(message.data, 0, sizeof(message.data));  // no error set yet
+            }
+            CanMessageHandler handler(message);
+            CanMessageView view(message);
+            CAN_CHECK(view.getErrorMessage() == handler.getErrorMessage());
+
+            CanMessageEncoder encoder(message);
+            encoder.setErrorMessage(static_cast<uint8_t>(code));
+            handler.setErrorMessage(static_cast<uint8_t>(code));
+            CAN_CHECK(sameData(handler.getMessage(), message));
+            CAN_CHECK(encoder.view().getErrorMessage() == handler.getErrorMessage());
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    checkFields();
+    checkMappedFields();
+    checkQuantizedFields();
+    checkErrorMessages();
+    return canTestResult();
+}
@@ -0,0 +1,186 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanMsgRingBufferTest.cpp
+ *
+ * Purpose:
+ *    CanMsgSpscRing and CanMsgMpscRing on one thread (full ring, batches, overflow
+ *    count, index wraparound), then under load: one producer for the SPSC ring and
+ *    four for the MPSC ring, the consumer checks that every frame arrives once and in
+ *    order for each producer. Also built with ThreadSanitizer as
+ *    CanMsgRingBufferTsanTest when the compiler supports it.
+ *
+ ***************************************************************************************/
+
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "CanMsgRingBuffer.h"
+#include "CanTest.h"
+
+namespace {
+
+const uint32_t FRAMES_PER_PRODUCER = 100000;
+const uint8_t PRODUCERS = 4;
+const size_t MAX_BATCH = 7;
+
+// The producer in data[0], its sequence number in data[1..4]
+CanMsg makeFrame(uint8_t producer, uint32_t sequence) {
+    CanMsg frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.id = 700 + producer;
+    frame.header.length = 8;
+    frame.data[0] = producer;
+    memcpy(&frame.data[1], &sequence, sizeof(sequence));
+    frame.data[7] = static_cast<uint8_t>(sequence ^ producer);
+    return frame;
+}
+
+bool readFrame(const CanMsg& frame, uint8_t* producer, uint32_t* sequence) {
+    *producer = frame.data[0];
+    memcpy(sequence, &frame.data[1], sizeof(*sequence));
+    return frame.id == 700u + *producer && frame.data[7] == static_cast<uint8_t>(*sequence ^ *producer);
+}
+
+template <class Ring>
+void checkFullRing() {
+    Ring ring;
+    const size_t capacity = Ring::capacity();
+    CanMsg frame;
+
+    CAN_CHECK(!ring.pop(frame));
+    for (size_t round = 0; round < 3; round++) {  // the indices go past the capacity
+        for (uint32_t i = 0; i < capacity; i++) {
+            CAN_CHECK(ring.push(makeFrame(0, i)));
+        }
+        CAN_CHECK(ring.size() == capacity);
+        CAN_CHECK(!ring.push(makeFrame(0, 999)));
+        CAN_CHECK(ring.overflowCount() == round + 1);
+
+        for (uint32_t i = 0; i < capacity; i++) {
+            uint8_t producer;
+            uint32_t sequence;
+            CAN_CHECK(ring.pop(frame) && readFrame(frame, &producer, &sequence) && sequence == i);
+        }
+        CAN_CHECK(!ring.pop(frame));
+        CAN_CHECK(ring.size() == 0);
+    }
+}
+
+template <class Ring>
+void checkBatches() {
+    Ring ring;
+    const size_t capacity = Ring::capacity();
+    std::vector<CanMsg> frames(capacity + 3);
+    for (uint32_t i = 0; i < frames.size(); i++) {
+        frames[i] = makeFrame(1, i);
+    }
+
+    CAN_CHECK(ring.push(&frames[0], 0) == 0);
+    CAN_CHECK(ring.push(&frames[0], 3) == 3);
+    // room for capacity - 3 frames out of capacity
+    CAN_CHECK(ring.push(&frames[3], capacity) == capacity - 3);
+    CAN_CHECK(ring.overflowCount() == 3);
+    CAN_CHECK(ring.size() == capacity);
+
+    std::vector<CanMsg> popped(capacity + 3);
+    CAN_CHECK(ring.pop(&popped[0], 2) == 2);
+    CAN_CHECK(ring.pop(&popped[2], capacity + 3) == capacity - 2);
+    for (uint32_t i = 0; i < capacity; i++) {
+        CAN_CHECK(memcmp(&popped[i], &frames[i], sizeof(CanMsg)) == 0);
+    }
+    CAN_CHECK(ring.pop(&popped[0], 1) == 0);
+
+    // more frames than the capacity at once
+    CAN_CHECK(ring.push(&frames[0], capacity + 3) == capacity);
+    CAN_CHECK(ring.overflowCount() == 6);
+    CAN_CHECK(ring.pop(&popped[0], capacity + 3) == capacity);
+    CAN_CHECK(memcmp(&popped[0], &frames[0], capacity * sizeof(CanMsg)) == 0);
+}
+
+// Pushes every frame of the producer, in batches of 1 to MAX_BATCH, again while the ring is full
+template <class Ring>
+void produce(Ring& ring, uint8_t producer, uint64_t* failedPushes) {
+    CanMsg batch[MAX_BATCH];
+    uint32_t sequence = 0;
+    size_t batchSize = 1 + producer % MAX_BATCH;
+    while (sequence < FRAMES_PER_PRODUCER) {
+        size_t count = 0;
+        while (count < batchSize && sequence + count < FRAMES_PER_PRODUCER) {
+            batch[count] = makeFrame(producer, static_cast<uint32_t>(sequence + count));
+            count++;
+        }
+        size_t pushed = (count == 1) ? (ring.push(batch[0]) ? 1 : 0) : ring.push(batch, count);
+        if (pushed < count) {
+            *failedPushes += count - pushed;
+            std::this_thread::yield();
+        }
+        sequence += static_cast<uint32_t>(pushed);
+        batchSize = batchSize % MAX_BATCH + 1;
+    }
+}
+
+template <class Ring>
+void checkUnderLoad(Ring& ring, uint8_t producers) {
+    std::vector<uint64_t> failedPushes(producers, 0);
+    std::vector<std::thread> threads;
+    for (uint8_t p = 0; p < producers; p++) {
+        threads.push_back(std::thread(produce<Ring>, std::ref(ring), p, &failedPushes[p]));
+    }
+
+    std::vector<uint32_t> expected(producers, 0);
+    uint64_t received = 0;
+    uint64_t total = static_cast<uint64_t>(producers) * FRAMES_PER_PRODUCER;
+    bool inOrder = true;
+    CanMsg frames[MAX_BATCH];
+    size_t maxCount = 1;
+    while (received < total) {
+        size_t popped = (maxCount == 1) ? (ring.pop(frames[0]) ? 1 : 0) : ring.pop(frames, maxCount);
+        for (size_t i = 0; i < popped; i++) {
+            uint8_t producer;
+            uint32_t sequence;
+            if (!readFrame(frames[i], &producer, &sequence) || producer >= producers ||
+                sequence != expected[producer]) {
+                inOrder = false;
+            } else {
+                expected[producer]++;
+            }
+        }
+        received += popped;  // drained to the end even out of order, the producers wait for room
+        if (popped == 0) {
+            std::this_thread::yield();
+        }
+        maxCount = maxCount % MAX_BATCH + 1;
+    }
+
+    for (size_t p = 0; p < threads.size(); p++) {
+        threads[p].join();
+    }
+    CAN_CHECK(inOrder);
+    CAN_CHECK(received == total);
+    CanMsg frame;
+    CAN_CHECK(!ring.pop(frame));
+
+    uint64_t failed = 0;
+    for (uint8_t p = 0; p < producers; p++) {
+        failed += failedPushes[p];
+    }
+    CAN_CHECK(ring.overflowCount() == failed);
+}
+
+}  // namespace
+
+int main() {
+    checkFullRing<CanMsgSpscRing<8> >();
+    checkFullRing<CanMsgMpscRing<8> >();
+    checkBatches<CanMsgSpscRing<16> >();
+    checkBatches<CanMsgMpscRing<16> >();
+
+    // small rings, to be full often
+    CanMsgSpscRing<64> spscRing;
+    checkUnderLoad(spscRing, 1);
+    CanMsgMpscRing<64> mpscRing;
+    checkUnderLoad(mpscRing, PRODUCERS);
+    return canTestResult();
+}
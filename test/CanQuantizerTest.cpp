@@ -0,0 +1,243 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanQuantizerTest.cpp
+ *
+ * Purpose:
+ *    MiniFloat on every value of small formats and sampled values of large ones:
+ *    exact round trip of the representable values, ties to even between two values,
+ *    subnormals, saturation, NaN and the default bias of 8 exponent bits. ScaledInteger
+ *    clamping and error bound over its range. Both through encodeQuantized() and
+ *    getQuantizedData() of CanMessageHandler, CanMessageView and CanMessageEncoder.
+ *
+ ***************************************************************************************/
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+
+#include "CanMessageHandler.h"
+#include "CanMessageView.h"
+#include "CanQuantizer.h"
+#include "CanTest.h"
+
+namespace {
+
+const int SAMPLES = 200000;
+
+float randomFloat(float low, float high) {
+    return low + (high - low) * (static_cast<float>(rand()) / static_cast<float>(RAND_MAX));
+}
+
+template <class Quantizer>
+bool withinBound(float value) {
+    return fabs(static_cast<double>(Quantizer::dequantize(Quantizer::quantize(value))) - value) <=
+           Quantizer::errorBound(value);
+}
+
+/**
+ * Every magnitude up to MAX_MAGNITUDE, or SAMPLES random ones
+ */
+template <uint8_t EXPONENT_BITS, uint8_t MANTISSA_BITS, bool SIGNED, int BIAS>
+void checkMiniFloat(bool exhaustive) {
+    typedef MiniFloat<EXPONENT_BITS, MANTISSA_BITS, SIGNED, BIAS> Quantizer;
+    const uint32_t maxMagnitude = Quantizer::MAX_MAGNITUDE;
+
+    CAN_CHECK(Quantizer::LENGTH == (SIGNED ? 1 : 0) + EXPONENT_BITS + MANTISSA_BITS);
+    CAN_CHECK(Quantizer::dequantize(0) == 0.0f);
+    CAN_CHECK(Quantizer::dequantize(1) == CanQuantizer::powerOfTwo(1 - BIAS - MANTISSA_BITS));  // subnormal
+    CAN_CHECK(Quantizer::dequantize(1UL << MANTISSA_BITS) == CanQuantizer::powerOfTwo(1 - BIAS));
+
+    uint32_t count = exhaustive ? maxMagnitude : SAMPLES;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t magnitude = exhaustive ? i : static_cast<uint32_t>(rand()) % maxMagnitude;
+        float value = Quantizer::dequantize(magnitude);
+        float next = Quantizer::dequantize(magnitude + 1);
+        CAN_CHECK(next > value);
+        CAN_CHECK(Quantizer::quantize(value) == magnitude);
+        if (SIGNED && magnitude != 0) {
+            CAN_CHECK(Quantizer::quantize(-value) == (magnitude | Quantizer::SIGN_BIT));
+            CAN_CHECK(Quantizer::dequantize(magnitude | Quantizer::SIGN_BIT) == -value);
+        }
+
+        // halfway, when it is a float: to the even one of the two
+        double middle = (static_cast<double>(value) + next) / 2;
+        float halfway = static_cast<float>(middle);
+        if (static_cast<double>(halfway) == middle) {
+            CAN_CHECK(Quantizer::quantize(halfway) == ((magnitude & 1) ? magnitude + 1 : magnitude));
+            CAN_CHECK(Quantizer::quantize(nextafterf(halfway, INFINITY)) == magnitude + 1);
+            CAN_CHECK(Quantizer::quantize(nextafterf(halfway, 0)) == magnitude);
+            CAN_CHECK(withinBound<Quantizer>(halfway));
+            CAN_CHECK(withinBound<Quantizer>(nextafterf(halfway, INFINITY)));
+        }
+        CAN_CHECK(withinBound<Quantizer>(value));
+    }
+
+    // values spread over the exponents, up to maxValue()
+    float maxValue = Quantizer::maxValue();
+    float minNormal = Quantizer::dequantize(1UL << MANTISSA_BITS);
+    for (int i = 0; i < SAMPLES / 4; i++) {
+        float value = static_cast<float>(ldexp(randomFloat(1.0f, 2.0f), -(rand() % (2 << EXPONENT_BITS)))) * maxValue;
+        if (value > maxValue) {
+            value = maxValue;
+        }
+        CAN_CHECK(withinBound<Quantizer>(value));
+        CAN_CHECK(withinBound<Quantizer>(SIGNED ? -value : value));
+        if (value >= minNormal) {
+            float error = static_cast<float>(fabs(Quantizer::dequantize(Quantizer::quantize(value)) - value));
+            CAN_CHECK(error <= value * Quantizer::relativeErrorBound());
+        }
+    }
+
+    // saturation, NaN and values below the range
+    CAN_CHECK(Quantizer::quantize(maxValue) == maxMagnitude);
+    CAN_CHECK(Quantizer::quantize(nextafterf(maxValue, INFINITY)) == maxMagnitude);
+    CAN_CHECK(Quantizer::quantize(maxValue * 4) == maxMagnitude);
+    CAN_CHECK(Quantizer::quantize(INFINITY) == maxMagnitude);
+    CAN_CHECK(Quantizer::quantize(-INFINITY) == (SIGNED ? (maxMagnitude | Quantizer::SIGN_BIT) : 0));
+    CAN_CHECK(Quantizer::quantize(NAN) == 0);
+    CAN_CHECK(Quantizer::quantize(-NAN) == 0);
+    CAN_CHECK(Quantizer::quantize(-0.0f) == 0);
+    uint32_t one = Quantizer::quantize(1.0f);
+    CAN_CHECK(Quantizer::quantize(-1.0f) == ((SIGNED && one != 0) ? one | Quantizer::SIGN_BIT : 0));
+    CAN_CHECK(Quantizer::minValue() == (SIGNED ? -maxValue : 0.0f));
+    CAN_CHECK(Quantizer::errorBound() == Quantizer::errorBound(maxValue));
+    // float subnormals, far below the smallest value of most formats
+    CAN_CHECK(withinBound<Quantizer>(CanQuantizer::powerOfTwo(-149)));
+    CAN_CHECK(withinBound<Quantizer>(CanQuantizer::powerOfTwo(-130) * 3));
+}
+
+void checkDefaultBias() {
+    // 8 exponent bits: 128, not the float 127, so that the largest exponent is finite
+    CAN_CHECK((std::is_same<MiniFloat<8, 7>, MiniFloat<8, 7, true, 128> >::value));
+    CAN_CHECK((std::is_same<MiniFloat<8, 22, false>, MiniFloat<8, 22, false, 128> >::value));
+    CAN_CHECK((std::is_same<MiniFloat<5, 10>, MiniFloat<5, 10, true, 15> >::value));
+    CAN_CHECK((std::is_same<MiniFloat<4, 3>, MiniFloat<4, 3, true, 7> >::value));
+
+    typedef MiniFloat<8, 7> BFloat16;
+    typedef MiniFloat<8, 22, false> Wide;
+    CAN_CHECK(isfinite(BFloat16::maxValue()));
+    CAN_CHECK(BFloat16::maxValue() == static_cast<float>(ldexp(2.0 - ldexp(1.0, -7), 127)));
+    CAN_CHECK(Wide::maxValue() == static_cast<float>(ldexp(2.0 - ldexp(1.0, -22), 127)));
+    CAN_CHECK(BFloat16::dequantize(1UL << 7) == CanQuantizer::powerOfTwo(-127));  // a float subnormal
+    CAN_CHECK(BFloat16::quantize(FLT_MAX) == BFloat16::MAX_MAGNITUDE);
+    // no infinities: twice the largest IEEE half
+    typedef MiniFloat<5, 10> Half;
+    CAN_CHECK(Half::maxValue() == 131008.0f);
+}
+
+template <long MIN, long MAX, uint8_t BITS>
+void checkScaledInteger() {
+    typedef ScaledInteger<MIN, MAX, BITS> Quantizer;
+    const uint32_t rawMax = Quantizer::RAW_MAX;
+
+    CAN_CHECK(Quantizer::LENGTH == BITS);
+    CAN_CHECK(fabs(Quantizer::step() * rawMax - (MAX - MIN)) <= (MAX - MIN) * 1e-6);
+    CAN_CHECK(Quantizer::quantize(static_cast<float>(MIN)) == 0);
+    CAN_CHECK(Quantizer::quantize(static_cast<float>(MAX)) == rawMax);
+    CAN_CHECK(Quantizer::quantize(static_cast<float>(MIN) - 10) == 0);
+    CAN_CHECK(Quantizer::quantize(static_cast<float>(MAX) + 10) == rawMax);
+    CAN_CHECK(Quantizer::quantize(INFINITY) == rawMax);
+    CAN_CHECK(Quantizer::quantize(-INFINITY) == 0);
+    CAN_CHECK(Quantizer::quantize(NAN) == 0);
+    CAN_CHECK(Quantizer::dequantize(0) == static_cast<float>(MIN));
+    CAN_CHECK(Quantizer::dequantize(rawMax) == static_cast<float>(MAX));
+
+    for (int i = 0; i < SAMPLES; i++) {
+        float value = randomFloat(static_cast<float>(MIN), static_cast<float>(MAX));
+        CAN_CHECK(fabs(static_cast<double>(Quantizer::dequantize(Quantizer::quantize(value))) - value) <=
+                  Quantizer::errorBound());
+    }
+    for (uint32_t raw = 0; raw <= rawMax && raw < SAMPLES; raw++) {
+        uint32_t sampled = (rawMax < SAMPLES) ? raw : static_cast<uint32_t>(rand()) % (rawMax + 1);
+        CAN_CHECK(Quantizer::quantize(Quantizer::dequantize(sampled)) == sampled);
+    }
+}
+
+/**
+ * value through encodeQuantized() then getQuantizedData() of the handler, the view and
+ * the encoder, at every start of the field
+ */
+template <class Quantizer>
+void checkFieldRoundTrip(float value) {
+    const uint8_t length = Quantizer::LENGTH;
+    float expected = Quantizer::dequantize(Quantizer::quantize(value));
+    bool nonZero = Quantizer::quantize(value) != 0;
+
+    for (uint8_t start = 0; start + length <= 64; start++) {
+        CanMessageHandler handler(MSG_ID_MARINE_SENSOR_DATA);
+        CAN_CHECK(handler.encodeQuantized(value, start, length, false, Quantizer()));
+        CanMsg message = handler.getMessage();
+
+        float decoded = -1;
+        CAN_CHECK(handler.getQuantizedData(&decoded, start, length, false, Quantizer()) == nonZero);
+        CAN_CHECK(decoded == (nonZero ? expected : 0.0f));
+
+        decoded = -1;
+        CAN_CHECK(CanMessageView(message).getQuantizedData(&decoded, start, length, false, Quantizer()) == nonZero);
+        CAN_CHECK(decoded == (nonZero ? expected : 0.0f));
+
+        CanMsg encoded = CanMessageHandler(MSG_ID_MARINE_SENSOR_DATA).getMessage();
+        CanMessageEncoder encoder(encoded);
+        CAN_CHECK(encoder.encodeQuantized(value, start, length, false, Quantizer()));
+        CAN_CHECK(memcmp(encoded.data, message.data, sizeof(message.data)) == 0);
+    }
+}
+
+template <class Quantizer>
+void checkFieldRejects() {
+    CanMessageHandler handler(MSG_ID_MARINE_SENSOR_DATA);
+    CanMsg before = handler.getMessage();
+    CAN_CHECK(!handler.encodeQuantized(NAN, 0, Quantizer::LENGTH, false, Quantizer()));
+    CAN_CHECK(!handler.encodeQuantized(nextafterf(Quantizer::maxValue(), INFINITY), 0, Quantizer::LENGTH, false,
+                                       Quantizer()));
+    CAN_CHECK(!handler.encodeQuantized(nextafterf(Quantizer::minValue(), -INFINITY), 0, Quantizer::LENGTH, false,
+                                       Quantizer()));
+    CAN_CHECK(!handler.encodeQuantized(1.0f, 0, Quantizer::LENGTH + 1, false, Quantizer()));  // length mismatch
+    CAN_CHECK(!handler.encodeQuantized(1.0f, 65 - Quantizer::LENGTH, Quantizer::LENGTH, false, Quantizer()));
+    CAN_CHECK(memcmp(handler.getMessage().data, before.data, sizeof(before.data)) == 0);
+
+    float decoded = -1;
+    CAN_CHECK(!handler.getQuantizedData(&decoded, 0, Quantizer::LENGTH + 1, false, Quantizer()));
+    CAN_CHECK(decoded == 0.0f);
+}
+
+}  // namespace
+
+int main() {
+    srand(1);
+    checkMiniFloat<5, 10, true, 15>(true);
+    checkMiniFloat<4, 3, true, 7>(true);
+    checkMiniFloat<5, 6, false, 15>(true);
+    checkMiniFloat<8, 7, true, 128>(true);
+    checkMiniFloat<3, 2, true, -2>(true);    // low bias, range moved up
+    checkMiniFloat<4, 3, false, 20>(true);   // high bias, range moved down
+    checkMiniFloat<8, 22, false, 128>(false);
+    checkMiniFloat<6, 17, true, 31>(false);
+    checkDefaultBias();
+
+    checkScaledInteger<-5, 40, 10>();
+    checkScaledInteger<0, 60, 16>();
+    checkScaledInteger<-1000, 1000, 20>();
+    checkScaledInteger<0, 1, 1>();
+
+    const float values[] = {0.0f, 1.0f, -1.0f, 21.5f, -3.25f, 0.001f, 1000.0f, 65504.0f, 40.0f, -5.0f, 7.77f};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        if (fabs(values[i]) <= MiniFloat<5, 10>::maxValue()) {
+            checkFieldRoundTrip<MiniFloat<5, 10> >(values[i]);
+        }
+        if (values[i] >= 0) {
+            checkFieldRoundTrip<MiniFloat<5, 6, false> >(values[i]);
+        }
+        checkFieldRoundTrip<MiniFloat<8, 22, false> >(fabs(values[i]));
+        if (values[i] >= -5 && values[i] <= 40) {
+            checkFieldRoundTrip<ScaledInteger<-5, 40, 10> >(values[i]);
+        }
+    }
+    checkFieldRejects<MiniFloat<5, 10> >();
+    checkFieldRejects<MiniFloat<5, 6, false> >();
+    checkFieldRejects<ScaledInteger<-5, 40, 10> >();
+    return canTestResult();
+}
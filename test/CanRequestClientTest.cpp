@@ -0,0 +1,318 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanRequestClientTest.cpp
+ *
+ * Purpose:
+ *    CanRequestClient on a CanLoopbackBus with a fake clock: parallel requests
+ *    answered out of order, matching by sensor id and oldest first, timeouts,
+ *    CAN_REQUEST_TOO_MANY, CAN_REQUEST_SEND_FAILED, the unmatched frames and the
+ *    slots of requests destroyed without being awaited.
+ *
+ * Developer Notes:
+ *    C++20, see test/CMakeLists.txt. The simulated sensor node records the requests
+ *    and does not answer, the tests inject the responses in the order they need.
+ *
+ ***************************************************************************************/
+
+#include <stdint.h>
+
+#include "CanLoopbackBus.h"
+#include "CanMessageHandler.h"
+#include "CanRequestClient.h"
+#include "CanTest.h"
+
+namespace {
+
+const size_t MAX_PENDING = 4;
+
+typedef CanRequestClient<CanLoopbackBus, MAX_PENDING> Client;
+
+uint64_t g_nowMs = 0;
+
+uint64_t fakeClock() {
+    return g_nowMs;
+}
+
+struct SensorNode {
+    uint32_t requests = 0;
+    CanMsg lastRequest = {};
+    bool refuse = false;
+};
+
+bool sensorNode(const CanMsg& frame, CanLoopbackBus&, void* context) {
+    SensorNode* node = static_cast<SensorNode*>(context);
+    if (node->refuse) {
+        return false;
+    }
+    node->requests++;
+    node->lastRequest = frame;
+    return true;
+}
+
+// The pH field tells the responses apart
+CanMsg marineResponse(uint8_t ph) {
+    CanMessageHandler handler(MSG_ID_MARINE_SENSOR_DATA);
+    handler.encodeMessage(ph, SENSOR_PH_START, SENSOR_PH_DATASIZE, SENSOR_PH_IN_BYTE);
+    return handler.getMessage();
+}
+
+CanMsg currentResponse(uint8_t sensorId, uint16_t current) {
+    CanMessageHandler handler(MSG_ID_CURRENT_SENSOR_DATA);
+    handler.encodeMessage(sensorId, CURRENT_SENSOR_ID_START, CURRENT_SENSOR_ID_DATASIZE, CURRENT_SENSOR_ID_IN_BYTE);
+    handler.encodeMessage(current, CURRENT_SENSOR_CURRENT_START, CURRENT_SENSOR_CURRENT_DATASIZE,
+                          CURRENT_SENSOR_CURRENT_IN_BYTE);
+    return handler.getMessage();
+}
+
+uint8_t phOf(const CanMsg& message) {
+    uint8_t ph = 0;
+    CanMessageView(message).getData(&ph, SENSOR_PH_START, SENSOR_PH_DATASIZE, SENSOR_PH_IN_BYTE);
+    return ph;
+}
+
+uint16_t currentOf(const CanMsg& message) {
+    uint16_t current = 0;
+    CanMessageView(message).getData(&current, CURRENT_SENSOR_CURRENT_START, CURRENT_SENSOR_CURRENT_DATASIZE,
+                                    CURRENT_SENSOR_CURRENT_IN_BYTE);
+    return current;
+}
+
+struct SensorReadings {
+    int resumed = 0;
+    CanResponse marine = {};
+    CanResponse current = {};
+};
+
+CanTask readSensors(Client& client, SensorReadings& readings) {
+    CanRequest marine = client.requestMarineSensorData(500);
+    CanRequest current = client.requestCurrentSensorData(2, 500);
+
+    readings.marine = co_await marine;
+    readings.resumed++;
+    readings.current = co_await current;
+    readings.resumed++;
+}
+
+void checkParallelRequestsOutOfOrder() {
+    CanLoopbackBus bus;
+    SensorNode node;
+    bus.addNode(sensorNode, &node);
+    Client client(bus, fakeClock);
+
+    SensorReadings readings;
+    CanTask task = readSensors(client, readings);
+    CAN_CHECK(node.requests == 2);
+    CAN_CHECK(client.outstanding() == 2);
+    CAN_CHECK(!task.done());
+
+    // the current sensor answers first, its request completes without resuming the task
+    bus.inject(currentResponse(2, 1234));
+    CAN_CHECK(client.poll() == 1);
+    CAN_CHECK(readings.resumed == 0);
+    CAN_CHECK(client.outstanding() == 1);
+
+    bus.inject(marineResponse(7));
+    CAN_CHECK(client.poll() == 1);
+    CAN_CHECK(task.done());
+    CAN_CHECK(readings.resumed == 2);
+    CAN_CHECK(readings.marine.ok() && phOf(readings.marine.message) == 7);
+    CAN_CHECK(readings.current.ok() && currentOf(readings.current.message) == 1234);
+    CAN_CHECK(client.outstanding() == 0);
+    CAN_CHECK(client.unmatched() == 0);
+}
+
+void checkSensorIdMatching() {
+    CanLoopbackBus bus;
+    SensorNode node;
+    bus.addNode(sensorNode, &node);
+    Client client(bus, fakeClock);
+
+    CanRequest sensor1 = client.requestCurrentSensorData(1, 500);
+    uint8_t requestedId = 0;
+    CanMessageView(node.lastRequest).getData(&requestedId, CURRENT_SENSOR_ID_START, CURRENT_SENSOR_ID_DATASIZE,
+                                             CURRENT_SENSOR_ID_IN_BYTE);
+    CAN_CHECK(node.lastRequest.id == MSG_ID_CURRENT_SENSOR_REQUEST && requestedId == 1);
+    CanRequest sensor2 = client.requestCurrentSensorData(2, 500);
+
+    CAN_CHECK(client.dispatch(currentResponse(2, 200)));
+    CAN_CHECK(!sensor1.await_ready());
+    CAN_CHECK(sensor2.await_ready());
+
+    CAN_CHECK(!client.dispatch(currentResponse(3, 300)));  // nobody asked sensor 3
+    CAN_CHECK(client.dispatch(currentResponse(1, 100)));
+    CAN_CHECK(sensor1.await_ready());
+
+    CAN_CHECK(currentOf(sensor1.await_resume().message) == 100);
+    CAN_CHECK(currentOf(sensor2.await_resume().message) == 200);
+}
+
+void checkOldestFirst() {
+    CanLoopbackBus bus;
+    SensorNode node;
+    bus.addNode(sensorNode, &node);
+    Client client(bus, fakeClock);
+
+    // three generations of slots, so that the oldest is not the first slot
+    {
+        CanRequest first = client.requestMarineSensorData(500);
+    }
+    CanRequest older = client.requestMarineSensorData(500);
+    CanRequest newer = client.requestMarineSensorData(500);
+    CanRequest newest = client.requestMarineSensorData(500);
+
+    bus.inject(marineResponse(1));
+    client.poll();
+    CAN_CHECK(older.await_ready() && !newer.await_ready() && !newest.await_ready());
+
+    bus.inject(marineResponse(2));
+    bus.inject(marineResponse(3));
+    client.poll();
+    CAN_CHECK(newer.await_ready() && newest.await_ready());
+
+    CAN_CHECK(phOf(older.await_resume().message) == 1);
+    CAN_CHECK(phOf(newer.await_resume().message) == 2);
+    CAN_CHECK(phOf(newest.await_resume().message) == 3);
+}
+
+CanTask awaitOne(CanRequest request, CanResponse& response, bool& resumed) {
+    response = co_await request;
+    resumed = true;
+}
+
+void checkTimeout() {
+    CanLoopbackBus bus;
+    SensorNode node;
+    bus.addNode(sensorNode, &node);
+    g_nowMs = 1000;
+    Client client(bus, fakeClock);
+
+    CanResponse response = {};
+    bool resumed = false;
+    CanTask task = awaitOne(client.requestMarineSensorData(100), response, resumed);
+
+    g_nowMs = 1099;
+    client.expire();
+    CAN_CHECK(!resumed && client.outstanding() == 1);
+
+    g_nowMs = 1100;
+    client.expire();
+    CAN_CHECK(resumed && task.done());
+    CAN_CHECK(response.status == CAN_REQUEST_TIMED_OUT);
+    CAN_CHECK(client.outstanding() == 0);
+
+    // a response after the timeout is no longer waited for
+    bus.inject(marineResponse(9));
+    client.poll();
+    CAN_CHECK(client.unmatched() == 1);
+}
+
+void checkTooMany() {
+    CanLoopbackBus bus;
+    SensorNode node;
+    bus.addNode(sensorNode, &node);
+    Client client(bus, fakeClock);
+
+    CanRequest requests[MAX_PENDING] = {
+        client.requestMarineSensorData(500), client.requestMarineSensorData(500),
+        client.requestMarineSensorData(500), client.requestMarineSensorData(500)};
+    CAN_CHECK(client.outstanding() == MAX_PENDING);
+
+    CanRequest rejected = client.requestCurrentSensorData(1, 500);
+    CAN_CHECK(rejected.await_ready());
+    CAN_CHECK(rejected.await_resume().status == CAN_REQUEST_TOO_MANY);
+    CAN_CHECK(node.requests == MAX_PENDING);  // not sent
+
+    // an awaited request gives its slot back
+    client.dispatch(marineResponse(1));
+    CAN_CHECK(requests[0].await_resume().ok());
+    CanRequest accepted = client.requestCurrentSensorData(1, 500);
+    CAN_CHECK(!accepted.await_ready());
+}
+
+void checkSendFailed() {
+    CanLoopbackBus bus;
+    SensorNode node;
+    bus.addNode(sensorNode, &node);
+    Client client(bus, fakeClock);
+
+    node.refuse = true;
+    for (size_t i = 0; i < 2 * MAX_PENDING; i++) {
+        CanRequest refused = client.requestMarineSensorData(500);
+        CAN_CHECK(refused.await_ready());
+        CAN_CHECK(refused.await_resume().status == CAN_REQUEST_SEND_FAILED);
+    }
+    CAN_CHECK(client.outstanding() == 0);
+
+    // the failed requests kept no slot
+    node.refuse = false;
+    CanRequest requests[MAX_PENDING] = {
+        client.requestMarineSensorData(500), client.requestMarineSensorData(500),
+        client.requestMarineSensorData(500), client.requestMarineSensorData(500)};
+    for (size_t i = 0; i < MAX_PENDING; i++) {
+        CAN_CHECK(!requests[i].await_ready());
+    }
+}
+
+void checkUnmatched() {
+    CanLoopbackBus bus;
+    SensorNode node;
+    bus.addNode(sensorNode, &node);
+    Client client(bus, fakeClock);
+
+    CanRequest current = client.requestCurrentSensorData(4, 500);
+    bus.inject(marineResponse(1));       // no marine request
+    bus.inject(currentResponse(5, 10));  // another sensor
+    bus.inject(CanMessageHandler(MSG_ID_RC_STATUS).getMessage());  // never a response
+    bus.inject(currentResponse(4, 40));
+    bus.inject(currentResponse(4, 41));  // already answered
+    CAN_CHECK(client.poll() == 5);
+    CAN_CHECK(client.unmatched() == 4);
+    CAN_CHECK(currentOf(current.await_resume().message) == 40);
+}
+
+void checkDestroyedRequests() {
+    CanLoopbackBus bus;
+    SensorNode node;
+    bus.addNode(sensorNode, &node);
+    Client client(bus, fakeClock);
+
+    for (int round = 0; round < 3; round++) {
+        CanRequest requests[MAX_PENDING] = {
+            client.requestMarineSensorData(500), client.requestCurrentSensorData(1, 500),
+            client.requestCurrentSensorData(2, 500), client.requestMarineSensorData(500)};
+        for (size_t i = 0; i < MAX_PENDING; i++) {
+            CAN_CHECK(!requests[i].await_ready());
+        }
+        CAN_CHECK(client.outstanding() == MAX_PENDING);
+    }
+    CAN_CHECK(client.outstanding() == 0);
+
+    // nobody waits for the responses of the destroyed requests
+    client.dispatch(marineResponse(1));
+    client.dispatch(currentResponse(1, 1));
+    CAN_CHECK(client.unmatched() == 2);
+
+    // a moved request keeps the slot, until the coroutine awaiting it is destroyed
+    {
+        CanResponse response = {};
+        bool resumed = false;
+        CanTask task = awaitOne(client.requestMarineSensorData(500), response, resumed);
+        CAN_CHECK(client.outstanding() == 1);
+    }
+    CAN_CHECK(client.outstanding() == 0);
+}
+
+}  // namespace
+
+int main() {
+    checkParallelRequestsOutOfOrder();
+    checkSensorIdMatching();
+    checkOldestFirst();
+    checkTimeout();
+    checkTooMany();
+    checkSendFailed();
+    checkUnmatched();
+    checkDestroyedRequests();
+    return canTestResult();
+}
@@ -0,0 +1,39 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanTest.h
+ *
+ * Purpose:
+ *    Minimal checks for the test executables of test/, no framework needed.
+ *
+ *      CAN_CHECK(condition);        counts and prints the first failures
+ *      return canTestResult();      0 when every check passed, 1 otherwise
+ *      return CAN_TEST_SKIPPED;     the test cannot run here (ctest SKIP_RETURN_CODE)
+ *
+ ***************************************************************************************/
+
+#ifndef SAILINGROBOT_CANTEST_H
+#define SAILINGROBOT_CANTEST_H
+
+#include <stdio.h>
+
+static const int CAN_TEST_SKIPPED = 77;
+static const unsigned long CAN_TEST_MAX_PRINTED = 20;
+
+static unsigned long g_canTestChecks = 0;
+static unsigned long g_canTestFailures = 0;
+
+#define CAN_CHECK(CONDITION)                                                              \
+    do {                                                                                  \
+        g_canTestChecks++;                                                                \
+        if (!(CONDITION) && g_canTestFailures++ < CAN_TEST_MAX_PRINTED) {                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #CONDITION); \
+        }                                                                                 \
+    } while (0)
+
+static inline int canTestResult() {
+    printf("%lu checks, %lu failed\n", g_canTestChecks, g_canTestFailures);
+    return g_canTestFailures == 0 ? 0 : 1;
+}
+
+#endif  // SAILINGROBOT_CANTEST_H
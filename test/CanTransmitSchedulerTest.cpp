@@ -0,0 +1,71 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanTransmitSchedulerTest.cpp
+ *
+ * Purpose:
+ *    CanTransmitScheduler with budgets below one frame per tenth of a second: the
+ *    frames are still sent at the budget rate, and msUntilNextDue() never asks for a
+ *    poll() that sends nothing (no busy polling of the RPI thread).
+ *
+ ***************************************************************************************/
+
+#include "CanTest.h"
+#include "CanTransmitScheduler.h"
+
+namespace {
+
+bool countFrame(uint32_t, void* context) {
+    (*static_cast<uint32_t*>(context))++;
+    return true;
+}
+
+/**
+ * Runs the scheduler for a minute, polling when msUntilNextDue() says so
+ */
+void checkLowBudget(uint32_t budgetBitsPerSecond, uint32_t burstBits, bool extendedId) {
+    const uint32_t DURATION_MS = 60000;
+    CanTransmitScheduler<2> scheduler(budgetBitsPerSecond, burstBits);
+    uint32_t sent = 0;
+    CAN_CHECK(scheduler.addMessage(0x100, 50, CAN_PRIORITY_TELEMETRY, countFrame, &sent, 8, extendedId));
+    CAN_CHECK(scheduler.addMessage(0x101, 50, CAN_PRIORITY_FEEDBACK, countFrame, &sent, 8, extendedId));
+
+    uint32_t nowMs = 1000;
+    uint32_t emptyPolls = 0;
+    uint32_t wakeups = 0;
+    while (nowMs < 1000 + DURATION_MS) {
+        uint32_t waitMs = scheduler.msUntilNextDue(nowMs);
+        CAN_CHECK(waitMs != CanTransmitScheduler<2>::NOTHING_SCHEDULED);
+        if (waitMs == 0) {
+            if (scheduler.poll(nowMs) == 0) {
+                emptyPolls++;
+                nowMs++;
+            }
+        } else {
+            nowMs += waitMs;
+            wakeups++;
+        }
+    }
+
+    // Both frames want 40 per second, the budget allows budget / frame bits
+    uint32_t frameBits = CanUtility::worstCaseFrameBits(8, extendedId);
+    uint32_t expected =
+        static_cast<uint32_t>(static_cast<uint64_t>(budgetBitsPerSecond) * DURATION_MS / 1000 / frameBits);
+    CAN_CHECK(sent + 2 >= expected && sent <= expected + 2);
+    CAN_CHECK(emptyPolls == 0);
+    // At most a wakeup for the budget and one at the due time of the other message
+    // per frame sent
+    CAN_CHECK(wakeups <= 2 * sent + 2);
+    CAN_CHECK(scheduler.statistics().sent == sent);
+}
+
+}  // namespace
+
+int main() {
+    checkLowBudget(1000, 0, false);
+    checkLowBudget(1000, 0, true);
+    checkLowBudget(300, 0, false);
+    checkLowBudget(1349, 0, false);
+    checkLowBudget(2000, 50, true);  // explicit burst below one frame
+    return canTestResult();
+}
@@ -0,0 +1,331 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CandumpLogTest.cpp
+ *
+ * Purpose:
+ *    CandumpParser on the log and screen formats, standard and extended ids, remote
+ *    requests and the lines to skip. CandumpReader on a file and on a pipe with the
+ *    same log, a last line without line feed and lines longer than the stream
+ *    buffer. CandumpReplayer batches, handed to a sink that records them.
+ *
+ * Developer Notes:
+ *    The log file is written in /tmp and removed at the end.
+ *
+ ***************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CandumpLog.h"
+#include "CanTest.h"
+
+namespace {
+
+bool parse(const char* line, CandumpFrame& frame) {
+    return CandumpParser::parseLine(line, line + strlen(line), frame);
+}
+
+bool hasData(const CandumpFrame& frame, const char* bytes, uint8_t length) {
+    return frame.message.header.length == length && memcmp(frame.message.data, bytes, length) == 0;
+}
+
+bool hasInterface(const CandumpFrame& frame, const char* name) {
+    return frame.interfaceLength == strlen(name) && memcmp(frame.interfaceName, name, frame.interfaceLength) == 0;
+}
+
+void checkLogFormat() {
+    CandumpFrame frame;
+    CAN_CHECK(parse("(1436509052.249713) can0 2BD#0102030405060708", frame));
+    CAN_CHECK(frame.hasTimestamp && frame.timestampNs == 1436509052249713000ULL);
+    CAN_CHECK(hasInterface(frame, "can0"));
+    CAN_CHECK(frame.message.id == 0x2BD && frame.message.header.ide == 0 && !frame.remoteRequest);
+    CAN_CHECK(hasData(frame, "\x01\x02\x03\x04\x05\x06\x07\x08", 8));
+
+    CAN_CHECK(parse("(12.5) vcan12 7FF#01.a2.FF", frame));
+    CAN_CHECK(frame.timestampNs == 12500000000ULL && hasInterface(frame, "vcan12"));
+    CAN_CHECK(frame.message.id == 0x7FF && frame.message.header.ide == 0);
+    CAN_CHECK(hasData(frame, "\x01\xA2\xFF", 3));
+
+    // extended ids: 8 digits, also below 0x800
+    CAN_CHECK(parse("(1.000000001) can0 1F334455#", frame));
+    CAN_CHECK(frame.timestampNs == 1000000001ULL);
+    CAN_CHECK(frame.message.id == 0x1F334455 && frame.message.header.ide == 1 && frame.message.header.length == 0);
+    CAN_CHECK(parse("(1.0) can0 0000012A#11", frame));
+    CAN_CHECK(frame.message.id == 0x12A && frame.message.header.ide == 1 && hasData(frame, "\x11", 1));
+
+    // remote requests, with and without length
+    CAN_CHECK(parse("(1.0) can0 123#R", frame));
+    CAN_CHECK(frame.remoteRequest && frame.message.id == 0x123 && frame.message.header.length == 0);
+    CAN_CHECK(parse("(1.0) can0 123#R3", frame));
+    CAN_CHECK(frame.remoteRequest && frame.message.header.length == 3);
+}
+
+void checkScreenFormat() {
+    CandumpFrame frame;
+    CAN_CHECK(parse("(1436509052.249713)  can0  2BD   [8]  01 02 03 04 05 06 07 08", frame));
+    CAN_CHECK(frame.hasTimestamp && frame.timestampNs == 1436509052249713000ULL);
+    CAN_CHECK(hasInterface(frame, "can0"));
+    CAN_CHECK(frame.message.id == 0x2BD && frame.message.header.ide == 0);
+    CAN_CHECK(hasData(frame, "\x01\x02\x03\x04\x05\x06\x07\x08", 8));
+
+    CAN_CHECK(parse("  can1  1F334455   [2]  AB cd", frame));
+    CAN_CHECK(!frame.hasTimestamp && frame.timestampNs == 0 && hasInterface(frame, "can1"));
+    CAN_CHECK(frame.message.id == 0x1F334455 && frame.message.header.ide == 1);
+    CAN_CHECK(hasData(frame, "\xAB\xCD", 2));
+
+    CAN_CHECK(parse("  can0  123   [0] ", frame));
+    CAN_CHECK(frame.message.id == 0x123 && frame.message.header.length == 0);
+
+    CAN_CHECK(parse("  can0  123   [2]  remote request", frame));
+    CAN_CHECK(frame.remoteRequest && frame.message.header.length == 2);
+}
+
+void checkSkippedLines() {
+    CandumpFrame frame;
+    CAN_CHECK(!parse("(1436509052.249713) can0 123##1112233", frame));             // CAN FD
+    CAN_CHECK(!parse("(1436509052.249713) can0 20000080#0000000000000000", frame)); // error frame
+    CAN_CHECK(!parse("  can0  20000004   [8]  00 04 00 00 00 00 00 00", frame));    // error frame
+    CAN_CHECK(!parse("(1.0) can0 123#010203040506070809", frame));                  // 9 bytes
+    CAN_CHECK(!parse("  can0  123   [9]  01 02 03 04 05 06 07 08 09", frame));
+    CAN_CHECK(!parse("  can0  123   [3]  01 02", frame));                           // bytes missing
+    CAN_CHECK(!parse("(1.0) can0 123#0", frame));                                   // half a byte
+    CAN_CHECK(!parse("(1.0) can0 123456789#00", frame));                            // 9 id digits
+    CAN_CHECK(!parse(" (2015-07-10 08:17:32.249713)  can0  2BD   [8]  01 02 03 04 05 06 07 08", frame));
+    CAN_CHECK(!parse("(1.0 can0 123#00", frame));
+    CAN_CHECK(!parse("(1.0) can0", frame));
+    CAN_CHECK(!parse("can0 xyz#00", frame));
+    CAN_CHECK(!parse("", frame));
+
+    const char lines[] = "(1.0) can0 123#00\n\n(1.0) can0 123##100\ngarbage\n  can0  124   [1]  01\n(2.0) can0 1";
+    uint64_t skipped = 0;
+    std::vector<uint32_t> ids;
+    auto callback = [&ids](const CandumpFrame& parsed) { ids.push_back(parsed.message.id); };
+    size_t consumed = CandumpParser::parseLines(lines, sizeof(lines) - 1, callback, skipped);
+    CAN_CHECK(consumed == strlen(lines) - strlen("(2.0) can0 1"));  // the unterminated line is left
+    CAN_CHECK(ids.size() == 2 && ids[0] == 0x123 && ids[1] == 0x124);
+    CAN_CHECK(skipped == 2);  // not the empty line
+}
+
+struct ReadResult {
+    std::vector<CanMsg> messages;
+    std::vector<uint64_t> timestamps;
+    int64_t frames;
+    uint64_t skippedLines;
+};
+
+ReadResult readFile(const char* path) {
+    ReadResult result;
+    CandumpReader reader;
+    CAN_CHECK(reader.open(path));
+    result.frames = static_cast<int64_t>(reader.forEach([&result](const CandumpFrame& frame) {
+        result.messages.push_back(frame.message);
+        result.timestamps.push_back(frame.timestampNs);
+    }));
+    result.skippedLines = reader.skippedLines();
+    return result;
+}
+
+// The writer thread sends the log in pieces of writeSize bytes
+ReadResult readPipe(const std::string& log, size_t writeSize) {
+    ReadResult result;
+    int fileDescriptors[2];
+    CAN_CHECK(pipe(fileDescriptors) == 0);
+    std::thread writer([&log, writeSize, fileDescriptors]() {
+        for (size_t offset = 0; offset < log.size();) {
+            size_t size = (log.size() - offset < writeSize) ? log.size() - offset : writeSize;
+            ssize_t written = write(fileDescriptors[1], log.data() + offset, size);
+            if (written <= 0) {
+                break;
+            }
+            offset += static_cast<size_t>(written);
+        }
+        close(fileDescriptors[1]);
+    });
+
+    CandumpReader reader;
+    result.frames = reader.forEachInStream(fileDescriptors[0], [&result](const CandumpFrame& frame) {
+        result.messages.push_back(frame.message);
+        result.timestamps.push_back(frame.timestampNs);
+    });
+    result.skippedLines = reader.skippedLines();
+    writer.join();
+    close(fileDescriptors[0]);
+    return result;
+}
+
+bool sameResult(const ReadResult& first, const ReadResult& second) {
+    if (first.frames != second.frames || first.skippedLines != second.skippedLines ||
+        first.messages.size() != second.messages.size() || first.timestamps != second.timestamps) {
+        return false;
+    }
+    for (size_t i = 0; i < first.messages.size(); i++) {
+        if (memcmp(&first.messages[i], &second.messages[i], sizeof(CanMsg)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool writeFile(const char* path, const std::string& content) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool written = fwrite(content.data(), 1, content.size(), file) == content.size();
+    return fclose(file) == 0 && written;
+}
+
+void checkReaders(const char* path) {
+    std::string log;
+    char line[64];
+    for (int i = 0; i < 20000; i++) {
+        const char* format = (i % 2) ? "(%d.%06d) can0 %03X#%02X%02X\n" : "(%d.%06d)  can0  %03X   [2]  %02X %02X\n";
+        snprintf(line, sizeof(line), format, i / 1000, i % 1000 * 1000, i % 0x800, i & 0xFF, (i >> 8) & 0xFF);
+        log += line;
+        if (i % 1000 == 0) {
+            log += "(1.0) can0 123##100\n\n";
+        }
+    }
+    // tails that parse as frames must not be taken for one
+    log += std::string(CandumpReader::STREAM_CHUNK_SIZE, 'X') + "(1.0) can0 7AA#01\n";
+    log += std::string(3 * CandumpReader::STREAM_CHUNK_SIZE + 5, 'Y') + " can0 7AB#02\n";
+    log += std::string(CandumpReader::STREAM_CHUNK_SIZE - 1, 'Z') + "\n";  // the longest line that fits
+    log += "(99.5) can0 1F334455#AABB";  // no line feed
+
+    CAN_CHECK(writeFile(path, log));
+    ReadResult fromFile = readFile(path);
+    CAN_CHECK(fromFile.frames == 20001);
+    CAN_CHECK(fromFile.skippedLines == 20 + 3);
+    CAN_CHECK(fromFile.messages.size() == 20001);
+    if (fromFile.messages.size() == 20001) {
+        CAN_CHECK(fromFile.messages[4321].id == 4321 % 0x800 && fromFile.messages[4321].data[0] == (4321 & 0xFF));
+        CAN_CHECK(fromFile.timestamps[4321] == 4321000000ULL);
+        const CanMsg& last = fromFile.messages.back();
+        CAN_CHECK(last.id == 0x1F334455 && last.header.ide == 1 && last.header.length == 2 && last.data[1] == 0xBB);
+        CAN_CHECK(fromFile.timestamps.back() == 99500000000ULL);
+    }
+
+    // in small pieces, and in pieces larger than the pipe
+    CAN_CHECK(sameResult(readPipe(log, 100), fromFile));
+    CAN_CHECK(sameResult(readPipe(log, 1 << 20), fromFile));
+
+    // an empty file and an empty stream
+    CAN_CHECK(writeFile(path, ""));
+    ReadResult empty = readFile(path);
+    CAN_CHECK(empty.frames == 0 && empty.skippedLines == 0);
+    empty = readPipe("", 100);
+    CAN_CHECK(empty.frames == 0 && empty.skippedLines == 0);
+}
+
+CandumpFrame makeFrame(uint32_t id, uint64_t timestampNs) {
+    CandumpFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.message.id = id;
+    frame.timestampNs = timestampNs;
+    frame.hasTimestamp = true;
+    return frame;
+}
+
+struct RecordingSink {
+    std::vector<size_t>* batchSizes;
+    std::vector<uint32_t>* ids;
+    size_t callsBeforeStop;
+
+    bool operator()(const CanMsg* messages, size_t count) {
+        batchSizes->push_back(count);
+        for (size_t i = 0; i < count; i++) {
+            ids->push_back(messages[i].id);
+        }
+        return batchSizes->size() < callsBeforeStop;
+    }
+};
+
+void checkReplayer() {
+    std::vector<size_t> batchSizes;
+    std::vector<uint32_t> ids;
+    RecordingSink sink = {&batchSizes, &ids, 1000};
+
+    // as fast as possible: full batches
+    {
+        CandumpReplayer replayer(CandumpReplayer::MAX_SPEED);
+        for (uint32_t i = 0; i < 150; i++) {
+            CAN_CHECK(replayer.add(makeFrame(i, i * 1000000000ULL), sink));
+        }
+        CAN_CHECK(replayer.flush(sink));
+        CAN_CHECK(batchSizes.size() == 3 && batchSizes[0] == CandumpReplayer::MAX_BATCH_SIZE &&
+                  batchSizes[1] == CandumpReplayer::MAX_BATCH_SIZE && batchSizes[2] == 150 - 2 * 64);
+        CAN_CHECK(ids.size() == 150 && ids[0] == 0 && ids[149] == 149);
+    }
+
+    // recorded spacing: the frames due together form a batch, handed before waiting
+    batchSizes.clear();
+    ids.clear();
+    {
+        CandumpReplayer replayer(CandumpReplayer::ORIGINAL);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const uint64_t base = 1000000000000ULL;
+        CAN_CHECK(replayer.add(makeFrame(1, base), sink));
+        CAN_CHECK(replayer.add(makeFrame(2, base), sink));
+        CAN_CHECK(replayer.add(makeFrame(3, base - 5000000), sink));  // going backwards, due now
+        CAN_CHECK(batchSizes.empty());
+        CAN_CHECK(replayer.add(makeFrame(4, base + 30000000), sink));
+        CAN_CHECK(batchSizes.size() == 1 && batchSizes[0] == 3);
+        CAN_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(30));
+        CAN_CHECK(replayer.add(makeFrame(5, base + 30000000), sink));
+        CAN_CHECK(replayer.flush(sink));
+        CAN_CHECK(batchSizes.size() == 2 && batchSizes[1] == 2);
+        CAN_CHECK(replayer.flush(sink));  // nothing queued, no call
+        CAN_CHECK(batchSizes.size() == 2);
+    }
+
+    // accelerated: 200 ms recorded in 20 ms
+    {
+        CandumpReplayer replayer(CandumpReplayer::ACCELERATED, 10.0);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        CAN_CHECK(replayer.add(makeFrame(1, 0), sink));
+        CAN_CHECK(replayer.add(makeFrame(2, 200000000), sink));
+        std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+        CAN_CHECK(elapsed >= std::chrono::milliseconds(20) && elapsed < std::chrono::milliseconds(150));
+    }
+
+    // the sink stops the replay
+    batchSizes.clear();
+    ids.clear();
+    sink.callsBeforeStop = 1;
+    {
+        CandumpReplayer replayer(CandumpReplayer::MAX_SPEED);
+        for (uint32_t i = 0; i < CandumpReplayer::MAX_BATCH_SIZE; i++) {
+            CAN_CHECK(replayer.add(makeFrame(i, 0), sink));
+        }
+        CAN_CHECK(!replayer.add(makeFrame(100, 0), sink));
+        CAN_CHECK(!replayer.add(makeFrame(101, 0), sink));
+        CAN_CHECK(!replayer.flush(sink));
+        CAN_CHECK(batchSizes.size() == 1 && ids.size() == CandumpReplayer::MAX_BATCH_SIZE);
+    }
+}
+
+}  // namespace
+
+int main() {
+    checkLogFormat();
+    checkScreenFormat();
+    checkSkippedLines();
+    checkReplayer();
+
+    char path[] = "/tmp/CandumpLogTestXXXXXX";
+    int fileDescriptor = mkstemp(path);
+    if (fileDescriptor < 0) {
+        printf("cannot create a file in /tmp, skipped\n");
+        return CAN_TEST_SKIPPED;
+    }
+    close(fileDescriptor);
+    checkReaders(path);
+    unlink(path);
+    return canTestResult();
+}
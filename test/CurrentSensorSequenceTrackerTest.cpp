@@ -0,0 +1,153 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CurrentSensorSequenceTrackerTest.cpp
+ *
+ * Purpose:
+ *    CurrentSensorSequenceTracker on frames with fake timestamps: each
+ *    CurrentSensorFrameStatus, the statistics after each of them, the rolling number
+ *    wraps found from the rate once MIN_RATE_SAMPLES intervals were seen, and the
+ *    sensors kept apart.
+ *
+ ***************************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "CanTest.h"
+#include "CurrentSensorSequenceTracker.h"
+
+namespace {
+
+const uint64_t PERIOD_NS = 10000000;  // 100 Hz
+const uint64_t START_NS = 5000000000ULL;
+
+/**
+ * Frame n of a sensor: rolling number n % 4, sent at n * PERIOD_NS, current n unless
+ * given
+ */
+class Sender {
+   public:
+    Sender(CurrentSensorSequenceTracker& tracker, uint8_t sensorId) : m_tracker(tracker), m_sensorId(sensorId) {}
+
+    CurrentSensorFrameStatus send(uint32_t n, uint64_t lateNs = 0) { return send(n, lateNs, n); }
+
+    CurrentSensorFrameStatus send(uint32_t n, uint64_t lateNs, uint32_t current) {
+        CanMsg message = makeCanMsg(MSG_ID_CURRENT_SENSOR_DATA, 0);
+        CurrentSensorData::SensorId::encode(message, m_sensorId);
+        CurrentSensorData::RollingNumber::encode(message, n % CurrentSensorSequenceTracker::ROLLING_NUMBER_COUNT);
+        CurrentSensorData::Current::encode(message, current);
+        return m_tracker.update(message, START_NS + n * PERIOD_NS + lateNs);
+    }
+
+    bool statisticsAre(uint32_t received, uint32_t dropped, uint32_t duplicates, uint32_t reordered) const {
+        CurrentSensorSequenceStatistics statistics = m_tracker.statistics(m_sensorId);
+        return statistics.received == received && statistics.dropped == dropped &&
+               statistics.duplicates == duplicates && statistics.reordered == reordered;
+    }
+
+    float rateHz() const { return m_tracker.statistics(m_sensorId).rateHz; }
+
+   private:
+    CurrentSensorSequenceTracker& m_tracker;
+    uint8_t m_sensorId;
+};
+
+void checkSequence() {
+    CurrentSensorSequenceTracker tracker;
+    Sender sender(tracker, 0);
+
+    CAN_CHECK(sender.send(0) == CURRENT_SENSOR_FRAME_FIRST);
+    for (uint32_t n = 1; n < CurrentSensorSequenceTracker::MIN_RATE_SAMPLES; n++) {
+        CAN_CHECK(sender.send(n) == CURRENT_SENSOR_FRAME_IN_ORDER);
+        CAN_CHECK(sender.rateHz() == 0.0f);  // not enough intervals yet
+    }
+    CAN_CHECK(sender.send(4) == CURRENT_SENSOR_FRAME_IN_ORDER);
+    CAN_CHECK(fabs(sender.rateHz() - 100.0f) < 1e-3f);
+    CAN_CHECK(sender.statisticsAre(5, 0, 0, 0));
+
+    // 5 lost, then arriving late by one position
+    CAN_CHECK(sender.send(6) == CURRENT_SENSOR_FRAME_GAP);
+    CAN_CHECK(sender.statisticsAre(6, 1, 0, 0));
+    CAN_CHECK(sender.send(5, 2 * PERIOD_NS) == CURRENT_SENSOR_FRAME_REORDERED);
+    CAN_CHECK(sender.statisticsAre(7, 0, 0, 1));
+
+    // 6 again soon after
+    CAN_CHECK(sender.send(6, PERIOD_NS / 10) == CURRENT_SENSOR_FRAME_DUPLICATE);
+    CAN_CHECK(sender.statisticsAre(8, 0, 1, 1));
+
+    // 7 and 8 lost, 8 arrives late: step 3 back to a missing rolling number
+    CAN_CHECK(sender.send(9) == CURRENT_SENSOR_FRAME_GAP);
+    CAN_CHECK(sender.statisticsAre(9, 2, 1, 1));
+    CAN_CHECK(sender.send(8, 2 * PERIOD_NS) == CURRENT_SENSOR_FRAME_REORDERED);
+    CAN_CHECK(sender.statisticsAre(10, 1, 1, 2));
+    CAN_CHECK(sender.send(10) == CURRENT_SENSOR_FRAME_IN_ORDER);
+    CAN_CHECK(sender.statisticsAre(11, 1, 1, 2));
+
+    // from the rate: 8 frames lost, the rolling number wrapped twice
+    CAN_CHECK(sender.send(19) == CURRENT_SENSOR_FRAME_GAP);
+    CAN_CHECK(sender.statisticsAre(12, 9, 1, 2));
+    // step 0 with another payload, 4 intervals later: 3 frames lost
+    CAN_CHECK(sender.send(23) == CURRENT_SENSOR_FRAME_GAP);
+    CAN_CHECK(sender.statisticsAre(13, 12, 1, 2));
+    CAN_CHECK(sender.send(23, PERIOD_NS / 4) == CURRENT_SENSOR_FRAME_DUPLICATE);
+    CAN_CHECK(sender.statisticsAre(14, 12, 2, 2));
+    // the same payload 4 intervals later is a new frame, the value did not change
+    CAN_CHECK(sender.send(27, 0, 23) == CURRENT_SENSOR_FRAME_GAP);
+    CAN_CHECK(sender.statisticsAre(15, 15, 2, 2));
+    CAN_CHECK(sender.send(28) == CURRENT_SENSOR_FRAME_IN_ORDER);
+    CAN_CHECK(fabs(sender.rateHz() - 100.0f) < 1e-3f);
+}
+
+void checkWithoutRate() {
+    CurrentSensorSequenceTracker tracker;
+    Sender sender(tracker, 3);
+
+    CAN_CHECK(sender.send(0) == CURRENT_SENSOR_FRAME_FIRST);
+    // same payload and rolling number: a duplicate however late, the rate is unknown
+    CAN_CHECK(sender.send(0, 40 * PERIOD_NS) == CURRENT_SENSOR_FRAME_DUPLICATE);
+    // another payload: four frames further
+    CAN_CHECK(sender.send(4) == CURRENT_SENSOR_FRAME_GAP);
+    CAN_CHECK(sender.statisticsAre(3, 3, 1, 0));
+    // no wrap can be seen without the rate
+    CAN_CHECK(sender.send(13) == CURRENT_SENSOR_FRAME_IN_ORDER);
+    CAN_CHECK(sender.statisticsAre(4, 3, 1, 0));
+    CAN_CHECK(sender.rateHz() == 0.0f);
+}
+
+void checkSensorsApart() {
+    CurrentSensorSequenceTracker tracker;
+    Sender first(tracker, 1);
+    Sender last(tracker, CurrentSensorSequenceTracker::SENSOR_COUNT - 1);
+
+    CAN_CHECK(first.send(0) == CURRENT_SENSOR_FRAME_FIRST);
+    CAN_CHECK(last.send(2) == CURRENT_SENSOR_FRAME_FIRST);
+    CAN_CHECK(first.send(1) == CURRENT_SENSOR_FRAME_IN_ORDER);
+    CAN_CHECK(last.send(3) == CURRENT_SENSOR_FRAME_IN_ORDER);
+    CAN_CHECK(first.send(3) == CURRENT_SENSOR_FRAME_GAP);
+    CAN_CHECK(first.statisticsAre(3, 1, 0, 0));
+    CAN_CHECK(last.statisticsAre(2, 0, 0, 0));
+    CAN_CHECK(Sender(tracker, 2).statisticsAre(0, 0, 0, 0));
+
+    CanMsg other = makeCanMsg(MSG_ID_MARINE_SENSOR_DATA, 0);
+    CAN_CHECK(tracker.update(other, START_NS) == CURRENT_SENSOR_FRAME_INVALID);
+    CAN_CHECK(first.statisticsAre(3, 1, 0, 0));
+    CurrentSensorSequenceStatistics outside = tracker.statistics(CurrentSensorSequenceTracker::SENSOR_COUNT);
+    CAN_CHECK(outside.received == 0 && outside.rateHz == 0.0f);
+
+    CAN_CHECK(CurrentSensorSequenceTracker::isFresh(CURRENT_SENSOR_FRAME_FIRST));
+    CAN_CHECK(CurrentSensorSequenceTracker::isFresh(CURRENT_SENSOR_FRAME_IN_ORDER));
+    CAN_CHECK(CurrentSensorSequenceTracker::isFresh(CURRENT_SENSOR_FRAME_GAP));
+    CAN_CHECK(!CurrentSensorSequenceTracker::isFresh(CURRENT_SENSOR_FRAME_DUPLICATE));
+    CAN_CHECK(!CurrentSensorSequenceTracker::isFresh(CURRENT_SENSOR_FRAME_REORDERED));
+    CAN_CHECK(!CurrentSensorSequenceTracker::isFresh(CURRENT_SENSOR_FRAME_INVALID));
+}
+
+}  // namespace
+
+int main() {
+    checkSequence();
+    checkWithoutRate();
+    checkSensorsApart();
+    return canTestResult();
+}
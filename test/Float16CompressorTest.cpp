@@ -0,0 +1,70 @@
+/****************************************************************************************
+ *
+ * File:
+ *    Float16CompressorTest.cpp
+ *
+ * Purpose:
+ *    Exhaustive check of the array compress()/decompress() of Float16Compressor against
+ *    the scalar functions: every float bit pattern and every half precision value, with
+ *    array lengths that leave a scalar tail after the vector loop.
+ *
+ ***************************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "CanTest.h"
+#include "Float16Compressor.h"
+
+namespace {
+
+const size_t CHUNK = 4099;  // not a multiple of VECTOR_WIDTH
+
+void checkCompress() {
+    std::vector<float> values(CHUNK);
+    std::vector<uint16_t> compressed(CHUNK);
+    uint64_t pattern = 0;
+    while (pattern <= 0xFFFFFFFFULL) {
+        size_t n = 0;
+        for (; n < CHUNK && pattern <= 0xFFFFFFFFULL; n++, pattern++) {
+            uint32_t bits = static_cast<uint32_t>(pattern);
+            memcpy(&values[n], &bits, sizeof(bits));
+        }
+        Float16Compressor::compress(values.data(), compressed.data(), n);
+        bool same = true;
+        for (size_t i = 0; i < n; i++) {
+            same &= (compressed[i] == Float16Compressor::compress(values[i]));
+        }
+        CAN_CHECK(same);
+    }
+}
+
+void checkDecompress() {
+    std::vector<uint16_t> compressed(0x10000);
+    std::vector<float> values(0x10000);
+    for (uint32_t i = 0; i < 0x10000; i++) {
+        compressed[i] = static_cast<uint16_t>(i);
+    }
+    // Every length up to a few vectors, then the whole range
+    for (size_t n = 0; n <= 3 * 8 + 1; n++) {
+        Float16Compressor::decompress(compressed.data() + 0x7BF0, values.data(), n);
+        for (size_t i = 0; i < n; i++) {
+            float expected = Float16Compressor::decompress(compressed[0x7BF0 + i]);
+            CAN_CHECK(memcmp(&values[i], &expected, sizeof(float)) == 0);
+        }
+    }
+    Float16Compressor::decompress(compressed.data(), values.data(), compressed.size());
+    for (uint32_t i = 0; i < 0x10000; i++) {
+        float expected = Float16Compressor::decompress(compressed[i]);
+        CAN_CHECK(memcmp(&values[i], &expected, sizeof(float)) == 0);
+    }
+}
+
+}  // namespace
+
+int main() {
+    checkDecompress();
+    checkCompress();
+    return canTestResult();
+}
@@ -0,0 +1,298 @@
+/****************************************************************************************
+ *
+ * File:
+ *    N2kFastPacketTest.cpp
+ *
+ * Purpose:
+ *    N2kFastPacketFragmenter against N2kFastPacketReassembler for every DataLen, frames
+ *    in order and reversed, two sources at once, then the statistics: duplicates,
+ *    restart on frame 0, timeout, eviction when the pool is full and frames shorter
+ *    than their data. Also the 29 bits id conversions of N2kCanId, PDU1 and PDU2.
+ *
+ ***************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "CanTest.h"
+#include "N2kFastPacket.h"
+
+namespace {
+
+const uint32_t GNSS_POSITION_PGN = 129029;  // fast-packet, PDU2
+const uint32_t GROUP_FUNCTION_PGN = 126208; // fast-packet, PDU1
+const uint32_t HEADING_PGN = 127250;        // single frame, PDU2
+
+N2kMsgArd makeMessage(uint32_t pgn, uint8_t source, uint8_t destination, int dataLength) {
+    N2kMsgArd message;
+    memset(&message, 0, sizeof(message));
+    message.PGN = pgn;
+    message.Priority = 3;
+    message.Source = source;
+    message.Destination = destination;
+    message.DataLen = dataLength;
+    for (int i = 0; i < dataLength; i++) {
+        message.Data[i] = static_cast<uint8_t>(rand());
+    }
+    return message;
+}
+
+std::vector<CanMsg> fragment(const N2kMsgArd& message, uint8_t sequenceId) {
+    N2kFastPacketFragmenter fragmenter(message, sequenceId);
+    std::vector<CanMsg> frames;
+    CanMsg frame;
+    while (fragmenter.next(frame)) {
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+bool sameMessage(const N2kMsgArd& received, const N2kMsgArd& sent) {
+    return received.PGN == sent.PGN && received.Priority == sent.Priority && received.Source == sent.Source &&
+           received.Destination == sent.Destination && received.DataLen == sent.DataLen &&
+           memcmp(received.Data, sent.Data, sent.DataLen) == 0;
+}
+
+void checkIds() {
+    // PDU1: the low byte of the PGN is the destination, given apart
+    uint32_t canId = N2kCanId::make(GROUP_FUNCTION_PGN, 3, 0x10, 0x42);
+    CAN_CHECK(canId == ((3UL << 26) | (GROUP_FUNCTION_PGN << 8) | (0x42UL << 8) | 0x10));
+    CAN_CHECK(N2kCanId::pgn(canId) == GROUP_FUNCTION_PGN);
+    CAN_CHECK(N2kCanId::priority(canId) == 3);
+    CAN_CHECK(N2kCanId::source(canId) == 0x10);
+    CAN_CHECK(N2kCanId::destination(canId) == 0x42);
+    CAN_CHECK(N2kCanId::make(GROUP_FUNCTION_PGN | 0x99, 3, 0x10, 0x42) == canId);  // destination wins
+    CAN_CHECK(N2kCanId::destination(N2kCanId::make(GROUP_FUNCTION_PGN, 3, 0x10, N2kCanId::BROADCAST_ADDRESS)) ==
+              N2kCanId::BROADCAST_ADDRESS);
+
+    // PDU2: the low byte belongs to the PGN, the destination is ignored
+    canId = N2kCanId::make(GNSS_POSITION_PGN, 7, 0x23, 0x42);
+    CAN_CHECK(canId == ((7UL << 26) | (GNSS_POSITION_PGN << 8) | 0x23));
+    CAN_CHECK(N2kCanId::pgn(canId) == GNSS_POSITION_PGN);
+    CAN_CHECK(N2kCanId::priority(canId) == 7);
+    CAN_CHECK(N2kCanId::source(canId) == 0x23);
+    CAN_CHECK(N2kCanId::destination(canId) == N2kCanId::BROADCAST_ADDRESS);
+}
+
+void checkRoundTrip(uint32_t pgn, uint8_t destination, int dataLength, bool reversed) {
+    N2kMsgArd sent = makeMessage(pgn, 0x10, destination, dataLength);
+    std::vector<CanMsg> frames = fragment(sent, static_cast<uint8_t>(dataLength));
+    CAN_CHECK(frames.size() == N2kFastPacket::frameCount(static_cast<uint8_t>(dataLength)));
+
+    N2kFastPacketReassembler<2> reassembler;
+    N2kMsgArd received;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const CanMsg& frame = frames[reversed ? frames.size() - 1 - i : i];
+        CAN_CHECK(frame.header.ide == 1 && frame.header.length == N2kFastPacket::FRAME_SIZE);
+        CAN_CHECK(N2kFastPacket::sequenceId(frame) == dataLength % N2kFastPacket::SEQUENCE_ID_COUNT);
+        N2kFastPacketResult result = reassembler.addFrame(frame, static_cast<uint32_t>(i), received);
+        CAN_CHECK(result == ((i + 1 == frames.size()) ? N2K_FRAME_COMPLETE : N2K_FRAME_PENDING));
+    }
+    CAN_CHECK(sameMessage(received, sent));
+    CAN_CHECK(reassembler.activeSessions() == 0);
+    CAN_CHECK(reassembler.statistics().completed == 1);
+}
+
+void checkSingleFrame() {
+    N2kMsgArd sent = makeMessage(HEADING_PGN, 0x10, N2kCanId::BROADCAST_ADDRESS, 8);
+    std::vector<CanMsg> frames = fragment(sent, 0);
+    CAN_CHECK(frames.size() == 1 && frames[0].header.length == 8);
+
+    N2kFastPacketReassembler<2> reassembler;
+    N2kMsgArd received;
+    CAN_CHECK(reassembler.addFrame(frames[0], 0, received) == N2K_FRAME_COMPLETE);
+    CAN_CHECK(sameMessage(received, sent));
+
+    sent.DataLen = 9;  // too long for a single frame
+    CAN_CHECK(fragment(sent, 0).empty());
+    sent = makeMessage(GNSS_POSITION_PGN, 0x10, N2kCanId::BROADCAST_ADDRESS, 0);
+    sent.DataLen = N2kFastPacket::MAX_DATA_SIZE + 1;
+    CAN_CHECK(fragment(sent, 0).empty());
+}
+
+void checkInterleavedSources() {
+    N2kMsgArd first = makeMessage(GNSS_POSITION_PGN, 0x10, N2kCanId::BROADCAST_ADDRESS, 43);
+    N2kMsgArd second = makeMessage(GNSS_POSITION_PGN, 0x11, N2kCanId::BROADCAST_ADDRESS, 43);
+    std::vector<CanMsg> firstFrames = fragment(first, 5);
+    std::vector<CanMsg> secondFrames = fragment(second, 5);  // same PGN and sequence id
+
+    N2kFastPacketReassembler<2> reassembler;
+    N2kMsgArd received;
+    for (size_t i = 0; i + 1 < firstFrames.size(); i++) {
+        CAN_CHECK(reassembler.addFrame(firstFrames[i], 0, received) == N2K_FRAME_PENDING);
+        CAN_CHECK(reassembler.addFrame(secondFrames[i], 0, received) == N2K_FRAME_PENDING);
+    }
+    CAN_CHECK(reassembler.activeSessions() == 2);
+    CAN_CHECK(reassembler.addFrame(secondFrames.back(), 0, received) == N2K_FRAME_COMPLETE);
+    CAN_CHECK(sameMessage(received, second));
+    CAN_CHECK(reassembler.addFrame(firstFrames.back(), 0, received) == N2K_FRAME_COMPLETE);
+    CAN_CHECK(sameMessage(received, first));
+    CAN_CHECK(reassembler.statistics().evicted == 0);
+}
+
+void checkDuplicatesAndRestart() {
+    N2kMsgArd first = makeMessage(GNSS_POSITION_PGN, 0x10, N2kCanId::BROADCAST_ADDRESS, 43);
+    N2kMsgArd second = makeMessage(GNSS_POSITION_PGN, 0x10, N2kCanId::BROADCAST_ADDRESS, 20);
+    std::vector<CanMsg> firstFrames = fragment(first, 1);
+    std::vector<CanMsg> secondFrames = fragment(second, 1);
+
+    N2kFastPacketReassembler<2> reassembler;
+    N2kMsgArd received;
+    CAN_CHECK(reassembler.addFrame(firstFrames[0], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(firstFrames[1], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(firstFrames[1], 0, received) == N2K_FRAME_DROPPED);
+    CAN_CHECK(reassembler.statistics().duplicates == 1);
+
+    // frame 0 again: the first message is given up, its frame 1 is not kept
+    for (size_t i = 0; i + 1 < secondFrames.size(); i++) {
+        CAN_CHECK(reassembler.addFrame(secondFrames[i], 0, received) == N2K_FRAME_PENDING);
+    }
+    CAN_CHECK(reassembler.statistics().restarted == 1);
+    CAN_CHECK(reassembler.addFrame(secondFrames.back(), 0, received) == N2K_FRAME_COMPLETE);
+    CAN_CHECK(sameMessage(received, second));
+
+    // a frame past the announced length
+    CAN_CHECK(reassembler.addFrame(secondFrames[0], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(firstFrames[5], 0, received) == N2K_FRAME_DROPPED);
+    CAN_CHECK(reassembler.statistics().invalid == 1);
+
+    // frame 0 announcing more than MAX_DATA_SIZE bytes
+    CanMsg tooLong = firstFrames[0];
+    tooLong.data[0] = 2 << 5;
+    tooLong.data[1] = N2kFastPacket::MAX_DATA_SIZE + 1;
+    CAN_CHECK(reassembler.addFrame(tooLong, 0, received) == N2K_FRAME_DROPPED);
+    CAN_CHECK(reassembler.statistics().invalid == 2);
+}
+
+void checkTimeout(uint32_t startMs) {
+    N2kMsgArd sent = makeMessage(GNSS_POSITION_PGN, 0x10, N2kCanId::BROADCAST_ADDRESS, 20);
+    std::vector<CanMsg> frames = fragment(sent, 0);
+    const uint32_t timeoutMs = N2kFastPacketReassembler<2>::DEFAULT_TIMEOUT_MS;
+
+    N2kFastPacketReassembler<2> reassembler;
+    N2kMsgArd received;
+    CAN_CHECK(reassembler.addFrame(frames[0], startMs, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[1], startMs + timeoutMs, received) == N2K_FRAME_PENDING);
+    reassembler.expire(startMs + 2 * timeoutMs);
+    CAN_CHECK(reassembler.activeSessions() == 1);
+    CAN_CHECK(reassembler.statistics().timedOut == 0);
+
+    // the session started again at frame 2, without frame 0 it never completes
+    CAN_CHECK(reassembler.addFrame(frames[2], startMs + 2 * timeoutMs + 1, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.statistics().timedOut == 1);
+    reassembler.expire(startMs + 3 * timeoutMs + 2);
+    CAN_CHECK(reassembler.activeSessions() == 0);
+    CAN_CHECK(reassembler.statistics().timedOut == 2);
+    CAN_CHECK(reassembler.statistics().completed == 0);
+}
+
+void checkEviction() {
+    std::vector<N2kMsgArd> messages;
+    std::vector<std::vector<CanMsg> > frames;
+    for (uint8_t source = 0; source < 3; source++) {
+        messages.push_back(makeMessage(GNSS_POSITION_PGN, source, N2kCanId::BROADCAST_ADDRESS, 20));
+        frames.push_back(fragment(messages.back(), 0));
+    }
+
+    N2kFastPacketReassembler<2> reassembler;
+    N2kMsgArd received;
+    CAN_CHECK(reassembler.addFrame(frames[0][0], 10, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[1][0], 20, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[0][1], 30, received) == N2K_FRAME_PENDING);
+    // the pool is full, the session of source 1 is the oldest
+    CAN_CHECK(reassembler.addFrame(frames[2][0], 40, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.statistics().evicted == 1);
+    CAN_CHECK(reassembler.activeSessions() == 2);
+
+    CAN_CHECK(reassembler.addFrame(frames[0][2], 50, received) == N2K_FRAME_COMPLETE);
+    CAN_CHECK(sameMessage(received, messages[0]));
+    CAN_CHECK(reassembler.addFrame(frames[2][1], 50, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[2][2], 50, received) == N2K_FRAME_COMPLETE);
+    CAN_CHECK(sameMessage(received, messages[2]));
+    CAN_CHECK(reassembler.addFrame(frames[1][1], 60, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[1][2], 60, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.statistics().completed == 2);
+}
+
+// frames of 6 + 7 + 2 bytes of data, the last one needs 3 bytes
+void checkShortFrames() {
+    N2kMsgArd sent = makeMessage(GNSS_POSITION_PGN, 0x10, N2kCanId::BROADCAST_ADDRESS, 15);
+    std::vector<CanMsg> frames = fragment(sent, 0);
+    CAN_CHECK(N2kFastPacket::frameLength(0, 15) == 8);
+    CAN_CHECK(N2kFastPacket::frameLength(1, 15) == 8);
+    CAN_CHECK(N2kFastPacket::frameLength(2, 15) == 3);
+    CAN_CHECK(N2kFastPacket::frameLength(0, 4) == 6);
+
+    // the last frame cut to its data
+    N2kFastPacketReassembler<2> reassembler;
+    N2kMsgArd received;
+    frames[2].header.length = 3;
+    CAN_CHECK(reassembler.addFrame(frames[0], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[1], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[2], 0, received) == N2K_FRAME_COMPLETE);
+    CAN_CHECK(sameMessage(received, sent));
+    // and before frame 0
+    CAN_CHECK(reassembler.addFrame(frames[2], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[1], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[0], 0, received) == N2K_FRAME_COMPLETE);
+    CAN_CHECK(sameMessage(received, sent));
+    CAN_CHECK(reassembler.statistics().invalid == 0);
+
+    // the last frame shorter than its data, after and before frame 0
+    frames[2].header.length = 2;
+    CAN_CHECK(reassembler.addFrame(frames[0], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[2], 0, received) == N2K_FRAME_DROPPED);
+    CAN_CHECK(reassembler.statistics().invalid == 1);
+    CAN_CHECK(reassembler.activeSessions() == 0);
+    CAN_CHECK(reassembler.addFrame(frames[2], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[0], 0, received) == N2K_FRAME_DROPPED);
+    CAN_CHECK(reassembler.statistics().invalid == 2);
+    CAN_CHECK(reassembler.activeSessions() == 0);
+    frames[2].header.length = 8;
+
+    // a short frame that is not the last one, after and before frame 0
+    frames[1].header.length = 7;
+    CAN_CHECK(reassembler.addFrame(frames[0], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[1], 0, received) == N2K_FRAME_DROPPED);
+    CAN_CHECK(reassembler.statistics().invalid == 3);
+    CAN_CHECK(reassembler.addFrame(frames[1], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[2], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[0], 0, received) == N2K_FRAME_DROPPED);
+    CAN_CHECK(reassembler.statistics().invalid == 4);
+    CAN_CHECK(reassembler.activeSessions() == 0);
+    frames[2].header.length = 3;
+    CAN_CHECK(reassembler.addFrame(frames[1], 0, received) == N2K_FRAME_PENDING);
+    CAN_CHECK(reassembler.addFrame(frames[2], 0, received) == N2K_FRAME_DROPPED);  // two short frames
+    CAN_CHECK(reassembler.statistics().invalid == 5);
+    frames[1].header.length = 8;
+
+    // frame 0 of a single frame message
+    N2kMsgArd small = makeMessage(GNSS_POSITION_PGN, 0x10, N2kCanId::BROADCAST_ADDRESS, 4);
+    CanMsg frame = fragment(small, 0)[0];
+    frame.header.length = 5;
+    CAN_CHECK(reassembler.addFrame(frame, 0, received) == N2K_FRAME_DROPPED);
+    frame.header.length = 6;
+    CAN_CHECK(reassembler.addFrame(frame, 0, received) == N2K_FRAME_COMPLETE);
+    CAN_CHECK(sameMessage(received, small));
+    CAN_CHECK(reassembler.statistics().invalid == 6);
+}
+
+}  // namespace
+
+int main() {
+    checkIds();
+    for (int dataLength = 0; dataLength <= N2kFastPacket::MAX_DATA_SIZE; dataLength++) {
+        checkRoundTrip(GNSS_POSITION_PGN, N2kCanId::BROADCAST_ADDRESS, dataLength, false);
+        checkRoundTrip(GNSS_POSITION_PGN, N2kCanId::BROADCAST_ADDRESS, dataLength, true);
+        checkRoundTrip(GROUP_FUNCTION_PGN, 0x42, dataLength, false);
+    }
+    checkSingleFrame();
+    checkInterleavedSources();
+    checkDuplicatesAndRestart();
+    checkTimeout(0);
+    checkTimeout(0xFFFFFFFF - 1000);  // millis() wraparound
+    checkEviction();
+    checkShortFrames();
+    return canTestResult();
+}
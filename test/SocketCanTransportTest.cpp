@@ -0,0 +1,201 @@
+/****************************************************************************************
+ *
+ * File:
+ *    SocketCanTransportTest.cpp
+ *
+ * Purpose:
+ *    SocketCanTransport against a virtual interface: batched send/receive round trip,
+ *    range filters split into masks (ids just inside and just outside each range) and
+ *    kernel timestamps present only when enabled.
+ *
+ * Developer Notes:
+ *    Skipped when vcan0 does not exist (or the kernel has no CAN support). To run it:
+ *      sudo modprobe vcan
+ *      sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+ *
+ *    Another process sending on vcan0 while the test runs makes it fail.
+ *
+ ***************************************************************************************/
+
+#include <net/if.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "CanTest.h"
+#include "SocketCanTransport.h"
+
+namespace {
+
+const char* INTERFACE = "vcan0";
+const int QUIET_TIMEOUT_MS = 200;
+
+bool interfaceAvailable() {
+    int probe = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (probe < 0) {
+        return false;
+    }
+    close(probe);
+    return if_nametoindex(INTERFACE) != 0;
+}
+
+CanMsg makeMessage(uint32_t id, bool extended, uint8_t length, uint8_t seed) {
+    CanMsg message;
+    memset(&message, 0, sizeof(message));
+    message.id = id;
+    message.header.ide = extended ? 1 : 0;
+    message.header.length = length;
+    for (uint8_t i = 0; i < length; i++) {
+        message.data[i] = static_cast<uint8_t>(seed * 31 + i);
+    }
+    return message;
+}
+
+bool sameFrame(const CanMsg& a, const CanMsg& b) {
+    return a.id == b.id && a.header.ide == b.header.ide && a.header.length == b.header.length &&
+           memcmp(a.data, b.data, a.header.length) == 0;
+}
+
+/**
+ * Receives until no frame comes for QUIET_TIMEOUT_MS
+ */
+std::vector<CanMsg> receiveAll(SocketCanTransport& receiver, std::vector<uint64_t>* timestamps = NULL) {
+    std::vector<CanMsg> received;
+    CanMsg batch[SocketCanTransport::MAX_BATCH_SIZE];
+    uint64_t stamps[SocketCanTransport::MAX_BATCH_SIZE];
+    memset(stamps, 0xFF, sizeof(stamps));
+    int count;
+    while ((count = receiver.receive(batch, SocketCanTransport::MAX_BATCH_SIZE, stamps, QUIET_TIMEOUT_MS)) > 0) {
+        received.insert(received.end(), batch, batch + count);
+        if (timestamps) {
+            timestamps->insert(timestamps->end(), stamps, stamps + count);
+        }
+    }
+    CAN_CHECK(count == 0);
+    return received;
+}
+
+uint64_t realtimeNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+}
+
+void checkBatchedRoundTrip() {
+    SocketCanTransport sender;
+    SocketCanTransport receiver;
+    CAN_CHECK(sender.open(INTERFACE));
+    CAN_CHECK(receiver.open(INTERFACE));
+
+    // A full batch, standard and extended ids, every length
+    std::vector<CanMsg> sent;
+    for (size_t i = 0; i < SocketCanTransport::MAX_BATCH_SIZE; i++) {
+        bool extended = (i % 3) == 0;
+        uint32_t id = extended ? static_cast<uint32_t>(0x1ABCD00 + i) : static_cast<uint32_t>(0x100 + i);
+        sent.push_back(makeMessage(id, extended, static_cast<uint8_t>(i % 9), static_cast<uint8_t>(i)));
+    }
+    CAN_CHECK(sender.send(sent.data(), sent.size()) == static_cast<int>(sent.size()));
+
+    std::vector<CanMsg> received = receiveAll(receiver);
+    CAN_CHECK(received.size() == sent.size());
+    for (size_t i = 0; i < received.size() && i < sent.size(); i++) {
+        CAN_CHECK(sameFrame(received[i], sent[i]));
+    }
+
+    // Nothing left, a zero timeout does not wait
+    CanMsg message;
+    CAN_CHECK(receiver.receive(&message, 1, NULL, 0) == 0);
+}
+
+void checkRangeFilters() {
+    SocketCanTransport sender;
+    SocketCanTransport receiver;
+    CAN_CHECK(sender.open(INTERFACE));
+    CAN_CHECK(receiver.open(INTERFACE));
+
+    // Unaligned bounds, a range across the standard/extended limit, an extended range
+    const CanIdRange ranges[] = {{0x123, 0x1F0}, {0x7F0, 0x805}, {0x12345, 0x12399}};
+    CAN_CHECK(receiver.setFilters(ranges, sizeof(ranges) / sizeof(ranges[0])));
+
+    struct Probe {
+        uint32_t id;
+        bool extended;
+        bool accepted;
+    };
+    const Probe probes[] = {
+        {0x122, false, false},   {0x123, false, true},    {0x150, false, true},    {0x1F0, false, true},
+        {0x1F1, false, false},   {0x7EF, false, false},   {0x7F0, false, true},    {0x7FF, false, true},
+        {0x800, true, true},     {0x805, true, true},     {0x806, true, false},    {0x12344, true, false},
+        {0x12345, true, true},   {0x12399, true, true},   {0x1239A, true, false},
+        {0x150, true, false},  // standard range, extended frame
+    };
+
+    std::vector<CanMsg> sent;
+    std::vector<CanMsg> expected;
+    for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); i++) {
+        CanMsg message = makeMessage(probes[i].id, probes[i].extended, 8, static_cast<uint8_t>(i));
+        sent.push_back(message);
+        if (probes[i].accepted) {
+            expected.push_back(message);
+        }
+    }
+    CAN_CHECK(sender.send(sent.data(), sent.size()) == static_cast<int>(sent.size()));
+
+    std::vector<CanMsg> received = receiveAll(receiver);
+    CAN_CHECK(received.size() == expected.size());
+    for (size_t i = 0; i < received.size() && i < expected.size(); i++) {
+        CAN_CHECK(sameFrame(received[i], expected[i]));
+    }
+
+    // Too many filters are refused
+    CanIdRange scattered[SocketCanTransport::MAX_FILTERS + 1];
+    for (size_t i = 0; i < SocketCanTransport::MAX_FILTERS + 1; i++) {
+        scattered[i].first = static_cast<uint32_t>(2 * i + 1);
+        scattered[i].last = static_cast<uint32_t>(2 * i + 1);
+    }
+    CAN_CHECK(!receiver.setFilters(scattered, SocketCanTransport::MAX_FILTERS + 1));
+}
+
+void checkTimestamps(bool enabled) {
+    SocketCanTransport sender;
+    SocketCanTransport receiver;
+    CAN_CHECK(sender.open(INTERFACE));
+    CAN_CHECK(receiver.open(INTERFACE, enabled));
+
+    std::vector<CanMsg> sent;
+    for (uint8_t i = 0; i < 8; i++) {
+        sent.push_back(makeMessage(0x200 + i, false, 8, i));
+    }
+    uint64_t before = realtimeNs();
+    CAN_CHECK(sender.send(sent.data(), sent.size()) == static_cast<int>(sent.size()));
+
+    std::vector<uint64_t> timestamps;
+    std::vector<CanMsg> received = receiveAll(receiver, &timestamps);
+    uint64_t after = realtimeNs();
+    CAN_CHECK(received.size() == sent.size());
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        if (enabled) {
+            CAN_CHECK(timestamps[i] >= before && timestamps[i] <= after);
+            CAN_CHECK(i == 0 || timestamps[i] >= timestamps[i - 1]);
+        } else {
+            CAN_CHECK(timestamps[i] == 0);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    if (!interfaceAvailable()) {
+        printf("%s not available, skipped\n", INTERFACE);
+        return CAN_TEST_SKIPPED;
+    }
+
+    checkBatchedRoundTrip();
+    checkRangeFilters();
+    checkTimestamps(false);
+    checkTimestamps(true);
+    return canTestResult();
+}
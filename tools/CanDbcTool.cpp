@@ -0,0 +1,1101 @@
+/****************************************************************************************
+ *
+ * File:
+ *    CanDbcTool.cpp
+ *
+ * Purpose:
+ *    DBC import/export of the message definitions, so the layouts are checked before
+ *    they reach the boards and bus analysis tools decode our traffic.
+ *
+ *      export: writes the messages of CanMessageSchema.h as a DBC file, with the
+ *              interval mappings as factor/offset, the names of their constants as
+ *              attributes and the error codes as values and as a value table.
+ *      import: reads a DBC file, checks it and generates canbus_id_defs.h,
+ *              canbus_datamappings_defs.h, canbus_error_defs.h and canbus_codec_defs.h
+ *              (constexpr encode/decode functions of every signal).
+ *      check:  only checks a DBC file and prints the bits used by each message.
+ *
+ * Developer Notes:
+ *    Host tool, C++17, built by the CMakeLists.txt of the repository (target
+ *    CanDbcTool).
+ *
+ *    Usage: CanDbcTool export <file.dbc>
+ *           CanDbcTool import <file.dbc> <output directory>
+ *           CanDbcTool check <file.dbc>
+ *
+ *    Bit positions follow CanPayload.h: CanMsg.data[0] holds bits 63..56 of the
+ *    payload word, so our fields are big-endian (Motorola, @0) signals. The messages
+ *    written in bytes in order by CanMessageHandler::encodeMessage(lengthInBytes,
+ *    data) (requests, winch, solar panel) hold little-endian values: they are Intel
+ *    (@1) signals on whole bytes, following each other from data[0], and only get a
+ *    _DATASIZE in bytes. Other Intel signals are only accepted within one byte, where
+ *    both orders are the same. Multiplexed signals are not supported.
+ *
+ *    Import fails on overlapping signals, signals outside of the frame, duplicate
+ *    names or ids, and signals of the same name with different layouts. Byte
+ *    aligned signals are generated in bytes (_IN_BYTE true) like the hand written
+ *    definitions, the others in bits. Scaled signals get _INTERVAL_MIN/_INTERVAL_MAX
+ *    from their [min|max] range, or the names of the CanbusMinimumName and
+ *    CanbusMaximumName attributes of the signal. The signals of the
+ *    VECTOR__INDEPENDENT_SIG_MSG pseudo message are definitions not placed in any
+ *    message. The values of the signals and of the value tables whose name ends
+ *    with ERROR become the error codes.
+ *
+ *    export, import and export again gives the same DBC file, checked by the
+ *    CanDbcRoundTrip test.
+ *
+ ***************************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../CanMessageSchema.h"
+#include "../canbus_defs.h"
+
+namespace {
+
+struct SignalValue {
+    uint64_t value;
+    std::string name;
+};
+
+struct Signal {
+    std::string name;
+    uint32_t startBit;  // bit of the payload word, see CanPayload.h
+    uint32_t length;
+    bool inOrder;        // little-endian bytes from CanMsg.data[startByte], not in the payload word
+    uint32_t startByte;  // if inOrder
+    bool isSigned;
+    double factor;
+    double offset;
+    double minimum;
+    double maximum;
+    std::string unit;
+    std::string comment;
+    std::string minimumName;  // constants of the interval, empty for the default names
+    std::string maximumName;
+    std::vector<SignalValue> values;
+};
+
+struct Message {
+    std::string name;  // without MSG_ID_
+    uint32_t id;
+    bool extended;
+    uint8_t length;
+    std::string comment;
+    std::vector<Signal> signals;
+};
+
+struct ValueTable {
+    std::string name;
+    std::vector<SignalValue> values;
+};
+
+struct Database {
+    std::vector<ValueTable> valueTables;
+    std::vector<Message> messages;
+};
+
+const uint32_t DBC_EXTENDED_ID_FLAG = 0x80000000UL;
+const uint32_t PAYLOAD_BITS = 64;
+const uint32_t PAYLOAD_BYTES = 8;
+
+// Pseudo message of the signals not placed in a message, as written by CANdb++
+const char* const INDEPENDENT_MESSAGE_NAME = "VECTOR__INDEPENDENT_SIG_MSG";
+const uint32_t INDEPENDENT_MESSAGE_ID = 0x40000000UL;
+
+const char* const MINIMUM_NAME_ATTRIBUTE = "CanbusMinimumName";
+const char* const MAXIMUM_NAME_ATTRIBUTE = "CanbusMaximumName";
+const char* const ERROR_TABLE_NAME = "CANBUS_ERROR";
+
+uint64_t rawMaximum(uint32_t length) {
+    return (length >= 64) ? ~0ULL : ((1ULL << length) - 1);
+}
+
+bool isIndependent(const Message& message) {
+    return message.name == INDEPENDENT_MESSAGE_NAME;
+}
+
+bool isErrorName(const std::string& name) {
+    const std::string suffix = "ERROR";
+    return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * Shift of CanMsg.data[index] in the payload word, as CanPayload::byteShift()
+ */
+uint32_t byteShift(uint32_t index) {
+    return (PAYLOAD_BYTES - 1 - index) * 8;
+}
+
+/**
+ * Bits of the payload word used by a signal
+ */
+uint64_t payloadBits(const Signal& signal) {
+    if (!signal.inOrder) {
+        return rawMaximum(signal.length) << signal.startBit;
+    }
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < signal.length / 8; i++) {
+        bits |= 0xFFULL << byteShift(signal.startByte + i);
+    }
+    return bits;
+}
+
+// Payload word bit <-> DBC bit numbering (byte * 8 + bit in byte, 0 the LSB)
+uint32_t dbcBit(uint32_t wordBit) {
+    return (7 - wordBit / 8) * 8 + wordBit % 8;
+}
+
+uint32_t wordBit(uint32_t dbcBit) {
+    return (7 - dbcBit / 8) * 8 + dbcBit % 8;
+}
+
+//---------------------------------------------------------------------------------------
+// Export, from CanMessageSchema.h
+//---------------------------------------------------------------------------------------
+
+/**
+ * Signal of a CanField, mapped on [minimum, maximum] if they differ
+ */
+template <class Field>
+Signal schemaSignal(const char* name, double minimum = 0, double maximum = 0, const char* comment = "",
+                    const char* minimumName = "", const char* maximumName = "") {
+    Signal signal;
+    signal.name = name;
+    signal.startBit = Field::START_BIT;
+    signal.length = Field::LENGTH;
+    signal.inOrder = false;
+    signal.startByte = 0;
+    signal.isSigned = false;
+    signal.comment = comment;
+    signal.minimumName = minimumName;
+    signal.maximumName = maximumName;
+    if (minimum != maximum) {
+        // Same mapping as CanMessageHandler::encodeMappedMessage()
+        signal.factor = (maximum - minimum) / static_cast<double>(Field::MASK);
+        signal.offset = minimum;
+        signal.minimum = minimum;
+        signal.maximum = maximum;
+    } else {
+        signal.factor = 1;
+        signal.offset = 0;
+        signal.minimum = 0;
+        signal.maximum = static_cast<double>(Field::MASK);
+    }
+    return signal;
+}
+
+// Mapped on the interval of two constants, whose names are kept in the DBC
+#define MAPPED_SIGNAL(FIELD, NAME, MINIMUM, MAXIMUM) schemaSignal<FIELD>(NAME, MINIMUM, MAXIMUM, "", #MINIMUM, #MAXIMUM)
+
+/**
+ * Signal of bytes bytes written after the previous ones of the message by
+ * CanMessageHandler::encodeMessage(lengthInBytes, data)
+ */
+void addInOrderSignal(Message& message, const char* name, uint32_t bytes, const char* comment = "") {
+    Signal signal;
+    signal.name = name;
+    signal.startBit = 0;
+    signal.length = bytes * 8;
+    signal.inOrder = true;
+    signal.startByte = 0;
+    if (!message.signals.empty()) {
+        const Signal& previous = message.signals.back();
+        signal.startByte = previous.startByte + previous.length / 8;
+    }
+    signal.isSigned = false;
+    signal.factor = 1;
+    signal.offset = 0;
+    signal.minimum = 0;
+    signal.maximum = static_cast<double>(rawMaximum(signal.length));
+    signal.comment = comment;
+    message.signals.push_back(signal);
+}
+
+#define ERROR_VALUE(NAME) {NAME, #NAME}
+
+// Error codes of canbus_error_defs.h
+const SignalValue ERROR_CODES[] = {
+    ERROR_VALUE(NO_ERRORS),
+    ERROR_VALUE(ERROR_SENSOR_PH_NO_CONNECTION),
+    ERROR_VALUE(ERROR_SENSOR_PH_SYNTAX),
+    ERROR_VALUE(ERROR_SENSOR_PH_NOT_READY),
+    ERROR_VALUE(ERROR_SENSOR_PH_NO_DATA),
+    ERROR_VALUE(ERROR_SENSOR_CONDUCTIVETY_NO_CONNECTION),
+    ERROR_VALUE(ERROR_SENSOR_CONDUCTIVETY_SYNTAX),
+    ERROR_VALUE(ERROR_SENSOR_CONDUCTIVETY_NOT_READY),
+    ERROR_VALUE(ERROR_SENSOR_CONDUCTIVETY_NO_DATA),
+    ERROR_VALUE(ERROR_SENSOR_TEMPERATURE_NO_CONNECTION),
+    ERROR_VALUE(ERROR_SENSOR_TEMPERATURE_SYNTAX),
+    ERROR_VALUE(ERROR_SENSOR_TEMPERATURE_NOT_READY),
+    ERROR_VALUE(ERROR_SENSOR_TEMPERATURE_NO_DATA),
+    ERROR_VALUE(ERROR_CANMSG_DATA_OUT_OF_INTERVAL),
+    ERROR_VALUE(ERROR_CANMSG_INDEX_OUT_OF_INTERVAL),
+    ERROR_VALUE(ERROR_CANMSG_ENCODING_OUT_OF_BOUND),
+    ERROR_VALUE(ERROR_CANMSG_MASK_HAS_NO_BIT_SET),
+    ERROR_VALUE(ERROR_CANMSG_OVERWRITING),
+};
+
+/**
+ * Error codes that fit in an error field of length bits
+ */
+std::vector<SignalValue> errorValues(uint32_t length) {
+    std::vector<SignalValue> values;
+    for (const SignalValue& code : ERROR_CODES) {
+        if (code.value <= rawMaximum(length)) {
+            values.push_back(code);
+        }
+    }
+    return values;
+}
+
+Message schemaMessage(const char* name, uint32_t id, const char* comment) {
+    Message message;
+    message.name = name;
+    message.id = id;
+    message.extended = false;
+    message.length = 8;
+    message.comment = comment;
+    return message;
+}
+
+/**
+ * Messages of canbus_id_defs.h, with the fields CanMessageSchema.h describes, and
+ * the error codes
+ */
+Database schemaDatabase() {
+    Database database;
+    database.valueTables.push_back({ERROR_TABLE_NAME, std::vector<SignalValue>(std::begin(ERROR_CODES),
+                                                                               std::end(ERROR_CODES))});
+    std::vector<Message>& messages = database.messages;
+
+    Message auControl = schemaMessage("AU_CONTROL", AuControl::ID, "Actuator unit control");
+    auControl.signals.push_back(
+        MAPPED_SIGNAL(AuControl::Rudder, "RUDDER_ANGLE", MIN_RUDDER_ANGLE, MAX_RUDDER_ANGLE));
+    auControl.signals.push_back(
+        MAPPED_SIGNAL(AuControl::Wingsail, "WINGSAIL_ANGLE", MIN_WINGSAIL_ANGLE, MAX_WINGSAIL_ANGLE));
+    auControl.signals.push_back(MAPPED_SIGNAL(AuControl::WindvaneSelfSteeringAngle, "WINDVANE_SELFSTEERING_ANGLE",
+                                              WINDVANE_SELFSTEERING_ANGLE_MIN, WINDVANE_SELFSTEERING_ANGLE_MAX));
+    messages.push_back(auControl);
+
+    Message auFeedback = schemaMessage("AU_FEEDBACK", AuFeedback::ID, "Actuator unit feedback");
+    auFeedback.signals.push_back(
+        MAPPED_SIGNAL(AuFeedback::Rudder, "RUDDER_ANGLE", MIN_RUDDER_ANGLE, MAX_RUDDER_ANGLE));
+    auFeedback.signals.push_back(
+        MAPPED_SIGNAL(AuFeedback::Wingsail, "WINGSAIL_ANGLE", MIN_WINGSAIL_ANGLE, MAX_WINGSAIL_ANGLE));
+    auFeedback.signals.push_back(MAPPED_SIGNAL(AuFeedback::WindvaneSelfSteeringAngle, "WINDVANE_SELFSTEERING_ANGLE",
+                                               WINDVANE_SELFSTEERING_ANGLE_MIN, WINDVANE_SELFSTEERING_ANGLE_MAX));
+    auFeedback.signals.push_back(
+        schemaSignal<AuFeedback::WindvaneActuatorPosition>("WINDVANE_ACTUATOR_POSITION"));
+    messages.push_back(auFeedback);
+
+    Message rcStatus = schemaMessage("RC_STATUS", RcStatus::ID, "Radio controller status");
+    rcStatus.signals.push_back(schemaSignal<RcStatus::RadioControllerOn>("RADIOCONTROLLER_ON"));
+    messages.push_back(rcStatus);
+
+    // Bytes in order, no field descriptors
+    Message solarPanel1 = schemaMessage("SOLAR_PANEL_CONTROL_PART_1", MSG_ID_SOLAR_PANEL_CONTROL_PART_1,
+                                        "Latitude and longitude");
+    addInOrderSignal(solarPanel1, "SOLAR_PANEL_LATITUDE", SOLAR_PANEL_LATITUDE_DATASIZE);
+    addInOrderSignal(solarPanel1, "SOLAR_PANEL_LONGITUDE", SOLAR_PANEL_LONGITUDE_DATASIZE);
+    messages.push_back(solarPanel1);
+
+    Message solarPanel2 = schemaMessage("SOLAR_PANEL_CONTROL_PART_2", MSG_ID_SOLAR_PANEL_CONTROL_PART_2,
+                                        "Time and heading");
+    addInOrderSignal(solarPanel2, "SOLAR_PANEL_TIME", SOLAR_PANEL_TIME_DATASIZE);
+    addInOrderSignal(solarPanel2, "SOLAR_PANEL_HEADING", SOLAR_PANEL_HEADING_DATASIZE);
+    messages.push_back(solarPanel2);
+
+    Message winchControl = schemaMessage("WINCH_CONTROL", MSG_ID_WINCH_CONTROL, "Winch control");
+    addInOrderSignal(winchControl, "WINCH_EXTENDED_LENGTH", WINCH_EXTENDED_LENGTH_DATASIZE);
+    messages.push_back(winchControl);
+
+    Message winchFeedback = schemaMessage("WINCH_FEEDBACK", MSG_ID_WINCH_FEEDBACK, "Winch feedback");
+    addInOrderSignal(winchFeedback, "WINCH_EXTENDED_LENGTH", WINCH_EXTENDED_LENGTH_DATASIZE);
+    messages.push_back(winchFeedback);
+
+    Message marineRequest = schemaMessage("MARINE_SENSOR_REQUEST", MSG_ID_MARINE_SENSOR_REQUEST,
+                                          "Marine sensor reading request");
+    addInOrderSignal(marineRequest, "REQUEST_CONTINOUS_READINGS", REQUEST_CONTINOUS_READINGS_DATASIZE,
+                     "Continuous readings on/off");
+    addInOrderSignal(marineRequest, "REQUEST_READING_TIME", REQUEST_READING_TIME_DATASIZE, "Reading interval");
+    messages.push_back(marineRequest);
+
+    // The sensor id at the place of CURRENT_SENSOR_DATA, see CanRequestClient.h
+    Message currentRequest = schemaMessage("CURRENT_SENSOR_REQUEST", MSG_ID_CURRENT_SENSOR_REQUEST,
+                                           "Current sensor reading request");
+    currentRequest.signals.push_back(schemaSignal<CAN_FIELD(CURRENT_SENSOR_ID)>("CURRENT_SENSOR_ID"));
+    messages.push_back(currentRequest);
+
+    Message marine = schemaMessage("MARINE_SENSOR_DATA", MarineSensorData::ID, "Marine sensor readings");
+    marine.signals.push_back(
+        MAPPED_SIGNAL(MarineSensorData::Ph, "SENSOR_PH", SENSOR_PH_INTERVAL_MIN, SENSOR_PH_INTERVAL_MAX));
+    marine.signals.push_back(MAPPED_SIGNAL(MarineSensorData::Conductivity, "SENSOR_CONDUCTIVETY",
+                                           SENSOR_CONDUCTIVETY_INTERVAL_MIN, SENSOR_CONDUCTIVETY_INTERVAL_MAX));
+    marine.signals.push_back(MAPPED_SIGNAL(MarineSensorData::Temperature, "SENSOR_TEMPERATURE",
+                                           SENSOR_TEMPERATURE_INTERVAL_MIN, SENSOR_TEMPERATURE_INTERVAL_MAX));
+    marine.signals.push_back(schemaSignal<MarineSensorData::Error>("SENSOR_ERROR"));
+    marine.signals.back().values = errorValues(MarineSensorData::Error::LENGTH);
+    messages.push_back(marine);
+
+    Message current = schemaMessage("CURRENT_SENSOR_DATA", CurrentSensorData::ID, "Current sensor reading");
+    current.signals.push_back(schemaSignal<CurrentSensorData::Voltage>(
+        "CURRENT_SENSOR_VOLTAGE", 0, 0, "Half precision float, see Float16Compressor.h"));
+    current.signals.push_back(schemaSignal<CurrentSensorData::Current>(
+        "CURRENT_SENSOR_CURRENT", 0, 0, "Half precision float, see Float16Compressor.h"));
+    current.signals.push_back(schemaSignal<CurrentSensorData::Error>("CURRENT_SENSOR_ERROR"));
+    current.signals.push_back(schemaSignal<CurrentSensorData::RollingNumber>("CURRENT_SENSOR_ROL_NUM"));
+    current.signals.push_back(schemaSignal<CurrentSensorData::SensorId>("CURRENT_SENSOR_ID"));
+    messages.push_back(current);
+
+    // Shares its bits with WINDVANE_SELFSTEERING_ANGLE, not in AU_CONTROL (see CanMessageSchema.h)
+    Message independent = schemaMessage(INDEPENDENT_MESSAGE_NAME, INDEPENDENT_MESSAGE_ID,
+                                        "Definitions not placed in a message");
+    independent.extended = true;
+    independent.length = 0;
+    independent.signals.push_back(
+        schemaSignal<CAN_FIELD(WINDVANE_SELFSTEERING_ON)>("WINDVANE_SELFSTEERING_ON"));
+    messages.push_back(independent);
+
+    return database;
+}
+
+std::string quoted(const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+        result += (c == '"') ? '\'' : c;
+    }
+    return result + "\"";
+}
+
+std::string number(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.10g", value);
+    return buffer;
+}
+
+std::string defaultMinimumName(const Signal& signal) {
+    return signal.name + "_INTERVAL_MIN";
+}
+
+std::string defaultMaximumName(const Signal& signal) {
+    return signal.name + "_INTERVAL_MAX";
+}
+
+void writeValues(const std::vector<SignalValue>& values, std::ostream& out) {
+    for (const SignalValue& value : values) {
+        out << " " << value.value << " " << quoted(value.name);
+    }
+    out << " ;\n";
+}
+
+void writeNameAttribute(const char* attribute, uint32_t id, const Signal& signal, const std::string& name,
+                        const std::string& defaultName, std::ostream& out) {
+    if (!name.empty() && name != defaultName) {
+        out << "BA_ \"" << attribute << "\" SG_ " << id << " " << signal.name << " " << quoted(name) << ";\n";
+    }
+}
+
+void writeDbc(const Database& database, std::ostream& out) {
+    out << "VERSION \"\"\n\nNS_ :\n    CM_\n    BA_DEF_\n    BA_\n    VAL_\n    BA_DEF_DEF_\n    VAL_TABLE_\n\n"
+        << "BS_:\n\nBU_:\n\n";
+
+    for (const ValueTable& table : database.valueTables) {
+        out << "VAL_TABLE_ " << table.name;
+        writeValues(table.values, out);
+    }
+    out << "\n";
+
+    const std::vector<Message>& messages = database.messages;
+    for (const Message& message : messages) {
+        uint32_t id = message.extended ? (message.id | DBC_EXTENDED_ID_FLAG) : message.id;
+        out << "BO_ " << id << " " << message.name << ": " << static_cast<int>(message.length) << " Vector__XXX\n";
+        for (const Signal& signal : message.signals) {
+            // Intel signals start at their least significant bit
+            uint32_t startBit = signal.inOrder ? signal.startByte * 8 : dbcBit(signal.startBit + signal.length - 1);
+            out << " SG_ " << signal.name << " : " << startBit << "|" << signal.length << "@"
+                << (signal.inOrder ? "1" : "0") << (signal.isSigned ? "-" : "+") << " (" << number(signal.factor)
+                << "," << number(signal.offset) << ") [" << number(signal.minimum) << "|" << number(signal.maximum)
+                << "] " << quoted(signal.unit) << " Vector__XXX\n";
+        }
+        out << "\n";
+    }
+
+    for (const Message& message : messages) {
+        uint32_t id = message.extended ? (message.id | DBC_EXTENDED_ID_FLAG) : message.id;
+        if (!message.comment.empty()) {
+            out << "CM_ BO_ " << id << " " << quoted(message.comment) << ";\n";
+        }
+        for (const Signal& signal : message.signals) {
+            if (!signal.comment.empty()) {
+                out << "CM_ SG_ " << id << " " << signal.name << " " << quoted(signal.comment) << ";\n";
+            }
+        }
+    }
+
+    out << "BA_DEF_ SG_ \"" << MINIMUM_NAME_ATTRIBUTE << "\" STRING ;\n"
+        << "BA_DEF_ SG_ \"" << MAXIMUM_NAME_ATTRIBUTE << "\" STRING ;\n"
+        << "BA_DEF_DEF_ \"" << MINIMUM_NAME_ATTRIBUTE << "\" \"\";\n"
+        << "BA_DEF_DEF_ \"" << MAXIMUM_NAME_ATTRIBUTE << "\" \"\";\n";
+    for (const Message& message : messages) {
+        uint32_t id = message.extended ? (message.id | DBC_EXTENDED_ID_FLAG) : message.id;
+        for (const Signal& signal : message.signals) {
+            writeNameAttribute(MINIMUM_NAME_ATTRIBUTE, id, signal, signal.minimumName, defaultMinimumName(signal),
+                               out);
+            writeNameAttribute(MAXIMUM_NAME_ATTRIBUTE, id, signal, signal.maximumName, defaultMaximumName(signal),
+                               out);
+        }
+    }
+
+    for (const Message& message : messages) {
+        uint32_t id = message.extended ? (message.id | DBC_EXTENDED_ID_FLAG) : message.id;
+        for (const Signal& signal : message.signals) {
+            if (signal.values.empty()) {
+                continue;
+            }
+            out << "VAL_ " << id << " " << signal.name;
+            writeValues(signal.values, out);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Import
+//---------------------------------------------------------------------------------------
+
+class DbcParser {
+   public:
+    explicit DbcParser(Database& database) : m_database(database), m_messages(database.messages), m_errors(0) {}
+
+    bool parse(std::istream& in) {
+        const std::regex messageLine(R"(^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+\S+\s*$)");
+        const std::regex signalLine(
+            R"(^SG_\s+(\w+)\s+(\S+\s+)?:\s*(\d+)\|(\d+)@([01])([+-])\s*\(\s*([^,\s]+)\s*,\s*([^)\s]+)\s*\)\s*)"
+            R"(\[\s*([^|\s]+)\s*\|\s*([^\]\s]+)\s*\]\s*"([^"]*)\".*$)");
+        const std::regex messageComment(R"(^CM_\s+BO_\s+(\d+)\s+"([^"]*)\"\s*;$)");
+        const std::regex signalComment(R"(^CM_\s+SG_\s+(\d+)\s+(\w+)\s+"([^"]*)\"\s*;$)");
+        const std::regex signalValues(R"(^VAL_\s+(\d+)\s+(\w+)\s+(.*);$)");
+        const std::regex valueTable(R"(^VAL_TABLE_\s+(\w+)\s+(.*);$)");
+        const std::regex signalAttribute(R"(^BA_\s+"(\w+)\"\s+SG_\s+(\d+)\s+(\w+)\s+"([^"]*)\"\s*;$)");
+
+        std::string statement;
+        int lineNumber = 0;
+        Message* message = nullptr;
+        while (nextStatement(in, statement, lineNumber)) {
+            std::smatch match;
+            if (std::regex_match(statement, match, messageLine)) {
+                uint32_t id = static_cast<uint32_t>(std::stoul(match[1]));
+                Message parsed;
+                parsed.name = match[2];
+                parsed.extended = (id & DBC_EXTENDED_ID_FLAG) != 0;
+                parsed.id = id & ~DBC_EXTENDED_ID_FLAG;
+                parsed.length = static_cast<uint8_t>(std::stoul(match[3]));
+                if (parsed.length > 8) {
+                    error(lineNumber, "message " + parsed.name + " is longer than 8 bytes");
+                }
+                m_messages.push_back(parsed);
+                message = &m_messages.back();
+            } else if (std::regex_match(statement, match, signalLine)) {
+                if (message == nullptr) {
+                    error(lineNumber, "signal outside of a message");
+                    continue;
+                }
+                if (match[2].matched) {
+                    error(lineNumber, "multiplexed signal " + match[1].str() + " is not supported");
+                    continue;
+                }
+                Signal signal;
+                signal.name = match[1];
+                signal.length = static_cast<uint32_t>(std::stoul(match[4]));
+                signal.isSigned = match[6] == "-";
+                signal.factor = std::stod(match[7]);
+                signal.offset = std::stod(match[8]);
+                signal.minimum = std::stod(match[9]);
+                signal.maximum = std::stod(match[10]);
+                signal.unit = match[11];
+                signal.inOrder = false;
+                signal.startByte = 0;
+                if (toWordBit(signal, static_cast<uint32_t>(std::stoul(match[3])), match[5] == "1", lineNumber)) {
+                    message->signals.push_back(signal);
+                }
+            } else if (std::regex_match(statement, match, messageComment)) {
+                if (Message* commented = find(static_cast<uint32_t>(std::stoul(match[1])))) {
+                    commented->comment = match[2];
+                }
+            } else if (std::regex_match(statement, match, signalComment)) {
+                if (Signal* commented = find(static_cast<uint32_t>(std::stoul(match[1])), match[2])) {
+                    commented->comment = match[3];
+                }
+            } else if (std::regex_match(statement, match, signalValues)) {
+                if (Signal* signal = find(static_cast<uint32_t>(std::stoul(match[1])), match[2])) {
+                    parseValues(match[3], signal->values);
+                }
+            } else if (std::regex_match(statement, match, valueTable)) {
+                ValueTable table;
+                table.name = match[1];
+                parseValues(match[2], table.values);
+                m_database.valueTables.push_back(table);
+            } else if (std::regex_match(statement, match, signalAttribute)) {
+                Signal* signal = find(static_cast<uint32_t>(std::stoul(match[2])), match[3]);
+                if (signal != nullptr && match[1] == MINIMUM_NAME_ATTRIBUTE) {
+                    signal->minimumName = match[4];
+                } else if (signal != nullptr && match[1] == MAXIMUM_NAME_ATTRIBUTE) {
+                    signal->maximumName = match[4];
+                }
+            }
+            // The other statements (attribute definitions, nodes...) are not needed
+        }
+        for (Message& parsed : m_messages) {
+            resolveInOrder(parsed);
+        }
+        return m_errors == 0;
+    }
+
+   private:
+    // A statement is a line, or up to the ';' for the comments and value tables
+    static bool nextStatement(std::istream& in, std::string& statement, int& lineNumber) {
+        std::string line;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            statement = trim(line);
+            if (statement.empty()) {
+                continue;
+            }
+            // Not the bare CM_, VAL_... of the NS_ list
+            if (statement.compare(0, 4, "CM_ ") == 0 || statement.compare(0, 5, "VAL_ ") == 0 ||
+                statement.compare(0, 11, "VAL_TABLE_ ") == 0 || statement.compare(0, 4, "BA_ ") == 0) {
+                while (statement.back() != ';' && std::getline(in, line)) {
+                    lineNumber++;
+                    statement += " " + trim(line);
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    static void parseValues(const std::string& text, std::vector<SignalValue>& values) {
+        static const std::regex value(R"((\d+)\s+"([^"]*)\")");
+        for (std::sregex_iterator it(text.begin(), text.end(), value), end; it != end; ++it) {
+            values.push_back({std::stoull((*it)[1]), (*it)[2]});
+        }
+    }
+
+    static std::string trim(const std::string& text) {
+        size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos) {
+            return "";
+        }
+        size_t last = text.find_last_not_of(" \t\r\n");
+        return text.substr(first, last - first + 1);
+    }
+
+    bool toWordBit(Signal& signal, uint32_t startBit, bool intel, int lineNumber) {
+        if (signal.length == 0 || signal.length > PAYLOAD_BITS || startBit >= PAYLOAD_BITS) {
+            error(lineNumber, "signal " + signal.name + " does not fit in 8 bytes");
+            return false;
+        }
+        if (intel) {
+            // Little-endian: the following bytes hold higher bits, unlike the payload word.
+            // Whole bytes are bytes in order, unless all the signals of the message fit in a
+            // byte (see resolveInOrder())
+            if (startBit % 8 == 0 && signal.length % 8 == 0) {
+                if (startBit / 8 + signal.length / 8 > PAYLOAD_BYTES) {
+                    error(lineNumber, "signal " + signal.name + " runs past the last byte");
+                    return false;
+                }
+                signal.inOrder = true;
+                signal.startBit = 0;
+                signal.startByte = startBit / 8;
+                return true;
+            }
+            if (startBit % 8 + signal.length > 8) {
+                error(lineNumber, "signal " + signal.name +
+                                      " is a multi-byte Intel (@1) signal not on whole bytes, use Motorola (@0) "
+                                      "byte order");
+                return false;
+            }
+            signal.startBit = wordBit(startBit);
+            return true;
+        }
+        uint32_t msbBit = wordBit(startBit);
+        if (msbBit + 1 < signal.length) {
+            error(lineNumber, "signal " + signal.name + " runs past the last byte");
+            return false;
+        }
+        signal.startBit = msbBit + 1 - signal.length;
+        return true;
+    }
+
+    /**
+     * One byte Intel signals are bit fields of the payload word, as the Motorola ones,
+     * unless the message has longer bytes in order
+     */
+    static void resolveInOrder(Message& message) {
+        for (const Signal& signal : message.signals) {
+            if (signal.inOrder && signal.length > 8) {
+                return;
+            }
+        }
+        for (Signal& signal : message.signals) {
+            if (signal.inOrder) {
+                signal.inOrder = false;
+                signal.startBit = wordBit(signal.startByte * 8);
+                signal.startByte = 0;
+            }
+        }
+    }
+
+    Message* find(uint32_t dbcId) {
+        uint32_t id = dbcId & ~DBC_EXTENDED_ID_FLAG;
+        for (Message& message : m_messages) {
+            if (message.id == id) {
+                return &message;
+            }
+        }
+        return nullptr;
+    }
+
+    Signal* find(uint32_t dbcId, const std::string& name) {
+        Message* message = find(dbcId);
+        if (message == nullptr) {
+            return nullptr;
+        }
+        for (Signal& signal : message->signals) {
+            if (signal.name == name) {
+                return &signal;
+            }
+        }
+        return nullptr;
+    }
+
+    void error(int lineNumber, const std::string& text) {
+        fprintf(stderr, "line %d: %s\n", lineNumber, text.c_str());
+        m_errors++;
+    }
+
+    Database& m_database;
+    std::vector<Message>& m_messages;
+    int m_errors;
+};
+
+bool validIdentifier(const std::string& name) {
+    static const std::regex identifier(R"(^[A-Za-z_]\w*$)");
+    return std::regex_match(name, identifier);
+}
+
+/**
+ * @return false if a layout is wrong, the errors are printed
+ */
+bool checkMessages(const std::vector<Message>& messages) {
+    bool valid = true;
+    std::map<uint64_t, std::string> ids;
+    std::map<std::string, const Signal*> signalNames;
+
+    for (const Message& message : messages) {
+        uint64_t key = (static_cast<uint64_t>(message.extended) << 32) | message.id;
+        if (ids.count(key) != 0) {
+            fprintf(stderr, "%s: same id as %s\n", message.name.c_str(), ids[key].c_str());
+            valid = false;
+        }
+        ids[key] = message.name;
+
+        uint64_t used = 0;
+        uint32_t nextByte = 0;
+        bool inOrder = !message.signals.empty() && message.signals.front().inOrder;
+        for (const Signal& signal : message.signals) {
+            uint64_t bits = payloadBits(signal);
+            if (used & bits) {
+                fprintf(stderr, "%s: %s overlaps another signal\n", message.name.c_str(), signal.name.c_str());
+                valid = false;
+            }
+            used |= bits;
+
+            // CanMessageHandler::encodeMessage(lengthInBytes, data) writes from data[0]
+            if (signal.inOrder != inOrder || (inOrder && signal.startByte != nextByte)) {
+                fprintf(stderr, "%s: %s does not follow the previous signal, bytes in order start at byte 0\n",
+                        message.name.c_str(), signal.name.c_str());
+                valid = false;
+            }
+            nextByte = signal.startByte + signal.length / 8;
+
+            // Bytes past the length of the frame are the low bits of the payload word
+            uint32_t lastByte = signal.inOrder ? nextByte - 1 : 7 - signal.startBit / 8;
+            if (!isIndependent(message) && lastByte >= message.length) {
+                fprintf(stderr, "%s: %s is past the %d bytes of the frame\n", message.name.c_str(),
+                        signal.name.c_str(), message.length);
+                valid = false;
+            }
+
+            auto other = signalNames.find(signal.name);
+            if (other != signalNames.end() && (other->second->startBit != signal.startBit ||
+                                               other->second->length != signal.length ||
+                                               other->second->inOrder != signal.inOrder ||
+                                               other->second->startByte != signal.startByte ||
+                                               other->second->minimum != signal.minimum ||
+                                               other->second->maximum != signal.maximum ||
+                                               other->second->minimumName != signal.minimumName ||
+                                               other->second->maximumName != signal.maximumName)) {
+                fprintf(stderr, "%s: %s is defined with another layout in another message\n",
+                        message.name.c_str(), signal.name.c_str());
+                valid = false;
+            }
+            signalNames[signal.name] = &signal;
+        }
+    }
+    return valid;
+}
+
+/**
+ * Prints the bits used by each message and the unused bits between its signals
+ */
+void printLayouts(const std::vector<Message>& messages) {
+    for (const Message& message : messages) {
+        if (isIndependent(message)) {
+            continue;
+        }
+        uint64_t used = 0;
+        for (const Signal& signal : message.signals) {
+            used |= payloadBits(signal);
+        }
+        int gaps = 0;
+        for (uint32_t bit = 1; bit < PAYLOAD_BITS; bit++) {
+            // A gap starts at an unused bit above a used bit, with used bits higher up
+            if (!(used & (1ULL << bit)) && (used & (1ULL << (bit - 1))) && (used >> bit) != 0) {
+                gaps++;
+            }
+        }
+        printf("%-28s %5u  %2d/%d bits used, %d gap(s)\n", message.name.c_str(), message.id,
+               __builtin_popcountll(used), message.length * 8, gaps);
+    }
+}
+
+std::string camelCase(const std::string& name) {
+    std::string result;
+    bool upper = true;
+    for (char c : name) {
+        if (c == '_') {
+            upper = true;
+            continue;
+        }
+        result += static_cast<char>(upper ? toupper(c) : tolower(c));
+        upper = false;
+    }
+    return result;
+}
+
+const char* valueType(uint32_t length) {
+    if (length <= 8) {
+        return "uint8_t";
+    }
+    if (length <= 16) {
+        return "uint16_t";
+    }
+    return (length <= 32) ? "uint32_t" : "uint64_t";
+}
+
+bool isScaled(const Signal& signal) {
+    return signal.factor != 1 || signal.offset != 0;
+}
+
+bool isIntegral(double value) {
+    return std::floor(value) == value;
+}
+
+void writeHeaderStart(std::ostream& out, const char* file, const char* purpose, const char* guard,
+                      const std::string& source) {
+    out << "/****************************************************************************************\n"
+        << " *\n * File:\n *    " << file << "\n *\n * Purpose:\n *    " << purpose << "\n *\n"
+        << " * Developer Notes:\n *    Generated by tools/CanDbcTool from " << source
+        << ", do not edit.\n *\n"
+        << " ***************************************************************************************/\n\n"
+        << "#ifndef " << guard << "\n#define " << guard << "\n\n";
+}
+
+void writeIdDefs(const std::vector<Message>& messages, const std::string& source, std::ostream& out) {
+    writeHeaderStart(out, "canbus_id_defs.h", "Ids of the messages, shared by Arduino and RPI",
+                     "SAILINGROBOT_CANBUS_ID_DEFS_H", source);
+    for (const Message& message : messages) {
+        if (isIndependent(message)) {
+            continue;
+        }
+        out << "/*\n";
+        if (!message.comment.empty()) {
+            out << " *  " << message.comment << "\n";
+        }
+        out << " *  Contains the following information:\n";
+        for (const Signal& signal : message.signals) {
+            if (signal.inOrder) {
+                out << " *  " << signal.name << ", " << signal.length / 8 << " bytes in order\n";
+            } else {
+                out << " *  " << signal.name << ", " << signal.length << " bits\n";
+            }
+        }
+        out << " */\n#define MSG_ID_" << message.name << " " << message.id << "\n\n";
+    }
+    out << "#endif  // SAILINGROBOT_CANBUS_ID_DEFS_H\n";
+}
+
+void writeDataMappingDefs(const std::vector<Message>& messages, const std::string& source, std::ostream& out) {
+    writeHeaderStart(out, "canbus_datamappings_defs.h",
+                     "Position and interval of the fields, shared by Arduino and RPI",
+                     "SAILINGROBOT_CANBUS_DATAMAPPINGS_DEFS_H", source);
+    out << "#include <stdint.h>\n\n";
+
+    std::map<std::string, bool> written;
+    for (const Message& message : messages) {
+        if (message.signals.empty()) {
+            continue;
+        }
+        if (isIndependent(message)) {
+            out << "// Not placed in a message\n";
+        } else {
+            out << "// Used by " << message.name << " message\n";
+        }
+        if (message.signals.front().inOrder) {
+            out << "// Bytes in this order, see CanMessageHandler::encodeMessage(lengthInBytes, data)\n";
+        }
+        for (const Signal& signal : message.signals) {
+            if (written[signal.name]) {
+                out << "// " << signal.name << " defined above\n";
+                continue;
+            }
+            written[signal.name] = true;
+
+            if (signal.inOrder) {
+                out << "const int " << signal.name << "_DATASIZE = " << signal.length / 8 << ";\n";
+                if (!signal.comment.empty()) {
+                    out << "// " << signal.comment << "\n";
+                }
+                out << "\n";
+                continue;
+            }
+
+            bool inByte = signal.startBit % 8 == 0 && signal.length % 8 == 0;
+            uint32_t scale = inByte ? 8 : 1;
+            out << "const uint32_t " << signal.name << "_START = " << signal.startBit / scale << ";\n"
+                << "const uint32_t " << signal.name << "_DATASIZE = " << signal.length / scale << ";\n"
+                << "const bool " << signal.name << "_IN_BYTE = " << (inByte ? "true" : "false") << ";\n";
+            if (isScaled(signal)) {
+                const char* type = (isIntegral(signal.minimum) && isIntegral(signal.maximum)) ? "long int" : "float";
+                std::string minimumName = signal.minimumName.empty() ? defaultMinimumName(signal) : signal.minimumName;
+                std::string maximumName = signal.maximumName.empty() ? defaultMaximumName(signal) : signal.maximumName;
+                out << "const " << type << " " << minimumName << " = " << number(signal.minimum) << ";\n"
+                    << "const " << type << " " << maximumName << " = " << number(signal.maximum) << ";\n";
+            }
+            if (!signal.comment.empty()) {
+                out << "// " << signal.comment << "\n";
+            }
+            out << "\n";
+        }
+        out << "//-----------------------------------------------------------\n\n";
+    }
+    out << "#endif  // SAILINGROBOT_CANBUS_DATAMAPPINGS_DEFS_H\n";
+}
+
+/**
+ * Adds the values of an error signal or value table to the error codes
+ *
+ * @return false if a value is not an identifier or has another code
+ */
+bool addErrorCodes(const std::string& owner, const std::vector<SignalValue>& values,
+                   std::map<std::string, uint64_t>& codes, std::vector<std::string>& order) {
+    bool valid = true;
+    for (const SignalValue& value : values) {
+        if (!validIdentifier(value.name)) {
+            fprintf(stderr, "%s: error value \"%s\" is not an identifier\n", owner.c_str(), value.name.c_str());
+            valid = false;
+            continue;
+        }
+        auto code = codes.find(value.name);
+        if (code == codes.end()) {
+            codes[value.name] = value.value;
+            order.push_back(value.name);
+        } else if (code->second != value.value) {
+            fprintf(stderr, "%s: %s has two values\n", owner.c_str(), value.name.c_str());
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+bool writeErrorDefs(const Database& database, const std::string& source, std::ostream& out) {
+    std::map<std::string, uint64_t> codes;
+    std::vector<std::string> order;
+    bool valid = true;
+    for (const ValueTable& table : database.valueTables) {
+        if (isErrorName(table.name)) {
+            valid &= addErrorCodes(table.name, table.values, codes, order);
+        }
+    }
+    for (const Message& message : database.messages) {
+        for (const Signal& signal : message.signals) {
+            if (isErrorName(signal.name)) {
+                valid &= addErrorCodes(signal.name, signal.values, codes, order);
+            }
+        }
+    }
+
+    writeHeaderStart(out, "canbus_error_defs.h", "Error codes, shared by Arduino and RPI", "CANBUS_ERROR_DEFS_H",
+                     source);
+    for (const std::string& name : order) {
+        out << "#define " << name << " " << codes[name] << "\n";
+    }
+    out << "\n#endif\n";
+    return valid;
+}
+
+/**
+ * Functions of a signal of bytes in order: byte i of the value is CanMsg.data[startByte + i]
+ */
+void writeInOrderCodec(const Signal& signal, const std::string& name, std::ostream& out) {
+    char mask[24];
+    snprintf(mask, sizeof(mask), "0x%016llXULL", static_cast<unsigned long long>(payloadBits(signal)));
+    std::string decoded, encoded;
+    for (uint32_t i = 0; i < signal.length / 8; i++) {
+        std::string shift = std::to_string(byteShift(signal.startByte + i));
+        decoded += (i == 0 ? "" : " |\n           ") + std::string("(((payload >> ") + shift + ") & 0xFFULL) << " +
+                   std::to_string(8 * i) + ")";
+        encoded += " |\n           (((value >> " + std::to_string(8 * i) + ") & 0xFFULL) << " + shift + ")";
+    }
+    out << "constexpr " << valueType(signal.length) << " decode" << name << "(uint64_t payload) {\n"
+        << "    return static_cast<" << valueType(signal.length) << ">(" << decoded << ");\n}\n"
+        << "constexpr uint64_t encode" << name << "(uint64_t payload, uint64_t value) {\n"
+        << "    return (payload & ~" << mask << ")" << encoded << ";\n}\n\n";
+}
+
+void writeCodecDefs(const std::vector<Message>& messages, const std::string& source, std::ostream& out) {
+    writeHeaderStart(out, "canbus_codec_defs.h",
+                     "Shift and mask of every field on the payload word of CanPayload.h",
+                     "SAILINGROBOT_CANBUS_CODEC_DEFS_H", source);
+    out << "#include <stdint.h>\n\n";
+
+    std::map<std::string, bool> written;
+    for (const Message& message : messages) {
+        for (const Signal& signal : message.signals) {
+            if (written[signal.name]) {
+                continue;
+            }
+            written[signal.name] = true;
+
+            char mask[24];
+            snprintf(mask, sizeof(mask), "0x%llXULL", static_cast<unsigned long long>(rawMaximum(signal.length)));
+            std::string name = camelCase(signal.name);
+            if (signal.inOrder) {
+                out << "// " << signal.name << ", " << message.name << ", bytes in order\n";
+                writeInOrderCodec(signal, name, out);
+                continue;
+            }
+            out << "// " << signal.name << ", " << message.name << "\n"
+                << "constexpr " << valueType(signal.length) << " decode" << name << "(uint64_t payload) {\n"
+                << "    return static_cast<" << valueType(signal.length) << ">((payload >> " << signal.startBit
+                << ") & " << mask << ");\n}\n"
+                << "constexpr uint64_t encode" << name << "(uint64_t payload, uint64_t value) {\n"
+                << "    return (payload & ~(" << mask << " << " << signal.startBit << ")) | ((value & " << mask
+                << ") << " << signal.startBit << ");\n}\n\n";
+        }
+    }
+    out << "#endif  // SAILINGROBOT_CANBUS_CODEC_DEFS_H\n";
+}
+
+bool readDbc(const char* path, Database& database) {
+    std::ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    DbcParser parser(database);
+    bool parsed = parser.parse(in);
+    bool checked = checkMessages(database.messages);
+    for (const Message& message : database.messages) {
+        if (!validIdentifier(message.name)) {
+            fprintf(stderr, "%s: message name is not an identifier\n", message.name.c_str());
+            checked = false;
+        }
+    }
+    return parsed && checked;
+}
+
+bool writeFile(const std::string& path, const std::string& content) {
+    std::ofstream out(path);
+    out << content;
+    if (!out) {
+        fprintf(stderr, "cannot write %s\n", path.c_str());
+        return false;
+    }
+    printf("%s\n", path.c_str());
+    return true;
+}
+
+int exportDbc(const char* path) {
+    Database database = schemaDatabase();
+    if (!checkMessages(database.messages)) {
+        return 1;
+    }
+    std::ostringstream out;
+    writeDbc(database, out);
+    return writeFile(path, out.str()) ? 0 : 1;
+}
+
+int importDbc(const char* path, const std::string& directory) {
+    Database database;
+    if (!readDbc(path, database)) {
+        return 1;
+    }
+    const std::vector<Message>& messages = database.messages;
+    std::string source = path;
+    source = source.substr(source.find_last_of('/') + 1);
+
+    std::ostringstream idDefs, dataMappingDefs, errorDefs, codecDefs;
+    writeIdDefs(messages, source, idDefs);
+    writeDataMappingDefs(messages, source, dataMappingDefs);
+    bool errorsValid = writeErrorDefs(database, source, errorDefs);
+    writeCodecDefs(messages, source, codecDefs);
+    if (!errorsValid) {
+        return 1;
+    }
+
+    bool written = writeFile(directory + "/canbus_id_defs.h", idDefs.str()) &&
+                   writeFile(directory + "/canbus_datamappings_defs.h", dataMappingDefs.str()) &&
+                   writeFile(directory + "/canbus_error_defs.h", errorDefs.str()) &&
+                   writeFile(directory + "/canbus_codec_defs.h", codecDefs.str());
+    return written ? 0 : 1;
+}
+
+int checkDbc(const char* path) {
+    Database database;
+    bool valid = readDbc(path, database);
+    printLayouts(database.messages);
+    return valid ? 0 : 1;
+}
+
+void usage() {
+    fprintf(stderr,
+            "Usage: CanDbcTool export <file.dbc>\n"
+            "       CanDbcTool import <file.dbc> <output directory>\n"
+            "       CanDbcTool check <file.dbc>\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 3 && std::string(argv[1]) == "export") {
+        return exportDbc(argv[2]);
+    }
+    if (argc == 4 && std::string(argv[1]) == "import") {
+        return importDbc(argv[2], argv[3]);
+    }
+    if (argc == 3 && std::string(argv[1]) == "check") {
+        return checkDbc(argv[2]);
+    }
+    usage();
+    return 2;
+}